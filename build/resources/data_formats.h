@@ -22,7 +22,7 @@ namespace ShaderShared
         int3(int x_, int y_, int z_) : x(x_), y(y_), z(z_) {}
     };
 
-    __declspec(align(16)) struct int4
+    struct alignas(16) int4
     {
         int     x, y, z, w;
         int4() {}
@@ -46,7 +46,7 @@ namespace ShaderShared
         uint3(uint x_, uint y_, uint z_) : x(x_), y(y_), z(z_) {}
     };
 
-    __declspec(align(16)) struct uint4
+    struct alignas(16) uint4
     {
         uint     x, y, z, w;
         uint4() {}
@@ -87,7 +87,7 @@ namespace ShaderShared
         return r;
     }
 
-    __declspec(align(16)) struct float4
+    struct alignas(16) float4
     {
         float     x, y, z, w;
         float4() {}
@@ -377,7 +377,7 @@ void main(uint threadIdx : SV_GroupIndex)
     g_TelemetryData[dataIdx].T.w = g_FlightData[threadIdx].guidance[3].T - g_FlightData[threadIdx].guidance[3].t;
 
     float2 upVec = normalize(g_TelemetryData[dataIdx].eciPosition);
-    float h = max(length(g_TelemetryData[dataIdx].eciPosition) - Re, 0);
+    float h = length(g_TelemetryData[dataIdx].eciPosition) - Re;
 
     // Crash = freeze telemetry
     if (h < 0)
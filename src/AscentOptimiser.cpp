@@ -0,0 +1,402 @@
+#include "AscentOptimiser.h"
+#include "FlightAnalysis.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <random>
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+static const char* const c_OptimiserMethodNames[] = { "cmaes", "neldermead" };
+
+const char* GetOptimiserMethodName( OptimiserMethod method )
+{
+    return c_OptimiserMethodNames[uint32_t( method )];
+}
+
+bool ParseOptimiserMethod( const char* name, OptimiserMethod& method )
+{
+    for ( uint32_t i = 0; i < sizeof( c_OptimiserMethodNames ) / sizeof( c_OptimiserMethodNames[0] ); ++i )
+    {
+        if ( !strcmp( name, c_OptimiserMethodNames[i] ) )
+        {
+            method = OptimiserMethod( i );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+    // Pitch over speed and angle scaled to [0, 1] over the search ranges.
+    typedef std::array<double, 2>   Point;
+
+    // Flies a generation of candidates as one sweep and keeps the best flight seen.
+    class CandidateEvaluator
+    {
+    public:
+        CandidateEvaluator( SweepEngine& engine, const float minValues[2], const float maxValues[2], double earthRadius, double earthMu, OptimiserResult& result ) :
+            m_engine( engine ),
+            m_earthRadius( earthRadius ),
+            m_earthMu( earthMu ),
+            m_result( result )
+        {
+            for ( uint32_t j = 0; j < 2; ++j )
+            {
+                m_minValues[j] = minValues[j];
+                m_maxValues[j] = maxValues[j];
+            }
+        }
+
+        // Points outside the unit square are moved onto its edge, scores are CalcSelectionObjective.
+        void    Evaluate( std::vector<Point>& points, std::vector<double>& scores )
+        {
+            m_params.resize( points.size() );
+            for ( size_t i = 0; i < points.size(); ++i )
+            {
+                for ( double& x : points[i] )
+                    x = std::min( std::max( x, 0.0 ), 1.0 );
+
+                m_params[i] = MakeAscentParams( float( m_minValues[0] + points[i][0] * (m_maxValues[0] - m_minValues[0]) ),
+                                                float( m_minValues[1] + points[i][1] * (m_maxValues[1] - m_minValues[1]) ) );
+            }
+
+            m_engine.Run( m_params );
+
+            const std::vector<FlightData>& flightData = m_engine.GetFlightData();
+            scores.resize( points.size() );
+
+            for ( size_t i = 0; i < points.size(); ++i )
+            {
+                float score = CalcSelectionObjective( flightData[i], m_engine.GetMissionParams(), m_earthRadius, m_earthMu );
+                scores[i] = score;
+
+                if ( score < m_result.bestScore )
+                {
+                    m_result.bestScore = score;
+                    m_result.bestParams = m_params[i];
+                    m_result.bestData = flightData[i];
+                }
+            }
+
+            m_result.evaluations += static_cast<uint32_t>(points.size());
+            ++m_result.generations;
+        }
+
+    private:
+        SweepEngine&                m_engine;
+        double                      m_minValues[2];
+        double                      m_maxValues[2];
+        double                      m_earthRadius;
+        double                      m_earthMu;
+        OptimiserResult&            m_result;
+        std::vector<AscentParams>   m_params;
+    };
+
+    std::vector<uint32_t> SortByScore( const std::vector<double>& scores )
+    {
+        std::vector<uint32_t> order( scores.size() );
+        std::iota( order.begin(), order.end(), 0 );
+        std::stable_sort( order.begin(), order.end(), [&scores] ( uint32_t a, uint32_t b ) { return scores[a] < scores[b]; } );
+
+        return order;
+    }
+
+    //--------------------------------------------------------------------------------------------
+
+    // (mu/mu_w, lambda)-CMA-ES with the default parameters from Hansen's tutorial, for n = 2.
+    void RunCmaEs( CandidateEvaluator& evaluator, const OptimiserConfig& config, const double tolerance[2], OptimiserResult& result )
+    {
+        const double n = 2;
+        const uint32_t lambda = std::max( config.populationSize, 4u );
+        const uint32_t mu = lambda / 2;
+
+        std::vector<double> weights( mu );
+        for ( uint32_t i = 0; i < mu; ++i )
+            weights[i] = log( mu + 0.5 ) - log( i + 1.0 );
+
+        double weightSum = std::accumulate( weights.begin(), weights.end(), 0.0 );
+        double weightSquareSum = 0;
+        for ( double& w : weights )
+        {
+            w /= weightSum;
+            weightSquareSum += w * w;
+        }
+
+        const double muEff = 1 / weightSquareSum;
+        const double cSigma = (muEff + 2) / (n + muEff + 5);
+        const double dSigma = 1 + 2 * std::max( 0.0, sqrt( (muEff - 1) / (n + 1) ) - 1 ) + cSigma;
+        const double cc = (4 + muEff / n) / (n + 4 + 2 * muEff / n);
+        const double c1 = 2 / ((n + 1.3) * (n + 1.3) + muEff);
+        const double cMu = std::min( 1 - c1, 2 * (muEff - 2 + 1 / muEff) / ((n + 2) * (n + 2) + muEff) );
+        const double chiN = sqrt( n ) * (1 - 1 / (4 * n) + 1 / (21 * n * n));
+
+        Point mean = { 0.5, 0.5 };
+        double sigma = 0.3;
+        double C[2][2] = { { 1, 0 }, { 0, 1 } };
+        Point pc = { 0, 0 }, ps = { 0, 0 };
+
+        std::mt19937 rng( config.seed );
+        std::normal_distribution<double> normal;
+
+        std::vector<Point> points( lambda );
+        std::vector<double> scores;
+        std::vector<float> bestScores;      // After each generation
+
+        for ( uint32_t generation = 0; result.evaluations + lambda <= config.maxEvaluations; ++generation )
+        {
+            // C = B diag(D^2) B^T, in closed form for a symmetric 2x2.
+            double halfSum = (C[0][0] + C[1][1]) / 2;
+            double radius = sqrt( (C[0][0] - C[1][1]) * (C[0][0] - C[1][1]) / 4 + C[0][1] * C[0][1] );
+            double D[2] = { sqrt( std::max( halfSum + radius, 1e-30 ) ), sqrt( std::max( halfSum - radius, 1e-30 ) ) };
+
+            double bx = C[0][1], by = halfSum + radius - C[0][0];
+            if ( fabs( bx ) + fabs( by ) < 1e-30 )
+            {
+                bx = C[0][0] >= C[1][1] ? 1 : 0;
+                by = 1 - bx;
+            }
+            double bLength = sqrt( bx * bx + by * by );
+            const double B[2][2] = { { bx / bLength, -by / bLength }, { by / bLength, bx / bLength } };
+
+            for ( Point& x : points )
+            {
+                double z[2] = { D[0] * normal( rng ), D[1] * normal( rng ) };
+                x[0] = mean[0] + sigma * (B[0][0] * z[0] + B[0][1] * z[1]);
+                x[1] = mean[1] + sigma * (B[1][0] * z[0] + B[1][1] * z[1]);
+            }
+
+            // The evaluator moves points inside the square, the update uses them where they were flown.
+            evaluator.Evaluate( points, scores );
+            std::vector<uint32_t> order = SortByScore( scores );
+
+            Point yw = { 0, 0 };
+            double Cmu[2][2] = { { 0, 0 }, { 0, 0 } };
+            for ( uint32_t i = 0; i < mu; ++i )
+            {
+                const Point& x = points[order[i]];
+                double y[2] = { (x[0] - mean[0]) / sigma, (x[1] - mean[1]) / sigma };
+
+                for ( uint32_t r = 0; r < 2; ++r )
+                {
+                    yw[r] += weights[i] * y[r];
+                    for ( uint32_t c = 0; c < 2; ++c )
+                        Cmu[r][c] += weights[i] * y[r] * y[c];
+                }
+            }
+
+            mean[0] += sigma * yw[0];
+            mean[1] += sigma * yw[1];
+
+            // C^-1/2 yw = B diag(1/D) B^T yw
+            double t[2] = { (B[0][0] * yw[0] + B[1][0] * yw[1]) / D[0], (B[0][1] * yw[0] + B[1][1] * yw[1]) / D[1] };
+            double whitened[2] = { B[0][0] * t[0] + B[0][1] * t[1], B[1][0] * t[0] + B[1][1] * t[1] };
+
+            double psScale = sqrt( cSigma * (2 - cSigma) * muEff );
+            ps[0] = (1 - cSigma) * ps[0] + psScale * whitened[0];
+            ps[1] = (1 - cSigma) * ps[1] + psScale * whitened[1];
+            double psLength = sqrt( ps[0] * ps[0] + ps[1] * ps[1] );
+
+            bool hSigma = psLength / sqrt( 1 - pow( 1 - cSigma, 2.0 * (generation + 1) ) ) < (1.4 + 2 / (n + 1)) * chiN;
+
+            double pcScale = hSigma ? sqrt( cc * (2 - cc) * muEff ) : 0;
+            pc[0] = (1 - cc) * pc[0] + pcScale * yw[0];
+            pc[1] = (1 - cc) * pc[1] + pcScale * yw[1];
+
+            double lostVariance = hSigma ? 0 : cc * (2 - cc);
+            for ( uint32_t r = 0; r < 2; ++r )
+            {
+                for ( uint32_t c = 0; c < 2; ++c )
+                    C[r][c] = (1 - c1 - cMu) * C[r][c] + c1 * (pc[r] * pc[c] + lostVariance * C[r][c]) + cMu * Cmu[r][c];
+            }
+
+            sigma *= exp( (cSigma / dSigma) * (psLength / chiN - 1) );
+
+            if ( sigma * sqrt( C[0][0] ) < tolerance[0] && sigma * sqrt( C[1][1] ) < tolerance[1] )
+            {
+                result.converged = true;
+                return;
+            }
+
+            // Stalled at the objective's noise floor.
+            bestScores.push_back( result.bestScore );
+            if ( config.stallGenerations > 0 && bestScores.size() > config.stallGenerations && result.bestScore < FLT_MAX &&
+                 bestScores[bestScores.size() - 1 - config.stallGenerations] - result.bestScore < config.stallTolerance )
+            {
+                result.converged = true;
+                return;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------------
+
+    double RadicalInverse( uint32_t i, uint32_t base )
+    {
+        double inverse = 0, scale = 1.0 / base;
+        for ( ; i > 0; i /= base, scale /= base )
+            inverse += (i % base) * scale;
+
+        return inverse;
+    }
+
+    void RunNelderMead( CandidateEvaluator& evaluator, const OptimiserConfig& config, const double tolerance[2], OptimiserResult& result )
+    {
+        // Starting triangle, the best three of a Halton set over the whole square.
+        std::vector<Point> points( std::max( config.initialSamples, 3u ) );
+        for ( uint32_t i = 0; i < points.size(); ++i )
+            points[i] = { RadicalInverse( i + 1, 2 ), RadicalInverse( i + 1, 3 ) };
+
+        std::vector<double> scores;
+        evaluator.Evaluate( points, scores );
+        std::vector<uint32_t> order = SortByScore( scores );
+
+        Point simplex[3];
+        double simplexScores[3];
+        for ( uint32_t i = 0; i < 3; ++i )
+        {
+            simplex[i] = points[order[i]];
+            simplexScores[i] = scores[order[i]];
+        }
+
+        points.resize( 4 );
+
+        // The objective is noisy at the scale of the tolerances, and a triangle can collapse short of the
+        // optimum along the valley. Converging restarts it around its best point, until a restart gains nothing.
+        const double restartSize = 0.1;
+        const uint32_t maxRestarts = 4;
+        uint32_t restarts = 0;
+        float restartScore = FLT_MAX;
+
+        while ( result.evaluations + 4 <= config.maxEvaluations )
+        {
+            uint32_t v[3] = { 0, 1, 2 };
+            std::sort( v, v + 3, [&simplexScores] ( uint32_t a, uint32_t b ) { return simplexScores[a] < simplexScores[b]; } );
+
+            const Point& best = simplex[v[0]];
+            double spread[2] = { 0, 0 };
+            for ( const Point& x : simplex )
+            {
+                spread[0] = std::max( spread[0], fabs( x[0] - best[0] ) );
+                spread[1] = std::max( spread[1], fabs( x[1] - best[1] ) );
+            }
+
+            if ( spread[0] < tolerance[0] && spread[1] < tolerance[1] )
+            {
+                if ( result.bestScore >= restartScore || restarts == maxRestarts )
+                {
+                    result.converged = true;
+                    return;
+                }
+
+                restartScore = result.bestScore;
+                ++restarts;
+
+                std::vector<Point> corners( 2 );
+                corners[0] = { best[0] + (best[0] < 0.5 ? restartSize : -restartSize), best[1] };
+                corners[1] = { best[0], best[1] + (best[1] < 0.5 ? restartSize : -restartSize) };
+
+                std::vector<double> cornerScores;
+                evaluator.Evaluate( corners, cornerScores );
+
+                for ( uint32_t i = 0; i < 2; ++i )
+                {
+                    simplex[v[i + 1]] = corners[i];
+                    simplexScores[v[i + 1]] = cornerScores[i];
+                }
+                continue;
+            }
+
+            // Reflection, expansion, outside and inside contraction of the worst point through the others' centroid.
+            const Point& worst = simplex[v[2]];
+            Point centroid = { (best[0] + simplex[v[1]][0]) / 2, (best[1] + simplex[v[1]][1]) / 2 };
+            const double steps[4] = { 1, 2, 0.5, -0.5 };
+
+            for ( uint32_t i = 0; i < 4; ++i )
+            {
+                points[i][0] = centroid[0] + steps[i] * (centroid[0] - worst[0]);
+                points[i][1] = centroid[1] + steps[i] * (centroid[1] - worst[1]);
+            }
+
+            evaluator.Evaluate( points, scores );
+
+            const double reflected = scores[0];
+            int32_t accept = -1;
+
+            if ( reflected < simplexScores[v[0]] )
+                accept = scores[1] < reflected ? 1 : 0;
+            else if ( reflected < simplexScores[v[1]] )
+                accept = 0;
+            else if ( reflected < simplexScores[v[2]] )
+                accept = scores[2] <= reflected ? 2 : -1;
+            else
+                accept = scores[3] < simplexScores[v[2]] ? 3 : -1;
+
+            if ( accept >= 0 )
+            {
+                simplex[v[2]] = points[accept];
+                simplexScores[v[2]] = scores[accept];
+                continue;
+            }
+
+            // Shrink towards the best point.
+            if ( result.evaluations + 2 > config.maxEvaluations )
+                return;
+
+            std::vector<Point> shrunk( 2 );
+            for ( uint32_t i = 0; i < 2; ++i )
+            {
+                const Point& x = simplex[v[i + 1]];
+                shrunk[i] = { best[0] + (x[0] - best[0]) / 2, best[1] + (x[1] - best[1]) / 2 };
+            }
+
+            std::vector<double> shrunkScores;
+            evaluator.Evaluate( shrunk, shrunkScores );
+
+            for ( uint32_t i = 0; i < 2; ++i )
+            {
+                simplex[v[i + 1]] = shrunk[i];
+                simplexScores[v[i + 1]] = shrunkScores[i];
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+bool OptimiseAscent( SweepEngine& engine, const OptimiserConfig& config, float minSpeed, float maxSpeed, float minAngle, float maxAngle,
+                     double earthRadius, double earthMu, OptimiserResult& result )
+{
+    result = OptimiserResult{};
+    result.bestScore = FLT_MAX;
+
+    const float minValues[2] = { minSpeed, minAngle };
+    const float maxValues[2] = { maxSpeed, maxAngle };
+    const double tolerance[2] = { config.speedTolerance / std::max( double( maxSpeed - minSpeed ), 1e-6 ),
+                                  config.angleTolerance / std::max( double( maxAngle - minAngle ), 1e-6 ) };
+
+    CandidateEvaluator evaluator( engine, minValues, maxValues, earthRadius, earthMu, result );
+
+    switch ( config.method )
+    {
+    case OptimiserMethod::NelderMead:
+        RunNelderMead( evaluator, config, tolerance, result );
+        break;
+    default:
+        RunCmaEs( evaluator, config, tolerance, result );
+        break;
+    }
+
+    return result.bestScore < FLT_MAX;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "SweepEngine.h"
+
+//------------------------------------------------------------------------------------------------
+// Searches pitch over speed and angle for the profile the auto select would pick, without a grid.
+// Candidates are proposed a generation at a time and each generation is flown as one sweep, so the
+// engine's threads and batch kernels stay busy. Both methods minimise CalcSelectionObjective over the
+// given ranges, which they see scaled to the unit square.
+//
+// CMA-ES samples a population from a Gaussian and adapts its mean, step size and covariance to the
+// best half. Nelder-Mead moves a triangle downhill, flying reflection, expansion and both contractions
+// of the worst point together each generation; its first generation is a quasi-random population that
+// the starting triangle is picked from.
+//
+// The objective is only smooth down to about a quarter of a kg, as min mass moves a step's propellant at a
+// time, so CMA-ES also stops once its best has gained less than that over a number of generations rather
+// than narrowing to the tolerances among the noise. With the defaults both reach the grid sweep's best in
+// well under half the grid's flights, see --bench optimise.
+
+enum class OptimiserMethod : uint32_t
+{
+    CmaEs,
+    NelderMead,
+};
+
+const char* GetOptimiserMethodName( OptimiserMethod method );
+bool        ParseOptimiserMethod( const char* name, OptimiserMethod& method );
+
+struct OptimiserConfig
+{
+    OptimiserMethod method = OptimiserMethod::CmaEs;
+    uint32_t    populationSize = 8;             // CMA-ES generation
+    uint32_t    initialSamples = 32;            // Nelder-Mead's first generation
+    float       stallTolerance = 0.25f;         // CMA-ES converged once its best gains less than this, kg,
+    uint32_t    stallGenerations = 12;          // over this many generations
+    float       speedTolerance = 0.1f;          // Converged once the search is this narrow, m/s
+    float       angleTolerance = 1.745329e-4f;  // And this, radians (0.01 degrees)
+    uint32_t    maxEvaluations = 4096;
+    uint32_t    seed = 1;                       // CMA-ES sampling
+};
+
+struct OptimiserResult
+{
+    ShaderShared::AscentParams  bestParams;
+    ShaderShared::FlightData    bestData;
+    float       bestScore;      // CalcSelectionObjective, FLT_MAX if nothing reached MECO within the max Q limit
+    uint32_t    evaluations;    // Profiles flown
+    uint32_t    generations;    // Sweeps run
+    bool        converged;      // Otherwise stopped at maxEvaluations
+};
+
+// Angles in radians. Returns false if no candidate reached MECO within the max Q limit.
+bool    OptimiseAscent( SweepEngine& engine, const OptimiserConfig& config, float minSpeed, float maxSpeed, float minAngle, float maxAngle,
+                        double earthRadius, double earthMu, OptimiserResult& result );
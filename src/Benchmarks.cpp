@@ -0,0 +1,1966 @@
+#include "AscentOptimiser.h"
+#include "Benchmarks.h"
+#include "FlightAnalysis.h"
+#include "FlightDispersion.h"
+#include "FlightGradient.h"
+#include "SweepCache.h"
+#include "SweepDesign.h"
+#include "SweepRefinement.h"
+#include "SweepShards.h"
+#include "SweepSurrogate.h"
+#include "VehicleBatch.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+using namespace ShaderShared;
+
+static constexpr float  c_RadToDegree = 180.0f / 3.14159265f;
+
+//------------------------------------------------------------------------------------------------
+
+static double TimeSweep( SweepEngine& engine, const std::vector<AscentParams>& ascentParams )
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    engine.Run( ascentParams );
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+struct FlightDataDiff
+{
+    uint32_t    phaseDiffs = 0;
+    float       maxApDelta = 0;
+    float       maxPeDelta = 0;
+    float       maxAltitudeDelta = 0;
+    float       medianApDelta = 0;
+    float       medianPeDelta = 0;
+};
+
+static float CalcMedian( std::vector<float>& values )
+{
+    if ( values.empty() )
+        return 0;
+
+    std::nth_element( values.begin(), values.begin() + values.size() / 2, values.end() );
+    return values[values.size() / 2];
+}
+
+// Differences in flight phase, and in apoapsis and periapsis of the flights reaching MECO in both.
+static FlightDataDiff CompareFlightData( const std::vector<FlightData>& flightData, const std::vector<FlightData>& referenceData, uint32_t profileCount )
+{
+    FlightDataDiff diff;
+    std::vector<float> apDeltas;
+    std::vector<float> peDeltas;
+
+    for ( uint32_t i = 0; i < profileCount; ++i )
+    {
+        const FlightData& a = flightData[i];
+        const FlightData& b = referenceData[i];
+
+        if ( a.flightPhase != b.flightPhase )
+        {
+            ++diff.phaseDiffs;
+        }
+        else if ( a.flightPhase == c_PhaseMECO )
+        {
+            apDeltas.push_back( fabsf( (1 + a.e) * a.a - (1 + b.e) * b.a ) );
+            peDeltas.push_back( fabsf( (1 - a.e) * a.a - (1 - b.e) * b.a ) );
+
+            diff.maxApDelta = fmaxf( diff.maxApDelta, apDeltas.back() );
+            diff.maxPeDelta = fmaxf( diff.maxPeDelta, peDeltas.back() );
+            diff.maxAltitudeDelta = fmaxf( diff.maxAltitudeDelta, fabsf( a.maxAltitude - b.maxAltitude ) );
+        }
+    }
+
+    // A few flights only just make orbit and swing far on any change, the median shows the typical flight.
+    diff.medianApDelta = CalcMedian( apDeltas );
+    diff.medianPeDelta = CalcMedian( peDeltas );
+
+    return diff;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Runs the sweep once per SIMD level and compares each against the per profile FlightSimulator path.
+static bool BenchmarkSimd( const BenchmarkContext& context )
+{
+    // Every profile runs the full flight so the step rates compare like for like.
+    SweepConfig config = context.config;
+    config.recordTelemetry = false;
+    config.coastMode = CoastMode::Integrate;
+    config.simdLevel = SimdLevel::None;
+
+    SweepEngine reference( context.environment, context.missionParams, config, context.threadPool );
+    double referenceTime = TimeSweep( reference, context.ascentParams );
+
+    const std::vector<FlightData>& referenceData = reference.GetFlightData();
+    const uint32_t profileCount = reference.GetProfileCount();
+    const double profileSteps = double( profileCount ) * reference.GetTotalSteps();
+
+    printf( "%u profiles x %u steps on %u threads\n", profileCount, reference.GetTotalSteps(), context.threadPool.GetThreadCount() );
+    printf( "level    width  time (s)  Msteps/s  speedup  phase diffs  max dAp (m)  max dPe (m)  selected\n" );
+    printf( "%-8s %5u  %8.3f  %8.2f  %6.2fx  %11s  %11s  %11s  %8u\n", GetSimdLevelName( SimdLevel::None ), GetSimdLevelWidth( SimdLevel::None ), referenceTime, profileSteps / referenceTime * 1e-6, 1.0,
+            "-", "-", "-", reference.SelectBestProfile( context.earthRadius, context.earthMu ) );
+
+    for ( SimdLevel level : { SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512 } )
+    {
+        if ( !IsSimdLevelSupported( level ) )
+        {
+            printf( "%-8s not supported\n", GetSimdLevelName( level ) );
+            continue;
+        }
+
+        config.simdLevel = level;
+        SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+        double time = TimeSweep( engine, context.ascentParams );
+
+        // The kernel's acos differs from the library one by an ulp or so, which is enough to move phase changes by a step.
+        FlightDataDiff diff = CompareFlightData( engine.GetFlightData(), referenceData, profileCount );
+
+        printf( "%-8s %5u  %8.3f  %8.2f  %6.2fx  %11u  %11.1f  %11.1f  %8u\n", GetSimdLevelName( level ), GetSimdLevelWidth( level ),
+                time, profileSteps / time * 1e-6, referenceTime / time, diff.phaseDiffs, diff.maxApDelta, diff.maxPeDelta, engine.SelectBestProfile( context.earthRadius, context.earthMu ) );
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Sweeps in each coast mode against integrating the coast, on the per profile path and the best SIMD level.
+static bool BenchmarkCoast( const BenchmarkContext& context )
+{
+    printf( "level    coast      time (s)  lane steps (M)  speedup  phase diffs  max dAp (m)  max dPe (m)  max dAlt (m)  selected\n" );
+
+    for ( SimdLevel level : { SimdLevel::None, DetectSimdLevel() } )
+    {
+        SweepConfig config = context.config;
+        config.recordTelemetry = false;
+        config.simdLevel = level;
+        config.coastMode = CoastMode::Integrate;
+
+        SweepEngine reference( context.environment, context.missionParams, config, context.threadPool );
+        double referenceTime = TimeSweep( reference, context.ascentParams );
+
+        printf( "%-8s %-9s  %8.3f  %14.1f  %6.2fx  %11s  %11s  %11s  %12s  %8u\n", GetSimdLevelName( level ), GetCoastModeName( config.coastMode ), referenceTime,
+                reference.GetLaneSteps() * 1e-6, 1.0, "-", "-", "-", "-", reference.SelectBestProfile( context.earthRadius, context.earthMu ) );
+
+        // The integrated coast drifts a and e a little, and freezing stops maxAltitude at the MECO altitude.
+        for ( CoastMode mode : { CoastMode::Freeze, CoastMode::Kepler } )
+        {
+            config.coastMode = mode;
+            SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+            double time = TimeSweep( engine, context.ascentParams );
+
+            FlightDataDiff diff = CompareFlightData( engine.GetFlightData(), reference.GetFlightData(), reference.GetProfileCount() );
+
+            printf( "%-8s %-9s  %8.3f  %14.1f  %6.2fx  %11u  %11.1f  %11.1f  %12.1f  %8u\n", GetSimdLevelName( level ), GetCoastModeName( mode ), time,
+                    engine.GetLaneSteps() * 1e-6, referenceTime / time, diff.phaseDiffs, diff.maxApDelta, diff.maxPeDelta, diff.maxAltitudeDelta,
+                    engine.SelectBestProfile( context.earthRadius, context.earthMu ) );
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Fixed step Euler against Euler at a tenth of the step, and adaptive Dormand-Prince at a few tolerances against
+// a much tighter one. The two integrators steer slightly differently (see FlightAdaptive.h), so each is measured
+// against its own converged flight, then the converged flights against each other.
+static bool BenchmarkAdaptive( const BenchmarkContext& context )
+{
+    struct Run
+    {
+        FlightIntegrator    integrator;
+        SimdLevel           simdLevel;
+        float               stepSize;
+        double              tolerance;
+    };
+
+    const float stepSize = context.config.simulationStepSize;
+    const Run runs[] =
+    {
+        { FlightIntegrator::Euler, DetectSimdLevel(), stepSize / 10, 0 },       // Euler reference
+        { FlightIntegrator::Euler, SimdLevel::None, stepSize, 0 },
+        { FlightIntegrator::Euler, DetectSimdLevel(), stepSize, 0 },
+        { FlightIntegrator::Dopri5, SimdLevel::None, stepSize, 1e-9 },          // Dormand-Prince reference
+        { FlightIntegrator::Dopri5, SimdLevel::None, stepSize, 1e-5 },
+        { FlightIntegrator::Dopri5, SimdLevel::None, stepSize, 1e-6 },
+        { FlightIntegrator::Dopri5, SimdLevel::None, stepSize, 1e-7 },
+        { FlightIntegrator::Dopri5, SimdLevel::None, stepSize, 1e-8 },
+    };
+
+    std::vector<FlightData> referenceData[4];
+    uint32_t profileCount = 0;
+
+    printf( "%s coast on %u threads, dAp and dPe as median / max\n", GetCoastModeName( context.config.coastMode ), context.threadPool.GetThreadCount() );
+    printf( "integrator  step (s)  tolerance  time (s)  steps/flight  phase diffs      dAp (m)          dPe (m)  selected\n" );
+
+    for ( const Run& run : runs )
+    {
+        SweepConfig config = context.config;
+        config.recordTelemetry = false;
+        config.integrator = run.integrator;
+        config.simdLevel = run.simdLevel;
+        config.simulationStepSize = run.stepSize;
+        config.telemetryStepSize = uint32_t( context.config.telemetryStepSize * stepSize / run.stepSize + 0.5f );
+        config.tolerance = run.tolerance;
+
+        SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+        double time = TimeSweep( engine, context.ascentParams );
+        profileCount = engine.GetProfileCount();
+
+        const char* name = run.integrator == FlightIntegrator::Euler ? GetSimdLevelName( engine.GetSimdLevel() ) : GetFlightIntegratorName( run.integrator );
+        printf( "%-10s  %8.3f  %9.0e  %8.3f  %12.0f", name, run.stepSize, run.tolerance, time, double( engine.GetLaneSteps() ) / profileCount );
+
+        std::vector<FlightData>& reference = referenceData[uint32_t( run.integrator )];
+        if ( reference.empty() )
+        {
+            reference = engine.GetFlightData();
+            printf( "  %11s  %15s  %15s", "reference", "-", "-" );
+        }
+        else
+        {
+            FlightDataDiff diff = CompareFlightData( engine.GetFlightData(), reference, profileCount );
+            printf( "  %11u  %6.1f / %6.0f  %6.1f / %6.0f", diff.phaseDiffs, diff.medianApDelta, diff.maxApDelta, diff.medianPeDelta, diff.maxPeDelta );
+        }
+
+        printf( "  %8u\n", engine.SelectBestProfile( context.earthRadius, context.earthMu ) );
+    }
+
+    FlightDataDiff diff = CompareFlightData( referenceData[uint32_t( FlightIntegrator::Dopri5 )], referenceData[uint32_t( FlightIntegrator::Euler )], profileCount );
+    printf( "dopri5 against euler references: %u phase diffs, dAp %.1f / %.0f m, dPe %.1f / %.0f m\n", diff.phaseDiffs,
+            diff.medianApDelta, diff.maxApDelta, diff.medianPeDelta, diff.maxPeDelta );
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Each fixed step integrator at a few step sizes against Yoshida4 at a tenth of the configured step, all on
+// the per profile path.
+static bool BenchmarkIntegrators( const BenchmarkContext& context )
+{
+    const float baseStep = context.config.simulationStepSize;
+    const float sampleInterval = baseStep * context.config.telemetryStepSize;
+
+    SweepConfig config = context.config;
+    config.recordTelemetry = false;
+    config.simdLevel = SimdLevel::None;
+    config.integrator = FlightIntegrator::Yoshida4;
+    config.simulationStepSize = baseStep / 10;
+    config.telemetryStepSize = context.config.telemetryStepSize * 10;
+
+    SweepEngine reference( context.environment, context.missionParams, config, context.threadPool );
+    double referenceTime = TimeSweep( reference, context.ascentParams );
+
+    const uint32_t profileCount = reference.GetProfileCount();
+
+    printf( "%u profiles, %s coast on %u threads, reference %s at %g s: %.3f s, selected %u\n", profileCount, GetCoastModeName( config.coastMode ), context.threadPool.GetThreadCount(),
+            GetFlightIntegratorName( config.integrator ), config.simulationStepSize, referenceTime, reference.SelectBestProfile( context.earthRadius, context.earthMu ) );
+    printf( "integrator  step (s)  time (s)  steps/flight  phase diffs      dAp (m)          dPe (m)  selected\n" );
+
+    for ( FlightIntegrator integrator : { FlightIntegrator::Euler, FlightIntegrator::Verlet, FlightIntegrator::Yoshida4 } )
+    {
+        for ( float stepScale : { 1.0f, 2.5f, 5.0f, 10.0f } )
+        {
+            // Telemetry sampling only sets the step count, keep it at the same interval.
+            config.integrator = integrator;
+            config.simulationStepSize = baseStep * stepScale;
+            config.telemetryStepSize = std::max( uint32_t( sampleInterval / config.simulationStepSize + 0.5f ), 1u );
+
+            SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+            double time = TimeSweep( engine, context.ascentParams );
+
+            FlightDataDiff diff = CompareFlightData( engine.GetFlightData(), reference.GetFlightData(), profileCount );
+
+            printf( "%-10s  %8.3f  %8.3f  %12.0f  %11u  %6.1f / %6.0f  %6.1f / %6.0f  %8u\n", GetFlightIntegratorName( integrator ), config.simulationStepSize, time,
+                    double( engine.GetLaneSteps() ) / profileCount, diff.phaseDiffs, diff.medianApDelta, diff.maxApDelta, diff.medianPeDelta, diff.maxPeDelta,
+                    engine.SelectBestProfile( context.earthRadius, context.earthMu ) );
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Sweeps with the vertical climb flown once per profile against flying it once for the whole sweep, on each
+// fixed step path. Forking off the shared climb should leave every flight as it was.
+static bool BenchmarkLiftoff( const BenchmarkContext& context )
+{
+    struct Run
+    {
+        FlightIntegrator    integrator;
+        SimdLevel           simdLevel;
+    };
+
+    const Run runs[] =
+    {
+        { FlightIntegrator::Euler, SimdLevel::None },
+        { FlightIntegrator::Euler, DetectSimdLevel() },
+        { FlightIntegrator::Yoshida4, SimdLevel::None },
+    };
+
+    printf( "%s coast on %u threads\n", GetCoastModeName( context.config.coastMode ), context.threadPool.GetThreadCount() );
+    printf( "integrator  level     shared  time (s)  lane steps (M)  speedup  phase diffs  max dAp (m)  max dPe (m)  selected\n" );
+
+    for ( const Run& run : runs )
+    {
+        SweepConfig config = context.config;
+        config.recordTelemetry = false;
+        config.integrator = run.integrator;
+        config.simdLevel = run.simdLevel;
+        config.shareLiftoff = false;
+
+        // Warm starts are offered between batches, and forking off the shared climb moves where the sweep's
+        // batches fall, so with them on the two sweeps seed some profiles differently.
+        config.warmStartGuidance = false;
+
+        SweepEngine reference( context.environment, context.missionParams, config, context.threadPool );
+        double referenceTime = TimeSweep( reference, context.ascentParams );
+
+        printf( "%-10s  %-8s  %6s  %8.3f  %14.2f  %6.2fx  %11s  %11s  %11s  %8u\n", GetFlightIntegratorName( run.integrator ), GetSimdLevelName( reference.GetSimdLevel() ), "no",
+                referenceTime, reference.GetLaneSteps() * 1e-6, 1.0, "-", "-", "-", reference.SelectBestProfile( context.earthRadius, context.earthMu ) );
+
+        config.shareLiftoff = true;
+        SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+        double time = TimeSweep( engine, context.ascentParams );
+
+        FlightDataDiff diff = CompareFlightData( engine.GetFlightData(), reference.GetFlightData(), reference.GetProfileCount() );
+
+        printf( "%-10s  %-8s  %6s  %8.3f  %14.2f  %6.2fx  %11u  %11.1f  %11.1f  %8u\n", GetFlightIntegratorName( run.integrator ), GetSimdLevelName( engine.GetSimdLevel() ), "yes",
+                time, engine.GetLaneSteps() * 1e-6, referenceTime / time, diff.phaseDiffs, diff.maxApDelta, diff.maxPeDelta, engine.SelectBestProfile( context.earthRadius, context.earthMu ) );
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Guidance solves started cold against seeding them from neighbouring profiles as they converge, then from
+// the previous sweep's solves by running the same sweep again.
+static bool BenchmarkGuidance( const BenchmarkContext& context )
+{
+    printf( "%s coast on %u threads, dAp and dPe as median / max\n", GetCoastModeName( context.config.coastMode ), context.threadPool.GetThreadCount() );
+    printf( "level    seeds       time (s)  solves  iterations  per solve  saved  phase diffs          dAp (m)          dPe (m)  selected\n" );
+
+    for ( SimdLevel level : { SimdLevel::None, DetectSimdLevel() } )
+    {
+        SweepConfig config = context.config;
+        config.recordTelemetry = false;
+        config.simdLevel = level;
+        config.warmStartGuidance = false;
+
+        SweepEngine reference( context.environment, context.missionParams, config, context.threadPool );
+        double referenceTime = TimeSweep( reference, context.ascentParams );
+
+        const uint64_t coldIterations = reference.GetGuidanceIterations();
+
+        printf( "%-8s %-10s  %8.3f  %6u  %10llu  %9.2f  %5s  %11s  %15s  %15s  %8u\n", GetSimdLevelName( reference.GetSimdLevel() ), "cold", referenceTime,
+                reference.GetGuidanceSolveCount(), (unsigned long long)coldIterations, double( coldIterations ) / std::max( reference.GetGuidanceSolveCount(), 1u ),
+                "-", "-", "-", "-", reference.SelectBestProfile( context.earthRadius, context.earthMu ) );
+
+        config.warmStartGuidance = true;
+        SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+
+        for ( const char* seeds : { "neighbours", "previous" } )
+        {
+            double time = TimeSweep( engine, context.ascentParams );
+            FlightDataDiff diff = CompareFlightData( engine.GetFlightData(), reference.GetFlightData(), reference.GetProfileCount() );
+
+            const uint64_t iterations = engine.GetGuidanceIterations();
+
+            printf( "%-8s %-10s  %8.3f  %6u  %10llu  %9.2f  %4.0f%%  %11u  %6.1f / %6.0f  %6.1f / %6.0f  %8u\n", GetSimdLevelName( engine.GetSimdLevel() ), seeds, time,
+                    engine.GetGuidanceSolveCount(), (unsigned long long)iterations, double( iterations ) / std::max( engine.GetGuidanceSolveCount(), 1u ),
+                    100.0 * (1.0 - double( iterations ) / std::max( coldIterations, uint64_t( 1 ) )), diff.phaseDiffs, diff.medianApDelta, diff.maxApDelta,
+                    diff.medianPeDelta, diff.maxPeDelta, engine.SelectBestProfile( context.earthRadius, context.earthMu ) );
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Same curves without the segment index, so every evaluation searches the keys.
+static FlightEnvironment CopyUncompiled( const FlightEnvironment& environment )
+{
+    FlightEnvironment copy;
+    copy.params = environment.params;
+    copy.pressureHeight.keys = environment.pressureHeight.keys;
+    copy.temperatureHeight.keys = environment.temperatureHeight.keys;
+
+    for ( uint32_t stage = 0; stage < 4; ++stage )
+    {
+        copy.liftMach[stage].keys = environment.liftMach[stage].keys;
+        copy.dragMach[stage].keys = environment.dragMach[stage].keys;
+    }
+
+    return copy;
+}
+
+// Nanoseconds per Evaluate at evenly spread x across the curve and a little past each end.
+static double TimeCurve( const HermiteCurve& curve, float& checksum )
+{
+    const uint32_t sampleCount = 1 << 20;
+    const float x0 = curve.keys.front().x;
+    const float x1 = curve.keys.back().x;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Stride through the range so consecutive samples land in unrelated segments.
+    float sum = 0;
+    for ( uint32_t i = 0; i < sampleCount; ++i )
+        sum += curve.Evaluate( lerp( x0, x1, float( (i * 7919u) % sampleCount ) * (1.1f / sampleCount) - 0.05f ) );
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    checksum = sum;
+
+    return elapsed.count() * 1e9 / sampleCount;
+}
+
+// Evaluate cost of each curve searched and compiled, then sweeps with the environment searched and compiled.
+static bool BenchmarkCurves( const BenchmarkContext& context )
+{
+    const FlightEnvironment searched = CopyUncompiled( context.environment );
+
+    struct NamedCurve
+    {
+        const char*     name;
+        const HermiteCurve& searched;
+        const HermiteCurve& compiled;
+    };
+
+    const NamedCurve curves[] =
+    {
+        { "pressure", searched.pressureHeight, context.environment.pressureHeight },
+        { "temperature", searched.temperatureHeight, context.environment.temperatureHeight },
+        { "drag S1", searched.dragMach[0], context.environment.dragMach[0] },
+        { "drag S2", searched.dragMach[1], context.environment.dragMach[1] },
+    };
+
+    printf( "curve         keys  cells  max walk  max error  search (ns)  index (ns)  speedup\n" );
+
+    for ( const NamedCurve& curve : curves )
+    {
+        if ( curve.compiled.keys.size() < 2 )
+            continue;
+
+        HermiteCurve check = curve.compiled;
+        float maxError = check.Compile();
+
+        float searchSum, indexSum;
+        double searchTime = TimeCurve( curve.searched, searchSum );
+        double indexTime = TimeCurve( curve.compiled, indexSum );
+
+        printf( "%-12s %5zu  %5zu  %8u  %9g  %11.2f  %10.2f  %6.2fx%s\n", curve.name, curve.compiled.keys.size(), curve.compiled.GetSegmentIndex().size(),
+                curve.compiled.GetMaxWalk(), maxError, searchTime, indexTime, searchTime / indexTime, searchSum == indexSum ? "" : "  (sums differ)" );
+    }
+
+    printf( "\nlevel    curves    time (s)  speedup  phase diffs  max dAp (m)  max dPe (m)  selected\n" );
+
+    for ( SimdLevel level : { SimdLevel::None, DetectSimdLevel() } )
+    {
+        SweepConfig config = context.config;
+        config.recordTelemetry = false;
+        config.simdLevel = level;
+
+        SweepEngine reference( searched, context.missionParams, config, context.threadPool );
+        double referenceTime = TimeSweep( reference, context.ascentParams );
+
+        printf( "%-8s %-8s  %8.3f  %6.2fx  %11s  %11s  %11s  %8u\n", GetSimdLevelName( reference.GetSimdLevel() ), "searched", referenceTime, 1.0,
+                "-", "-", "-", reference.SelectBestProfile( context.earthRadius, context.earthMu ) );
+
+        SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+        double time = TimeSweep( engine, context.ascentParams );
+
+        FlightDataDiff diff = CompareFlightData( engine.GetFlightData(), reference.GetFlightData(), reference.GetProfileCount() );
+
+        printf( "%-8s %-8s  %8.3f  %6.2fx  %11u  %11.1f  %11.1f  %8u\n", GetSimdLevelName( engine.GetSimdLevel() ), "compiled", time, referenceTime / time,
+                diff.phaseDiffs, diff.maxApDelta, diff.maxPeDelta, engine.SelectBestProfile( context.earthRadius, context.earthMu ) );
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Resamples a curve to keyCount evenly spaced keys with fresh interpolants, as a Mach sweep csv that dense would load.
+static void ResampleCurve( HermiteCurve& curve, uint32_t keyCount )
+{
+    const float x0 = curve.keys.front().x;
+    const float x1 = curve.keys.back().x;
+
+    std::vector<float4> keys;
+    for ( uint32_t i = 0; i < keyCount; ++i )
+    {
+        float x = lerp( x0, x1, float( i ) / (keyCount - 1) );
+        keys.emplace_back( x, curve.Evaluate( x ), 0.0f, 0.0f );
+    }
+
+    GenerateMonotonicInterpolants( keys );
+    FixupHermiteTangents( keys );
+
+    curve.keys = keys;
+    curve.Compile();
+}
+
+// Nanoseconds per Evaluate over machs, searched, through the segment index and walking a cursor.
+static void TimeCurveLookups( const HermiteCurve& searched, const HermiteCurve& compiled, const std::vector<float>& machs, double times[3], bool& match )
+{
+    const uint32_t repeats = std::max( (1u << 22) / uint32_t( machs.size() ), 1u );
+    float sums[3] = {};
+
+    for ( uint32_t method = 0; method < 3; ++method )
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        float sum = 0;
+        for ( uint32_t r = 0; r < repeats; ++r )
+        {
+            uint32_t cursor = 0;
+            for ( float M : machs )
+            {
+                if ( method == 0 )
+                    sum += searched.Evaluate( M );
+                else if ( method == 1 )
+                    sum += compiled.Evaluate( M );
+                else
+                    sum += searched.Evaluate( M, cursor );
+            }
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        times[method] = elapsed.count() * 1e9 / (double( repeats ) * machs.size());
+        sums[method] = sum;
+    }
+
+    match = sums[0] == sums[1] && sums[0] == sums[2];
+}
+
+// Drag curve lookups along a flight's Mach history, per step, on the bundled Mach sweep and one resampled to
+// 1000 keys, then sweeps on the dense curves with them searched and compiled.
+static bool BenchmarkCursor( const BenchmarkContext& context )
+{
+    // The Mach number at every step of the middle profile, which crosses the transonic keys twice or so.
+    std::vector<float> machs;
+    {
+        FlightSimulator simulator( context.environment, context.missionParams, context.config.simulationStepSize );
+        const AscentParams& ascentParams = context.ascentParams[context.ascentParams.size() / 2];
+
+        TelemetryData state;
+        FlightData flightData;
+        simulator.InitFlight( ascentParams, state, flightData );
+
+        const uint32_t totalSteps = uint32_t( context.config.flightTime / context.config.simulationStepSize + 0.5f );
+        for ( uint32_t step = 0; step < totalSteps && !simulator.IsFlightTerminal( state, flightData ); ++step )
+        {
+            simulator.StepFlight( ascentParams, state, flightData );
+
+            float h = length( state.eciPosition ) - context.environment.params.Re;
+            machs.push_back( length( state.surfVelocity ) / context.environment.GetSpeedOfSound( context.environment.GetTemperature( h ) ) );
+        }
+    }
+
+    if ( machs.empty() || context.environment.dragMach[0].keys.size() < 2 )
+    {
+        fprintf( stderr, "No powered flight or no stage 1 drag curve to benchmark.\n" );
+        return false;
+    }
+
+    // Same Mach numbers in an order with no locality.
+    std::vector<float> shuffled = machs;
+    for ( size_t i = 0; i < shuffled.size(); ++i )
+        std::swap( shuffled[i], shuffled[(i * 7919u) % shuffled.size()] );
+
+    FlightEnvironment dense = CopyUncompiled( context.environment );
+    for ( uint32_t stage = 0; stage < 4; ++stage )
+    {
+        if ( dense.dragMach[stage].keys.size() > 1 )
+            ResampleCurve( dense.dragMach[stage], 1000 );
+    }
+
+    printf( "%zu steps of powered flight\n", machs.size() );
+    printf( "curve        keys  order     search (ns)  index (ns)  cursor (ns)  match\n" );
+
+    const HermiteCurve* const curves[] = { &context.environment.dragMach[0], &dense.dragMach[0] };
+
+    for ( const HermiteCurve* curve : curves )
+    {
+        HermiteCurve searched;
+        searched.keys = curve->keys;
+
+        for ( const std::vector<float>* order : { &machs, &shuffled } )
+        {
+            double times[3];
+            bool match;
+            TimeCurveLookups( searched, *curve, *order, times, match );
+
+            printf( "%-10s %6zu  %-8s  %11.2f  %10.2f  %11.2f  %5s\n", curve == &dense.dragMach[0] ? "drag dense" : "drag S1", curve->keys.size(),
+                    order == &machs ? "flight" : "shuffled", times[0], times[1], times[2], match ? "yes" : "no" );
+        }
+    }
+
+    // Sweeps on the dense curves, searching 1000 keys per lookup, through the index and walking cursors.
+    const FlightEnvironment denseSearched = CopyUncompiled( dense );
+    dense.Compile();
+
+    struct SweepCase
+    {
+        const char*         name;
+        const FlightEnvironment& environment;
+        SimdLevel           simdLevel;
+        bool                curveCursors;
+    };
+
+    const SweepCase cases[] =
+    {
+        { "search", denseSearched, SimdLevel::None, false },
+        { "index", dense, SimdLevel::None, false },
+        { "cursor", dense, SimdLevel::None, true },
+        { "search", denseSearched, DetectSimdLevel(), false },
+        { "index", dense, DetectSimdLevel(), false },
+    };
+
+    printf( "\nlevel    lookup  time (s)  speedup  phase diffs  selected\n" );
+
+    SweepConfig config = context.config;
+    config.recordTelemetry = false;
+
+    std::unique_ptr<SweepEngine> reference;
+    double referenceTime = 0;
+
+    for ( const SweepCase& sweepCase : cases )
+    {
+        config.simdLevel = sweepCase.simdLevel;
+        config.curveCursors = sweepCase.curveCursors;
+
+        std::unique_ptr<SweepEngine> engine = std::make_unique<SweepEngine>( sweepCase.environment, context.missionParams, config, context.threadPool );
+        double time = TimeSweep( *engine, context.ascentParams );
+
+        // Each level is checked against its own search, the batch kernels round differently to the per profile path.
+        if ( &sweepCase.environment == &denseSearched )
+        {
+            reference = std::move( engine );
+            referenceTime = time;
+
+            printf( "%-8s %-6s  %8.3f  %6.2fx  %11s  %8u\n", GetSimdLevelName( reference->GetSimdLevel() ), sweepCase.name, time, 1.0, "-",
+                    reference->SelectBestProfile( context.earthRadius, context.earthMu ) );
+            continue;
+        }
+
+        FlightDataDiff diff = CompareFlightData( engine->GetFlightData(), reference->GetFlightData(), reference->GetProfileCount() );
+
+        printf( "%-8s %-6s  %8.3f  %6.2fx  %11u  %8u\n", GetSimdLevelName( engine->GetSimdLevel() ), sweepCase.name, time, referenceTime / time, diff.phaseDiffs,
+                engine->SelectBestProfile( context.earthRadius, context.earthMu ) );
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Sweep time and telemetry size with and without telemetry, then the middle profile's decoded samples against
+// the full records stepping it on its own writes.
+static bool BenchmarkTelemetry( const BenchmarkContext& context )
+{
+    // Cold guidance solves so the profile on its own flies exactly as it does in the per profile sweep.
+    SweepConfig config = context.config;
+    config.warmStartGuidance = false;
+
+    printf( "level    telemetry  time (s)  size (MB)  full records (MB)\n" );
+
+    std::unique_ptr<SweepEngine> perProfile;
+
+    for ( SimdLevel level : { SimdLevel::None, DetectSimdLevel() } )
+    {
+        for ( bool recordTelemetry : { false, true } )
+        {
+            config.simdLevel = level;
+            config.recordTelemetry = recordTelemetry;
+
+            std::unique_ptr<SweepEngine> engine = std::make_unique<SweepEngine>( context.environment, context.missionParams, config, context.threadPool );
+            double time = TimeSweep( *engine, context.ascentParams );
+
+            size_t fullBytes = recordTelemetry ? size_t( engine->GetProfileCount() ) * engine->GetTelemetryMaxSamples() * sizeof( TelemetryData ) : 0;
+            printf( "%-8s %-9s  %8.3f  %9.1f  %17.1f\n", GetSimdLevelName( engine->GetSimdLevel() ), recordTelemetry ? "on" : "off", time,
+                    engine->GetTelemetryBytes() / 1e6, fullBytes / 1e6 );
+
+            if ( recordTelemetry && level == SimdLevel::None )
+                perProfile = std::move( engine );
+        }
+    }
+
+    const uint32_t profile = perProfile->GetProfileCount() / 2;
+    const AscentParams& ascentParams = context.ascentParams[profile];
+
+    FlightSimulator simulator( context.environment, context.missionParams, config.simulationStepSize );
+
+    TelemetryData state;
+    FlightData flightData;
+    simulator.InitFlight( ascentParams, state, flightData );
+
+    float maxPositionError = 0, maxVelocityError = 0, maxSurfVelocityError = 0, maxMassError = 0;
+    float maxHeadingError = 0, maxPitchError = 0;
+    uint32_t enumDiffs = 0, sampleCount = 0;
+
+    const std::vector<TelemetryData> samples = perProfile->GetProfileTelemetry( profile );
+    const uint32_t totalSteps = perProfile->GetTotalSteps();
+    for ( uint32_t step = 0; step < totalSteps && !simulator.IsFlightTerminal( state, flightData ); ++step )
+    {
+        simulator.StepFlight( ascentParams, state, flightData );
+
+        if ( (step % config.telemetryStepSize) != config.telemetryStepSize - 1 )
+            continue;
+
+        const TelemetryData& sample = samples[step / config.telemetryStepSize];
+
+        maxPositionError = fmaxf( maxPositionError, length( sample.eciPosition - state.eciPosition ) );
+        maxVelocityError = fmaxf( maxVelocityError, length( sample.eciVelocity - state.eciVelocity ) );
+        maxSurfVelocityError = fmaxf( maxSurfVelocityError, length( sample.surfVelocity - state.surfVelocity ) );
+        maxMassError = fmaxf( maxMassError, fabsf( sample.mass - state.mass ) );
+        maxHeadingError = fmaxf( maxHeadingError, fabsf( atan2f( sample.heading.x * state.heading.y - sample.heading.y * state.heading.x, dot( sample.heading, state.heading ) ) ) );
+        maxPitchError = fmaxf( maxPitchError, fabsf( sample.guidancePitch - state.guidancePitch ) );
+        enumDiffs += sample.stage != state.stage || sample.flightPhase != state.flightPhase;
+        ++sampleCount;
+    }
+
+    printf( "\nprofile %u, %u powered samples decoded against full records\n", profile, sampleCount );
+    printf( "max error: position %.3f m, velocity %.4f m/s, surface velocity %.4f m/s, mass %.3f kg\n", maxPositionError, maxVelocityError, maxSurfVelocityError, maxMassError );
+    printf( "           heading %.4f deg, guidance pitch %.4f deg, stage or phase diffs %u\n", maxHeadingError * c_RadToDegree, maxPitchError * c_RadToDegree, enumDiffs );
+
+    return true;
+}
+
+// Telemetry stored for every profile against the best few only, with the rest replayed. Every profile is
+// replayed to check the FlightData matches the sweep bit for bit, as must the stored telemetry.
+static bool BenchmarkTopTelemetry( const BenchmarkContext& context )
+{
+    const uint32_t keepCount = 16;
+
+    SweepConfig config = context.config;
+    config.recordTelemetry = true;
+
+    printf( "level    stored    time (s)  size (MB)  replay (ms)  flight diffs  telemetry diffs\n" );
+
+    for ( SimdLevel level : { SimdLevel::None, DetectSimdLevel() } )
+    {
+        config.simdLevel = level;
+        config.telemetryProfiles = 0;
+
+        SweepEngine reference( context.environment, context.missionParams, config, context.threadPool );
+        double referenceTime = TimeSweep( reference, context.ascentParams );
+
+        printf( "%-8s %-8s  %8.3f  %9.1f  %11s  %12s  %15s\n", GetSimdLevelName( reference.GetSimdLevel() ), "all", referenceTime, reference.GetTelemetryBytes() / 1e6,
+                "-", "-", "-" );
+
+        config.telemetryProfiles = keepCount;
+
+        SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        engine.Run( context.ascentParams );
+        std::vector<uint32_t> best = engine.RankProfiles( context.earthRadius, context.earthMu, keepCount );
+        engine.StoreTelemetry( best );
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        // A profile that isn't stored, replayed on its own as a graph or export would ask for it.
+        uint32_t replayProfile = 0;
+        while ( replayProfile < engine.GetProfileCount() && engine.GetTelemetry( replayProfile ) )
+            ++replayProfile;
+
+        start = std::chrono::steady_clock::now();
+        std::vector<TelemetryData> replayed = engine.GetProfileTelemetry( replayProfile );
+        std::chrono::duration<double> replayTime = std::chrono::steady_clock::now() - start;
+
+        std::vector<uint32_t> everyProfile( engine.GetProfileCount() );
+        for ( uint32_t i = 0; i < engine.GetProfileCount(); ++i )
+            everyProfile[i] = i;
+
+        std::vector<FlightData> replayedData( everyProfile.size() );
+        engine.ReplayFlights( everyProfile, nullptr, replayedData.data() );
+
+        uint32_t flightDiffs = 0;
+        for ( uint32_t i = 0; i < engine.GetProfileCount(); ++i )
+            flightDiffs += memcmp( &replayedData[i], &engine.GetFlightData()[i], sizeof( FlightData ) ) != 0;
+
+        const size_t sampleBytes = size_t( engine.GetTelemetryMaxSamples() ) * sizeof( CompactTelemetry );
+
+        uint32_t telemetryDiffs = 0;
+        for ( uint32_t profile : best )
+            telemetryDiffs += memcmp( engine.GetTelemetry( profile ), reference.GetTelemetry( profile ), sampleBytes ) != 0;
+
+        std::vector<TelemetryData> expected = reference.GetProfileTelemetry( replayProfile );
+        telemetryDiffs += memcmp( replayed.data(), expected.data(), expected.size() * sizeof( TelemetryData ) ) != 0;
+
+        char stored[16];
+        snprintf( stored, sizeof( stored ), "best %u", keepCount );
+
+        printf( "%-8s %-8s  %8.3f  %9.1f  %11.2f  %12u  %15u\n", GetSimdLevelName( engine.GetSimdLevel() ), stored, elapsed.count(), engine.GetTelemetryBytes() / 1e6,
+                replayTime.count() * 1e3, flightDiffs, telemetryDiffs );
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Envelopes of the selected profile's channels from the min/max pyramid against scanning the samples,
+// and max Q as the graphs find it, interpolating two samples per point, against the envelope's.
+static bool BenchmarkEnvelope( const BenchmarkContext& context )
+{
+    SweepConfig config = context.config;
+    config.recordTelemetry = true;
+
+    SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+    engine.Run( context.ascentParams );
+
+    uint32_t profile = engine.SelectBestProfile( context.earthRadius, context.earthMu );
+    if ( profile >= engine.GetProfileCount() )
+    {
+        fprintf( stderr, "No profile reached MECO.\n" );
+        return false;
+    }
+
+    const std::vector<TelemetryData> telemetry = engine.GetProfileTelemetry( profile );
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    TelemetryPyramid pyramid( context.environment );
+    for ( const TelemetryData& t : telemetry )
+        pyramid.Append( t );
+    std::chrono::duration<double> buildTime = std::chrono::steady_clock::now() - start;
+
+    // The channels by sample for the scans.
+    const uint32_t sampleCount = pyramid.GetSampleCount();
+    std::vector<float> values( size_t( sampleCount ) * c_TelemetryChannelCount );
+    for ( uint32_t s = 0; s < sampleCount; ++s )
+        CalcTelemetryChannels( telemetry[s], context.environment, &values[size_t( s ) * c_TelemetryChannelCount] );
+
+    printf( "profile %u, %u samples, %u levels, pyramid built in %.2f ms\n", profile, sampleCount, pyramid.GetLevelCount(), buildTime.count() * 1e3 );
+    printf( "points  pyramid (us)  scan (us)  speedup  mismatches  graph max Q (kPa)  envelope max Q (kPa)\n" );
+
+    const uint32_t qChannel = uint32_t( TelemetryChannel::Q );
+
+    for ( uint32_t points : { 100u, 400u, 1600u, 6000u } )
+    {
+        std::vector<float2> envelope( size_t( points ) * c_TelemetryChannelCount );
+        std::vector<float2> scanned( envelope.size() );
+
+        const uint32_t repeats = 20;
+
+        start = std::chrono::steady_clock::now();
+        for ( uint32_t r = 0; r < repeats; ++r )
+        {
+            for ( uint32_t channel = 0; channel < c_TelemetryChannelCount; ++channel )
+                pyramid.GetEnvelope( TelemetryChannel( channel ), points, &envelope[size_t( channel ) * points] );
+        }
+        std::chrono::duration<double> pyramidTime = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for ( uint32_t r = 0; r < repeats; ++r )
+        {
+            for ( uint32_t channel = 0; channel < c_TelemetryChannelCount; ++channel )
+            {
+                for ( uint32_t bucket = 0; bucket < points; ++bucket )
+                {
+                    uint32_t begin = uint32_t( uint64_t( bucket ) * sampleCount / points );
+                    uint32_t end = std::max( uint32_t( uint64_t( bucket + 1 ) * sampleCount / points ), begin + 1 );
+
+                    float2 range( FLT_MAX, -FLT_MAX );
+                    for ( uint32_t s = begin; s < end; ++s )
+                    {
+                        float v = values[size_t( s ) * c_TelemetryChannelCount + channel];
+                        range = float2( fminf( range.x, v ), fmaxf( range.y, v ) );
+                    }
+                    scanned[size_t( channel ) * points + bucket] = range;
+                }
+            }
+        }
+        std::chrono::duration<double> scanTime = std::chrono::steady_clock::now() - start;
+
+        uint32_t mismatches = 0;
+        for ( size_t i = 0; i < envelope.size(); ++i )
+            mismatches += envelope[i].x != scanned[i].x || envelope[i].y != scanned[i].y;
+
+        // A graph point interpolates the two samples either side of it.
+        float graphMaxQ = 0;
+        for ( uint32_t point = 0; point < points; ++point )
+        {
+            float x = float( point ) / (points - 1) * (sampleCount - 1);
+            uint32_t s1 = std::min( uint32_t( x ), sampleCount - 1 );
+            uint32_t s2 = std::min( s1 + 1, sampleCount - 1 );
+            float q = lerp( values[size_t( s1 ) * c_TelemetryChannelCount + qChannel], values[size_t( s2 ) * c_TelemetryChannelCount + qChannel], x - s1 );
+            graphMaxQ = fmaxf( graphMaxQ, q );
+        }
+
+        float envelopeMaxQ = 0;
+        for ( uint32_t bucket = 0; bucket < points; ++bucket )
+            envelopeMaxQ = fmaxf( envelopeMaxQ, envelope[size_t( qChannel ) * points + bucket].y );
+
+        printf( "%6u  %12.1f  %9.1f  %6.1fx  %10u  %17.3f  %20.3f\n", points, pyramidTime.count() * 1e6 / repeats, scanTime.count() * 1e6 / repeats,
+                scanTime.count() / pyramidTime.count(), mismatches, graphMaxQ / 1000, envelopeMaxQ / 1000 );
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// count flights for the analysis benchmarks. Larger sets tile the sweep's flights out of order, with each
+// min/max field scaled by its own factor of up to 1%, so the extremes come from all over the set.
+static std::vector<FlightData> TileFlightData( const std::vector<FlightData>& sweepData, uint32_t profileCount, uint32_t count )
+{
+    if ( count == profileCount )
+        return std::vector<FlightData>( sweepData.begin(), sweepData.begin() + profileCount );
+
+    std::vector<FlightData> flightData( count );
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        FlightData& data = flightData[i];
+        data = sweepData[(i * 7919u) % profileCount];
+
+        float* fields[] = { &data.maxAltitude, &data.maxSurfSpeed, &data.maxEciSpeed, &data.maxQ, &data.minMass, &data.maxAccel };
+        for ( uint32_t f = 0; f < 6; ++f )
+        {
+            uint32_t hash = ((i * 2654435761u) ^ (f * 0x85ebca6bu)) * 0xc2b2ae35u;
+            *fields[f] *= 1.0f + float( hash >> 22 ) / 1023.0f * 0.01f;
+        }
+    }
+
+    return flightData;
+}
+
+static bool BenchmarkExtents( const BenchmarkContext& context )
+{
+    const float earthRadius = float( context.earthRadius );
+
+    // The extents each sweep path accumulates as it steps, against the two pass scan of its flights. Integrating
+    // the coast leaves every surviving flight live to the end, which only the last batch's partials hold, and a
+    // sweep should never need the fallback reduction over its FlightData.
+    printf( "path        coast      fused extents match  fallback\n" );
+
+    struct SweepCase
+    {
+        const char*         name;
+        SimdLevel           simdLevel;
+        FlightIntegrator    integrator;
+        CoastMode           coastMode;
+    };
+
+    const SweepCase sweepCases[] =
+    {
+        { "batch", context.config.simdLevel, FlightIntegrator::Euler, CoastMode::Kepler },
+        { "batch", context.config.simdLevel, FlightIntegrator::Euler, CoastMode::Integrate },
+        { "profile", SimdLevel::None, FlightIntegrator::Euler, CoastMode::Kepler },
+        { "profile", SimdLevel::None, FlightIntegrator::Euler, CoastMode::Integrate },
+        { "dopri5", SimdLevel::None, FlightIntegrator::Dopri5, CoastMode::Kepler },
+        { "dopri5", SimdLevel::None, FlightIntegrator::Dopri5, CoastMode::Integrate },
+    };
+
+    bool fusedMatch = true;
+    for ( const SweepCase& sweepCase : sweepCases )
+    {
+        SweepConfig config = context.config;
+        config.simdLevel = sweepCase.simdLevel;
+        config.integrator = sweepCase.integrator;
+        config.coastMode = sweepCase.coastMode;
+        config.recordTelemetry = false;
+
+        SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+        engine.Run( context.ascentParams );
+
+        const std::vector<FlightData>& flightData = engine.GetFlightData();
+        const uint32_t profileCount = engine.GetProfileCount();
+
+        FlightData extents[2];
+        CalcFlightDataExtents( flightData.data(), profileCount, context.missionParams, earthRadius, extents[0], extents[1] );
+
+        bool match = memcmp( extents, &flightData[profileCount], sizeof( extents ) ) == 0;
+        printf( "%-10s  %-9s  %19s  %8s\n", sweepCase.name, GetCoastModeName( sweepCase.coastMode ), match ? "yes" : "NO", engine.GetExtentsReduced() ? "TAKEN" : "no" );
+        fusedMatch &= match && !engine.GetExtentsReduced();
+    }
+
+    if ( !fusedMatch )
+        return false;
+
+    SweepEngine engine( context.environment, context.missionParams, context.config, context.threadPool );
+    engine.Run( context.ascentParams );
+
+    const std::vector<FlightData>& sweepData = engine.GetFlightData();
+    const uint32_t profileCount = engine.GetProfileCount();
+
+    printf( "\n%u threads\n", context.threadPool.GetThreadCount() );
+    printf( "flights   two pass (ms)  reduction (ms)  speedup  match\n" );
+
+    for ( uint32_t count : { profileCount, 65536u, 1048576u } )
+    {
+        std::vector<FlightData> flightData = TileFlightData( sweepData, profileCount, count );
+
+        const uint32_t repeats = std::max( 4194304u / count, 4u );
+        FlightData serialExtents[2], reducedExtents[2];
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for ( uint32_t r = 0; r < repeats; ++r )
+            CalcFlightDataExtents( flightData.data(), count, context.missionParams, earthRadius, serialExtents[0], serialExtents[1] );
+        std::chrono::duration<double> serialTime = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for ( uint32_t r = 0; r < repeats; ++r )
+            ReduceFlightDataExtents( flightData.data(), count, context.missionParams, earthRadius, context.threadPool, reducedExtents[0], reducedExtents[1] );
+        std::chrono::duration<double> reducedTime = std::chrono::steady_clock::now() - start;
+
+        bool match = memcmp( serialExtents, reducedExtents, sizeof( serialExtents ) ) == 0;
+
+        printf( "%7u  %13.3f  %14.3f  %6.1fx  %5s\n", count, serialTime.count() * 1e3 / repeats, reducedTime.count() * 1e3 / repeats,
+                serialTime.count() / reducedTime.count(), match ? "yes" : "NO" );
+
+        if ( !match )
+            return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static bool BenchmarkPareto( const BenchmarkContext& context )
+{
+    SweepEngine engine( context.environment, context.missionParams, context.config, context.threadPool );
+    engine.Run( context.ascentParams );
+
+    const std::vector<FlightData>& sweepData = engine.GetFlightData();
+    const uint32_t profileCount = engine.GetProfileCount();
+
+    printf( "flights  front  skyline (ms)  pairwise (ms)  match\n" );
+
+    for ( uint32_t count : { profileCount, 65536u, 1048576u } )
+    {
+        std::vector<FlightData> flightData = TileFlightData( sweepData, profileCount, count );
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<uint32_t> front = CalcParetoFront( flightData.data(), count, context.missionParams, context.earthRadius, context.earthMu );
+        std::chrono::duration<double> skylineTime = std::chrono::steady_clock::now() - start;
+
+        // The O(n^2) scan against every other flight, too slow to run on the largest set.
+        if ( count > 65536 )
+        {
+            printf( "%7u  %5zu  %12.1f  %13s  %5s\n", count, front.size(), skylineTime.count() * 1e3, "-", "-" );
+            continue;
+        }
+
+        start = std::chrono::steady_clock::now();
+
+        std::vector<uint32_t> candidates;
+        std::vector<float> objectives;
+        for ( uint32_t i = 0; i < count; ++i )
+        {
+            float o[c_ParetoObjectiveCount];
+            CalcParetoObjectives( flightData[i], context.missionParams, context.earthRadius, context.earthMu, o );
+
+            if ( flightData[i].flightPhase == c_PhaseMECO && std::all_of( o, o + c_ParetoObjectiveCount, [] ( float x ) { return isfinite( x ); } ) )
+            {
+                candidates.push_back( i );
+                objectives.insert( objectives.end(), o, o + c_ParetoObjectiveCount );
+            }
+        }
+
+        std::vector<uint32_t> pairwise;
+        for ( size_t i = 0; i < candidates.size(); ++i )
+        {
+            const float* b = &objectives[i * c_ParetoObjectiveCount];
+
+            bool dominated = false;
+            for ( size_t j = 0; j < candidates.size() && !dominated; ++j )
+            {
+                const float* a = &objectives[j * c_ParetoObjectiveCount];
+
+                bool noWorse = true, better = false;
+                for ( uint32_t k = 0; k < c_ParetoObjectiveCount; ++k )
+                {
+                    noWorse &= a[k] <= b[k];
+                    better |= a[k] < b[k];
+                }
+                dominated = noWorse && better;
+            }
+
+            if ( !dominated )
+                pairwise.push_back( candidates[i] );
+        }
+
+        std::chrono::duration<double> pairwiseTime = std::chrono::steady_clock::now() - start;
+
+        bool match = front == pairwise;
+        printf( "%7u  %5zu  %12.1f  %13.1f  %5s\n", count, front.size(), skylineTime.count() * 1e3, pairwiseTime.count() * 1e3, match ? "yes" : "NO" );
+
+        if ( !match )
+            return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static bool BenchmarkRefine( const BenchmarkContext& context )
+{
+    const std::vector<AscentParams>& grid = context.ascentParams;
+    float minSpeed = grid.front().pitchOverSpeed;
+    float maxSpeed = grid.back().pitchOverSpeed;
+    float minAngle = asinf( grid.front().sinPitchOverAngle );
+    float maxAngle = asinf( grid[context.angleCount - 1].sinPitchOverAngle );
+
+    // A single sweep at the same resolution over the starting ranges, for scale.
+    RefinementConfig config;
+    uint64_t fullGrid = uint64_t( ceilf( (maxSpeed - minSpeed) / config.speedResolution ) + 1 ) * uint64_t( ceilf( (maxAngle - minAngle) / config.angleResolution ) + 1 );
+    printf( "to 0.1 m/s and 0.01 degrees, a full grid would be %llu profiles\n", (unsigned long long)fullGrid );
+    printf( "reuse  levels  swept  reused  time (s)  best speed (m/s)  best angle (deg)  min mass (t)\n" );
+
+    for ( bool reuse : { false, true } )
+    {
+        config.reuseResults = reuse;
+
+        SweepConfig sweepConfig = context.config;
+        sweepConfig.recordTelemetry = false;
+        SweepEngine engine( context.environment, context.missionParams, sweepConfig, context.threadPool );
+
+        RefinementResult result;
+        if ( !RefineSweep( engine, config, minSpeed, maxSpeed, minAngle, maxAngle, context.earthRadius, context.earthMu, result ) )
+        {
+            fprintf( stderr, "No profile reached MECO within the max Q limit.\n" );
+            return false;
+        }
+
+        uint32_t swept = 0, reused = 0;
+        double time = 0;
+        for ( const RefinementLevel& level : result.levels )
+        {
+            swept += level.simulated;
+            reused += level.reused;
+            time += level.time;
+        }
+
+        printf( "%5s  %6zu  %5u  %6u  %8.3f  %16.3f  %16.4f  %12.3f\n", reuse ? "yes" : "no", result.levels.size(), swept, reused, time,
+                result.bestParams.pitchOverSpeed, asinf( result.bestParams.sinPitchOverAngle ) * c_RadToDegree, result.bestData.minMass / 1000.0f );
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static bool BenchmarkOptimise( const BenchmarkContext& context )
+{
+    const std::vector<AscentParams>& grid = context.ascentParams;
+    float minSpeed = grid.front().pitchOverSpeed;
+    float maxSpeed = grid.back().pitchOverSpeed;
+    float minAngle = asinf( grid.front().sinPitchOverAngle );
+    float maxAngle = asinf( grid[context.angleCount - 1].sinPitchOverAngle );
+
+    SweepConfig sweepConfig = context.config;
+    sweepConfig.recordTelemetry = false;
+
+    printf( "search      profiles  sweeps  time (s)  objective (kg)  speed (m/s)  angle (deg)  min mass (kg)\n" );
+
+    auto printRow = [&context] ( const char* name, uint32_t profiles, uint32_t sweeps, double time, const AscentParams& params, const FlightData& data )
+    {
+        float objective = CalcSelectionObjective( data, context.missionParams, context.earthRadius, context.earthMu );
+        printf( "%-10s  %8u  %6u  %8.3f  %14.2f  %11.3f  %11.4f  %13.2f\n", name, profiles, sweeps, time, objective, params.pitchOverSpeed,
+                asinf( params.sinPitchOverAngle ) * c_RadToDegree, data.minMass );
+    };
+
+    {
+        SweepEngine engine( context.environment, context.missionParams, sweepConfig, context.threadPool );
+        double time = TimeSweep( engine, grid );
+
+        uint32_t best = engine.SelectBestProfile( context.earthRadius, context.earthMu );
+        if ( best >= engine.GetProfileCount() )
+        {
+            fprintf( stderr, "No profile reached MECO within the max Q limit.\n" );
+            return false;
+        }
+
+        printRow( "grid", engine.GetProfileCount(), 1, time, grid[best], engine.GetFlightData()[best] );
+    }
+
+    {
+        SweepEngine engine( context.environment, context.missionParams, sweepConfig, context.threadPool );
+        RefinementResult result;
+        if ( !RefineSweep( engine, RefinementConfig{}, minSpeed, maxSpeed, minAngle, maxAngle, context.earthRadius, context.earthMu, result ) )
+        {
+            fprintf( stderr, "No profile reached MECO within the max Q limit.\n" );
+            return false;
+        }
+
+        uint32_t swept = 0;
+        double time = 0;
+        for ( const RefinementLevel& level : result.levels )
+        {
+            swept += level.simulated;
+            time += level.time;
+        }
+
+        printRow( "refine", swept, static_cast<uint32_t>(result.levels.size()), time, result.bestParams, result.bestData );
+    }
+
+    for ( OptimiserMethod method : { OptimiserMethod::CmaEs, OptimiserMethod::NelderMead } )
+    {
+        OptimiserConfig config;
+        config.method = method;
+
+        SweepEngine engine( context.environment, context.missionParams, sweepConfig, context.threadPool );
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        OptimiserResult result;
+        bool found = OptimiseAscent( engine, config, minSpeed, maxSpeed, minAngle, maxAngle, context.earthRadius, context.earthMu, result );
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if ( !found )
+        {
+            fprintf( stderr, "%s: No profile reached MECO within the max Q limit.\n", GetOptimiserMethodName( method ) );
+            return false;
+        }
+
+        printRow( GetOptimiserMethodName( method ), result.evaluations, result.generations, elapsed.count(), result.bestParams, result.bestData );
+    }
+
+    // CMA-ES's samples depend on its seed, so how far one run is from the grid's best does too.
+    const uint32_t seedCount = 10;
+    uint32_t totalProfiles = 0, maxProfiles = 0;
+    double totalObjective = 0;
+    float worstObjective = -FLT_MAX;
+    for ( uint32_t seed = 1; seed <= seedCount; ++seed )
+    {
+        OptimiserConfig config;
+        config.seed = seed;
+
+        SweepEngine engine( context.environment, context.missionParams, sweepConfig, context.threadPool );
+        OptimiserResult result;
+        OptimiseAscent( engine, config, minSpeed, maxSpeed, minAngle, maxAngle, context.earthRadius, context.earthMu, result );
+
+        totalProfiles += result.evaluations;
+        maxProfiles = std::max( maxProfiles, result.evaluations );
+        totalObjective += result.bestScore;
+        worstObjective = std::max( worstObjective, result.bestScore );
+    }
+
+    printf( "\ncmaes over seeds 1-%u: %.0f profiles on average, %u at most, objective %.2f kg on average, %.2f kg at worst\n", seedCount,
+            double( totalProfiles ) / seedCount, maxProfiles, totalObjective / seedCount, worstObjective );
+
+    return true;
+}
+
+// Profiles the surrogate search flies before it matches the grid sweep's best and the refined optimum, and how well
+// a surrogate fitted to an eighth of the grid predicts the rest.
+static bool BenchmarkSurrogate( const BenchmarkContext& context )
+{
+    const std::vector<AscentParams>& grid = context.ascentParams;
+    float minSpeed = grid.front().pitchOverSpeed;
+    float maxSpeed = grid.back().pitchOverSpeed;
+    float minAngle = asinf( grid.front().sinPitchOverAngle );
+    float maxAngle = asinf( grid[context.angleCount - 1].sinPitchOverAngle );
+
+    SweepConfig sweepConfig = context.config;
+    sweepConfig.recordTelemetry = false;
+
+    float gridScore = FLT_MAX;
+    {
+        SweepEngine engine( context.environment, context.missionParams, sweepConfig, context.threadPool );
+        double time = TimeSweep( engine, grid );
+
+        const std::vector<FlightData>& flightData = engine.GetFlightData();
+        const uint32_t count = engine.GetProfileCount();
+
+        std::vector<AscentParams> fitParams;
+        std::vector<FlightData> fitData;
+        for ( uint32_t i = 0; i < count; ++i )
+        {
+            gridScore = std::min( gridScore, CalcSelectionObjective( flightData[i], context.missionParams, context.earthRadius, context.earthMu ) );
+
+            if ( (i % context.angleCount) % 2 == 0 && (i / context.angleCount) % 4 == 0 )
+            {
+                fitParams.push_back( grid[i] );
+                fitData.push_back( flightData[i] );
+            }
+        }
+
+        if ( gridScore == FLT_MAX )
+        {
+            fprintf( stderr, "No profile reached MECO within the max Q limit.\n" );
+            return false;
+        }
+
+        FlightSurrogate surrogate( context.missionParams, context.earthRadius, context.earthMu, minSpeed, maxSpeed, minAngle, maxAngle );
+        surrogate.AddResults( fitParams.data(), fitData.data(), static_cast<uint32_t>(fitParams.size()) );
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        surrogate.Fit( context.threadPool );
+
+        double massError = 0, qError = 0, orbitError = 0;
+        uint32_t mecoCount = 0, feasibleMisses = 0;
+        for ( uint32_t i = 0; i < count; ++i )
+        {
+            SurrogatePrediction prediction = surrogate.Predict( grid[i].pitchOverSpeed, asinf( grid[i].sinPitchOverAngle ) );
+            bool meco = flightData[i].flightPhase == c_PhaseMECO;
+            feasibleMisses += (meco && flightData[i].maxQ < 60000.0f) != (prediction.mecoProbability >= 0.5f);
+
+            // Max Q and orbit error as the surrogate fits them, in logs.
+            double q = log( prediction.maxQ / std::max( flightData[i].maxQ, 1.0f ) );
+            qError += q * q;
+
+            if ( meco )
+            {
+                double orbit = log1p( prediction.orbitError ) - log1p( CalcOrbitError( flightData[i], context.missionParams, context.earthRadius, context.earthMu ) );
+                massError += (prediction.minMass - flightData[i].minMass) * (prediction.minMass - flightData[i].minMass);
+                orbitError += orbit * orbit;
+                ++mecoCount;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        mecoCount = std::max( mecoCount, 1u );
+        printf( "Grid: %u profiles in %.3f s, best objective %.2f kg\n", count, time, gridScore );
+        printf( "Surrogate of %u grid profiles, fitted and predicting all %u in %.3f s:\n", static_cast<uint32_t>(fitParams.size()), count, elapsed.count() );
+        printf( "    rms error of min mass %.2f kg, max Q x%.2f, orbit error x%.2f; feasibility mispredicted for %u\n\n", sqrt( massError / mecoCount ),
+                exp( sqrt( qError / count ) ), exp( sqrt( orbitError / mecoCount ) ), feasibleMisses );
+    }
+
+    RefinementResult refined;
+    {
+        SweepEngine engine( context.environment, context.missionParams, sweepConfig, context.threadPool );
+        if ( !RefineSweep( engine, RefinementConfig{}, minSpeed, maxSpeed, minAngle, maxAngle, context.earthRadius, context.earthMu, refined ) )
+        {
+            fprintf( stderr, "No profile reached MECO within the max Q limit.\n" );
+            return false;
+        }
+    }
+
+    uint32_t refineSwept = 0;
+    for ( const RefinementLevel& level : refined.levels )
+        refineSwept += level.simulated;
+
+    float refineScore = CalcSelectionObjective( refined.bestData, context.missionParams, context.earthRadius, context.earthMu );
+
+    SweepEngine engine( context.environment, context.missionParams, sweepConfig, context.threadPool );
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    SurrogateConfig config;
+    config.maxEvaluations = static_cast<uint32_t>(grid.size());
+
+    SurrogateResult result;
+    bool found = SearchWithSurrogate( engine, context.threadPool, config, minSpeed, maxSpeed, minAngle, maxAngle, context.earthRadius, context.earthMu, result );
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if ( !found )
+    {
+        fprintf( stderr, "Surrogate: No profile reached MECO within the max Q limit.\n" );
+        return false;
+    }
+
+    printf( "sweep  profiles  objective (kg)\n" );
+    for ( uint32_t i = 0; i < result.history.size(); ++i )
+        printf( "%5u  %8u  %14.2f\n", i + 1, result.history[i].first, result.history[i].second );
+
+    auto profilesTo = [&result] ( float score )
+    {
+        for ( const std::pair<uint32_t, float>& entry : result.history )
+        {
+            if ( entry.second <= score )
+                return int32_t( entry.first );
+        }
+
+        return -1;
+    };
+
+    printf( "\nSurrogate: %u profiles in %.3f s, best objective %.2f kg at %.3f m/s, %.4f deg\n", result.evaluations, elapsed.count(), result.bestScore,
+            result.bestParams.pitchOverSpeed, asinf( result.bestParams.sinPitchOverAngle ) * c_RadToDegree );
+    printf( "Refinement: %u profiles, best objective %.2f kg\n\n", refineSwept, refineScore );
+
+    // Flights a hair apart differ by tenths of a kg or more, so the grid's best is partly luck; the margins show
+    // how fast the search closes in rather than whether it draws the same luck.
+    printf( "profiles to within  of grid best  of refined best\n" );
+    for ( float margin : { 2.0f, 1.0f, 0.5f, 0.25f, 0.0f } )
+        printf( "%14.2f kg  %12d  %14d\n", margin, profilesTo( gridScore + margin ), profilesTo( refineScore + margin ) );
+    printf( "(-1: not reached)\n" );
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static bool BenchmarkDesign( const BenchmarkContext& context )
+{
+    const std::vector<AscentParams>& grid = context.ascentParams;
+    const uint32_t angleCount = context.angleCount;
+    const uint32_t speedCount = static_cast<uint32_t>(grid.size()) / angleCount;
+
+    SweepAxis speedAxis = { SweepParameter::PitchOverSpeed, 0, grid.front().pitchOverSpeed, grid.back().pitchOverSpeed, speedCount };
+    SweepAxis angleAxis = { SweepParameter::PitchOverAngle, 0, asinf( grid.front().sinPitchOverAngle ) * c_RadToDegree,
+                            asinf( grid[angleCount - 1].sinPitchOverAngle ) * c_RadToDegree, angleCount };
+
+    // The loaded grid as a design, which should fly exactly as the grid does.
+    SweepDesign design;
+    MakeGridDesign( { speedAxis, angleAxis }, design );
+
+    SweepConfig sweepConfig = context.config;
+    sweepConfig.recordTelemetry = false;
+    SweepEngine engine( context.environment, context.missionParams, sweepConfig, context.threadPool );
+    engine.Run( grid );
+
+    DesignResult result;
+    RunSweepDesign( design, context.environment, context.missionParams, sweepConfig, context.threadPool, context.earthRadius, context.earthMu,
+                    static_cast<uint32_t>(grid.size()), result );
+
+    uint32_t differences = 0;
+    for ( uint32_t i = 0; i < grid.size(); ++i )
+        differences += memcmp( &result.flightData[i], &engine.GetFlightData()[i], sizeof( FlightData ) ) != 0;
+    printf( "grid of %zu as a design: %u flights differ from the grid sweep\n\n", grid.size(), differences );
+
+    // A sampled study over the grid's ranges, 4 first stage thrust scales and 4 launch latitudes.
+    SweepAxis thrustAxis = { SweepParameter::ThrustScale, 0, 0.85f, 1.0f, 4 };
+    SweepAxis latitudeAxis = { SweepParameter::LaunchLatitude, 0, 0.0f, 45.0f, 4 };
+    MakeSampledDesign( { thrustAxis, latitudeAxis, speedAxis, angleAxis }, 4096, design );
+
+    printf( "batch  missions  sweeps  time (s)  profiles/s  best objective (kg)\n" );
+
+    for ( uint32_t batchSize : { 64u, 512u, 4096u } )
+    {
+        RunSweepDesign( design, context.environment, context.missionParams, sweepConfig, context.threadPool, context.earthRadius, context.earthMu, batchSize, result );
+
+        float best = *std::min_element( result.objective.begin(), result.objective.end() );
+        printf( "%5u  %8u  %6u  %8.3f  %10.0f  %19.3f\n", batchSize, result.missions, result.sweeps, result.time, design.GetPointCount() / result.time, best );
+    }
+
+    // Per mission bests, to show what the extra axes buy.
+    printf( "\nthrust scale  latitude (deg)  points  best objective (kg)\n" );
+    for ( uint32_t thrust = 0; thrust < thrustAxis.count; ++thrust )
+    {
+        for ( uint32_t latitude = 0; latitude < latitudeAxis.count; ++latitude )
+        {
+            float thrustScale = thrustAxis.min + (thrustAxis.max - thrustAxis.min) * thrust / (thrustAxis.count - 1);
+            float launchLatitude = latitudeAxis.min + (latitudeAxis.max - latitudeAxis.min) * latitude / (latitudeAxis.count - 1);
+
+            uint32_t points = 0;
+            float best = FLT_MAX;
+            for ( uint32_t i = 0; i < design.GetPointCount(); ++i )
+            {
+                const float* point = design.GetPoint( i );
+                if ( point[0] == thrustScale && point[1] == launchLatitude )
+                {
+                    ++points;
+                    best = std::min( best, result.objective[i] );
+                }
+            }
+
+            printf( "%12.3f  %14.1f  %6u  %19.3f\n", thrustScale, launchLatitude, points, best );
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static bool BenchmarkDispersion( const BenchmarkContext& context )
+{
+    SweepConfig sweepConfig = context.config;
+    sweepConfig.recordTelemetry = false;
+    SweepEngine engine( context.environment, context.missionParams, sweepConfig, context.threadPool );
+    engine.Run( context.ascentParams );
+
+    uint32_t selected = engine.SelectBestProfile( context.earthRadius, context.earthMu );
+    if ( selected == ~0u )
+    {
+        fprintf( stderr, "No profile reached MECO within the max Q limit.\n" );
+        return false;
+    }
+
+    const AscentParams& ascentParams = context.ascentParams[selected];
+
+    DispersionConfig config;
+    config.runCount = 2048;
+
+    std::vector<FlightData> flightData( config.runCount );
+    DispersionResult result;
+    RunDispersion( ascentParams, context.environment, context.missionParams, sweepConfig, config, context.threadPool, context.earthRadius, context.earthMu, result, flightData.data() );
+
+    printf( "%u runs in %.3f s, %.0f runs/s, %u reached MECO within the max Q limit\n", result.runs, result.time, result.runs / result.time, result.mecoRuns );
+
+    // Any run should fly the same however the runs are batched, and alone.
+    DispersionConfig rebatched = config;
+    rebatched.runCount = 256;
+    rebatched.batchSize = 37;
+    std::vector<FlightData> rebatchedData( rebatched.runCount );
+    DispersionResult rebatchedResult;
+    RunDispersion( ascentParams, context.environment, context.missionParams, sweepConfig, rebatched, context.threadPool, context.earthRadius, context.earthMu,
+                   rebatchedResult, rebatchedData.data() );
+
+    DispersionConfig offset = config;
+    offset.firstRun = 1000;
+    offset.runCount = 64;
+    std::vector<FlightData> offsetData( offset.runCount );
+    DispersionResult offsetResult;
+    RunDispersion( ascentParams, context.environment, context.missionParams, sweepConfig, offset, context.threadPool, context.earthRadius, context.earthMu,
+                   offsetResult, offsetData.data() );
+
+    uint32_t rebatchedDiffs = 0, offsetDiffs = 0;
+    for ( uint32_t i = 0; i < rebatched.runCount; ++i )
+        rebatchedDiffs += memcmp( &rebatchedData[i], &flightData[i], sizeof( FlightData ) ) != 0;
+    for ( uint32_t i = 0; i < offset.runCount; ++i )
+        offsetDiffs += memcmp( &offsetData[i], &flightData[offset.firstRun + i], sizeof( FlightData ) ) != 0;
+
+    printf( "runs 0-255 in batches of 37: %u differ, runs 1000-1063 alone: %u differ\n\n", rebatchedDiffs, offsetDiffs );
+
+    // Streaming quantiles against sorting every sample.
+    std::vector<double> apoapsis, maxQ;
+    for ( const FlightData& data : flightData )
+    {
+        maxQ.push_back( data.maxQ );
+        if ( CalcSelectionObjective( data, context.missionParams, context.earthRadius, context.earthMu ) < FLT_MAX )
+            apoapsis.push_back( (1.0 + data.e) * data.a - context.earthRadius );
+    }
+
+    std::sort( apoapsis.begin(), apoapsis.end() );
+    std::sort( maxQ.begin(), maxQ.end() );
+
+    auto exactQuantile = [] ( const std::vector<double>& sorted, double p )
+    {
+        double position = p * double( sorted.size() - 1 );
+        size_t i = size_t( position );
+        size_t j = std::min( i + 1, sorted.size() - 1 );
+        return sorted[i] + (sorted[j] - sorted[i]) * (position - double( i ));
+    };
+
+    printf( "quantile  apoapsis P2 (m)  exact (m)  max Q P2 (Pa)  exact (Pa)\n" );
+    for ( uint32_t q = 0; q < StreamingStatistic::c_QuantileCount; ++q )
+    {
+        double p = StreamingStatistic::c_Quantiles[q];
+        printf( "%7.0f%%  %15.1f  %9.1f  %13.1f  %10.1f\n", p * 100, result.apoapsis.GetQuantile( q ), exactQuantile( apoapsis, p ),
+                result.maxQ.GetQuantile( q ), exactQuantile( maxQ, p ) );
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static bool BenchmarkVehicles( const BenchmarkContext& context )
+{
+    const std::vector<AscentParams>& grid = context.ascentParams;
+    float minSpeed = grid.front().pitchOverSpeed;
+    float maxSpeed = grid.back().pitchOverSpeed;
+    float minAngle = asinf( grid.front().sinPitchOverAngle );
+    float maxAngle = asinf( grid[context.angleCount - 1].sinPitchOverAngle );
+
+    // Variants of the loaded vehicle with the first stage's thrust limited, which differ in how long they take to optimise.
+    std::vector<MissionParams> vehicles;
+    for ( float thrustLimit : { 1.0f, 0.95f, 0.9f, 0.85f, 0.8f, 0.75f, 0.7f, 0.65f } )
+    {
+        MissionParams missionParams = context.missionParams;
+        missionParams.stage[0].massFlow *= thrustLimit;
+        vehicles.push_back( missionParams );
+    }
+
+    VehicleBatchConfig config;
+    config.useOptimiser = true;
+
+    printf( "%u threads, %zu vehicles by cmaes\n", context.threadPool.GetThreadCount(), vehicles.size() );
+    printf( "schedule      time (s)  profiles  best objectives (kg)\n" );
+
+    std::vector<VehicleResult> sequential, concurrent;
+
+    // One vehicle at a time, each with every thread for its sweeps, against all of them on the pool at once.
+    for ( bool together : { false, true } )
+    {
+        std::vector<VehicleResult>& results = together ? concurrent : sequential;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if ( together )
+        {
+            OptimiseVehicles( context.environment, vehicles, context.config, config, context.threadPool, minSpeed, maxSpeed, minAngle, maxAngle,
+                              context.earthRadius, context.earthMu, results );
+        }
+        else
+        {
+            for ( const MissionParams& vehicle : vehicles )
+            {
+                std::vector<VehicleResult> result;
+                OptimiseVehicles( context.environment, { vehicle }, context.config, config, context.threadPool, minSpeed, maxSpeed, minAngle, maxAngle,
+                                  context.earthRadius, context.earthMu, result );
+                results.push_back( result[0] );
+            }
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        uint32_t profiles = 0;
+        for ( const VehicleResult& result : results )
+            profiles += result.evaluations;
+
+        printf( "%-10s  %10.3f  %8u ", together ? "concurrent" : "sequential", elapsed.count(), profiles );
+        for ( const VehicleResult& result : results )
+        {
+            if ( result.found )
+                printf( " %.2f", result.bestScore );
+            else
+                printf( " none" );
+        }
+        printf( "\n" );
+    }
+
+    uint32_t differences = 0;
+    for ( size_t v = 0; v < vehicles.size(); ++v )
+        differences += memcmp( &sequential[v].bestData, &concurrent[v].bestData, sizeof( FlightData ) ) != 0;
+    printf( "%u of %zu vehicles' best flights differ between the schedules\n", differences, vehicles.size() );
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// With cold guidance, as the cache needs, every sweep should match flying it uncached exactly.
+static bool BenchmarkCache( const BenchmarkContext& context )
+{
+    const std::vector<AscentParams>& grid = context.ascentParams;
+    const uint32_t angleCount = context.angleCount;
+    const uint32_t speedCount = static_cast<uint32_t>(grid.size()) / angleCount;
+
+    // The grid with an angle halfway between each of its own, half of it already flown.
+    std::vector<AscentParams> overlap( size_t( speedCount ) * (2 * angleCount - 1) );
+    GenerateAscentParams( grid.front().pitchOverSpeed, grid.back().pitchOverSpeed, asinf( grid.front().sinPitchOverAngle ), asinf( grid[angleCount - 1].sinPitchOverAngle ),
+                          speedCount, 2 * angleCount - 1, overlap.data() );
+
+    SweepConfig config = context.config;
+    config.recordTelemetry = false;
+    config.warmStartGuidance = false;
+
+    // A pack left by an interrupted run would make the first sweep warm.
+    SweepCache cache( "sweep_cache_benchmark" );
+    {
+        SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+        engine.SetResultCache( &cache );
+        if ( !cache.IsOpen() )
+        {
+            fprintf( stderr, "sweep_cache_benchmark: Failed to open the result cache.\n" );
+            return false;
+        }
+        cache.Close();
+        remove( cache.GetPackPath().c_str() );
+    }
+
+    struct Sweep
+    {
+        const char*     name;
+        const std::vector<AscentParams>*    ascentParams;
+    };
+
+    printf( "sweep     profiles  cache hits  time (s)  uncached (s)  differ from uncached\n" );
+
+    // Each sweep on an engine of its own, as a separate run of the CLI would be, the warm one reading the
+    // pack back from disk.
+    for ( const Sweep& sweep : { Sweep{ "cold", &grid }, Sweep{ "warm", &grid }, Sweep{ "overlap", &overlap } } )
+    {
+        SweepEngine reference( context.environment, context.missionParams, config, context.threadPool );
+        double referenceTime = TimeSweep( reference, *sweep.ascentParams );
+
+        SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+        engine.SetResultCache( &cache );
+        double time = TimeSweep( engine, *sweep.ascentParams );
+        cache.Close();
+
+        uint32_t differences = 0;
+        for ( uint32_t i = 0; i < engine.GetProfileCount(); ++i )
+            differences += memcmp( &engine.GetFlightData()[i], &reference.GetFlightData()[i], sizeof( FlightData ) ) != 0;
+
+        printf( "%-8s  %8u  %10u  %8.3f  %12.3f  %20u\n", sweep.name, engine.GetProfileCount(), engine.GetCacheHits(), time, referenceTime, differences );
+    }
+
+    remove( cache.GetPackPath().c_str() );
+    remove( "sweep_cache_benchmark" );
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static bool BenchmarkShards( const BenchmarkContext& context )
+{
+    SweepConfig config = context.config;
+    config.recordTelemetry = false;
+    config.warmStartGuidance = false;
+
+    SweepEngine reference( context.environment, context.missionParams, config, context.threadPool );
+    double referenceTime = TimeSweep( reference, context.ascentParams );
+
+    const uint32_t profileCount = reference.GetProfileCount();
+
+    printf( "%u profiles, cold guidance, single process in %.3f s\n", profileCount, referenceTime );
+    printf( "workers  shard size  killed  time (s)  reassigned  flown here  differ from single\n" );
+
+    struct Run
+    {
+        uint32_t    workers;
+        uint32_t    shardSize;
+        uint32_t    killAfter;
+    };
+
+    // The worker killed on being sent its second shard, so it dies holding one.
+    for ( const Run& run : { Run{ 1, 64, 0 }, Run{ 2, 64, 0 }, Run{ 4, 64, 0 }, Run{ 4, 16, 0 }, Run{ 4, 64, 2 }, Run{ 1, 64, 2 } } )
+    {
+        ShardConfig shardConfig;
+        shardConfig.workerCount = run.workers;
+        shardConfig.shardSize = run.shardSize;
+        shardConfig.killAfter = run.killAfter;
+
+        std::vector<FlightData> flightData;
+        ShardStats stats;
+        if ( !RunShardedSweep( context.workerCommand, context.environment, context.missionParams, config, context.threadPool, context.ascentParams, shardConfig,
+                               flightData, stats ) )
+            return false;
+
+        // Extents included.
+        uint32_t differences = 0;
+        for ( uint32_t i = 0; i < profileCount + 2; ++i )
+            differences += memcmp( &flightData[i], &reference.GetFlightData()[i], sizeof( FlightData ) ) != 0;
+
+        printf( "%7u  %10u  %6s  %8.3f  %10u  %10u  %18u\n", run.workers, run.shardSize, run.killAfter ? "yes" : "no", stats.time, stats.reassigned,
+                stats.localShards, differences );
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static double TimeFlights( uint32_t repeats, const std::function<void()>& fly )
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( uint32_t i = 0; i < repeats; ++i )
+        fly();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / repeats;
+}
+
+// One forward pass over dual numbers against central differences, which fly the profile and four more, on the
+// best five profiles of the sweep. Then the derivatives of the best against differences at a range of steps.
+static bool BenchmarkGradient( const BenchmarkContext& context )
+{
+    // Flown per profile with cold guidance, as the gradient flies them, so the sweep's flights are the same.
+    SweepConfig config = context.config;
+    config.recordTelemetry = false;
+    config.simdLevel = SimdLevel::None;
+    config.warmStartGuidance = false;
+    if ( config.integrator == FlightIntegrator::Dopri5 )
+        config.integrator = FlightIntegrator::Euler;
+
+    SweepEngine engine( context.environment, context.missionParams, config, context.threadPool );
+    engine.Run( context.ascentParams );
+
+    const std::vector<uint32_t> ranked = engine.RankProfiles( context.earthRadius, context.earthMu, 5 );
+    if ( ranked.empty() )
+    {
+        fprintf( stderr, "No profile reached MECO within the max Q limit.\n" );
+        return false;
+    }
+
+    // The ranked profiles from their speed and angle, as the gradient makes them, swept again to check its values.
+    std::vector<AscentParams> rankedParams;
+    for ( uint32_t profile : ranked )
+        rankedParams.push_back( MakeAscentParams( context.ascentParams[profile].pitchOverSpeed, asinf( context.ascentParams[profile].sinPitchOverAngle ) ) );
+
+    SweepEngine sweep( context.environment, context.missionParams, config, context.threadPool );
+    sweep.Run( rankedParams );
+
+    FlightSimulator simulator( context.environment, context.missionParams, config.simulationStepSize );
+    const uint32_t repeats = 3;
+    const float speedStep = 1.0f;
+    const float angleStep = 0.05f / c_RadToDegree;
+
+    printf( "Integrator %s, FD steps %.2f m/s and %.3f\xc2\xb0\n", GetFlightIntegratorName( config.integrator ), speedStep, angleStep * c_RadToDegree );
+    printf( "profile  speed (m/s)  angle (deg)  flight (ms)  dual (ms)  FD (ms)  dual/flight  FD/dual  values match\n" );
+
+    for ( uint32_t i = 0; i < ranked.size(); ++i )
+    {
+        const uint32_t profile = ranked[i];
+        const AscentParams& ascentParams = context.ascentParams[profile];
+        const float speed = ascentParams.pitchOverSpeed;
+        const float angle = asinf( ascentParams.sinPitchOverAngle );
+
+        FlightGradient dual, differences;
+        double dualTime = TimeFlights( repeats, [&] { CalcFlightGradient( simulator, config, speed, angle, dual ); } );
+        double differencesTime = TimeFlights( repeats, [&] { CalcFlightDifferences( simulator, config, speed, angle, speedStep, angleStep, differences ); } );
+
+        // One float flight, as the first of the differences flies it.
+        FlightGradient single;
+        double flightTime = TimeFlights( repeats, [&] { CalcFlightDifferences( simulator, config, speed, angle, speedStep, angleStep, single ); } ) / 5;
+
+        // The dual flight's values against the float flight's and the sweep's.
+        const bool match = memcmp( &dual.flightData, &differences.flightData, sizeof( FlightData ) ) == 0 &&
+                           memcmp( &dual.flightData, &sweep.GetFlightData()[i], sizeof( FlightData ) ) == 0;
+        printf( "%7u  %11.2f  %11.3f  %11.2f  %9.2f  %7.2f  %11.2f  %7.2f  %12s\n", profile, speed, angle * c_RadToDegree, flightTime * 1e3, dualTime * 1e3,
+                differencesTime * 1e3, dualTime / flightTime, differencesTime / dualTime, match ? "yes" : "no" );
+    }
+
+    // Derivatives of the best profile, per m/s and per degree, over a span of profiles either side of it. Each MECO
+    // falls at the end of a step, so the float flights' orbits scatter by about a step's energy gain and their least
+    // squares slope and central differences mostly measure that. With the events interpolated to their crossings
+    // the flights move smoothly, and their derivatives averaged over the span should come to their change across it.
+    // That's checked for the orbit's altitudes; the final mass still steps with guidance updates and E is held at
+    // the target by MECO, see FlightGradient.h, so theirs are only shown.
+    const AscentParams& best = context.ascentParams[ranked[0]];
+    const float speed = best.pitchOverSpeed;
+    const float angle = asinf( best.sinPitchOverAngle );
+    const uint32_t spanCount = 21;
+    const float spans[2] = { 2.0f, 0.4f / c_RadToDegree };
+
+    FlightGradient differences;
+    CalcFlightDifferences( simulator, config, speed, angle, speedStep, angleStep, differences );
+
+    struct GradientQuantity
+    {
+        const char*     name;
+        FlightSensitivity FlightGradient::*sensitivity;
+        bool            checked;        // Whether the mean derivative must come to the change
+    };
+
+    const GradientQuantity quantities[] =
+    {
+        { "minMass (kg)", &FlightGradient::minMass, false },
+        { "apoapsis (m)", &FlightGradient::apoapsis, true },
+        { "periapsis (m)", &FlightGradient::periapsis, true },
+        { "E (J/kg)", &FlightGradient::E, false },
+    };
+    const double tolerance = 0.2;
+    bool agreed = true;
+
+    for ( uint32_t input = 0; input < 2; ++input )
+    {
+        // The profiles across the span, speed or angle, offset -span to +span with the profile itself in the middle.
+        FlightGradient span[spanCount];
+        FlightGradient interpolated[spanCount];
+        float offsets[spanCount];
+        for ( uint32_t i = 0; i < spanCount; ++i )
+        {
+            offsets[i] = spans[input] * (2.0f * i / (spanCount - 1) - 1);
+            const float spanSpeed = speed + (input == 0 ? offsets[i] : 0);
+            const float spanAngle = angle + (input == 1 ? offsets[i] : 0);
+            CalcFlightGradient( simulator, config, spanSpeed, spanAngle, span[i] );
+            CalcFlightGradient( simulator, config, spanSpeed, spanAngle, interpolated[i], true );
+        }
+
+        const float unit = input == 0 ? 1 : 1 / c_RadToDegree;
+        if ( input == 0 )
+            printf( "\nProfile %u per m/s over +-%.2f m/s, FD at %.2f m/s\n", ranked[0], spans[0], speedStep );
+        else
+            printf( "\nProfile %u per degree over +-%.3f\xc2\xb0, FD at %.3f\xc2\xb0\n", ranked[0], spans[1] * c_RadToDegree, angleStep * c_RadToDegree );
+        printf( "                      dual  interpolated: dual  mean dual     change  agrees   float: LS slope         FD\n" );
+
+        for ( const GradientQuantity& quantity : quantities )
+        {
+            auto derivative = [&]( const FlightGradient& gradient )
+            {
+                const FlightSensitivity& x = gradient.*quantity.sensitivity;
+                return double( input == 0 ? x.perSpeed : x.perAngle );
+            };
+
+            // Trapezoidal mean of the interpolated flights' derivatives, against the change in their value.
+            double mean = -(derivative( interpolated[0] ) + derivative( interpolated[spanCount - 1] )) / 2;
+            for ( uint32_t i = 0; i < spanCount; ++i )
+                mean += derivative( interpolated[i] );
+            mean /= spanCount - 1;
+
+            const double change = ((interpolated[spanCount - 1].*quantity.sensitivity).value - (interpolated[0].*quantity.sensitivity).value) / (2 * spans[input]);
+
+            // The offsets are symmetric about zero.
+            double meanValue = 0;
+            for ( uint32_t i = 0; i < spanCount; ++i )
+                meanValue += (span[i].*quantity.sensitivity).value;
+            meanValue /= spanCount;
+
+            double covariance = 0, variance = 0;
+            for ( uint32_t i = 0; i < spanCount; ++i )
+            {
+                covariance += offsets[i] * ((span[i].*quantity.sensitivity).value - meanValue);
+                variance += sqr( offsets[i] );
+            }
+
+            const bool agrees = fabs( mean - change ) <= tolerance * fabs( change );
+            if ( quantity.checked )
+                agreed &= agrees;
+
+            printf( "%-14s  %10.4g  %18.4g  %9.4g  %9.4g  %6s  %16.4g  %9.4g\n", quantity.name, derivative( span[spanCount / 2] ) * unit,
+                    derivative( interpolated[spanCount / 2] ) * unit, mean * unit, change * unit, !quantity.checked ? "-" : agrees ? "yes" : "NO",
+                    covariance / variance * unit, derivative( differences ) * unit );
+        }
+    }
+
+    if ( !agreed )
+        fprintf( stderr, "Mean interpolated derivatives differ from the change across the span by more than %.0f%%.\n", tolerance * 100 );
+
+    return agreed;
+}
+
+//------------------------------------------------------------------------------------------------
+
+struct Benchmark
+{
+    const char*     name;
+    const char*     description;
+    bool            (*func)( const BenchmarkContext& context );
+};
+
+static const Benchmark c_Benchmarks[] =
+{
+    { "simd", "Sweep throughput of each SIMD batch kernel against the per profile path", BenchmarkSimd },
+    { "coast", "Sweep time, step count and results of each coast mode against integrating the coast", BenchmarkCoast },
+    { "adaptive", "Steps and accuracy of adaptive Dormand-Prince against fixed step Euler", BenchmarkAdaptive },
+    { "integrators", "Final orbit error and time of each fixed step integrator over a range of step sizes", BenchmarkIntegrators },
+    { "liftoff", "Sweep time and results with the vertical climb shared by every profile against flying it per profile", BenchmarkLiftoff },
+    { "guidance", "Guidance solve iterations and results seeded from converged neighbours against starting cold", BenchmarkGuidance },
+    { "curves", "Curve evaluation with the compiled segment index against searching the keys", BenchmarkCurves },
+    { "cursor", "Drag lookups along a flight by search, segment index and cursor, on the Mach sweep and a 1000 key one", BenchmarkCursor },
+    { "telemetry", "Sweep time and telemetry size with compact records, and their decoding error", BenchmarkTelemetry },
+    { "topk", "Telemetry stored for the best 16 profiles with the rest replayed, checked against storing all", BenchmarkTopTelemetry },
+    { "envelope", "Telemetry channel envelopes from the min/max pyramid against scanning the samples", BenchmarkEnvelope },
+    { "extents", "Flight data extents accumulated by each sweep path, and by the parallel reduction at 512, 64k and 1M flights, against the two pass scan", BenchmarkExtents },
+    { "pareto", "Pareto front by the sort filter skyline against the pairwise scan, at 512, 64k and 1M flights", BenchmarkPareto },
+    { "refine", "Grid refinement to 0.1 m/s and 0.01 degrees, with and without reusing coinciding grid points", BenchmarkRefine },
+    { "optimise", "Profiles flown to the best selection objective by CMA-ES and Nelder-Mead against the grid sweep and refinement", BenchmarkOptimise },
+    { "surrogate", "Profiles flown by expected improvement on a Gaussian process surrogate to reach the grid's and refinement's best", BenchmarkSurrogate },
+    { "dispersion", "Monte Carlo dispersion of the selected profile: throughput, reproducibility by run index and streaming quantiles against exact ones", BenchmarkDispersion },
+    { "vehicles", "Eight vehicles optimised one at a time against all at once on the shared thread pool", BenchmarkVehicles },
+    { "cache", "Sweep time cold, rerun warm from the result cache and over a grid half flown before, checked against flying every profile", BenchmarkCache },
+    { "shards", "Sweep on 1, 2 and 4 worker processes, one killed mid shard, checked against a single process sweep", BenchmarkShards },
+    { "gradient", "Final mass and orbit derivatives by one dual number pass against central differences and flights with interpolated events, their cost and agreement", BenchmarkGradient },
+    { "design", "Sweep design throughput by batch size over thrust limit and launch latitude, and the grid flown as a design against the grid", BenchmarkDesign },
+};
+
+bool RunBenchmark( const std::string& name, const BenchmarkContext& context )
+{
+    for ( const Benchmark& benchmark : c_Benchmarks )
+    {
+        if ( name == benchmark.name )
+            return benchmark.func( context );
+    }
+
+    fprintf( stderr, "Unknown benchmark %s.\n", name.c_str() );
+    return false;
+}
+
+void PrintBenchmarks()
+{
+    for ( const Benchmark& benchmark : c_Benchmarks )
+    {
+        printf( "    %-22s%s\n", benchmark.name, benchmark.description );
+    }
+}
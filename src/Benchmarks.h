@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "SweepEngine.h"
+
+//------------------------------------------------------------------------------------------------
+// Benchmarks run by rocketsim-cli --bench <name>, on the inputs loaded for a normal sweep.
+
+struct BenchmarkContext
+{
+    const FlightEnvironment&                        environment;
+    const ShaderShared::MissionParams&              missionParams;
+    const std::vector<ShaderShared::AscentParams>&  ascentParams;
+    uint32_t                                        angleCount;     // Of the speed major ascentParams grid
+    SweepConfig                                     config;
+    ThreadPool&                                     threadPool;
+    double                                          earthRadius;
+    double                                          earthMu;
+    const std::vector<std::string>&                 workerCommand;  // This program serving shards of the same inputs, see RunShardWorker
+};
+
+// Returns false, having printed the reason, if the benchmark is unknown or fails.
+bool    RunBenchmark( const std::string& name, const BenchmarkContext& context );
+
+// Lists the benchmark names and descriptions for the usage text.
+void    PrintBenchmarks();
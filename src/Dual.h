@@ -0,0 +1,248 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ShaderMath.h"
+
+//------------------------------------------------------------------------------------------------
+// Forward mode automatic differentiation. A Dual carries a value and its derivatives with respect to N
+// inputs, and every operation on it applies the chain rule, so code written over a scalar type yields
+// the derivatives of its results in the same pass that computes them.
+//
+// Values are computed by the same float operations in the same order as the plain float code, so the
+// value half of a flight differentiated through rounds exactly as the float flight does. Comparisons only
+// look at values, branches are taken as the float code takes them and contribute no derivative.
+//
+// Operators and maths functions are friends, found by argument dependent lookup alongside ShaderMath.h's,
+// so float operands convert to constants (no derivative) wherever they're mixed with Duals.
+
+template<uint32_t N>
+struct Dual
+{
+    float   v;          // Value
+    float   d[N];       // Derivatives with respect to each input
+
+    Dual() : v( 0 )
+    {
+        for ( uint32_t i = 0; i < N; ++i )
+            d[i] = 0;
+    }
+
+    // Constant.
+    Dual( float value ) : v( value )
+    {
+        for ( uint32_t i = 0; i < N; ++i )
+            d[i] = 0;
+    }
+
+    // Input i of the N.
+    static Dual MakeInput( float value, uint32_t i )
+    {
+        Dual x( value );
+        x.d[i] = 1;
+        return x;
+    }
+
+    // Value derivative pair from a function's value and its derivative at a.v.
+    static Dual Chain( const Dual& a, float value, float derivative )
+    {
+        Dual r;
+        r.v = value;
+        for ( uint32_t i = 0; i < N; ++i )
+            r.d[i] = derivative * a.d[i];
+        return r;
+    }
+
+    //--------------------------------------------------------------------------------------------
+
+    friend Dual operator+( const Dual& a, const Dual& b )
+    {
+        Dual r;
+        r.v = a.v + b.v;
+        for ( uint32_t i = 0; i < N; ++i )
+            r.d[i] = a.d[i] + b.d[i];
+        return r;
+    }
+
+    friend Dual operator-( const Dual& a, const Dual& b )
+    {
+        Dual r;
+        r.v = a.v - b.v;
+        for ( uint32_t i = 0; i < N; ++i )
+            r.d[i] = a.d[i] - b.d[i];
+        return r;
+    }
+
+    friend Dual operator-( const Dual& a )
+    {
+        Dual r;
+        r.v = -a.v;
+        for ( uint32_t i = 0; i < N; ++i )
+            r.d[i] = -a.d[i];
+        return r;
+    }
+
+    friend Dual operator*( const Dual& a, const Dual& b )
+    {
+        Dual r;
+        r.v = a.v * b.v;
+        for ( uint32_t i = 0; i < N; ++i )
+            r.d[i] = a.d[i] * b.v + a.v * b.d[i];
+        return r;
+    }
+
+    friend Dual operator/( const Dual& a, const Dual& b )
+    {
+        Dual r;
+        r.v = a.v / b.v;
+        for ( uint32_t i = 0; i < N; ++i )
+            r.d[i] = (a.d[i] - r.v * b.d[i]) / b.v;
+        return r;
+    }
+
+    friend Dual& operator+=( Dual& a, const Dual& b ) { return a = a + b; }
+    friend Dual& operator-=( Dual& a, const Dual& b ) { return a = a - b; }
+    friend Dual& operator*=( Dual& a, const Dual& b ) { return a = a * b; }
+    friend Dual& operator/=( Dual& a, const Dual& b ) { return a = a / b; }
+
+    friend bool operator<( const Dual& a, const Dual& b ) { return a.v < b.v; }
+    friend bool operator<=( const Dual& a, const Dual& b ) { return a.v <= b.v; }
+    friend bool operator>( const Dual& a, const Dual& b ) { return a.v > b.v; }
+    friend bool operator>=( const Dual& a, const Dual& b ) { return a.v >= b.v; }
+    friend bool operator==( const Dual& a, const Dual& b ) { return a.v == b.v; }
+    friend bool operator!=( const Dual& a, const Dual& b ) { return a.v != b.v; }
+
+    //--------------------------------------------------------------------------------------------
+
+    // The derivative is taken as zero at zero, where a length starts from rest.
+    friend Dual sqrtf( const Dual& a )
+    {
+        float value = ::sqrtf( a.v );
+        return Chain( a, value, value > 0 ? 0.5f / value : 0.0f );
+    }
+
+    friend Dual expf( const Dual& a )
+    {
+        float value = ::expf( a.v );
+        return Chain( a, value, value );
+    }
+
+    friend Dual logf( const Dual& a )
+    {
+        return Chain( a, ::logf( a.v ), 1 / a.v );
+    }
+
+    friend Dual sinf( const Dual& a )
+    {
+        return Chain( a, ::sinf( a.v ), ::cosf( a.v ) );
+    }
+
+    friend Dual cosf( const Dual& a )
+    {
+        return Chain( a, ::cosf( a.v ), -::sinf( a.v ) );
+    }
+
+    // Unbounded at +-1, so is the derivative of anything steered by the angle between two unit vectors
+    // there; StepFlight only uses such angles through fmaxf with the turn rate, which drops it.
+    friend Dual acosf( const Dual& a )
+    {
+        return Chain( a, ::acosf( a.v ), -1 / ::sqrtf( 1 - a.v * a.v ) );
+    }
+
+    friend Dual fabsf( const Dual& a )
+    {
+        return a.v < 0 ? -a : a;
+    }
+
+    // As fminf and fmaxf, the non-NaN operand if one is NaN. The derivative is the chosen operand's.
+    friend Dual fminf( const Dual& a, const Dual& b )
+    {
+        return b.v < a.v || a.v != a.v ? b : a;
+    }
+
+    friend Dual fmaxf( const Dual& a, const Dual& b )
+    {
+        return b.v > a.v || a.v != a.v ? b : a;
+    }
+
+    friend Dual sqr( const Dual& a )
+    {
+        return a * a;
+    }
+
+    friend Dual cube( const Dual& a )
+    {
+        return a * a * a;
+    }
+
+    friend Dual lerp( const Dual& a, const Dual& b, const Dual& t )
+    {
+        return a + (b - a) * t;
+    }
+};
+
+// The value alone, so code over a scalar type can take one without knowing which it is.
+inline float GetValue( float x )
+{
+    return x;
+}
+
+template<uint32_t N>
+inline float GetValue( const Dual<N>& x )
+{
+    return x.v;
+}
+
+//------------------------------------------------------------------------------------------------
+// Vectors of Duals, with the float2 and float3 operations of ShaderMath.h.
+
+template<uint32_t N>
+struct Dual2
+{
+    Dual<N>     x, y;
+
+    Dual2() {}
+    Dual2( const Dual<N>& x_, const Dual<N>& y_ ) : x( x_ ), y( y_ ) {}
+    Dual2( const ShaderShared::float2& v ) : x( v.x ), y( v.y ) {}
+
+    friend Dual2 operator+( const Dual2& a, const Dual2& b ) { return Dual2( a.x + b.x, a.y + b.y ); }
+    friend Dual2 operator-( const Dual2& a, const Dual2& b ) { return Dual2( a.x - b.x, a.y - b.y ); }
+    friend Dual2 operator-( const Dual2& a ) { return Dual2( -a.x, -a.y ); }
+    friend Dual2 operator*( const Dual2& a, const Dual<N>& s ) { return Dual2( a.x * s, a.y * s ); }
+    friend Dual2 operator*( const Dual<N>& s, const Dual2& a ) { return Dual2( a.x * s, a.y * s ); }
+    friend Dual2 operator/( const Dual2& a, const Dual<N>& s ) { return Dual2( a.x / s, a.y / s ); }
+    friend Dual2& operator+=( Dual2& a, const Dual2& b ) { return a = a + b; }
+    friend Dual2& operator-=( Dual2& a, const Dual2& b ) { return a = a - b; }
+
+    friend Dual<N> dot( const Dual2& a, const Dual2& b ) { return a.x * b.x + a.y * b.y; }
+    friend Dual<N> length( const Dual2& a ) { return sqrtf( dot( a, a ) ); }
+    friend Dual2 normalize( const Dual2& a ) { return a / length( a ); }
+    friend Dual2 lerp( const Dual2& a, const Dual2& b, const Dual<N>& t ) { return a + (b - a) * t; }
+};
+
+template<uint32_t N>
+struct Dual3
+{
+    Dual<N>     x, y, z;
+
+    Dual3() {}
+    Dual3( const Dual<N>& x_, const Dual<N>& y_, const Dual<N>& z_ ) : x( x_ ), y( y_ ), z( z_ ) {}
+
+    friend Dual3 operator+( const Dual3& a, const Dual3& b ) { return Dual3( a.x + b.x, a.y + b.y, a.z + b.z ); }
+    friend Dual3 operator-( const Dual3& a, const Dual3& b ) { return Dual3( a.x - b.x, a.y - b.y, a.z - b.z ); }
+    friend Dual3 operator*( const Dual3& a, const Dual<N>& s ) { return Dual3( a.x * s, a.y * s, a.z * s ); }
+    friend Dual3 operator*( const Dual<N>& s, const Dual3& a ) { return Dual3( a.x * s, a.y * s, a.z * s ); }
+    friend Dual3 operator/( const Dual3& a, const Dual<N>& s ) { return Dual3( a.x / s, a.y / s, a.z / s ); }
+
+    friend Dual<N> dot( const Dual3& a, const Dual3& b ) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    friend Dual3 cross( const Dual3& a, const Dual3& b ) { return Dual3( a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x ); }
+    friend Dual<N> length( const Dual3& a ) { return sqrtf( dot( a, a ) ); }
+    friend Dual3 normalize( const Dual3& a ) { return a / length( a ); }
+    friend Dual2<N> xy( const Dual3& a ) { return Dual2<N>( a.x, a.y ); }
+};
+
+template<uint32_t N>
+struct Dual4
+{
+    Dual<N>     x, y, z, w;
+};
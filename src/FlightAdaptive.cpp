@@ -0,0 +1,617 @@
+#include "FlightAdaptive.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+using namespace ShaderShared;
+
+static constexpr double c_Pi = 3.14159265358979;
+
+// Heading tracks its aim with this time constant (1/s) when inside the turn rate limit.
+static constexpr double c_HeadingGain = 10.0;
+
+// Steps never grow past this, so telemetry read from the dense output stays within tolerance on long coasts.
+static constexpr double c_MaxStep = 60.0;
+
+// Events are located to this many seconds.
+static constexpr double c_EventTolerance = 1e-6;
+
+//------------------------------------------------------------------------------------------------
+// Dormand-Prince 5(4) tableau, with Hairer's coefficients for the fourth order dense output.
+
+namespace
+{
+
+const double c_C[7] = { 0, 1.0 / 5, 3.0 / 10, 4.0 / 5, 8.0 / 9, 1, 1 };
+
+const double c_A[7][6] =
+{
+    { 0 },
+    { 1.0 / 5 },
+    { 3.0 / 40, 9.0 / 40 },
+    { 44.0 / 45, -56.0 / 15, 32.0 / 9 },
+    { 19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729 },
+    { 9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656 },
+    { 35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84 },
+};
+
+// Fifth minus fourth order weights.
+const double c_E[7] = { 71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920, -17253.0 / 339200, 22.0 / 525, -1.0 / 40 };
+
+const double c_D[7] = { -12715105075.0 / 11282082432, 0, 87487479700.0 / 32700410799, -10690763975.0 / 1880347072,
+                        701980252875.0 / 199316789632, -1453857185.0 / 822651844, 69997945.0 / 29380423 };
+
+// Interpolant over an accepted step from t0 to t0 + h.
+struct DenseOutput
+{
+    double  t0;
+    double  h;
+    double  r[5][6];
+
+    void    Evaluate( double t, double* y ) const
+    {
+        double theta = (t - t0) / h;
+        double theta1 = 1 - theta;
+
+        for ( uint32_t i = 0; i < 6; ++i )
+            y[i] = r[0][i] + theta * (r[1][i] + theta1 * (r[2][i] + theta * (r[3][i] + theta1 * r[4][i])));
+    }
+};
+
+double WrapAngle( double angle )
+{
+    return angle - 2 * c_Pi * floor( (angle + c_Pi) / (2 * c_Pi) );
+}
+
+}
+
+//------------------------------------------------------------------------------------------------
+
+AdaptiveFlightSimulator::AdaptiveFlightSimulator( const FlightSimulator& simulator, double tolerance ) :
+    m_simulator( simulator ),
+    m_tolerance( tolerance )
+{
+    const EnvironmentalData& env = simulator.GetEnvironment().params;
+
+    // Error is measured relative to these or the component's size, whichever is larger.
+    m_scale[0] = env.Re;
+    m_scale[1] = env.Re;
+    m_scale[2] = 1000;
+    m_scale[3] = 1000;
+    m_scale[4] = simulator.GetMissionParams().stage[0].wetMass;
+    m_scale[5] = 1;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void AdaptiveFlightSimulator::CalcGuidanceAim( const Mode& mode, double t, const State& state, float accel, float2& aim ) const
+{
+    GuidanceData G = mode.guidance[mode.stage];
+    if ( mode.guidanceClock )
+        G.t += float( t - mode.guidanceTime );
+
+    float3 position( float( state.y[0] ), float( state.y[1] ), 0 );
+    float3 velocity( float( state.y[2] ), float( state.y[3] ), 0 );
+
+    aim = xy( m_simulator.CalcGuidanceAim( G, position, velocity, accel ) );
+}
+
+// StepFlight's forces and steering, with the heading's turn toward its aim as a rate.
+void AdaptiveFlightSimulator::Evaluate( const AscentParams& ascentParams, double t, const State& state, const Mode& mode, Forces& forces ) const
+{
+    const FlightEnvironment& environment = m_simulator.GetEnvironment();
+    const EnvironmentalData& env = environment.params;
+    const MissionParams& missionParams = m_simulator.GetMissionParams();
+    const StageData& stageData = missionParams.stage[mode.stage];
+
+    double px = state.y[0];
+    double py = state.y[1];
+    double r = sqrt( px * px + py * py );
+    float2 upVec( float( px / r ), float( py / r ) );
+
+    // Curves are only read above ground, a crash stops the flight at zero.
+    forces.h = float( r - env.Re );
+    float h = fmaxf( forces.h, 0 );
+
+    float P = environment.GetStaticPressure( h );
+    float T = environment.GetTemperature( h );
+
+    double mass = state.y[4];
+    bool burning = mode.phase < c_PhaseMECO && mass > stageData.dryMass;
+
+    forces.exhaustV = env.g0 * lerp( stageData.IspVac, stageData.IspSL, P / environment.GetSeaLevelPressure() );
+    forces.thrust = burning ? stageData.massFlow * forces.exhaustV : 0;
+    forces.massRate = burning ? -stageData.massFlow : 0;
+
+    float2 surfVelocity( float( state.y[2] - mode.frameVelocity[0] ), float( state.y[3] - mode.frameVelocity[1] ) );
+    forces.surfSpeed = length( surfVelocity );
+
+    float M = forces.surfSpeed / environment.GetSpeedOfSound( T );
+    forces.Q = environment.CalcQfromPressure( P, M );
+    float Fdrag = forces.Q * environment.GetCdA( mode.stage, M );
+
+    double headingX = cos( state.y[5] );
+    double headingY = sin( state.y[5] );
+    double gravity = env.mu / (r * r);
+    double thrustAccel = (forces.thrust - Fdrag) / mass;
+
+    forces.accel[0] = -px / r * gravity + thrustAccel * headingX;
+    forces.accel[1] = -py / r * gravity + thrustAccel * headingY;
+
+    float2 prograde = forces.surfSpeed > 0 ? surfVelocity / forces.surfSpeed : upVec;
+    forces.upDotPrograde = dot( upVec, prograde );
+    forces.upDotGuidance = 0;
+    forces.guidanceValid = false;
+
+    // steering
+    float2 aim;
+    bool steering = true;
+
+    if ( mode.phase == c_PhaseLiftoff )
+    {
+        aim = upVec;
+    }
+    else if ( mode.phase == c_PhasePitchOver )
+    {
+        aim.x = dot( upVec, float2( ascentParams.cosAimAngle, ascentParams.sinAimAngle ) );
+        aim.y = dot( upVec, float2( -ascentParams.sinAimAngle, ascentParams.cosAimAngle ) );
+    }
+    else if ( mode.phase < c_PhaseMECO && forces.thrust > 0 )
+    {
+        float2 guidance( 0, 0 );
+        if ( mode.phase >= c_PhaseGuidanceReady )
+            CalcGuidanceAim( mode, t, state, forces.thrust / float( mass ), guidance );
+
+        forces.guidanceValid = dot( guidance, guidance ) > 0.9f;
+        forces.upDotGuidance = dot( upVec, guidance );
+
+        aim = (mode.phase < c_PhaseGuidanceActive || !forces.guidanceValid) ? prograde : guidance;
+    }
+    else
+    {
+        steering = false;
+    }
+
+    forces.headingRate = 0;
+    if ( steering )
+    {
+        double turn = WrapAngle( atan2( aim.y, aim.x ) - state.y[5] );
+        double maxRate = fmaxf( stageData.rotationRate, 0.001f ) * sqrt( missionParams.stage[0].wetMass / mass );
+
+        forces.headingRate = std::min( std::max( turn * c_HeadingGain, -maxRate ), maxRate );
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Each phase waits on one condition becoming true, this crosses zero when it does.
+double AdaptiveFlightSimulator::EventFunction( const AscentParams& ascentParams, double t, const State& state, const Mode& mode ) const
+{
+    Forces forces;
+    Evaluate( ascentParams, t, state, mode, forces );
+
+    switch ( mode.phase )
+    {
+    case c_PhaseLiftoff:
+        return ascentParams.pitchOverSpeed - forces.surfSpeed;
+
+    case c_PhasePitchOver:
+        return forces.upDotPrograde - ascentParams.cosPitchOverAngle;
+
+    case c_PhaseAeroFlight:
+        return forces.thrust > 0 ? forces.Q - mode.maxQ * 0.2f : 1;
+
+    case c_PhaseGuidanceReady:
+    {
+        if ( forces.thrust <= 0 || !forces.guidanceValid )
+            return 1;
+
+        // Q low enough, and guidance pitching below open loop or, past the first stage, Q at 1% of maxQ.
+        double pitchBelow = forces.upDotGuidance - forces.upDotPrograde;
+        if ( mode.stage > 0 )
+            pitchBelow = std::min( pitchBelow, double( forces.Q - mode.maxQ * 0.01f ) );
+
+        return std::max( double( forces.Q - mode.maxQ * 0.05f ), pitchBelow );
+    }
+
+    case c_PhaseGuidanceActive:
+    {
+        if ( forces.thrust <= 0 || !forces.guidanceValid )
+            return 1;
+
+        // Final orbital energy reached, located exactly rather than predicted half a step ahead.
+        float a, E;
+        float2 e;
+        m_simulator.GetEnvironment().CalcOrbitParameters( float2( float( state.y[0] ), float( state.y[1] ) ), float2( float( state.y[2] ), float( state.y[3] ) ), a, e, E );
+
+        return m_simulator.GetMissionParams().finalOrbitalEnergy - E;
+    }
+
+    default:
+        return 1;
+    }
+}
+
+void AdaptiveFlightSimulator::ApplyEvent( const AscentParams& ascentParams, double t, const State& state, Mode& mode, GuidanceSolve* solve ) const
+{
+    switch ( mode.phase )
+    {
+    case c_PhaseLiftoff:
+        mode.phase = c_PhasePitchOver;
+        break;
+
+    case c_PhasePitchOver:
+        mode.phase = c_PhaseAeroFlight;
+        break;
+
+    case c_PhaseAeroFlight:
+    {
+        Forces forces;
+        Evaluate( ascentParams, t, state, mode, forces );
+
+        m_simulator.ConvergeLaneGuidance( mode.guidance, mode.stage, float( state.y[4] ), float( state.y[0] ), float( state.y[1] ), float( state.y[2] ), float( state.y[3] ),
+                                          forces.exhaustV, forces.thrust / float( state.y[4] ), solve );
+
+        mode.phase = c_PhaseGuidanceReady;
+        mode.guidanceClock = true;
+        mode.guidanceTime = t;
+        break;
+    }
+
+    case c_PhaseGuidanceReady:
+        mode.phase = c_PhaseGuidanceActive;
+        break;
+
+    case c_PhaseGuidanceActive:
+        mode.guidance[mode.stage].t += float( t - mode.guidanceTime );
+        mode.guidanceClock = false;
+        mode.phase = c_PhaseMECO;
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+void AdaptiveFlightSimulator::WriteSample( const AscentParams& ascentParams, double t, const State& state, const Mode& mode, CompactTelemetry& sample,
+                                           float& guidancePitch ) const
+{
+    Forces forces;
+    Evaluate( ascentParams, t, state, mode, forces );
+
+    if ( forces.guidanceValid )
+        guidancePitch = float( c_Pi ) - acosf( forces.upDotGuidance );
+
+    TelemetryData telemetry = {};
+    telemetry.eciPosition = float2( float( state.y[0] ), float( state.y[1] ) );
+    telemetry.eciVelocity = float2( float( state.y[2] ), float( state.y[3] ) );
+    telemetry.heading = float2( float( cos( state.y[5] ) ), float( sin( state.y[5] ) ) );
+    telemetry.stage = mode.stage;
+    telemetry.mass = float( state.y[4] );
+    telemetry.flightPhase = mode.phase;
+    telemetry.guidancePitch = guidancePitch;
+
+    sample = EncodeTelemetry( telemetry );
+}
+
+void AdaptiveFlightSimulator::UpdateFlightData( const AscentParams& ascentParams, double t, const State& state, Mode& mode, FlightData& flightData ) const
+{
+    Forces forces;
+    Evaluate( ascentParams, t, state, mode, forces );
+
+    flightData.maxAltitude = fmaxf( flightData.maxAltitude, forces.h );
+    flightData.maxSurfSpeed = fmaxf( flightData.maxSurfSpeed, forces.surfSpeed );
+    flightData.maxEciSpeed = fmaxf( flightData.maxEciSpeed, float( sqrt( state.y[2] * state.y[2] + state.y[3] * state.y[3] ) ) );
+    flightData.maxQ = fmaxf( flightData.maxQ, forces.Q );
+    flightData.minMass = fminf( flightData.minMass, float( state.y[4] ) );
+    flightData.maxAccel = fmaxf( flightData.maxAccel, float( sqrt( forces.accel[0] * forces.accel[0] + forces.accel[1] * forces.accel[1] ) ) );
+
+    mode.maxQ = flightData.maxQ;
+}
+
+//------------------------------------------------------------------------------------------------
+
+uint32_t AdaptiveFlightSimulator::SimulateFlight( const AscentParams& ascentParams, const TelemetryData& initialState, FlightData& flightData,
+                                                  CompactTelemetry* telemetry, double sampleInterval, uint32_t telemetryMaxSamples, double flightTime, CoastMode coastMode,
+                                                  GuidanceSolve* solve ) const
+{
+    const MissionParams& missionParams = m_simulator.GetMissionParams();
+    const float Re = m_simulator.GetEnvironment().params.Re;
+
+    State state;
+    state.y[0] = initialState.eciPosition.x;
+    state.y[1] = initialState.eciPosition.y;
+    state.y[2] = initialState.eciVelocity.x;
+    state.y[3] = initialState.eciVelocity.y;
+    state.y[4] = initialState.mass;
+    state.y[5] = atan2( initialState.heading.y, initialState.heading.x );
+
+    Mode mode;
+    mode.phase = flightData.flightPhase;
+    mode.stage = initialState.stage;
+    memcpy( mode.guidance, flightData.guidance, sizeof( mode.guidance ) );
+    mode.guidanceTime = 0;
+    mode.guidanceClock = false;
+    mode.maxQ = flightData.maxQ;
+
+    float2 frameVelocity = initialState.eciVelocity - initialState.surfVelocity;
+    mode.frameVelocity[0] = frameVelocity.x;
+    mode.frameVelocity[1] = frameVelocity.y;
+
+    float guidancePitch = initialState.guidancePitch;
+    uint32_t nextSample = 0;
+    uint32_t stepCount = 0;
+
+    double t = 0;
+    double h = m_simulator.GetTimeStep();
+    double k[7][c_StateSize];
+    bool haveK1 = false;
+    bool stopped = false;
+
+    auto derivative = [this, &ascentParams, &mode] ( double time, const State& y, double* dy )
+    {
+        Forces forces;
+        Evaluate( ascentParams, time, y, mode, forces );
+
+        dy[0] = y.y[2];
+        dy[1] = y.y[3];
+        dy[2] = forces.accel[0];
+        dy[3] = forces.accel[1];
+        dy[4] = forces.massRate;
+        dy[5] = forces.headingRate;
+    };
+
+    while ( t < flightTime && !stopped )
+    {
+        // Conditions already met at the start of a step, such as guidance converging on the pad when
+        // pitching over there, change phase before stepping.
+        for ( uint32_t i = 0; i < 4 && EventFunction( ascentParams, t, state, mode ) <= 0; ++i )
+        {
+            ApplyEvent( ascentParams, t, state, mode, solve );
+            haveK1 = false;
+        }
+
+        // Guidance runs every second.
+        GuidanceData& G = mode.guidance[mode.stage];
+        if ( mode.guidanceClock && G.T > 10 && G.t + (t - mode.guidanceTime) >= 1 - c_EventTolerance )
+        {
+            Forces forces;
+            Evaluate( ascentParams, t, state, mode, forces );
+
+            G.t += float( t - mode.guidanceTime );
+            mode.guidanceTime = t;
+
+            m_simulator.UpdateLaneGuidance( mode.guidance, mode.stage, float( state.y[0] ), float( state.y[1] ), float( state.y[2] ), float( state.y[3] ),
+                                            forces.exhaustV, forces.thrust / float( state.y[4] ) );
+            haveK1 = false;
+        }
+
+        const StageData& stageData = missionParams.stage[mode.stage];
+        bool burning = mode.phase < c_PhaseMECO && state.y[4] > stageData.dryMass;
+
+        // Steps end on burnout and on the once a second guidance update, both known in advance.
+        double stepEnd = flightTime;
+        bool burnout = false;
+        bool guidanceTick = false;
+
+        if ( burning )
+        {
+            double burnoutTime = t + (state.y[4] - stageData.dryMass) / stageData.massFlow;
+            if ( burnoutTime < stepEnd )
+            {
+                stepEnd = burnoutTime;
+                burnout = true;
+            }
+        }
+
+        if ( mode.guidanceClock && G.T > 10 )
+        {
+            double tickTime = mode.guidanceTime + std::max( 1.0 - G.t, 0.0 );
+            if ( tickTime <= stepEnd )
+            {
+                stepEnd = tickTime;
+                burnout = false;
+                guidanceTick = true;
+            }
+        }
+
+        h = std::min( h, c_MaxStep );
+        bool hitStepEnd = t + h >= stepEnd;
+        if ( hitStepEnd )
+            h = stepEnd - t;
+
+        if ( !haveK1 )
+        {
+            derivative( t, state, k[0] );
+            haveK1 = true;
+        }
+
+        // Runge-Kutta stages
+        State stage;
+        for ( uint32_t s = 1; s < 7; ++s )
+        {
+            for ( uint32_t i = 0; i < c_StateSize; ++i )
+            {
+                double sum = 0;
+                for ( uint32_t j = 0; j < s; ++j )
+                    sum += c_A[s][j] * k[j][i];
+
+                stage.y[i] = state.y[i] + h * sum;
+            }
+
+            derivative( t + c_C[s] * h, stage, k[s] );
+        }
+
+        // The last stage is the fifth order solution, the error is its difference from the fourth order one.
+        double errorSq = 0;
+        for ( uint32_t i = 0; i < c_StateSize; ++i )
+        {
+            double error = 0;
+            for ( uint32_t j = 0; j < 7; ++j )
+                error += c_E[j] * k[j][i];
+
+            double scale = m_tolerance * std::max( m_scale[i], std::max( fabs( state.y[i] ), fabs( stage.y[i] ) ) );
+            errorSq += (h * error / scale) * (h * error / scale);
+        }
+
+        double error = sqrt( errorSq / c_StateSize );
+        double factor = std::min( 5.0, std::max( 0.2, 0.9 * pow( std::max( error, 1e-10 ), -0.2 ) ) );
+
+        if ( error > 1 )
+        {
+            h *= std::min( factor, 0.9 );
+            continue;
+        }
+
+        ++stepCount;
+
+        DenseOutput dense;
+        dense.t0 = t;
+        dense.h = h;
+        for ( uint32_t i = 0; i < c_StateSize; ++i )
+        {
+            double delta = stage.y[i] - state.y[i];
+            double bspl = h * k[0][i] - delta;
+
+            dense.r[0][i] = state.y[i];
+            dense.r[1][i] = delta;
+            dense.r[2][i] = bspl;
+            dense.r[3][i] = delta - h * k[6][i] - bspl;
+
+            double d = 0;
+            for ( uint32_t j = 0; j < 7; ++j )
+                d += c_D[j] * k[j][i];
+            dense.r[4][i] = h * d;
+        }
+
+        // Locate the earliest of the phase change and a crash, both positive at the start of the step.
+        double stepTime = t + h;
+        uint32_t event = 0;    // 1 phase change, 2 crash
+
+        auto crashFunction = [Re] ( const State& y ) { return sqrt( y.y[0] * y.y[0] + y.y[1] * y.y[1] ) - Re; };
+        auto locate = [&dense, t] ( double t1, const auto& g )
+        {
+            double a = t;
+            double b = t1;
+            State y;
+
+            for ( uint32_t i = 0; i < 60 && b - a > c_EventTolerance; ++i )
+            {
+                double mid = (a + b) * 0.5;
+                dense.Evaluate( mid, y.y );
+                if ( g( y, mid ) <= 0 )
+                    b = mid;
+                else
+                    a = mid;
+            }
+
+            return b;
+        };
+
+        if ( EventFunction( ascentParams, stepTime, stage, mode ) <= 0 )
+        {
+            stepTime = locate( stepTime, [this, &ascentParams, &mode] ( const State& y, double time ) { return EventFunction( ascentParams, time, y, mode ); } );
+            event = 1;
+        }
+
+        if ( crashFunction( stage ) < 0 )
+        {
+            State y;
+            dense.Evaluate( stepTime, y.y );
+            if ( event == 0 || crashFunction( y ) < 0 )
+            {
+                stepTime = locate( stepTime, [&crashFunction] ( const State& y, double ) { return crashFunction( y ); } );
+                event = 2;
+            }
+        }
+
+        // Telemetry samples falling in the step come from the interpolant.
+        for ( ; telemetry && nextSample < telemetryMaxSamples && (nextSample + 1) * sampleInterval <= stepTime; ++nextSample )
+        {
+            State y;
+            double sampleTime = (nextSample + 1) * sampleInterval;
+            dense.Evaluate( sampleTime, y.y );
+            WriteSample( ascentParams, sampleTime, y, mode, telemetry[nextSample], guidancePitch );
+        }
+
+        if ( burning )
+            flightData.stageBurnTime[mode.stage] += float( stepTime - t );
+
+        // Extremes at the middle and end of the step.
+        State mid;
+        dense.Evaluate( (t + stepTime) * 0.5, mid.y );
+        UpdateFlightData( ascentParams, (t + stepTime) * 0.5, mid, mode, flightData );
+
+        if ( event != 0 )
+            dense.Evaluate( stepTime, state.y );
+        else
+            state = stage;
+
+        t = stepTime;
+        UpdateFlightData( ascentParams, t, state, mode, flightData );
+
+        // FSAL, the last stage is the next step's first unless something changes discontinuously.
+        memcpy( k[0], k[6], sizeof( k[0] ) );
+        haveK1 = event == 0;
+
+        if ( event == 2 )
+        {
+            stopped = true;
+        }
+        else if ( event == 1 )
+        {
+            ApplyEvent( ascentParams, t, state, mode, solve );
+        }
+        else if ( hitStepEnd && burnout )
+        {
+            state.y[4] = stageData.dryMass;
+
+            if ( mode.stage + 1 < missionParams.stageCount )
+            {
+                // Guidance for the next stage carries on from its own t.
+                if ( mode.guidanceClock )
+                    mode.guidance[mode.stage].t += float( t - mode.guidanceTime );
+
+                mode.stage += 1;
+                mode.guidanceTime = t;
+                state.y[4] = missionParams.stage[mode.stage].wetMass;
+            }
+            else if ( mode.guidanceClock )
+            {
+                mode.guidance[mode.stage].t += float( t - mode.guidanceTime );
+                mode.guidanceClock = false;
+            }
+
+            haveK1 = false;
+        }
+        else if ( hitStepEnd && guidanceTick )
+        {
+            haveK1 = false;
+        }
+
+        // Burnt out on the last stage, or MECO, with nothing left to simulate but a coast.
+        if ( coastMode == CoastMode::Freeze && (mode.phase == c_PhaseMECO || (mode.stage == missionParams.stageCount - 1 && state.y[4] <= missionParams.stage[mode.stage].dryMass)) )
+            stopped = true;
+
+        h *= factor;
+    }
+
+    // Frozen from here on, as FinishFlight holds a retired flight.
+    for ( ; telemetry && nextSample < telemetryMaxSamples; ++nextSample )
+        WriteSample( ascentParams, t, state, mode, telemetry[nextSample], guidancePitch );
+
+    if ( mode.guidanceClock )
+        mode.guidance[mode.stage].t += float( t - mode.guidanceTime );
+
+    float2 position( float( state.y[0] ), float( state.y[1] ) );
+    float2 velocity( float( state.y[2] ), float( state.y[3] ) );
+    float2 eccentricity;
+    m_simulator.GetEnvironment().CalcOrbitParameters( position, velocity, flightData.a, eccentricity, flightData.E );
+    flightData.e = length( eccentricity );
+
+    flightData.flightPhase = mode.phase;
+    flightData.stage = mode.stage;
+    memcpy( flightData.guidance, mode.guidance, sizeof( mode.guidance ) );
+
+    return stepCount;
+}
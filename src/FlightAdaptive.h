@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "FlightCoast.h"
+#include "FlightSim.h"
+#include "FlightTelemetry.h"
+
+//------------------------------------------------------------------------------------------------
+// Dormand-Prince 5(4) integration of a flight with error control, as an alternative to stepping
+// StepFlight at a fixed 1/50 s. The flight is the continuous limit of StepFlight: the same forces,
+// steering and guidance, with every phase change, staging, the once a second guidance update and
+// MECO located as an event rather than found at the end of a step. Steps can then grow to whatever
+// the tolerance allows between events.
+//
+// Heading is a state with its turn rate limited to the stage's rotation rate, tracking the aim with
+// a first order lag (c_HeadingGain) where StepFlight would snap onto it.
+//------------------------------------------------------------------------------------------------
+
+class AdaptiveFlightSimulator
+{
+public:
+    // tolerance is relative, scaled per component by the size of the pad state. The forces are evaluated in
+    // float as StepFlight does, so much below 1e-9 the error estimate is mostly rounding and steps collapse.
+    AdaptiveFlightSimulator( const FlightSimulator& simulator, double tolerance );
+
+    // Flies one profile from its InitFlight state to flightTime. Telemetry samples (if not null) are taken
+    // every sampleInterval seconds, sample i holding the state at (i + 1) * sampleInterval as in SweepEngine.
+    // Flights stop at a crash, or at MECO or burnout with CoastMode::Freeze. solve, if not null, seeds and records
+    // the guidance solve. Returns the accepted step count.
+    uint32_t    SimulateFlight( const ShaderShared::AscentParams& ascentParams, const ShaderShared::TelemetryData& initialState, ShaderShared::FlightData& flightData,
+                                CompactTelemetry* telemetry, double sampleInterval, uint32_t telemetryMaxSamples, double flightTime, CoastMode coastMode,
+                                GuidanceSolve* solve ) const;
+
+private:
+    static const uint32_t   c_StateSize = 6;
+
+    // Position, velocity, mass and heading angle (from +x).
+    struct State
+    {
+        double  y[c_StateSize];
+    };
+
+    // Everything that only changes at events.
+    struct Mode
+    {
+        uint32_t                    phase;
+        uint32_t                    stage;
+        ShaderShared::GuidanceData  guidance[4];
+        double                      guidanceTime;   // Time guidance[stage].t was last set at
+        bool                        guidanceClock;  // guidance[stage].t is advancing
+        float                       maxQ;
+        double                      frameVelocity[2];   // ECI velocity of the surface frame
+    };
+
+    // Forces and steering at one state.
+    struct Forces
+    {
+        double  accel[2];
+        double  massRate;
+        double  headingRate;
+
+        float   h;
+        float   Q;
+        float   thrust;
+        float   exhaustV;
+        float   upDotPrograde;
+        float   upDotGuidance;
+        float   surfSpeed;
+        bool    guidanceValid;
+    };
+
+    void    Evaluate( const ShaderShared::AscentParams& ascentParams, double t, const State& state, const Mode& mode, Forces& forces ) const;
+
+    // Positive until the mode's pending phase change, see the .cpp.
+    double  EventFunction( const ShaderShared::AscentParams& ascentParams, double t, const State& state, const Mode& mode ) const;
+
+    // Applies the phase change EventFunction reached.
+    void    ApplyEvent( const ShaderShared::AscentParams& ascentParams, double t, const State& state, Mode& mode, GuidanceSolve* solve ) const;
+
+    void    CalcGuidanceAim( const Mode& mode, double t, const State& state, float accel, ShaderShared::float2& aim ) const;
+
+    void    WriteSample( const ShaderShared::AscentParams& ascentParams, double t, const State& state, const Mode& mode, CompactTelemetry& sample,
+                         float& guidancePitch ) const;
+
+    void    UpdateFlightData( const ShaderShared::AscentParams& ascentParams, double t, const State& state, Mode& mode, ShaderShared::FlightData& flightData ) const;
+
+    const FlightSimulator&  m_simulator;
+    double                  m_tolerance;
+    double                  m_scale[c_StateSize];
+};
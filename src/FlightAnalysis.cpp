@@ -0,0 +1,342 @@
+#include "FlightAnalysis.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+void CalcFlightDataExtents( const FlightData* flightData, uint32_t count, const MissionParams& missionParams, float earthRadius, FlightData& minData, FlightData& maxData )
+{
+    minData = FlightData{};
+    maxData = FlightData{};
+
+    bool dataValid = false;
+    minData.flightPhase = ~0u;
+    maxData.flightPhase = 0;
+
+    // Pass 1, determine flight phase extents
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        minData.flightPhase = std::min( minData.flightPhase, flightData[i].flightPhase );
+        maxData.flightPhase = std::max( maxData.flightPhase, flightData[i].flightPhase );
+    }
+
+    // Pass 2, extents only captured for flights reaching maximum flight phase
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        const FlightData& data = flightData[i];
+
+        if ( data.flightPhase == maxData.flightPhase )
+        {
+            // Ignore flights which missed the target orbit significantly
+            if ( fabsf( (1 - data.e) * data.a - missionParams.finalState.r ) < (missionParams.finalState.r - earthRadius) * 0.03f )
+            {
+                if ( !dataValid )
+                {
+                    uint32_t minFlightPhase = minData.flightPhase;
+
+                    minData = data;
+                    maxData = data;
+                    dataValid = true;
+
+                    minData.flightPhase = minFlightPhase;
+                }
+                else
+                {
+                    minData.maxAltitude = fminf( minData.maxAltitude, data.maxAltitude );
+                    maxData.maxAltitude = fmaxf( maxData.maxAltitude, data.maxAltitude );
+                    minData.maxSurfSpeed = fminf( minData.maxSurfSpeed, data.maxSurfSpeed );
+                    maxData.maxSurfSpeed = fmaxf( maxData.maxSurfSpeed, data.maxSurfSpeed );
+                    minData.maxEciSpeed = fminf( minData.maxEciSpeed, data.maxEciSpeed );
+                    maxData.maxEciSpeed = fmaxf( maxData.maxEciSpeed, data.maxEciSpeed );
+                    minData.maxQ = fminf( minData.maxQ, data.maxQ );
+                    maxData.maxQ = fmaxf( maxData.maxQ, data.maxQ );
+                    minData.minMass = fminf( minData.minMass, data.minMass );
+                    maxData.minMass = fmaxf( maxData.minMass, data.minMass );
+                    minData.maxAccel = fminf( minData.maxAccel, data.maxAccel );
+                    maxData.maxAccel = fmaxf( maxData.maxAccel, data.maxAccel );
+                }
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Folds the reduced fields of another pair of extents into minData and maxData.
+static void ReduceExtentFields( FlightData& minData, FlightData& maxData, const FlightData& otherMin, const FlightData& otherMax )
+{
+    minData.maxAltitude = fminf( minData.maxAltitude, otherMin.maxAltitude );
+    maxData.maxAltitude = fmaxf( maxData.maxAltitude, otherMax.maxAltitude );
+    minData.maxSurfSpeed = fminf( minData.maxSurfSpeed, otherMin.maxSurfSpeed );
+    maxData.maxSurfSpeed = fmaxf( maxData.maxSurfSpeed, otherMax.maxSurfSpeed );
+    minData.maxEciSpeed = fminf( minData.maxEciSpeed, otherMin.maxEciSpeed );
+    maxData.maxEciSpeed = fmaxf( maxData.maxEciSpeed, otherMax.maxEciSpeed );
+    minData.maxQ = fminf( minData.maxQ, otherMin.maxQ );
+    maxData.maxQ = fmaxf( maxData.maxQ, otherMax.maxQ );
+    minData.minMass = fminf( minData.minMass, otherMin.minMass );
+    maxData.minMass = fmaxf( maxData.minMass, otherMax.minMass );
+    minData.maxAccel = fminf( minData.maxAccel, otherMin.maxAccel );
+    maxData.maxAccel = fmaxf( maxData.maxAccel, otherMax.maxAccel );
+}
+
+void AccumulateFlightDataExtents( const FlightData& data, uint32_t index, const MissionParams& missionParams, float earthRadius, FlightDataExtents& extents )
+{
+    ++extents.flightCount;
+    extents.minFlightPhase = std::min( extents.minFlightPhase, data.flightPhase );
+
+    // A later phase discards everything gathered so far, an earlier one never contributes.
+    if ( data.flightPhase > extents.maxFlightPhase )
+    {
+        extents.maxFlightPhase = data.flightPhase;
+        extents.first = ~0u;
+    }
+    else if ( data.flightPhase < extents.maxFlightPhase )
+    {
+        return;
+    }
+
+    // Ignore flights which missed the target orbit significantly
+    if ( !(fabsf( (1 - data.e) * data.a - missionParams.finalState.r ) < (missionParams.finalState.r - earthRadius) * 0.03f) )
+        return;
+
+    if ( extents.first == ~0u )
+    {
+        extents.first = index;
+        extents.minData = data;
+        extents.maxData = data;
+    }
+    else
+    {
+        ReduceExtentFields( extents.minData, extents.maxData, data, data );
+
+        // The earliest flight supplies the fields that aren't reduced, whatever order they arrive in.
+        if ( index < extents.first )
+        {
+            FlightDataExtents reduced = extents;
+            extents.first = index;
+            extents.minData = data;
+            extents.maxData = data;
+            ReduceExtentFields( extents.minData, extents.maxData, reduced.minData, reduced.maxData );
+        }
+    }
+}
+
+void AccumulateFlightDataExtents( const FlightData* flightData, uint32_t begin, uint32_t end, const MissionParams& missionParams, float earthRadius, FlightDataExtents& extents )
+{
+    for ( uint32_t i = begin; i < end; ++i )
+        AccumulateFlightDataExtents( flightData[i], i, missionParams, earthRadius, extents );
+}
+
+void MergeFlightDataExtents( FlightDataExtents& a, const FlightDataExtents& b )
+{
+    a.flightCount += b.flightCount;
+    a.minFlightPhase = std::min( a.minFlightPhase, b.minFlightPhase );
+
+    if ( b.maxFlightPhase < a.maxFlightPhase || (b.maxFlightPhase == a.maxFlightPhase && b.first == ~0u) )
+        return;
+
+    if ( b.maxFlightPhase > a.maxFlightPhase || a.first == ~0u )
+    {
+        a.maxFlightPhase = b.maxFlightPhase;
+        a.first = b.first;
+        a.minData = b.minData;
+        a.maxData = b.maxData;
+    }
+    else if ( b.first < a.first )
+    {
+        FlightData minData = b.minData, maxData = b.maxData;
+        ReduceExtentFields( minData, maxData, a.minData, a.maxData );
+
+        a.first = b.first;
+        a.minData = minData;
+        a.maxData = maxData;
+    }
+    else
+    {
+        ReduceExtentFields( a.minData, a.maxData, b.minData, b.maxData );
+    }
+}
+
+void ResolveFlightDataExtents( const FlightDataExtents& extents, FlightData& minData, FlightData& maxData )
+{
+    minData = FlightData{};
+    maxData = FlightData{};
+
+    if ( extents.first != ~0u )
+    {
+        minData = extents.minData;
+        maxData = extents.maxData;
+    }
+
+    minData.flightPhase = extents.minFlightPhase;
+    maxData.flightPhase = extents.maxFlightPhase;
+}
+
+uint32_t SelectBestFlight( const FlightData* flightData, uint32_t count, float maxMinMass, const MissionParams& missionParams, double earthRadius, double earthMu )
+{
+    float bestDelta = FLT_MAX;
+    uint32_t selected = ~0u;
+
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        float delta = CalcSelectionScore( flightData[i], maxMinMass, missionParams, earthRadius, earthMu );
+
+        if ( delta < bestDelta )
+        {
+            bestDelta = delta;
+            selected = i;
+        }
+    }
+
+    return selected;
+}
+
+//------------------------------------------------------------------------------------------------
+
+float CalcOrbitError( const FlightData& flightData, const MissionParams& missionParams, double earthRadius, double earthMu )
+{
+    float targetPe = float( missionParams.finalState.r - earthRadius );
+    float targetAp = float( -earthMu / (2 * missionParams.finalOrbitalEnergy) - earthRadius ) * 2 - targetPe;
+
+    float Ap = (1 + flightData.e) * flightData.a - float( earthRadius );
+    float Pe = (1 - flightData.e) * flightData.a - float( earthRadius );
+
+    return sqrtf( (Ap - targetAp) * (Ap - targetAp) + (Pe - targetPe) * (Pe - targetPe) );
+}
+
+float CalcSelectionObjective( const FlightData& flightData, const MissionParams& missionParams, double earthRadius, double earthMu )
+{
+    if ( flightData.flightPhase != c_PhaseMECO || flightData.maxQ >= 60000.0f )
+        return FLT_MAX;
+
+    float orbDelta = CalcOrbitError( flightData, missionParams, earthRadius, earthMu );
+
+    return -flightData.minMass + (orbDelta * 0.001f) * (orbDelta * 0.001f) * 10.0f;
+}
+
+float CalcSelectionScore( const FlightData& flightData, float maxMinMass, const MissionParams& missionParams, double earthRadius, double earthMu )
+{
+    if ( flightData.flightPhase != c_PhaseMECO || flightData.maxQ >= 60000.0f )
+        return FLT_MAX;
+
+    float massDelta = maxMinMass - flightData.minMass;
+    massDelta = std::max( massDelta, 0.0f );
+
+    float orbDelta = CalcOrbitError( flightData, missionParams, earthRadius, earthMu );
+
+    return massDelta + (orbDelta * 0.001f) * (orbDelta * 0.001f) * 10.0f;
+}
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+    struct ParetoCandidate
+    {
+        float       key;
+        float       objectives[c_ParetoObjectiveCount];
+        uint32_t    index;
+    };
+
+    bool Dominates( const ParetoCandidate& a, const ParetoCandidate& b )
+    {
+        bool better = false;
+        for ( uint32_t j = 0; j < c_ParetoObjectiveCount; ++j )
+        {
+            if ( a.objectives[j] > b.objectives[j] )
+                return false;
+
+            better |= a.objectives[j] < b.objectives[j];
+        }
+
+        return better;
+    }
+}
+
+void CalcParetoObjectives( const FlightData& flightData, const MissionParams& missionParams, double earthRadius, double earthMu, float objectives[c_ParetoObjectiveCount] )
+{
+    objectives[0] = -flightData.minMass;
+    objectives[1] = flightData.maxQ;
+    objectives[2] = flightData.maxAccel;
+    objectives[3] = CalcOrbitError( flightData, missionParams, earthRadius, earthMu );
+}
+
+// Sort filter skyline. Candidates are sorted by a weighted sum of their objectives, which can't decrease from
+// a flight to any flight it dominates, with ties broken lexicographically. Every flight's dominators then come
+// before it, so one pass against the front found so far settles each flight for good. The front is small next
+// to the sweep, and most dominated flights are rejected by one of its first few members.
+std::vector<uint32_t> CalcParetoFront( const FlightData* flightData, uint32_t count, const MissionParams& missionParams, double earthRadius, double earthMu )
+{
+    std::vector<ParetoCandidate> candidates;
+    candidates.reserve( count );
+
+    float minObjectives[c_ParetoObjectiveCount], maxObjectives[c_ParetoObjectiveCount];
+    std::fill( minObjectives, minObjectives + c_ParetoObjectiveCount, FLT_MAX );
+    std::fill( maxObjectives, maxObjectives + c_ParetoObjectiveCount, -FLT_MAX );
+
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        if ( flightData[i].flightPhase != c_PhaseMECO )
+            continue;
+
+        ParetoCandidate candidate;
+        candidate.index = i;
+        CalcParetoObjectives( flightData[i], missionParams, earthRadius, earthMu, candidate.objectives );
+
+        if ( !std::all_of( candidate.objectives, candidate.objectives + c_ParetoObjectiveCount, [] ( float x ) { return isfinite( x ); } ) )
+            continue;
+
+        for ( uint32_t j = 0; j < c_ParetoObjectiveCount; ++j )
+        {
+            minObjectives[j] = fminf( minObjectives[j], candidate.objectives[j] );
+            maxObjectives[j] = fmaxf( maxObjectives[j], candidate.objectives[j] );
+        }
+
+        candidates.push_back( candidate );
+    }
+
+    // Each objective scaled to [0, 1] over the candidates so none swamps the sort.
+    float weights[c_ParetoObjectiveCount];
+    for ( uint32_t j = 0; j < c_ParetoObjectiveCount; ++j )
+        weights[j] = maxObjectives[j] > minObjectives[j] ? 1 / (maxObjectives[j] - minObjectives[j]) : 0;
+
+    for ( ParetoCandidate& candidate : candidates )
+    {
+        candidate.key = 0;
+        for ( uint32_t j = 0; j < c_ParetoObjectiveCount; ++j )
+            candidate.key += (candidate.objectives[j] - minObjectives[j]) * weights[j];
+    }
+
+    std::sort( candidates.begin(), candidates.end(), [] ( const ParetoCandidate& a, const ParetoCandidate& b )
+    {
+        if ( a.key != b.key )
+            return a.key < b.key;
+
+        return std::lexicographical_compare( a.objectives, a.objectives + c_ParetoObjectiveCount, b.objectives, b.objectives + c_ParetoObjectiveCount );
+    } );
+
+    // A member that dominates one flight tends to dominate its neighbours in the sort too, so it's moved
+    // halfway to the start of the front to be tried sooner. The order of the front doesn't matter otherwise.
+    std::vector<ParetoCandidate> front;
+    for ( const ParetoCandidate& candidate : candidates )
+    {
+        auto dominator = std::find_if( front.begin(), front.end(), [&candidate] ( const ParetoCandidate& member ) { return Dominates( member, candidate ); } );
+
+        if ( dominator == front.end() )
+            front.push_back( candidate );
+        else
+            std::iter_swap( dominator, front.begin() + (dominator - front.begin()) / 2 );
+    }
+
+    std::vector<uint32_t> profiles( front.size() );
+    for ( size_t i = 0; i < front.size(); ++i )
+        profiles[i] = front[i].index;
+
+    std::sort( profiles.begin(), profiles.end() );
+    return profiles;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "resources/data_formats.h"
+
+//------------------------------------------------------------------------------------------------
+// Post processing of sweep results, shared by the renderer and the CPU engine.
+
+// CPU version of flight_data_extents_cs.hlsl. Only flights reaching the most advanced flight phase and
+// within 3% of the target periapsis altitude contribute, except minData.flightPhase which covers all flights.
+void    CalcFlightDataExtents( const ShaderShared::FlightData* flightData, uint32_t count, const ShaderShared::MissionParams& missionParams, float earthRadius,
+                               ShaderShared::FlightData& minData, ShaderShared::FlightData& maxData );
+
+// The same extents gathered in a single pass, so flights can be reduced in any grouping and order and the
+// partials merged. Each partial tracks its own most advanced phase and the flights in that phase passing the
+// orbit filter; merging keeps whichever side is further along, or combines both when they are level. The
+// fields that aren't reduced come from the lowest indexed flight contributing, as in the two pass scan.
+struct FlightDataExtents
+{
+    uint32_t    flightCount = 0;    // Flights accumulated, contributing or not
+    uint32_t    minFlightPhase = ~0u;
+    uint32_t    maxFlightPhase = 0;
+    uint32_t    first = ~0u;        // Index of the first flight contributing, ~0u if none
+
+    ShaderShared::FlightData    minData;    // Valid if first isn't ~0u
+    ShaderShared::FlightData    maxData;
+};
+
+void    AccumulateFlightDataExtents( const ShaderShared::FlightData& flightData, uint32_t index, const ShaderShared::MissionParams& missionParams, float earthRadius,
+                                     FlightDataExtents& extents );
+void    AccumulateFlightDataExtents( const ShaderShared::FlightData* flightData, uint32_t begin, uint32_t end, const ShaderShared::MissionParams& missionParams,
+                                     float earthRadius, FlightDataExtents& extents );
+void    MergeFlightDataExtents( FlightDataExtents& a, const FlightDataExtents& b );
+// Writes the result in the form CalcFlightDataExtents does.
+void    ResolveFlightDataExtents( const FlightDataExtents& extents, ShaderShared::FlightData& minData, ShaderShared::FlightData& maxData );
+
+// Auto select score, lower is better. FLT_MAX for flights that didn't reach MECO or exceeded the max Q limit.
+// maxMinMass is the best final mass in the sweep, i.e. maxData.minMass from the extents.
+float   CalcSelectionScore( const ShaderShared::FlightData& flightData, float maxMinMass, const ShaderShared::MissionParams& missionParams, double earthRadius, double earthMu );
+
+// The selection score without the sweep's best final mass, for searches that have no sweep. It differs
+// from CalcSelectionScore by maxMinMass for any flight no heavier than that, so ranks flights the same.
+float   CalcSelectionObjective( const ShaderShared::FlightData& flightData, const ShaderShared::MissionParams& missionParams, double earthRadius, double earthMu );
+
+// Flight with the lowest CalcSelectionScore, the first of any tie, ~0u if none reached MECO within the max Q limit.
+uint32_t    SelectBestFlight( const ShaderShared::FlightData* flightData, uint32_t count, float maxMinMass, const ShaderShared::MissionParams& missionParams,
+                              double earthRadius, double earthMu );
+
+// Distance in metres of the flight's apoapsis and periapsis altitudes from the target orbit's.
+float   CalcOrbitError( const ShaderShared::FlightData& flightData, const ShaderShared::MissionParams& missionParams, double earthRadius, double earthMu );
+
+// Objectives of the Pareto front, each lower is better: negated final mass, max Q, max acceleration and
+// orbit error. Unlike the selection score there's no max Q limit, the front shows what each kPa costs.
+static const uint32_t   c_ParetoObjectiveCount = 4;
+
+void    CalcParetoObjectives( const ShaderShared::FlightData& flightData, const ShaderShared::MissionParams& missionParams, double earthRadius, double earthMu,
+                              float objectives[c_ParetoObjectiveCount] );
+
+// Flights that reached MECO and that no other such flight dominates, i.e. matches or beats on every objective
+// and beats on at least one, in index order. O(n log n) sort then a filter against the front so far.
+std::vector<uint32_t>   CalcParetoFront( const ShaderShared::FlightData* flightData, uint32_t count, const ShaderShared::MissionParams& missionParams, double earthRadius, double earthMu );
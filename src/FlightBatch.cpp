@@ -0,0 +1,345 @@
+#include "FlightBatchImpl.h"
+
+#include <string.h>
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#elif defined( __x86_64__ ) || defined( __i386__ )
+#include <cpuid.h>
+#endif
+
+using namespace ShaderShared;
+
+#ifdef FLIGHT_BATCH_AVX2
+FlightBatchKernel*  CreateFlightBatchKernelAvx2( const FlightSimulator& simulator );
+#endif
+#ifdef FLIGHT_BATCH_AVX512
+FlightBatchKernel*  CreateFlightBatchKernelAvx512( const FlightSimulator& simulator );
+#endif
+
+//------------------------------------------------------------------------------------------------
+// CPU feature detection
+
+#if defined( FLIGHT_BATCH_AVX2 ) || defined( FLIGHT_BATCH_AVX512 )
+
+static void CpuId( uint32_t leaf, uint32_t subLeaf, uint32_t regs[4] )
+{
+#if defined( _MSC_VER )
+    int cpuInfo[4];
+    __cpuidex( cpuInfo, int( leaf ), int( subLeaf ) );
+    memcpy( regs, cpuInfo, sizeof( cpuInfo ) );
+#else
+    __cpuid_count( leaf, subLeaf, regs[0], regs[1], regs[2], regs[3] );
+#endif
+}
+
+// Register state the OS saves on a context switch, without it the wide registers are unusable.
+static uint64_t GetEnabledXState()
+{
+#if defined( _MSC_VER )
+    return _xgetbv( 0 );
+#else
+    uint32_t eax, edx;
+    __asm__( "xgetbv" : "=a"( eax ), "=d"( edx ) : "c"( 0 ) );
+    return (uint64_t( edx ) << 32) | eax;
+#endif
+}
+
+static SimdLevel DetectCpuSimdLevel()
+{
+    uint32_t regs[4];
+    CpuId( 0, 0, regs );
+    if ( regs[0] < 7 )
+        return SimdLevel::Scalar;
+
+    CpuId( 1, 0, regs );
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    if ( !osxsave || !avx )
+        return SimdLevel::Scalar;
+
+    uint64_t xstate = GetEnabledXState();
+    bool ymmState = (xstate & 0x06) == 0x06;
+    bool zmmState = (xstate & 0xe6) == 0xe6;
+
+    CpuId( 7, 0, regs );
+    bool avx2 = (regs[1] & (1u << 5)) != 0;
+    bool avx512f = (regs[1] & (1u << 16)) != 0;
+
+    if ( avx512f && zmmState )
+        return SimdLevel::Avx512;
+    if ( avx2 && ymmState )
+        return SimdLevel::Avx2;
+
+    return SimdLevel::Scalar;
+}
+
+#else
+
+static SimdLevel DetectCpuSimdLevel()
+{
+    return SimdLevel::Scalar;
+}
+
+#endif
+
+//------------------------------------------------------------------------------------------------
+
+SimdLevel DetectSimdLevel()
+{
+    if ( IsSimdLevelSupported( SimdLevel::Avx512 ) )
+        return SimdLevel::Avx512;
+    if ( IsSimdLevelSupported( SimdLevel::Avx2 ) )
+        return SimdLevel::Avx2;
+
+    return SimdLevel::Scalar;
+}
+
+bool IsSimdLevelSupported( SimdLevel level )
+{
+    static const SimdLevel cpuLevel = DetectCpuSimdLevel();
+
+    switch ( level )
+    {
+    case SimdLevel::None:
+    case SimdLevel::Scalar:
+        return true;
+    case SimdLevel::Avx2:
+#ifdef FLIGHT_BATCH_AVX2
+        return cpuLevel >= SimdLevel::Avx2;
+#else
+        return false;
+#endif
+    case SimdLevel::Avx512:
+#ifdef FLIGHT_BATCH_AVX512
+        return cpuLevel >= SimdLevel::Avx512;
+#else
+        return false;
+#endif
+    }
+
+    return cpuLevel == level;
+}
+
+static const char* const c_SimdLevelNames[] = { "none", "scalar", "avx2", "avx512" };
+
+const char* GetSimdLevelName( SimdLevel level )
+{
+    return c_SimdLevelNames[uint32_t( level )];
+}
+
+uint32_t GetSimdLevelWidth( SimdLevel level )
+{
+    static const uint32_t widths[] = { 1, 1, 8, 16 };
+    return widths[uint32_t( level )];
+}
+
+bool ParseSimdLevel( const char* name, SimdLevel& level )
+{
+    for ( uint32_t i = 0; i < sizeof( c_SimdLevelNames ) / sizeof( c_SimdLevelNames[0] ); ++i )
+    {
+        if ( !strcmp( name, c_SimdLevelNames[i] ) )
+        {
+            level = SimdLevel( i );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------------------------
+
+FlightBatchKernel::FlightBatchKernel( const FlightSimulator& simulator, uint32_t width ) :
+    m_simulator( simulator ),
+    m_constants(),
+    m_width( width ),
+    m_groupCount( 0 ),
+    m_telemetry( nullptr ),
+    m_telemetryStepSize( 1 ),
+    m_telemetryMaxSamples( 0 ),
+    m_coastMode( CoastMode::Integrate ),
+    m_totalSteps( 0 ),
+    m_guidanceSolves( nullptr )
+{
+    const FlightEnvironment& environment = simulator.GetEnvironment();
+    const MissionParams& missionParams = simulator.GetMissionParams();
+
+    m_constants.mu = environment.params.mu;
+    m_constants.Re = environment.params.Re;
+    m_constants.g0 = environment.params.g0;
+    m_constants.airM = environment.params.airM;
+    m_constants.Rstar = environment.params.Rstar;
+    m_constants.airGamma = environment.params.airGamma;
+    m_constants.timeStep = simulator.GetTimeStep();
+    m_constants.pressureAtZero = environment.GetSeaLevelPressure();
+    m_constants.finalOrbitalEnergy = missionParams.finalOrbitalEnergy;
+    m_constants.atmosphereRadius = environment.params.Re + environment.GetAtmosphereHeight();
+    m_constants.stageCount = missionParams.stageCount;
+
+    for ( uint32_t s = 0; s < 4; ++s )
+    {
+        m_constants.wetMass[s] = missionParams.stage[s].wetMass;
+        m_constants.dryMass[s] = missionParams.stage[s].dryMass;
+        m_constants.massFlow[s] = missionParams.stage[s].massFlow;
+        m_constants.IspSL[s] = missionParams.stage[s].IspSL;
+        m_constants.IspVac[s] = missionParams.stage[s].IspVac;
+        m_constants.rotationRate[s] = missionParams.stage[s].rotationRate;
+    }
+
+    // Split the curve keys into per component arrays, pointers are fixed up once the store stops growing.
+    const HermiteCurve* curves[] =
+    {
+        &environment.pressureHeight, &environment.temperatureHeight,
+        &environment.dragMach[0], &environment.dragMach[1], &environment.dragMach[2], &environment.dragMach[3],
+    };
+    BatchCurve* batchCurves[] =
+    {
+        &m_constants.pressureHeight, &m_constants.temperatureHeight,
+        &m_constants.dragMach[0], &m_constants.dragMach[1], &m_constants.dragMach[2], &m_constants.dragMach[3],
+    };
+
+    const uint32_t curveCount = sizeof( curves ) / sizeof( curves[0] );
+
+    // The segment index is stored as floats for Gather, exact up to 2^24 segments.
+    size_t offsets[curveCount];
+    size_t indexOffsets[curveCount];
+    for ( uint32_t i = 0; i < curveCount; ++i )
+    {
+        const std::vector<float4>& keys = curves[i]->keys;
+        offsets[i] = m_curveData.size();
+
+        for ( const float4& key : keys )
+            m_curveData.push_back( key.x );
+        for ( const float4& key : keys )
+            m_curveData.push_back( key.y );
+        for ( const float4& key : keys )
+            m_curveData.push_back( key.z );
+        for ( const float4& key : keys )
+            m_curveData.push_back( key.w );
+
+        indexOffsets[i] = m_curveData.size();
+
+        for ( uint32_t segment : curves[i]->GetSegmentIndex() )
+            m_curveData.push_back( float( segment ) );
+    }
+
+    for ( uint32_t i = 0; i < curveCount; ++i )
+    {
+        uint32_t count = static_cast<uint32_t>(curves[i]->keys.size());
+        const float* data = m_curveData.data() + offsets[i];
+
+        batchCurves[i]->count = count;
+        batchCurves[i]->x = data;
+        batchCurves[i]->y = data + count;
+        batchCurves[i]->z = data + count * 2;
+        batchCurves[i]->w = data + count * 3;
+
+        const std::vector<uint32_t>& segmentIndex = curves[i]->GetSegmentIndex();
+
+        batchCurves[i]->segment = segmentIndex.empty() ? nullptr : m_curveData.data() + indexOffsets[i];
+        batchCurves[i]->lastCell = segmentIndex.empty() ? 0.0f : float( segmentIndex.size() - 1 );
+        batchCurves[i]->cellScale = curves[i]->GetCellScale();
+        batchCurves[i]->maxWalk = curves[i]->GetMaxWalk();
+    }
+}
+
+FlightBatchKernel::~FlightBatchKernel()
+{
+}
+
+void FlightBatchKernel::SetTelemetryOutput( CompactTelemetry* telemetry, uint32_t telemetryStepSize, uint32_t telemetryMaxSamples )
+{
+    m_telemetry = telemetry;
+    m_telemetryStepSize = telemetryStepSize;
+    m_telemetryMaxSamples = telemetryMaxSamples;
+}
+
+void FlightBatchKernel::SetCoastMode( CoastMode coastMode, uint32_t totalSteps )
+{
+    m_coastMode = coastMode;
+    m_totalSteps = totalSteps;
+}
+
+void FlightBatchKernel::SetGuidanceSolves( GuidanceSolve* guidanceSolves )
+{
+    m_guidanceSolves = guidanceSolves;
+}
+
+//------------------------------------------------------------------------------------------------
+// One lane build of the kernel, the fallback when the CPU has no supported vector extension.
+
+namespace
+{
+
+struct ScalarMask
+{
+    bool    m;
+
+    ScalarMask( bool b ) : m( b ) {}
+};
+
+struct ScalarLanes
+{
+    static const uint32_t Width = 1;
+    typedef ScalarMask Mask;
+
+    float   v;
+
+    ScalarLanes() {}
+    ScalarLanes( float f ) : v( f ) {}
+
+    static ScalarLanes  Load( const float* p ) { return ScalarLanes( *p ); }
+    static void         Store( ScalarLanes a, float* p ) { *p = a.v; }
+};
+
+inline ScalarLanes operator+( ScalarLanes a, ScalarLanes b ) { return ScalarLanes( a.v + b.v ); }
+inline ScalarLanes operator-( ScalarLanes a, ScalarLanes b ) { return ScalarLanes( a.v - b.v ); }
+inline ScalarLanes operator*( ScalarLanes a, ScalarLanes b ) { return ScalarLanes( a.v * b.v ); }
+inline ScalarLanes operator/( ScalarLanes a, ScalarLanes b ) { return ScalarLanes( a.v / b.v ); }
+inline ScalarLanes operator-( ScalarLanes a ) { return ScalarLanes( -a.v ); }
+
+inline ScalarMask operator<( ScalarLanes a, ScalarLanes b ) { return a.v < b.v; }
+inline ScalarMask operator<=( ScalarLanes a, ScalarLanes b ) { return a.v <= b.v; }
+inline ScalarMask operator>( ScalarLanes a, ScalarLanes b ) { return a.v > b.v; }
+inline ScalarMask operator>=( ScalarLanes a, ScalarLanes b ) { return a.v >= b.v; }
+inline ScalarMask operator==( ScalarLanes a, ScalarLanes b ) { return a.v == b.v; }
+
+inline ScalarMask operator&( ScalarMask a, ScalarMask b ) { return a.m && b.m; }
+inline ScalarMask operator|( ScalarMask a, ScalarMask b ) { return a.m || b.m; }
+inline ScalarMask AndNot( ScalarMask a, ScalarMask b ) { return a.m && !b.m; }
+inline bool       Any( ScalarMask mask ) { return mask.m; }
+inline uint32_t   MaskBits( ScalarMask mask ) { return mask.m ? 1u : 0u; }
+
+inline ScalarLanes  Select( ScalarMask mask, ScalarLanes a, ScalarLanes b ) { return mask.m ? a : b; }
+inline ScalarLanes  Min( ScalarLanes a, ScalarLanes b ) { return a.v < b.v ? a : b; }
+inline ScalarLanes  Max( ScalarLanes a, ScalarLanes b ) { return a.v > b.v ? a : b; }
+inline ScalarLanes  Sqrt( ScalarLanes a ) { return ScalarLanes( sqrtf( a.v ) ); }
+inline ScalarLanes  Abs( ScalarLanes a ) { return ScalarLanes( fabsf( a.v ) ); }
+inline ScalarLanes  Gather( const float* table, ScalarLanes index ) { return ScalarLanes( table[int( index.v )] ); }
+
+}
+
+//------------------------------------------------------------------------------------------------
+
+std::unique_ptr<FlightBatchKernel> CreateFlightBatchKernel( SimdLevel level, const FlightSimulator& simulator )
+{
+    if ( !IsSimdLevelSupported( level ) )
+        return nullptr;
+
+    switch ( level )
+    {
+    case SimdLevel::Scalar:
+        return std::unique_ptr<FlightBatchKernel>( new FlightBatchKernelImpl<ScalarLanes>( simulator ) );
+#ifdef FLIGHT_BATCH_AVX2
+    case SimdLevel::Avx2:
+        return std::unique_ptr<FlightBatchKernel>( CreateFlightBatchKernelAvx2( simulator ) );
+#endif
+#ifdef FLIGHT_BATCH_AVX512
+    case SimdLevel::Avx512:
+        return std::unique_ptr<FlightBatchKernel>( CreateFlightBatchKernelAvx512( simulator ) );
+#endif
+    default:
+        return nullptr;
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "FlightAnalysis.h"
+#include "FlightCoast.h"
+#include "FlightSim.h"
+#include "FlightTelemetry.h"
+
+//------------------------------------------------------------------------------------------------
+// SIMD batch version of FlightSimulator::StepFlight. Profiles are packed structure of arrays into
+// lane groups of 8 (AVX2) or 16 (AVX-512) and a whole group is advanced per instruction, with a one
+// lane build of the same kernel as the fallback. Only the guidance solves (once per second, per
+// profile) drop back to scalar code, through FlightSimulator's lane entry points.
+//
+// Each instruction set is compiled in its own translation unit and picked at runtime, so only
+// FlightBatch.cpp is built for the baseline target.
+
+enum class SimdLevel : uint32_t
+{
+    None,       // Per profile FlightSimulator path
+    Scalar,     // Batch kernel, one lane per group
+    Avx2,       // Batch kernel, 8 lanes per group
+    Avx512,     // Batch kernel, 16 lanes per group
+};
+
+// Best level supported by both the build and the CPU.
+SimdLevel   DetectSimdLevel();
+bool        IsSimdLevelSupported( SimdLevel level );
+const char* GetSimdLevelName( SimdLevel level );
+uint32_t    GetSimdLevelWidth( SimdLevel level );
+bool        ParseSimdLevel( const char* name, SimdLevel& level );
+
+//------------------------------------------------------------------------------------------------
+
+// Hermite curve keys split into one array per component, and the segment index if the curve is compiled.
+struct BatchCurve
+{
+    const float*    x;
+    const float*    y;
+    const float*    z;      // in tangent
+    const float*    w;      // out tangent
+    uint32_t        count;
+
+    const float*    segment;    // First segment of each cell, null if not compiled
+    float           lastCell;
+    float           cellScale;
+    uint32_t        maxWalk;
+};
+
+// Everything the kernel reads from the environment and mission, flattened so the SIMD translation
+// units need no inline code from the shared headers.
+struct BatchConstants
+{
+    float       mu;
+    float       Re;
+    float       g0;
+    float       airM;
+    float       Rstar;
+    float       airGamma;
+    float       timeStep;
+    float       pressureAtZero;     // GetStaticPressure( 0 )
+    float       finalOrbitalEnergy;
+    float       atmosphereRadius;   // Re + GetAtmosphereHeight()
+    uint32_t    stageCount;
+
+    // Per stage tables, indexed by the stage lane.
+    float       wetMass[4];
+    float       dryMass[4];
+    float       massFlow[4];
+    float       IspSL[4];
+    float       IspVac[4];
+    float       rotationRate[4];
+
+    BatchCurve  pressureHeight;
+    BatchCurve  temperatureHeight;
+    BatchCurve  dragMach[4];
+};
+
+//------------------------------------------------------------------------------------------------
+
+class FlightBatchKernel
+{
+public:
+    virtual ~FlightBatchKernel();
+
+    FlightBatchKernel( const FlightBatchKernel& ) = delete;
+    FlightBatchKernel& operator=( const FlightBatchKernel& ) = delete;
+
+    uint32_t    GetWidth() const { return m_width; }
+
+    // Groups holding at least one live lane, StepFlights only needs to cover these.
+    uint32_t    GetGroupCount() const { return m_groupCount; }
+
+    // Samples are written per profile as in SweepEngine, null disables telemetry.
+    void        SetTelemetryOutput( CompactTelemetry* telemetry, uint32_t telemetryStepSize, uint32_t telemetryMaxSamples );
+
+    // Lanes retire as ShouldRetireFlight says, writing out their FlightData and finishing the flight up to
+    // totalSteps with FinishFlight.
+    void        SetCoastMode( CoastMode coastMode, uint32_t totalSteps );
+
+    // One per profile, seeding and recording each profile's guidance solve. Null solves guidance cold.
+    void        SetGuidanceSolves( GuidanceSolve* guidanceSolves );
+
+    // Packs the initial state of count profiles (from FlightSimulator::InitFlight) into lane groups.
+    virtual void    InitFlights( const ShaderShared::AscentParams* ascentParams, const ShaderShared::TelemetryData* telemetry, const ShaderShared::FlightData* flightData, uint32_t count ) = 0;
+
+    // Advances lane groups [begin, end) by stepCount steps, firstStep is the sweep step of the first one.
+    // Unless null, the FlightData of lanes that retired in these steps is then accumulated into retired and
+    // that of lanes still flying into live, for SweepEngine's running extents.
+    virtual void    StepFlights( uint32_t begin, uint32_t end, uint32_t firstStep, uint32_t stepCount, FlightDataExtents* retired, FlightDataExtents* live ) = 0;
+
+    // Moves the live lanes into the fewest groups, returning the new group count. Not thread safe, call
+    // between StepFlights batches.
+    virtual uint32_t    CompactFlights() = 0;
+
+    // Unpacks the FlightData of every profile.
+    virtual void    GetFlightData( ShaderShared::FlightData* flightData ) const = 0;
+
+protected:
+    FlightBatchKernel( const FlightSimulator& simulator, uint32_t width );
+
+    const FlightSimulator&          m_simulator;
+    BatchConstants                  m_constants;
+
+    uint32_t                        m_width;
+    uint32_t                        m_groupCount;
+
+    CompactTelemetry*               m_telemetry;
+    uint32_t                        m_telemetryStepSize;
+    uint32_t                        m_telemetryMaxSamples;
+
+    CoastMode                       m_coastMode;
+    uint32_t                        m_totalSteps;
+
+    GuidanceSolve*                  m_guidanceSolves;
+
+private:
+    std::vector<float>              m_curveData;    // Backing store for the curves in m_constants
+};
+
+// Returns null for SimdLevel::None or a level this build or CPU can't run.
+std::unique_ptr<FlightBatchKernel>  CreateFlightBatchKernel( SimdLevel level, const FlightSimulator& simulator );
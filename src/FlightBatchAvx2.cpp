@@ -0,0 +1,66 @@
+// Built with AVX2 enabled, only called once DetectSimdLevel has checked the CPU supports it.
+
+#include "FlightBatchImpl.h"
+
+#include <immintrin.h>
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+struct Avx2Mask
+{
+    __m256  m;
+
+    Avx2Mask( __m256 mask ) : m( mask ) {}
+};
+
+struct Avx2Lanes
+{
+    static const uint32_t Width = 8;
+    typedef Avx2Mask Mask;
+
+    __m256  v;
+
+    Avx2Lanes() {}
+    Avx2Lanes( __m256 a ) : v( a ) {}
+    Avx2Lanes( float f ) : v( _mm256_set1_ps( f ) ) {}
+
+    static Avx2Lanes    Load( const float* p ) { return _mm256_loadu_ps( p ); }
+    static void         Store( Avx2Lanes a, float* p ) { _mm256_storeu_ps( p, a.v ); }
+};
+
+inline Avx2Lanes operator+( Avx2Lanes a, Avx2Lanes b ) { return _mm256_add_ps( a.v, b.v ); }
+inline Avx2Lanes operator-( Avx2Lanes a, Avx2Lanes b ) { return _mm256_sub_ps( a.v, b.v ); }
+inline Avx2Lanes operator*( Avx2Lanes a, Avx2Lanes b ) { return _mm256_mul_ps( a.v, b.v ); }
+inline Avx2Lanes operator/( Avx2Lanes a, Avx2Lanes b ) { return _mm256_div_ps( a.v, b.v ); }
+inline Avx2Lanes operator-( Avx2Lanes a ) { return _mm256_xor_ps( a.v, _mm256_set1_ps( -0.0f ) ); }
+
+inline Avx2Mask operator<( Avx2Lanes a, Avx2Lanes b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_LT_OQ ); }
+inline Avx2Mask operator<=( Avx2Lanes a, Avx2Lanes b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_LE_OQ ); }
+inline Avx2Mask operator>( Avx2Lanes a, Avx2Lanes b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_GT_OQ ); }
+inline Avx2Mask operator>=( Avx2Lanes a, Avx2Lanes b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_GE_OQ ); }
+inline Avx2Mask operator==( Avx2Lanes a, Avx2Lanes b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_EQ_OQ ); }
+
+inline Avx2Mask operator&( Avx2Mask a, Avx2Mask b ) { return _mm256_and_ps( a.m, b.m ); }
+inline Avx2Mask operator|( Avx2Mask a, Avx2Mask b ) { return _mm256_or_ps( a.m, b.m ); }
+inline Avx2Mask AndNot( Avx2Mask a, Avx2Mask b ) { return _mm256_andnot_ps( b.m, a.m ); }
+inline bool     Any( Avx2Mask mask ) { return _mm256_movemask_ps( mask.m ) != 0; }
+inline uint32_t MaskBits( Avx2Mask mask ) { return uint32_t( _mm256_movemask_ps( mask.m ) ); }
+
+inline Avx2Lanes Select( Avx2Mask mask, Avx2Lanes a, Avx2Lanes b ) { return _mm256_blendv_ps( b.v, a.v, mask.m ); }
+inline Avx2Lanes Min( Avx2Lanes a, Avx2Lanes b ) { return _mm256_min_ps( a.v, b.v ); }
+inline Avx2Lanes Max( Avx2Lanes a, Avx2Lanes b ) { return _mm256_max_ps( a.v, b.v ); }
+inline Avx2Lanes Sqrt( Avx2Lanes a ) { return _mm256_sqrt_ps( a.v ); }
+inline Avx2Lanes Abs( Avx2Lanes a ) { return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), a.v ); }
+inline Avx2Lanes Gather( const float* table, Avx2Lanes index ) { return _mm256_i32gather_ps( table, _mm256_cvttps_epi32( index.v ), 4 ); }
+
+}
+
+//------------------------------------------------------------------------------------------------
+
+FlightBatchKernel* CreateFlightBatchKernelAvx2( const FlightSimulator& simulator )
+{
+    return new FlightBatchKernelImpl<Avx2Lanes>( simulator );
+}
@@ -0,0 +1,80 @@
+// Built with AVX-512F enabled, only called once DetectSimdLevel has checked the CPU supports it.
+
+#include "FlightBatchImpl.h"
+
+#include <immintrin.h>
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+
+struct Avx512Mask
+{
+    __mmask16   m;
+
+    Avx512Mask( __mmask16 mask ) : m( mask ) {}
+};
+
+struct Avx512Lanes
+{
+    static const uint32_t Width = 16;
+    typedef Avx512Mask Mask;
+
+    __m512  v;
+
+    Avx512Lanes() {}
+    Avx512Lanes( __m512 a ) : v( a ) {}
+    Avx512Lanes( float f ) : v( _mm512_set1_ps( f ) ) {}
+
+    static Avx512Lanes  Load( const float* p ) { return _mm512_loadu_ps( p ); }
+    static void         Store( Avx512Lanes a, float* p ) { _mm512_storeu_ps( p, a.v ); }
+};
+
+// Sign flips go through the integer unit, float bitwise ops need AVX-512DQ.
+inline __m512 FlipSign( __m512 a, __m512i signMask )
+{
+    return _mm512_castsi512_ps( _mm512_xor_si512( _mm512_castps_si512( a ), signMask ) );
+}
+
+inline Avx512Lanes operator+( Avx512Lanes a, Avx512Lanes b ) { return _mm512_add_ps( a.v, b.v ); }
+inline Avx512Lanes operator-( Avx512Lanes a, Avx512Lanes b ) { return _mm512_sub_ps( a.v, b.v ); }
+inline Avx512Lanes operator*( Avx512Lanes a, Avx512Lanes b ) { return _mm512_mul_ps( a.v, b.v ); }
+inline Avx512Lanes operator/( Avx512Lanes a, Avx512Lanes b ) { return _mm512_div_ps( a.v, b.v ); }
+inline Avx512Lanes operator-( Avx512Lanes a ) { return FlipSign( a.v, _mm512_set1_epi32( int( 0x80000000 ) ) ); }
+
+inline Avx512Mask operator<( Avx512Lanes a, Avx512Lanes b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_LT_OQ ); }
+inline Avx512Mask operator<=( Avx512Lanes a, Avx512Lanes b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_LE_OQ ); }
+inline Avx512Mask operator>( Avx512Lanes a, Avx512Lanes b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_GT_OQ ); }
+inline Avx512Mask operator>=( Avx512Lanes a, Avx512Lanes b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_GE_OQ ); }
+inline Avx512Mask operator==( Avx512Lanes a, Avx512Lanes b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_EQ_OQ ); }
+
+inline Avx512Mask operator&( Avx512Mask a, Avx512Mask b ) { return __mmask16( a.m & b.m ); }
+inline Avx512Mask operator|( Avx512Mask a, Avx512Mask b ) { return __mmask16( a.m | b.m ); }
+inline Avx512Mask AndNot( Avx512Mask a, Avx512Mask b ) { return __mmask16( a.m & ~b.m ); }
+inline bool       Any( Avx512Mask mask ) { return mask.m != 0; }
+inline uint32_t   MaskBits( Avx512Mask mask ) { return mask.m; }
+
+// The zero masked forms with every lane set compile to the plain instructions, but unlike the plain
+// intrinsics don't trip GCC's uninitialized warnings in avx512fintrin.h.
+static const __mmask16 c_AllLanes = 0xffff;
+
+inline Avx512Lanes Select( Avx512Mask mask, Avx512Lanes a, Avx512Lanes b ) { return _mm512_mask_blend_ps( mask.m, b.v, a.v ); }
+inline Avx512Lanes Min( Avx512Lanes a, Avx512Lanes b ) { return _mm512_maskz_min_ps( c_AllLanes, a.v, b.v ); }
+inline Avx512Lanes Max( Avx512Lanes a, Avx512Lanes b ) { return _mm512_maskz_max_ps( c_AllLanes, a.v, b.v ); }
+inline Avx512Lanes Sqrt( Avx512Lanes a ) { return _mm512_maskz_sqrt_ps( c_AllLanes, a.v ); }
+inline Avx512Lanes Abs( Avx512Lanes a ) { return _mm512_abs_ps( a.v ); }
+
+inline Avx512Lanes Gather( const float* table, Avx512Lanes index )
+{
+    return _mm512_mask_i32gather_ps( _mm512_setzero_ps(), c_AllLanes, _mm512_maskz_cvttps_epi32( c_AllLanes, index.v ), table, 4 );
+}
+
+}
+
+//------------------------------------------------------------------------------------------------
+
+FlightBatchKernel* CreateFlightBatchKernelAvx512( const FlightSimulator& simulator )
+{
+    return new FlightBatchKernelImpl<Avx512Lanes>( simulator );
+}
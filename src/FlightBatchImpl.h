@@ -0,0 +1,823 @@
+#pragma once
+
+#include "FlightBatch.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------------------------
+// The batch kernel, written once against a lane type V and included by each instruction set's
+// translation unit. Every function here is a template over V, and each unit's V lives in an
+// anonymous namespace, so nothing compiled for AVX can be picked by the linker for baseline code.
+//
+// V provides:
+//   V::Width, V::Mask, V( float ), V::Load( const float* ), V::Store( V, float* )
+//   + - * / and unary -, comparisons returning V::Mask (false for NaN, as in C++)
+//   Select( mask, a, b ), Min( a, b ) and Max( a, b ) returning b if a is NaN (as fminf/fmaxf do
+//   when b is valid), Sqrt, Abs, Gather( table, index ) with float indices
+//   Masks: & |, AndNot( a, b ), Any( mask ), MaskBits( mask ) with lane i in bit i
+//
+// The maths follows StepFlight operation for operation so the lanes round the same as the scalar
+// code, with the exception of acos which has no SIMD library version.
+
+template<uint32_t Width>
+struct FlightLanes
+{
+    uint32_t    profile[Width];         // ~0u for retired lanes and those padding out the last group
+    float       live[Width];            // 1 while profile is valid, as a float for lane masks
+
+    // AscentParams
+    float       pitchOverSpeed[Width];
+    float       cosPitchOverAngle[Width];
+    float       sinAimAngle[Width];
+    float       cosAimAngle[Width];
+
+    // TelemetryData, stage and flight phase are kept as floats so they can index and compare in lanes.
+    float       eciPositionX[Width];
+    float       eciPositionY[Width];
+    float       eciVelocityX[Width];
+    float       eciVelocityY[Width];
+    float       surfVelocityX[Width];
+    float       surfVelocityY[Width];
+    float       headingX[Width];
+    float       headingY[Width];
+    float       stage[Width];
+    float       mass[Width];
+    float       flightPhase[Width];
+    float       guidancePitch[Width];
+
+    // FlightData
+    float       maxAltitude[Width];
+    float       maxSurfSpeed[Width];
+    float       maxEciSpeed[Width];
+    float       maxQ[Width];
+    float       minMass[Width];
+    float       maxAccel[Width];
+    float       stageBurnTime[4][Width];
+    float       a[Width];
+    float       e[Width];
+    float       E[Width];
+
+    // GuidanceData, per stage
+    float       guidanceA[4][Width];
+    float       guidanceB[4][Width];
+    float       guidanceT[4][Width];
+    float       guidancet[4][Width];
+    float       guidanceOmegaT[4][Width];
+};
+
+//------------------------------------------------------------------------------------------------
+
+template<class V>
+inline V BatchLerp( V a, V b, V t )
+{
+    return a + (b - a) * t;
+}
+
+// Cephes acosf, accurate to a couple of ulp. NaN outside [-1, 1] like acosf.
+template<class V>
+inline V BatchAcos( V x )
+{
+    const float pi = 3.14159265f;
+
+    V a = Abs( x );
+    typename V::Mask wide = a > V( 0.5f );
+
+    // Beyond 0.5, acos(x) = 2 asin(sqrt((1 - x) / 2)) keeps the asin argument small.
+    V z = Select( wide, (V( 1.0f ) - a) * V( 0.5f ), a * a );
+    V s = Select( wide, Sqrt( z ), a );
+
+    V asinS = ((((V( 4.2163199048e-2f ) * z + V( 2.4181311049e-2f )) * z + V( 4.5470025998e-2f )) * z + V( 7.4953002686e-2f )) * z + V( 1.6666752422e-1f )) * z * s + s;
+
+    typename V::Mask negative = x < V( 0.0f );
+    V narrowResult = V( pi * 0.5f ) - Select( negative, -asinS, asinS );
+    V wideResult = Select( negative, V( pi ) - (asinS + asinS), asinS + asinS );
+
+    return Select( a > V( 1.0f ), V( NAN ), Select( wide, wideResult, narrowResult ) );
+}
+
+// Same result as HermiteCurve::Evaluate.
+template<class V>
+inline V BatchEvaluateCurve( const BatchCurve& curve, V x )
+{
+    // Unbound curves read as zero on the GPU.
+    if ( curve.count == 0 )
+        return V( 0.0f );
+
+    if ( curve.count == 1 )
+        return V( curve.y[0] );
+
+    uint32_t len = curve.count - 1;
+
+    V segment( 0.0f );
+    if ( curve.segment )
+    {
+        // Segment index lookup then a walk over the keys sharing the cell, as HermiteCurve::FindSegment.
+        V cell = Min( Max( (x - V( curve.x[0] )) * V( curve.cellScale ), V( 0.0f ) ), V( curve.lastCell ) );
+        segment = Gather( curve.segment, cell );
+
+        for ( uint32_t i = 0; i < curve.maxWalk; ++i )
+        {
+            segment = segment + Select( (segment < V( float( len - 1 ) )) & (x >= Gather( curve.x + 1, segment )), V( 1.0f ), V( 0.0f ) );
+        }
+    }
+    else
+    {
+        // Branch free segment search, counting keys at or below x finds the same segment as the scalar loop.
+        for ( uint32_t i = 1; i < len; ++i )
+        {
+            segment = segment + Select( x >= V( curve.x[i] ), V( 1.0f ), V( 0.0f ) );
+        }
+    }
+
+    V x0 = Gather( curve.x, segment );
+    V x1 = Gather( curve.x + 1, segment );
+
+    // evaluate hermite
+    V t = (x - x0) / (x1 - x0);
+    V t2 = t * t;
+    V t3 = t * t * t;
+
+    V y = (V( 2.0f ) * t3 - V( 3.0f ) * t2 + V( 1.0f )) * Gather( curve.y, segment ) + (t3 - V( 2.0f ) * t2 + t) * Gather( curve.w, segment ) +
+          (V( -2.0f ) * t3 + V( 3.0f ) * t2) * Gather( curve.y + 1, segment ) + (t3 - t2) * Gather( curve.z + 1, segment );
+
+    y = Select( x >= V( curve.x[len] ), V( curve.y[len] ), y );
+    return Select( x <= V( curve.x[0] ), V( curve.y[0] ), y );
+}
+
+// Picks each lane's entry from a per stage lane array.
+template<class V>
+inline V BatchSelectStage( const float (&values)[4][V::Width], V stage, uint32_t stageCount )
+{
+    V result = V::Load( values[0] );
+    for ( uint32_t s = 1; s < stageCount; ++s )
+    {
+        result = Select( stage == V( float( s ) ), V::Load( values[s] ), result );
+    }
+
+    return result;
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<class V>
+class FlightBatchKernelImpl : public FlightBatchKernel
+{
+public:
+    typedef FlightLanes<V::Width>   Lanes;
+    typedef typename V::Mask        Mask;
+
+    explicit FlightBatchKernelImpl( const FlightSimulator& simulator ) :
+        FlightBatchKernel( simulator, V::Width )
+    {
+    }
+
+    void        InitFlights( const ShaderShared::AscentParams* ascentParams, const ShaderShared::TelemetryData* telemetry, const ShaderShared::FlightData* flightData, uint32_t count ) override;
+    void        StepFlights( uint32_t begin, uint32_t end, uint32_t firstStep, uint32_t stepCount, FlightDataExtents* retired, FlightDataExtents* live ) override;
+    uint32_t    CompactFlights() override;
+    void        GetFlightData( ShaderShared::FlightData* flightData ) const override;
+
+private:
+    void    StepLanes( Lanes& lanes, uint32_t step );
+    void    UpdateLaneGuidance( Lanes& lanes, Mask converge, Mask update, V exhaustV, V accel ) const;
+    void    WriteTelemetry( const Lanes& lanes, uint32_t sample ) const;
+    void    RetireLanes( Lanes& lanes, uint32_t laneBits, uint32_t step );
+
+    static void     UnpackTelemetry( const Lanes& lanes, uint32_t lane, ShaderShared::TelemetryData& telemetry );
+    static void     UnpackFlightData( const Lanes& lanes, uint32_t lane, ShaderShared::FlightData& data );
+    static void     CopyLane( Lanes& dst, uint32_t dstLane, const Lanes& src, uint32_t srcLane );
+    static void     DisableLane( Lanes& lanes, uint32_t lane );
+
+    std::vector<Lanes>                      m_lanes;
+    std::vector<ShaderShared::FlightData>   m_flightData;   // Per profile, filled in as lanes retire
+};
+
+//------------------------------------------------------------------------------------------------
+
+template<class V>
+void FlightBatchKernelImpl<V>::InitFlights( const ShaderShared::AscentParams* ascentParams, const ShaderShared::TelemetryData* telemetry, const ShaderShared::FlightData* flightData, uint32_t count )
+{
+    m_groupCount = (count + V::Width - 1) / V::Width;
+    m_lanes.resize( m_groupCount );
+    m_flightData.assign( flightData, flightData + count );
+
+    for ( uint32_t group = 0; group < m_groupCount; ++group )
+    {
+        Lanes& lanes = m_lanes[group];
+
+        for ( uint32_t lane = 0; lane < V::Width; ++lane )
+        {
+            // Padding lanes fly a copy of the last profile and are never written back.
+            uint32_t profile = group * V::Width + lane;
+            uint32_t src = profile < count ? profile : count - 1;
+
+            const ShaderShared::AscentParams& ascent = ascentParams[src];
+            const ShaderShared::TelemetryData& state = telemetry[src];
+            const ShaderShared::FlightData& data = flightData[src];
+
+            lanes.profile[lane] = profile;
+            lanes.live[lane] = 1;
+
+            lanes.pitchOverSpeed[lane] = ascent.pitchOverSpeed;
+            lanes.cosPitchOverAngle[lane] = ascent.cosPitchOverAngle;
+            lanes.sinAimAngle[lane] = ascent.sinAimAngle;
+            lanes.cosAimAngle[lane] = ascent.cosAimAngle;
+
+            lanes.eciPositionX[lane] = state.eciPosition.x;
+            lanes.eciPositionY[lane] = state.eciPosition.y;
+            lanes.eciVelocityX[lane] = state.eciVelocity.x;
+            lanes.eciVelocityY[lane] = state.eciVelocity.y;
+            lanes.surfVelocityX[lane] = state.surfVelocity.x;
+            lanes.surfVelocityY[lane] = state.surfVelocity.y;
+            lanes.headingX[lane] = state.heading.x;
+            lanes.headingY[lane] = state.heading.y;
+            lanes.stage[lane] = float( state.stage );
+            lanes.mass[lane] = state.mass;
+            lanes.flightPhase[lane] = float( data.flightPhase );
+            lanes.guidancePitch[lane] = state.guidancePitch;
+
+            lanes.maxAltitude[lane] = data.maxAltitude;
+            lanes.maxSurfSpeed[lane] = data.maxSurfSpeed;
+            lanes.maxEciSpeed[lane] = data.maxEciSpeed;
+            lanes.maxQ[lane] = data.maxQ;
+            lanes.minMass[lane] = data.minMass;
+            lanes.maxAccel[lane] = data.maxAccel;
+            lanes.a[lane] = data.a;
+            lanes.e[lane] = data.e;
+            lanes.E[lane] = data.E;
+
+            for ( uint32_t s = 0; s < 4; ++s )
+            {
+                lanes.stageBurnTime[s][lane] = data.stageBurnTime[s];
+                lanes.guidanceA[s][lane] = data.guidance[s].A;
+                lanes.guidanceB[s][lane] = data.guidance[s].B;
+                lanes.guidanceT[s][lane] = data.guidance[s].T;
+                lanes.guidancet[s][lane] = data.guidance[s].t;
+                lanes.guidanceOmegaT[s][lane] = data.guidance[s].omegaT;
+            }
+
+            if ( profile >= count )
+                DisableLane( lanes, lane );
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<class V>
+void FlightBatchKernelImpl<V>::StepFlights( uint32_t begin, uint32_t end, uint32_t firstStep, uint32_t stepCount, FlightDataExtents* retired, FlightDataExtents* live )
+{
+    const ShaderShared::MissionParams& missionParams = m_simulator.GetMissionParams();
+    const float earthRadius = m_simulator.GetEnvironment().params.Re;
+
+    for ( uint32_t group = begin; group < end; ++group )
+    {
+        Lanes& lanes = m_lanes[group];
+
+        // Retiring clears a lane's profile, so note who was flying first.
+        uint32_t profiles[V::Width];
+        std::copy( lanes.profile, lanes.profile + V::Width, profiles );
+
+        for ( uint32_t step = firstStep; step < firstStep + stepCount; ++step )
+        {
+            StepLanes( lanes, step );
+        }
+
+        if ( !retired )
+            continue;
+
+        for ( uint32_t lane = 0; lane < V::Width; ++lane )
+        {
+            uint32_t profile = profiles[lane];
+            if ( profile == ~0u )
+                continue;
+
+            if ( lanes.profile[lane] == ~0u )
+            {
+                AccumulateFlightDataExtents( m_flightData[profile], profile, missionParams, earthRadius, *retired );
+            }
+            else
+            {
+                ShaderShared::FlightData data;
+                UnpackFlightData( lanes, lane, data );
+                AccumulateFlightDataExtents( data, profile, missionParams, earthRadius, *live );
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<class V>
+uint32_t FlightBatchKernelImpl<V>::CompactFlights()
+{
+    uint32_t liveCount = 0;
+    for ( uint32_t group = 0; group < m_groupCount; ++group )
+    {
+        for ( uint32_t lane = 0; lane < V::Width; ++lane )
+            liveCount += m_lanes[group].profile[lane] != ~0u;
+    }
+
+    // Retired lanes cost nothing but their share of a group, so only move lanes when a group comes free.
+    uint32_t groupCount = (liveCount + V::Width - 1) / V::Width;
+    if ( groupCount == m_groupCount )
+        return m_groupCount;
+
+    // Destinations never run ahead of sources, so the packing can be done in place.
+    uint32_t dst = 0;
+    for ( uint32_t group = 0; group < m_groupCount; ++group )
+    {
+        for ( uint32_t lane = 0; lane < V::Width; ++lane )
+        {
+            if ( m_lanes[group].profile[lane] == ~0u )
+                continue;
+
+            if ( dst != group * V::Width + lane )
+                CopyLane( m_lanes[dst / V::Width], dst % V::Width, m_lanes[group], lane );
+
+            ++dst;
+        }
+    }
+
+    // Pad the last group out with copies of a live lane so the disabled lanes stay finite.
+    for ( ; dst % V::Width != 0; ++dst )
+    {
+        Lanes& lanes = m_lanes[dst / V::Width];
+        CopyLane( lanes, dst % V::Width, lanes, 0 );
+        DisableLane( lanes, dst % V::Width );
+    }
+
+    m_groupCount = groupCount;
+    return m_groupCount;
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<class V>
+void FlightBatchKernelImpl<V>::GetFlightData( ShaderShared::FlightData* flightData ) const
+{
+    std::copy( m_flightData.begin(), m_flightData.end(), flightData );
+
+    for ( uint32_t group = 0; group < m_groupCount; ++group )
+    {
+        const Lanes& lanes = m_lanes[group];
+
+        for ( uint32_t lane = 0; lane < V::Width; ++lane )
+        {
+            if ( lanes.profile[lane] != ~0u )
+                UnpackFlightData( lanes, lane, flightData[lanes.profile[lane]] );
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<class V>
+void FlightBatchKernelImpl<V>::StepLanes( Lanes& lanes, uint32_t step )
+{
+    using namespace ShaderShared;
+
+    const BatchConstants& c = m_constants;
+    const V timeStep( c.timeStep );
+
+    bool writeSample = m_telemetry && (step % m_telemetryStepSize) == m_telemetryStepSize - 1;
+
+    V posX = V::Load( lanes.eciPositionX );
+    V posY = V::Load( lanes.eciPositionY );
+    V eciVelX = V::Load( lanes.eciVelocityX );
+    V eciVelY = V::Load( lanes.eciVelocityY );
+    V surfVelX = V::Load( lanes.surfVelocityX );
+    V surfVelY = V::Load( lanes.surfVelocityY );
+    V headingX = V::Load( lanes.headingX );
+    V headingY = V::Load( lanes.headingY );
+    V stage = V::Load( lanes.stage );
+    V mass = V::Load( lanes.mass );
+    V flightPhase = V::Load( lanes.flightPhase );
+    V maxQ = V::Load( lanes.maxQ );
+
+    V radius = Sqrt( posX * posX + posY * posY );
+    V upX = posX / radius;
+    V upY = posY / radius;
+    // Crashed lanes retire before their next step, the clamp only keeps disabled lanes on the curves.
+    V h = Max( radius - V( c.Re ), V( 0.0f ) );
+
+    // environmental data
+    V P = BatchEvaluateCurve( c.pressureHeight, h ) * V( 1000.0f );
+    V T = BatchEvaluateCurve( c.temperatureHeight, h );
+
+    V dryMass = Gather( c.dryMass, stage );
+    V massFlow = Gather( c.massFlow, stage );
+
+    // calculate fuel burn time
+    V fuelT = Select( flightPhase < V( float( c_PhaseMECO ) ), Min( (mass - dryMass) / (timeStep * massFlow), V( 1.0f ) ) * timeStep, V( 0.0f ) );
+
+    // calculate current thrust, F0
+    V thrustMul = fuelT / timeStep;
+    V exhaustV = V( c.g0 ) * BatchLerp( Gather( c.IspVac, stage ), Gather( c.IspSL, stage ), P / V( c.pressureAtZero ) );
+    V thrust = thrustMul * massFlow * exhaustV;
+
+    // reduce thrust by drag
+    V M = Sqrt( surfVelX * surfVelX + surfVelY * surfVelY ) / Sqrt( V( c.airGamma ) * V( c.Rstar ) * T / V( c.airM ) );
+    V Q = V( 0.5f ) * V( c.airGamma ) * P * (M * M);
+
+    V CdA = BatchEvaluateCurve( c.dragMach[0], M );
+    for ( uint32_t s = 1; s < c.stageCount; ++s )
+    {
+        Mask inStage = stage == V( float( s ) );
+        if ( Any( inStage ) )
+            CdA = Select( inStage, BatchEvaluateCurve( c.dragMach[s], M ), CdA );
+    }
+
+    V Fdrag = Q * CdA;
+
+    // Symplectic Euler integration; a0 = F0/m0, v1 = v0 + a0*dt, x1 = x0 + v1*dt
+    // acceleration
+    V distSq = posX * posX + posY * posY;
+    V accelX = (-upX * V( c.mu )) / distSq;
+    V accelY = (-upY * V( c.mu )) / distSq;
+
+    accelX = accelX + ((thrust - Fdrag) * headingX) / mass;
+    accelY = accelY + ((thrust - Fdrag) * headingY) / mass;
+
+    // velocity
+    surfVelX = surfVelX + accelX * timeStep;
+    surfVelY = surfVelY + accelY * timeStep;
+    eciVelX = eciVelX + accelX * timeStep;
+    eciVelY = eciVelY + accelY * timeStep;
+
+    // position
+    posX = posX + eciVelX * timeStep;
+    posY = posY + eciVelY * timeStep;
+
+    // Current osculating orbit
+    V prevE = V::Load( lanes.E );
+    V v2 = eciVelX * eciVelX + eciVelY * eciVelY;
+    V r = Sqrt( posX * posX + posY * posY );
+    V eccScale = v2 / V( c.mu ) - V( 1.0f ) / r;
+    V eccDot = (posX * eciVelX + posY * eciVelY) / V( c.mu );
+    V eccX = eccScale * posX - eccDot * eciVelX;
+    V eccY = eccScale * posY - eccDot * eciVelY;
+    V orbitE = v2 / V( 2.0f ) - V( c.mu ) / r;
+    V orbitA = V( -c.mu ) / (V( 2.0f ) * orbitE);
+
+    V surfSpeed = Sqrt( surfVelX * surfVelX + surfVelY * surfVelY );
+
+    // steering, lanes not in any of the phases below hold their heading
+    V aimX = headingX;
+    V aimY = headingY;
+
+    Mask liftoff = flightPhase == V( float( c_PhaseLiftoff ) );
+    Mask pitchOver = flightPhase == V( float( c_PhasePitchOver ) );
+    Mask guided = (flightPhase >= V( float( c_PhaseAeroFlight ) )) & (flightPhase < V( float( c_PhaseMECO ) )) & (thrust > V( 0.0f ));
+
+    // if below pitch over speed just aim straight up.
+    aimX = Select( liftoff, upX, aimX );
+    aimY = Select( liftoff, upY, aimY );
+    V nextPhase = Select( liftoff & (surfSpeed >= V::Load( lanes.pitchOverSpeed )), V( float( c_PhasePitchOver ) ), flightPhase );
+
+    if ( Any( pitchOver ) )
+    {
+        V sinAim = V::Load( lanes.sinAimAngle );
+        V cosAim = V::Load( lanes.cosAimAngle );
+        aimX = Select( pitchOver, upX * cosAim + upY * sinAim, aimX );
+        aimY = Select( pitchOver, upX * -sinAim + upY * cosAim, aimY );
+
+        V pitch = (surfVelX / surfSpeed) * upX + (surfVelY / surfSpeed) * upY;
+        nextPhase = Select( pitchOver & (pitch <= V::Load( lanes.cosPitchOverAngle )), V( float( c_PhaseAeroFlight ) ), nextPhase );
+    }
+
+    if ( Any( guided ) )
+    {
+        V accel = thrust / mass;
+
+        Mask aeroFlight = guided & (flightPhase == V( float( c_PhaseAeroFlight ) ));
+        Mask converge = aeroFlight & (Q <= maxQ * V( 0.2f ));
+        Mask running = AndNot( guided, aeroFlight );
+
+        // Guidance runs every second
+        Mask update = running & (BatchSelectStage<V>( lanes.guidancet, stage, c.stageCount ) >= V( 1.0f - c.timeStep * 0.5f )) &
+                      (BatchSelectStage<V>( lanes.guidanceT, stage, c.stageCount ) > V( 10.0f ));
+
+        if ( Any( converge | update ) )
+        {
+            // Positions and velocities are the post integration ones, as in StepFlight.
+            V::Store( posX, lanes.eciPositionX );
+            V::Store( posY, lanes.eciPositionY );
+            V::Store( eciVelX, lanes.eciVelocityX );
+            V::Store( eciVelY, lanes.eciVelocityY );
+
+            UpdateLaneGuidance( lanes, converge, update, exhaustV, accel );
+
+            nextPhase = Select( converge, V( float( c_PhaseGuidanceReady ) ), nextPhase );
+        }
+
+        // High frequency guidance loop, GetGuidanceAim in the orbital plane.
+        V guidanceX( 0.0f );
+        V guidanceY( 0.0f );
+
+        if ( Any( running ) )
+        {
+            V A = BatchSelectStage<V>( lanes.guidanceA, stage, c.stageCount );
+            V B = BatchSelectStage<V>( lanes.guidanceB, stage, c.stageCount );
+            V t = BatchSelectStage<V>( lanes.guidancet, stage, c.stageCount );
+
+            V radialX = posX / r;
+            V radialY = posY / r;
+
+            // normalize( cross( position, velocity ) ) is +-z, crossing it with radial gives downtrack.
+            V normalZ = posX * eciVelY - posY * eciVelX;
+            normalZ = normalZ / Sqrt( normalZ * normalZ );
+            V downtrackX = -(normalZ * radialY);
+            V downtrackY = normalZ * radialX;
+            V omega = (eciVelX * downtrackX + eciVelY * downtrackY) / r;
+
+            // Calculate radial heading vector
+            V Fr = A + B * t;
+            // Add gravity and centifugal force term.
+            Fr = Fr + (V( c.mu ) / (r * r) - (omega * omega) * r) / accel;
+
+            // Construct vector
+            Mask steer = running & (Fr < V( 1.0f ));
+            V tangential = Sqrt( V( 1.0f ) - Fr * Fr );
+            guidanceX = Select( steer, Fr * radialX + tangential * downtrackX, guidanceX );
+            guidanceY = Select( steer, Fr * radialY + tangential * downtrackY, guidanceY );
+
+            // Advance t
+            for ( uint32_t s = 0; s < c.stageCount; ++s )
+            {
+                V guidancet = V::Load( lanes.guidancet[s] );
+                V::Store( Select( running & (stage == V( float( s ) )), guidancet + timeStep, guidancet ), lanes.guidancet[s] );
+            }
+        }
+
+        // If guidance is valid then it is a unit vector
+        Mask guidanceValid = guided & (guidanceX * guidanceX + guidanceY * guidanceY > V( 0.9f ));
+        V upDotGuidance = upX * guidanceX + upY * guidanceY;
+
+        V::Store( Select( guidanceValid, V( 3.14159265f ) - BatchAcos( upDotGuidance ), V::Load( lanes.guidancePitch ) ), lanes.guidancePitch );
+
+        // If we don't have valid guidance then fall back to open loop
+        Mask openLoop = (guided & (nextPhase < V( float( c_PhaseGuidanceActive ) ))) | AndNot( guided, guidanceValid );
+        Mask closedLoop = AndNot( guided, openLoop );
+
+        V progradeX = surfVelX / surfSpeed;
+        V progradeY = surfVelY / surfSpeed;
+        aimX = Select( openLoop, progradeX, aimX );
+        aimY = Select( openLoop, progradeY, aimY );
+
+        // Make sure dynamic pressure is low enough to start manoeuvres, then engage guidance once it pitches below
+        // open loop or, past the first stage, Q is at 1% of maxQ.
+        Mask engage = openLoop & guidanceValid & (Q <= maxQ * V( 0.05f )) &
+                      ((upDotGuidance <= upX * progradeX + upY * progradeY) | ((stage > V( 0.0f )) & (Q <= maxQ * V( 0.01f ))));
+
+        nextPhase = Select( engage, V( float( c_PhaseGuidanceActive ) ), nextPhase );
+        aimX = Select( engage | closedLoop, guidanceX, aimX );
+        aimY = Select( engage | closedLoop, guidanceY, aimY );
+
+        // Have we reached final orbital energy, or likely to reach it within half the next time step?
+        V finalE( c.finalOrbitalEnergy );
+        Mask meco = closedLoop & ((orbitE >= finalE) | (orbitE + (orbitE - prevE) * V( 0.5f ) >= finalE));
+        nextPhase = Select( meco, V( float( c_PhaseMECO ) ), nextPhase );
+    }
+
+    // steer to aim (a bit rough but eh).
+    V steerAngle = BatchAcos( aimX * headingX + aimY * headingY );
+    V rotRate = Max( Gather( c.rotationRate, stage ), V( 0.001f ) ) * timeStep * Sqrt( V( c.wetMass[0] ) / mass );
+    V steerT = rotRate / Max( steerAngle, rotRate );
+    headingX = BatchLerp( headingX, aimX, steerT );
+    headingY = BatchLerp( headingY, aimY, steerT );
+    V headingLength = Sqrt( headingX * headingX + headingY * headingY );
+    headingX = headingX / headingLength;
+    headingY = headingY / headingLength;
+
+    // mass and staging
+    mass = mass - massFlow * fuelT;
+
+    Mask burning = fuelT > V( 0.0f );
+    for ( uint32_t s = 0; s < c.stageCount; ++s )
+    {
+        V burnTime = V::Load( lanes.stageBurnTime[s] );
+        V::Store( burnTime + Select( burning & (stage == V( float( s ) )), timeStep, V( 0.0f ) ), lanes.stageBurnTime[s] );
+    }
+
+    V nextStage = stage + V( 1.0f );
+    Mask staging = (mass <= dryMass) & (nextStage < V( float( c.stageCount ) ));
+    mass = Select( staging, Gather( c.wetMass, Min( nextStage, V( 3.0f ) ) ), mass );
+    stage = Select( staging, nextStage, stage );
+
+    V::Store( posX, lanes.eciPositionX );
+    V::Store( posY, lanes.eciPositionY );
+    V::Store( eciVelX, lanes.eciVelocityX );
+    V::Store( eciVelY, lanes.eciVelocityY );
+    V::Store( surfVelX, lanes.surfVelocityX );
+    V::Store( surfVelY, lanes.surfVelocityY );
+    V::Store( headingX, lanes.headingX );
+    V::Store( headingY, lanes.headingY );
+    V::Store( stage, lanes.stage );
+    V::Store( mass, lanes.mass );
+    V::Store( nextPhase, lanes.flightPhase );
+    V::Store( orbitA, lanes.a );
+    V::Store( Sqrt( eccX * eccX + eccY * eccY ), lanes.e );
+    V::Store( orbitE, lanes.E );
+
+    // Update flight data
+    V::Store( Max( h, V::Load( lanes.maxAltitude ) ), lanes.maxAltitude );
+    V::Store( Max( surfSpeed, V::Load( lanes.maxSurfSpeed ) ), lanes.maxSurfSpeed );
+    V::Store( Max( Sqrt( eciVelX * eciVelX + eciVelY * eciVelY ), V::Load( lanes.maxEciSpeed ) ), lanes.maxEciSpeed );
+    V::Store( Max( Q, maxQ ), lanes.maxQ );
+    V::Store( Min( mass, V::Load( lanes.minMass ) ), lanes.minMass );
+    V::Store( Max( Sqrt( accelX * accelX + accelY * accelY ), V::Load( lanes.maxAccel ) ), lanes.maxAccel );
+
+    if ( writeSample )
+        WriteTelemetry( lanes, step / m_telemetryStepSize );
+
+    // ShouldRetireFlight, crashed lanes always retire as StepFlight would freeze them from here on.
+    Mask retire = r - V( c.Re ) < V( 0.0f );
+    if ( m_coastMode != CoastMode::Integrate )
+    {
+        Mask burntOut = (stage == V( float( c.stageCount - 1 ) )) & (mass <= Gather( c.dryMass, stage ));
+        Mask terminal = (nextPhase == V( float( c_PhaseMECO ) )) | burntOut;
+
+        if ( m_coastMode == CoastMode::Kepler )
+        {
+            // IsOrbitClearOfAtmosphere
+            V e = V::Load( lanes.e );
+            terminal = terminal & (orbitE < V( 0.0f )) & (orbitA * (V( 1.0f ) - e) >= V( c.atmosphereRadius ));
+        }
+
+        retire = retire | terminal;
+    }
+
+    retire = retire & (V::Load( lanes.live ) > V( 0.0f ));
+    if ( Any( retire ) )
+        RetireLanes( lanes, MaskBits( retire ), step );
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<class V>
+void FlightBatchKernelImpl<V>::UpdateLaneGuidance( Lanes& lanes, Mask converge, Mask update, V exhaustV, V accel ) const
+{
+    float laneExhaustV[V::Width];
+    float laneAccel[V::Width];
+    V::Store( exhaustV, laneExhaustV );
+    V::Store( accel, laneAccel );
+
+    uint32_t convergeBits = MaskBits( converge );
+    uint32_t laneBits = convergeBits | MaskBits( update );
+
+    for ( uint32_t lane = 0; lane < V::Width; ++lane )
+    {
+        if ( !(laneBits & (1u << lane)) )
+            continue;
+
+        ShaderShared::GuidanceData guidance[4];
+        for ( uint32_t s = 0; s < 4; ++s )
+        {
+            guidance[s].A = lanes.guidanceA[s][lane];
+            guidance[s].B = lanes.guidanceB[s][lane];
+            guidance[s].T = lanes.guidanceT[s][lane];
+            guidance[s].t = lanes.guidancet[s][lane];
+            guidance[s].omegaT = lanes.guidanceOmegaT[s][lane];
+        }
+
+        uint32_t stage = uint32_t( lanes.stage[lane] );
+
+        if ( convergeBits & (1u << lane) )
+        {
+            uint32_t profile = lanes.profile[lane];
+            GuidanceSolve* solve = (m_guidanceSolves && profile != ~0u) ? &m_guidanceSolves[profile] : nullptr;
+
+            m_simulator.ConvergeLaneGuidance( guidance, stage, lanes.mass[lane], lanes.eciPositionX[lane], lanes.eciPositionY[lane],
+                                              lanes.eciVelocityX[lane], lanes.eciVelocityY[lane], laneExhaustV[lane], laneAccel[lane], solve );
+        }
+        else
+        {
+            m_simulator.UpdateLaneGuidance( guidance, stage, lanes.eciPositionX[lane], lanes.eciPositionY[lane],
+                                            lanes.eciVelocityX[lane], lanes.eciVelocityY[lane], laneExhaustV[lane], laneAccel[lane] );
+        }
+
+        for ( uint32_t s = 0; s < 4; ++s )
+        {
+            lanes.guidanceA[s][lane] = guidance[s].A;
+            lanes.guidanceB[s][lane] = guidance[s].B;
+            lanes.guidanceT[s][lane] = guidance[s].T;
+            lanes.guidancet[s][lane] = guidance[s].t;
+            lanes.guidanceOmegaT[s][lane] = guidance[s].omegaT;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<class V>
+void FlightBatchKernelImpl<V>::WriteTelemetry( const Lanes& lanes, uint32_t sample ) const
+{
+    for ( uint32_t lane = 0; lane < V::Width; ++lane )
+    {
+        if ( lanes.profile[lane] == ~0u )
+            continue;
+
+        ShaderShared::TelemetryData telemetry = {};
+        UnpackTelemetry( lanes, lane, telemetry );
+
+        m_telemetry[size_t( lanes.profile[lane] ) * m_telemetryMaxSamples + sample] = EncodeTelemetry( telemetry );
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Hands the lanes' state back per profile to finish the flight, as SweepEngine::RetireProfile does.
+template<class V>
+void FlightBatchKernelImpl<V>::RetireLanes( Lanes& lanes, uint32_t laneBits, uint32_t step )
+{
+    for ( uint32_t lane = 0; lane < V::Width; ++lane )
+    {
+        if ( !(laneBits & (1u << lane)) )
+            continue;
+
+        uint32_t profile = lanes.profile[lane];
+        ShaderShared::FlightData& flightData = m_flightData[profile];
+        UnpackFlightData( lanes, lane, flightData );
+
+        ShaderShared::TelemetryData state = {};
+        UnpackTelemetry( lanes, lane, state );
+
+        CompactTelemetry* telemetry = m_telemetry ? &m_telemetry[size_t( profile ) * m_telemetryMaxSamples] : nullptr;
+        FinishFlight( m_coastMode, m_simulator, step, m_totalSteps, state, flightData, telemetry, m_telemetryStepSize, m_telemetryMaxSamples );
+
+        DisableLane( lanes, lane );
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<class V>
+void FlightBatchKernelImpl<V>::UnpackTelemetry( const Lanes& lanes, uint32_t lane, ShaderShared::TelemetryData& telemetry )
+{
+    telemetry.eciPosition.x = lanes.eciPositionX[lane];
+    telemetry.eciPosition.y = lanes.eciPositionY[lane];
+    telemetry.eciVelocity.x = lanes.eciVelocityX[lane];
+    telemetry.eciVelocity.y = lanes.eciVelocityY[lane];
+    telemetry.surfVelocity.x = lanes.surfVelocityX[lane];
+    telemetry.surfVelocity.y = lanes.surfVelocityY[lane];
+    telemetry.heading.x = lanes.headingX[lane];
+    telemetry.heading.y = lanes.headingY[lane];
+    telemetry.stage = uint32_t( lanes.stage[lane] );
+    telemetry.mass = lanes.mass[lane];
+    telemetry.flightPhase = uint32_t( lanes.flightPhase[lane] );
+    telemetry.guidancePitch = lanes.guidancePitch[lane];
+}
+
+template<class V>
+void FlightBatchKernelImpl<V>::UnpackFlightData( const Lanes& lanes, uint32_t lane, ShaderShared::FlightData& data )
+{
+    data.maxAltitude = lanes.maxAltitude[lane];
+    data.maxSurfSpeed = lanes.maxSurfSpeed[lane];
+    data.maxEciSpeed = lanes.maxEciSpeed[lane];
+    data.maxQ = lanes.maxQ[lane];
+    data.minMass = lanes.minMass[lane];
+    data.maxAccel = lanes.maxAccel[lane];
+    data.flightPhase = uint32_t( lanes.flightPhase[lane] );
+    data.stage = uint32_t( lanes.stage[lane] );
+    data.a = lanes.a[lane];
+    data.e = lanes.e[lane];
+    data.E = lanes.E[lane];
+
+    for ( uint32_t s = 0; s < 4; ++s )
+    {
+        data.stageBurnTime[s] = lanes.stageBurnTime[s][lane];
+        data.guidance[s].A = lanes.guidanceA[s][lane];
+        data.guidance[s].B = lanes.guidanceB[s][lane];
+        data.guidance[s].T = lanes.guidanceT[s][lane];
+        data.guidance[s].t = lanes.guidancet[s][lane];
+        data.guidance[s].omegaT = lanes.guidanceOmegaT[s][lane];
+    }
+}
+
+// Every field is a 32 bit array Width long, so a lane is one word from each.
+template<class V>
+void FlightBatchKernelImpl<V>::CopyLane( Lanes& dst, uint32_t dstLane, const Lanes& src, uint32_t srcLane )
+{
+    static_assert( sizeof( Lanes ) % (sizeof( float ) * V::Width) == 0, "FlightLanes fields must all be 32 bit lane arrays" );
+    const uint32_t fieldCount = sizeof( Lanes ) / (sizeof( float ) * V::Width);
+
+    unsigned char* dstWords = reinterpret_cast<unsigned char*>(&dst);
+    const unsigned char* srcWords = reinterpret_cast<const unsigned char*>(&src);
+
+    for ( uint32_t field = 0; field < fieldCount; ++field )
+    {
+        memcpy( dstWords + (field * V::Width + dstLane) * sizeof( float ), srcWords + (field * V::Width + srcLane) * sizeof( float ), sizeof( float ) );
+    }
+}
+
+// Disabled lanes keep stepping with their group but coast as if past MECO, which skips the guidance
+// solves, and are never written back.
+template<class V>
+void FlightBatchKernelImpl<V>::DisableLane( Lanes& lanes, uint32_t lane )
+{
+    lanes.profile[lane] = ~0u;
+    lanes.live[lane] = 0;
+    lanes.flightPhase[lane] = float( ShaderShared::c_PhaseMECO );
+}
@@ -0,0 +1,256 @@
+#include "FlightCoast.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+using namespace ShaderShared;
+
+static constexpr double c_TwoPi = 6.283185307179586;
+
+//------------------------------------------------------------------------------------------------
+
+static const char* const c_CoastModeNames[] = { "integrate", "freeze", "kepler" };
+
+const char* GetCoastModeName( CoastMode mode )
+{
+    return c_CoastModeNames[uint32_t( mode )];
+}
+
+bool ParseCoastMode( const char* name, CoastMode& mode )
+{
+    for ( uint32_t i = 0; i < sizeof( c_CoastModeNames ) / sizeof( c_CoastModeNames[0] ); ++i )
+    {
+        if ( !strcmp( name, c_CoastModeNames[i] ) )
+        {
+            mode = CoastMode( i );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------------------------
+
+bool ShouldRetireFlight( CoastMode mode, const FlightSimulator& simulator, const TelemetryData& telemetry, const FlightData& flightData )
+{
+    if ( simulator.IsFlightCrashed( telemetry ) )
+        return true;
+
+    switch ( mode )
+    {
+    case CoastMode::Freeze:
+        return simulator.IsFlightTerminal( telemetry, flightData );
+    case CoastMode::Kepler:
+        return simulator.IsFlightTerminal( telemetry, flightData ) && simulator.IsOrbitClearOfAtmosphere( flightData );
+    default:
+        return false;
+    }
+}
+
+void FinishFlight( CoastMode mode, const FlightSimulator& simulator, uint32_t retireStep, uint32_t totalSteps, const TelemetryData& state,
+                   FlightData& flightData, CompactTelemetry* telemetry, uint32_t telemetryStepSize, uint32_t telemetryMaxSamples )
+{
+    CompactTelemetry coast = EncodeTelemetry( state );
+
+    // The sample holding the state after retireStep has already been written.
+    const uint32_t firstSample = (retireStep + 1) / telemetryStepSize;
+
+    if ( mode != CoastMode::Kepler || simulator.IsFlightCrashed( state ) )
+    {
+        for ( uint32_t sample = firstSample; telemetry && sample < telemetryMaxSamples; ++sample )
+            telemetry[sample] = coast;
+
+        return;
+    }
+
+    const EnvironmentalData& env = simulator.GetEnvironment().params;
+    const double timeStep = simulator.GetTimeStep();
+
+    KeplerOrbit orbit( env.mu, state.eciPosition, state.eciVelocity );
+
+    // Surface velocity differs from the ECI one by the pad's rotation, which gravity doesn't change.
+    float2 frameVelocity = state.eciVelocity - state.surfVelocity;
+
+    // Maxima over the rest of the flight time. a, e and E are constants of the orbit already.
+    double coastTime = double( totalSteps - retireStep - 1 ) * timeStep;
+    double endAnomaly = orbit.SolveAnomaly( coastTime, coastTime * orbit.GetMeanMotion() );
+
+    double minR, maxR;
+    orbit.CalcRadiusRange( endAnomaly, minR, maxR );
+
+    flightData.maxAltitude = fmaxf( flightData.maxAltitude, float( maxR - env.Re ) );
+    flightData.maxEciSpeed = fmaxf( flightData.maxEciSpeed, float( orbit.GetSpeedAtRadius( minR ) ) );
+    flightData.maxSurfSpeed = fmaxf( flightData.maxSurfSpeed, float( orbit.CalcMaxSpeed( endAnomaly, frameVelocity ) ) );
+    flightData.maxAccel = fmaxf( flightData.maxAccel, float( env.mu / (minR * minR) ) );
+
+    if ( !telemetry )
+        return;
+
+    // Each solve starts from the last, advanced at the mean motion.
+    double anomaly = 0;
+    double prevTime = 0;
+
+    for ( uint32_t sample = firstSample; sample < telemetryMaxSamples; ++sample )
+    {
+        double time = double( (sample + 1) * telemetryStepSize - (retireStep + 1) ) * timeStep;
+        anomaly = orbit.SolveAnomaly( time, anomaly + (time - prevTime) * orbit.GetMeanMotion() );
+        prevTime = time;
+
+        // Only position and velocity move, and the surface velocity is left for decoding to derive.
+        orbit.GetState( anomaly, coast.eciPosition, coast.eciVelocity );
+        telemetry[sample] = coast;
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+KeplerOrbit::KeplerOrbit( double mu, const float2& position, const float2& velocity ) :
+    m_mu( mu )
+{
+    m_r0[0] = position.x;
+    m_r0[1] = position.y;
+    m_v0[0] = velocity.x;
+    m_v0[1] = velocity.y;
+
+    m_r0Length = sqrt( m_r0[0] * m_r0[0] + m_r0[1] * m_r0[1] );
+    m_sigma0 = (m_r0[0] * m_v0[0] + m_r0[1] * m_v0[1]) / sqrt( mu );
+
+    double v2 = m_v0[0] * m_v0[0] + m_v0[1] * m_v0[1];
+    m_a = 1 / (2 / m_r0Length - v2 / mu);
+    m_meanMotion = m_a > 0 ? sqrt( mu / (m_a * m_a * m_a) ) : 0;
+}
+
+// Kepler's equation relative to the initial state, n dt = dE + sigma0 / sqrt( a ) (1 - cos dE) - (1 - r0 / a) sin dE.
+double KeplerOrbit::SolveAnomaly( double dt, double guess ) const
+{
+    const double c1 = m_sigma0 / sqrt( m_a );
+    const double c2 = 1 - m_r0Length / m_a;
+    const double M = m_meanMotion * dt;
+
+    double x = guess;
+    for ( uint32_t i = 0; i < 32; ++i )
+    {
+        double s = sin( x );
+        double c = cos( x );
+
+        // The derivative is r / a, never zero for a bound orbit.
+        double dx = (x + c1 * (1 - c) - c2 * s - M) / (1 + c1 * s - c2 * c);
+        x -= dx;
+
+        if ( fabs( dx ) < 1e-12 )
+            break;
+    }
+
+    return x;
+}
+
+double KeplerOrbit::GetRadius( double dE ) const
+{
+    return m_a + (m_r0Length - m_a) * cos( dE ) + m_sigma0 * sqrt( m_a ) * sin( dE );
+}
+
+double KeplerOrbit::GetSpeedAtRadius( double r ) const
+{
+    // vis-viva
+    return sqrt( m_mu * (2 / r - 1 / m_a) );
+}
+
+// Lagrange f and g coefficients in terms of the change in eccentric anomaly.
+void KeplerOrbit::GetState( double dE, float2& position, float2& velocity ) const
+{
+    double s = sin( dE );
+    double c = cos( dE );
+    double dt = (dE + m_sigma0 / sqrt( m_a ) * (1 - c) - (1 - m_r0Length / m_a) * s) / m_meanMotion;
+
+    double f = 1 - m_a / m_r0Length * (1 - c);
+    double g = dt - (dE - s) / m_meanMotion;
+
+    position.x = float( f * m_r0[0] + g * m_v0[0] );
+    position.y = float( f * m_r0[1] + g * m_v0[1] );
+
+    double vx, vy;
+    GetVelocity( dE, vx, vy );
+    velocity.x = float( vx );
+    velocity.y = float( vy );
+}
+
+void KeplerOrbit::GetVelocity( double dE, double& vx, double& vy ) const
+{
+    double s = sin( dE );
+    double r = GetRadius( dE );
+
+    double fDot = -sqrt( m_mu * m_a ) * s / (r * m_r0Length);
+    double gDot = 1 - m_a / r * (1 - cos( dE ));
+
+    vx = fDot * m_r0[0] + gDot * m_v0[0];
+    vy = fDot * m_r0[1] + gDot * m_v0[1];
+}
+
+// The radius is a + ae cos( dE - phi ), so the apsides fall at phi + k pi.
+void KeplerOrbit::CalcRadiusRange( double dE, double& minR, double& maxR ) const
+{
+    double x = m_r0Length - m_a;
+    double y = m_sigma0 * sqrt( m_a );
+    double amplitude = sqrt( x * x + y * y );
+    double phi = atan2( y, x );
+
+    double endR = GetRadius( dE );
+    minR = std::min( m_r0Length, endR );
+    maxR = std::max( m_r0Length, endR );
+
+    // First anomaly change at or after the start reaching each apsis.
+    double apoapsis = phi < 0 ? phi + c_TwoPi : phi;
+    double periapsis = fmod( phi + c_TwoPi * 1.5, c_TwoPi );
+
+    if ( apoapsis <= dE )
+        maxR = m_a + amplitude;
+    if ( periapsis <= dE )
+        minR = m_a - amplitude;
+}
+
+double KeplerOrbit::CalcMaxSpeed( double dE, const float2& frameVelocity ) const
+{
+    auto speedAt = [this, &frameVelocity] ( double x )
+    {
+        double vx, vy;
+        GetVelocity( x, vx, vy );
+        return sqrt( (vx - frameVelocity.x) * (vx - frameVelocity.x) + (vy - frameVelocity.y) * (vy - frameVelocity.y) );
+    };
+
+    // No closed form relative to a moving frame, so sample every 1/64th of a revolution and refine around the best sample.
+    uint32_t count = std::max( uint32_t( ceil( dE / (c_TwoPi / 64) ) ), 1u );
+    double spacing = dE / count;
+
+    double best = speedAt( 0 );
+    double bestX = 0;
+
+    for ( uint32_t i = 1; i <= count; ++i )
+    {
+        double speed = speedAt( spacing * i );
+        if ( speed > best )
+        {
+            best = speed;
+            bestX = spacing * i;
+        }
+    }
+
+    // Golden section search over the neighbouring intervals.
+    const double ratio = 0.6180339887498949;
+    double lo = std::max( bestX - spacing, 0.0 );
+    double hi = std::min( bestX + spacing, dE );
+
+    for ( uint32_t i = 0; i < 40 && hi - lo > 1e-9; ++i )
+    {
+        double x1 = hi - (hi - lo) * ratio;
+        double x2 = lo + (hi - lo) * ratio;
+
+        if ( speedAt( x1 ) < speedAt( x2 ) )
+            lo = x1;
+        else
+            hi = x2;
+    }
+
+    return std::max( best, speedAt( (lo + hi) * 0.5 ) );
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "FlightSim.h"
+#include "FlightTelemetry.h"
+
+//------------------------------------------------------------------------------------------------
+// How a sweep finishes flights once they stop burning (FlightSimulator::IsFlightTerminal). Crashed
+// flights are frozen whatever the mode, as StepFlight does.
+
+enum class CoastMode : uint32_t
+{
+    Integrate,  // Keep stepping them to the end of the flight time, as the GPU does
+    Freeze,     // Hold the state they stopped burning with
+    Kepler,     // Two body orbit in closed form once clear of the atmosphere, stepped until then
+};
+
+const char* GetCoastModeName( CoastMode mode );
+bool        ParseCoastMode( const char* name, CoastMode& mode );
+
+// Whether a sweep in this mode stops stepping the flight after the step that left it in this state.
+bool        ShouldRetireFlight( CoastMode mode, const FlightSimulator& simulator, const ShaderShared::TelemetryData& telemetry, const ShaderShared::FlightData& flightData );
+
+// Fills in the rest of a flight that retired after step retireStep of totalSteps: the telemetry samples
+// past it (if telemetry isn't null) and, for a Kepler coast, the FlightData maxima over the coast.
+void        FinishFlight( CoastMode mode, const FlightSimulator& simulator, uint32_t retireStep, uint32_t totalSteps, const ShaderShared::TelemetryData& state,
+                          ShaderShared::FlightData& flightData, CompactTelemetry* telemetry, uint32_t telemetryStepSize, uint32_t telemetryMaxSamples );
+
+//------------------------------------------------------------------------------------------------
+
+// Elliptical two body orbit from an initial state, in double precision. Time is measured by the change in
+// eccentric anomaly from the initial state, which stays well behaved for near circular orbits.
+class KeplerOrbit
+{
+public:
+    KeplerOrbit( double mu, const ShaderShared::float2& position, const ShaderShared::float2& velocity );
+
+    // Semi-major axis is negative for unbound orbits, which this doesn't handle.
+    bool    IsBound() const { return m_a > 0; }
+
+    // Change in eccentric anomaly after dt seconds, guess is the starting point for the Newton solve.
+    double  SolveAnomaly( double dt, double guess ) const;
+
+    double  GetMeanMotion() const { return m_meanMotion; }
+
+    double  GetRadius( double dE ) const;
+    double  GetSpeedAtRadius( double r ) const;
+    void    GetState( double dE, ShaderShared::float2& position, ShaderShared::float2& velocity ) const;
+
+    // Smallest and largest radius while the anomaly advances by [0, dE].
+    void    CalcRadiusRange( double dE, double& minR, double& maxR ) const;
+
+    // Largest speed relative to frameVelocity while the anomaly advances by [0, dE].
+    double  CalcMaxSpeed( double dE, const ShaderShared::float2& frameVelocity ) const;
+
+private:
+    void    GetVelocity( double dE, double& vx, double& vy ) const;
+
+    double  m_mu;
+    double  m_r0[2];
+    double  m_v0[2];
+    double  m_r0Length;
+    double  m_a;
+    double  m_sigma0;       // dot( r0, v0 ) / sqrt( mu )
+    double  m_meanMotion;
+};
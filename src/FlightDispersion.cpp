@@ -0,0 +1,303 @@
+#include "FlightDispersion.h"
+#include "FlightAnalysis.h"
+#include "Noise.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+    // Quantities drawn per run, the stage ones once per stage.
+    enum DispersedQuantity : uint32_t
+    {
+        WetMass,
+        DryMass = WetMass + 4,
+        Isp = DryMass + 4,
+        Thrust = Isp + 4,
+        Drag = Thrust + 4,
+        Pressure = Drag + 4,
+        Temperature,
+    };
+
+    // Standard normal by Box-Muller from two hashes of (run, quantity), truncated at 3 sigma. Draws past it are
+    // drawn again from the next two hashes, so a run's factors still only depend on the run.
+    float DrawGaussian( uint32_t seed, uint32_t run, uint32_t quantity )
+    {
+        double z = 0;
+        for ( uint32_t attempt = 0; attempt < 64; ++attempt )
+        {
+            double u1 = (double( Noise1dUnsigned( NoiseMake3dKey( run, quantity, attempt * 2 ), seed ) ) + 0.5) / 4294967296.0;
+            double u2 = (double( Noise1dUnsigned( NoiseMake3dKey( run, quantity, attempt * 2 + 1 ), seed ) ) + 0.5) / 4294967296.0;
+
+            z = sqrt( -2.0 * log( u1 ) ) * cos( 6.283185307179586 * u2 );
+            if ( fabs( z ) <= 3.0 )
+                break;
+        }
+
+        // 64 draws in a row past 3 sigma won't happen, but the result is still bounded if they do.
+        return float( std::min( std::max( z, -3.0 ), 3.0 ) );
+    }
+}
+
+void DisperseFlight( const DispersionConfig& config, uint32_t run, FlightEnvironment& environment, MissionParams& missionParams )
+{
+    auto factor = [&config, run] ( uint32_t quantity, float sigma )
+    {
+        return 1.0f + sigma * DrawGaussian( config.seed, run, quantity );
+    };
+
+    for ( uint32_t s = 0; s < missionParams.stageCount; ++s )
+    {
+        StageData& stage = missionParams.stage[s];
+
+        stage.wetMass *= factor( WetMass + s, config.massSigma );
+        stage.dryMass *= factor( DryMass + s, config.massSigma );
+
+        // Thrust is mass flow times exhaust velocity, so mass flow takes the Isp factor out again.
+        float isp = factor( Isp + s, config.ispSigma );
+        stage.IspSL *= isp;
+        stage.IspVac *= isp;
+        stage.massFlow *= factor( Thrust + s, config.thrustSigma ) / isp;
+
+        environment.dragMach[s].Scale( factor( Drag + s, config.dragSigma ) );
+    }
+
+    environment.ScaleAtmosphere( factor( Pressure, config.pressureSigma ), factor( Temperature, config.temperatureSigma ) );
+}
+
+//------------------------------------------------------------------------------------------------
+
+const double StreamingStatistic::c_Quantiles[c_QuantileCount] = { 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99 };
+
+StreamingStatistic::StreamingStatistic() :
+    m_count( 0 ),
+    m_mean( 0 ),
+    m_m2( 0 ),
+    m_min( DBL_MAX ),
+    m_max( -DBL_MAX )
+{
+    for ( uint32_t q = 0; q < c_QuantileCount; ++q )
+    {
+        const double p = c_Quantiles[q];
+        Markers& markers = m_markers[q];
+
+        const double desired[5] = { 0, 2 * p, 4 * p, 2 + 2 * p, 4 };
+        const double increment[5] = { 0, p / 2, p, (1 + p) / 2, 1 };
+
+        for ( uint32_t i = 0; i < 5; ++i )
+        {
+            markers.height[i] = 0;
+            markers.position[i] = i;
+            markers.desired[i] = desired[i];
+            markers.increment[i] = increment[i];
+        }
+    }
+}
+
+void StreamingStatistic::Add( double x )
+{
+    ++m_count;
+    double delta = x - m_mean;
+    m_mean += delta / double( m_count );
+    m_m2 += delta * (x - m_mean);
+    m_min = std::min( m_min, x );
+    m_max = std::max( m_max, x );
+
+    for ( Markers& markers : m_markers )
+    {
+        double* q = markers.height;
+        double* n = markers.position;
+
+        // The first five samples are the markers.
+        if ( m_count <= 5 )
+        {
+            q[m_count - 1] = x;
+            if ( m_count == 5 )
+                std::sort( q, q + 5 );
+            continue;
+        }
+
+        uint32_t k;
+        if ( x < q[0] )
+        {
+            q[0] = x;
+            k = 0;
+        }
+        else if ( x >= q[4] )
+        {
+            q[4] = x;
+            k = 3;
+        }
+        else
+        {
+            for ( k = 0; k < 3 && x >= q[k + 1]; ++k )
+                ;
+        }
+
+        for ( uint32_t i = k + 1; i < 5; ++i )
+            n[i] += 1;
+        for ( uint32_t i = 0; i < 5; ++i )
+            markers.desired[i] += markers.increment[i];
+
+        // Moves the middle markers a step towards their desired positions, along a parabola through their
+        // neighbours or, if that would overtake one, a line to it.
+        for ( uint32_t i = 1; i < 4; ++i )
+        {
+            double d = markers.desired[i] - n[i];
+            if ( (d >= 1 && n[i + 1] - n[i] > 1) || (d <= -1 && n[i - 1] - n[i] < -1) )
+            {
+                d = d > 0 ? 1.0 : -1.0;
+
+                double parabolic = q[i] + d / (n[i + 1] - n[i - 1]) *
+                                   ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) + (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+
+                if ( q[i - 1] < parabolic && parabolic < q[i + 1] )
+                {
+                    q[i] = parabolic;
+                }
+                else
+                {
+                    uint32_t j = d > 0 ? i + 1 : i - 1;
+                    q[i] += d * (q[j] - q[i]) / (n[j] - n[i]);
+                }
+
+                n[i] += d;
+            }
+        }
+    }
+}
+
+double StreamingStatistic::GetQuantile( uint32_t index ) const
+{
+    const Markers& markers = m_markers[index];
+
+    if ( m_count == 0 )
+        return 0.0;
+
+    if ( m_count > 5 )
+        return markers.height[2];
+
+    // Interpolated between the samples themselves.
+    double samples[5];
+    std::copy( markers.height, markers.height + m_count, samples );
+    std::sort( samples, samples + m_count );
+
+    double position = c_Quantiles[index] * double( m_count - 1 );
+    uint32_t i = std::min( uint32_t( position ), uint32_t( m_count - 1 ) );
+    uint32_t j = std::min( i + 1, uint32_t( m_count - 1 ) );
+    return samples[i] + (samples[j] - samples[i]) * (position - i);
+}
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+    template<typename Integrator>
+    void FlyRun( const FlightSimulator& simulator, const AscentParams& ascentParams, const SweepConfig& config, uint32_t totalSteps, uint32_t telemetryMaxSamples,
+                 TelemetryData& state, FlightData& flightData, GuidanceSolve& solve )
+    {
+        CurveCursors cursors;
+
+        for ( uint32_t step = 0; step < totalSteps; ++step )
+        {
+            simulator.StepFlight<Integrator>( ascentParams, state, flightData, &solve, config.curveCursors ? &cursors : nullptr );
+
+            if ( ShouldRetireFlight( config.coastMode, simulator, state, flightData ) )
+            {
+                FinishFlight( config.coastMode, simulator, step, totalSteps, state, flightData, nullptr, config.telemetryStepSize, telemetryMaxSamples );
+                break;
+            }
+        }
+    }
+}
+
+void RunDispersion( const AscentParams& ascentParams, const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& sweepConfig,
+                    const DispersionConfig& config, ThreadPool& threadPool, double earthRadius, double earthMu, DispersionResult& result, FlightData* flightData )
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // As SweepEngine rounds the flight time.
+    const uint32_t telemetryMaxSamples = uint32_t( sweepConfig.flightTime / (sweepConfig.simulationStepSize * sweepConfig.telemetryStepSize) + 0.5f );
+    const uint32_t totalSteps = telemetryMaxSamples * sweepConfig.telemetryStepSize;
+    const uint32_t batchSize = std::max( config.batchSize, 1u );
+
+    result = DispersionResult{};
+
+    std::vector<FlightData> batchData( std::min( batchSize, config.runCount ) );
+    std::vector<MissionParams> batchMissions( batchData.size() );
+
+    for ( uint32_t batch = 0; batch < config.runCount; batch += batchSize )
+    {
+        const uint32_t count = std::min( batchSize, config.runCount - batch );
+
+        threadPool.ParallelFor( count, 1, [&] ( uint32_t begin, uint32_t end )
+        {
+            for ( uint32_t i = begin; i < end; ++i )
+            {
+                FlightEnvironment runEnvironment = environment;
+                MissionParams& runMission = batchMissions[i];
+                runMission = missionParams;
+                DisperseFlight( config, config.firstRun + batch + i, runEnvironment, runMission );
+
+                FlightSimulator simulator( runEnvironment, runMission, sweepConfig.simulationStepSize );
+
+                TelemetryData state;
+                FlightData& data = batchData[i];
+                GuidanceSolve solve = {};
+                simulator.InitFlight( ascentParams, state, data );
+
+                switch ( sweepConfig.integrator )
+                {
+                case FlightIntegrator::Dopri5:
+                {
+                    AdaptiveFlightSimulator adaptive( simulator, sweepConfig.tolerance );
+                    adaptive.SimulateFlight( ascentParams, state, data, nullptr, double( sweepConfig.simulationStepSize ) * sweepConfig.telemetryStepSize, telemetryMaxSamples,
+                                             double( totalSteps ) * sweepConfig.simulationStepSize, sweepConfig.coastMode, &solve );
+                    break;
+                }
+                case FlightIntegrator::Verlet:
+                    FlyRun<VelocityVerlet>( simulator, ascentParams, sweepConfig, totalSteps, telemetryMaxSamples, state, data, solve );
+                    break;
+                case FlightIntegrator::Yoshida4:
+                    FlyRun<Yoshida4>( simulator, ascentParams, sweepConfig, totalSteps, telemetryMaxSamples, state, data, solve );
+                    break;
+                default:
+                    FlyRun<SymplecticEuler>( simulator, ascentParams, sweepConfig, totalSteps, telemetryMaxSamples, state, data, solve );
+                    break;
+                }
+            }
+        } );
+
+        // In run order, so the quantile estimates don't depend on which thread finished first.
+        for ( uint32_t i = 0; i < count; ++i )
+        {
+            const FlightData& data = batchData[i];
+
+            result.maxQ.Add( data.maxQ );
+
+            if ( CalcSelectionObjective( data, batchMissions[i], earthRadius, earthMu ) < FLT_MAX )
+            {
+                ++result.mecoRuns;
+                result.apoapsis.Add( (1.0 + data.e) * data.a - earthRadius );
+                result.periapsis.Add( (1.0 - data.e) * data.a - earthRadius );
+                result.orbitError.Add( CalcOrbitError( data, batchMissions[i], earthRadius, earthMu ) );
+                result.minMass.Add( data.minMass );
+            }
+        }
+
+        if ( flightData )
+            std::copy( batchData.begin(), batchData.begin() + count, flightData + batch );
+
+        result.runs += count;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.time = elapsed.count();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "SweepEngine.h"
+
+//------------------------------------------------------------------------------------------------
+// Monte Carlo dispersion of a single ascent profile. Each run flies the profile with the vehicle and
+// atmosphere perturbed: stage wet and dry mass, Isp, thrust, drag and the pressure and temperature curves,
+// each scaled by a Gaussian factor truncated at 3 sigma.
+//
+// The factors are drawn from Noise1dUnsigned keyed on the run index and the quantity, so run n is the same
+// flight whichever thread flies it, whatever the batch size, and whether or not the runs before it are flown.
+// Every run has a vehicle of its own, so runs are flown one per task rather than by the batch kernels,
+// a batch at a time, and their results folded into streaming statistics in run order.
+
+struct DispersionConfig
+{
+    uint32_t    seed = 1;
+    uint32_t    runCount = 4096;
+    uint32_t    firstRun = 0;           // Runs are firstRun to firstRun + runCount - 1
+    uint32_t    batchSize = 1024;       // Runs flown before their results are folded in
+
+    // One sigma, relative.
+    float       massSigma = 0.005f;         // Each stage's wet and dry mass
+    float       ispSigma = 0.005f;          // Each stage's sea level and vacuum Isp together
+    float       thrustSigma = 0.01f;        // Each stage's thrust, at the same Isp
+    float       dragSigma = 0.05f;          // Each stage's drag curve
+    float       pressureSigma = 0.03f;      // Pressure curve
+    float       temperatureSigma = 0.01f;   // Temperature curve
+};
+
+// Scales the base vehicle and atmosphere by the run's factors. The curves are scaled in place, compiled
+// segment index and all, so the environment needn't be recompiled.
+void    DisperseFlight( const DispersionConfig& config, uint32_t run, FlightEnvironment& environment, ShaderShared::MissionParams& missionParams );
+
+//------------------------------------------------------------------------------------------------
+
+// Mean and variance by Welford's update, and quantiles by the P-square algorithm, which keeps five markers
+// per quantile rather than the samples. Quantiles are exact up to five samples, estimates after.
+class StreamingStatistic
+{
+public:
+    static const uint32_t   c_QuantileCount = 7;
+    static const double     c_Quantiles[c_QuantileCount];   // 1%, 5%, 25%, 50%, 75%, 95% and 99%
+
+    StreamingStatistic();
+
+    void        Add( double x );
+
+    uint64_t    GetCount() const { return m_count; }
+    double      GetMean() const { return m_mean; }
+    double      GetVariance() const { return m_count > 1 ? m_m2 / double( m_count - 1 ) : 0.0; }
+    double      GetMin() const { return m_min; }
+    double      GetMax() const { return m_max; }
+    double      GetQuantile( uint32_t index ) const;
+
+private:
+    // Marker heights, positions and desired positions for one quantile.
+    struct Markers
+    {
+        double  height[5];
+        double  position[5];
+        double  desired[5];
+        double  increment[5];
+    };
+
+    uint64_t    m_count;
+    double      m_mean;
+    double      m_m2;
+    double      m_min;
+    double      m_max;
+    Markers     m_markers[c_QuantileCount];
+};
+
+struct DispersionResult
+{
+    uint32_t    runs;
+    uint32_t    mecoRuns;           // Reached MECO within the max Q limit
+
+    // Over the runs that reached MECO within the max Q limit.
+    StreamingStatistic  apoapsis;   // Altitude, m
+    StreamingStatistic  periapsis;
+    StreamingStatistic  orbitError; // CalcOrbitError, m
+    StreamingStatistic  minMass;    // kg
+
+    // Over every run.
+    StreamingStatistic  maxQ;       // Pa
+
+    double      time;               // Seconds
+};
+
+// Flies the runs of config, with the sweep config's step size, flight time, integrator and coast mode.
+// flightData, if not null, takes each run's FlightData, runCount of them.
+void    RunDispersion( const ShaderShared::AscentParams& ascentParams, const FlightEnvironment& environment, const ShaderShared::MissionParams& missionParams,
+                       const SweepConfig& sweepConfig, const DispersionConfig& config, ThreadPool& threadPool, double earthRadius, double earthMu,
+                       DispersionResult& result, ShaderShared::FlightData* flightData );
@@ -0,0 +1,545 @@
+#include "FlightEnvironment.h"
+
+#include <ctype.h>
+#include <float.h>
+
+#include <algorithm>
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+// Enough for a key every 25 m of a 100 km pressure curve, closer keys share cells.
+static const uint32_t   c_MaxCurveCells = 4096;
+
+float HermiteCurve::Compile()
+{
+    m_segmentIndex.clear();
+    m_cellScale = 0;
+    m_maxWalk = 0;
+
+    if ( keys.size() < 2 )
+        return 0;
+
+    const uint32_t len = static_cast<uint32_t>(keys.size() - 1);
+    const float range = keys[len].x - keys[0].x;
+    if ( !(range > 0) )
+        return 0;
+
+    float minSegment = range;
+    for ( uint32_t i = 0; i < len; ++i )
+    {
+        if ( keys[i + 1].x > keys[i].x )
+            minSegment = std::min( minSegment, keys[i + 1].x - keys[i].x );
+    }
+
+    uint32_t cellCount = uint32_t( std::min( ceilf( range / minSegment ), float( c_MaxCurveCells ) ) );
+    m_cellScale = float( cellCount ) / range;
+
+    // CalcCell never decreases with x, so every x below a key lands in the key's cell or an earlier one. The
+    // first segment of a cell is then the number of keys in earlier cells, and the walk from there at most
+    // the number of keys in the cell.
+    std::vector<uint32_t> cellKeys( cellCount, 0 );
+    for ( uint32_t i = 1; i < len; ++i )
+        ++cellKeys[uint32_t( CalcCell( keys[i].x ) )];
+
+    m_segmentIndex.resize( cellCount );
+    uint32_t segment = 0;
+    for ( uint32_t cell = 0; cell < cellCount; ++cell )
+    {
+        m_segmentIndex[cell] = segment;
+        segment += cellKeys[cell];
+        m_maxWalk = std::max( m_maxWalk, cellKeys[cell] );
+    }
+
+    float maxError = 0;
+    auto check = [this, &maxError, len] ( float x )
+    {
+        if ( x > keys[0].x && x < keys[len].x )
+            maxError = fmaxf( maxError, fabsf( Evaluate( x ) - EvaluateSegment( SearchSegment( x ), x ) ) );
+    };
+
+    const uint32_t samplesPerSegment = 16;
+    for ( uint32_t i = 0; i <= len; ++i )
+    {
+        check( nextafterf( keys[i].x, -FLT_MAX ) );
+        check( keys[i].x );
+        check( nextafterf( keys[i].x, FLT_MAX ) );
+
+        for ( uint32_t j = 1; i < len && j < samplesPerSegment; ++j )
+            check( lerp( keys[i].x, keys[i + 1].x, float( j ) / samplesPerSegment ) );
+    }
+
+    return maxError;
+}
+
+float HermiteCurve::Evaluate( float x ) const
+{
+    // Unbound curves read as zero on the GPU.
+    if ( keys.empty() )
+        return 0.0f;
+
+    if ( x <= keys[0].x )
+    {
+        return keys[0].y;
+    }
+
+    size_t len = keys.size() - 1;
+
+    if ( x >= keys[len].x )
+    {
+        return keys[len].y;
+    }
+
+    return EvaluateSegment( m_segmentIndex.empty() ? SearchSegment( x ) : FindSegment( x ), x );
+}
+
+float HermiteCurve::Evaluate( float x, uint32_t& cursor ) const
+{
+    if ( keys.empty() )
+        return 0.0f;
+
+    if ( x <= keys[0].x )
+    {
+        return keys[0].y;
+    }
+
+    size_t len = keys.size() - 1;
+
+    if ( x >= keys[len].x )
+    {
+        return keys[len].y;
+    }
+
+    cursor = WalkSegment( x, cursor );
+    return EvaluateSegment( cursor, x );
+}
+
+void HermiteCurve::Scale( float scale )
+{
+    for ( float4& key : keys )
+    {
+        key.y *= scale;
+        key.z *= scale;
+        key.w *= scale;
+    }
+}
+
+// NaN clamps to the first cell.
+float HermiteCurve::CalcCell( float x ) const
+{
+    return fminf( fmaxf( (x - keys[0].x) * m_cellScale, 0.0f ), float( m_segmentIndex.size() - 1 ) );
+}
+
+uint32_t HermiteCurve::FindSegment( float x ) const
+{
+    const uint32_t len = static_cast<uint32_t>(keys.size() - 1);
+
+    // Walk over the keys sharing the cell.
+    uint32_t i = m_segmentIndex[uint32_t( CalcCell( x ) )];
+    while ( i + 1 < len && x >= keys[i + 1].x )
+        ++i;
+
+    return i;
+}
+
+// Lands on the same segment as searching, keys sharing an x are walked past going forward.
+uint32_t HermiteCurve::WalkSegment( float x, uint32_t cursor ) const
+{
+    const uint32_t len = static_cast<uint32_t>(keys.size() - 1);
+
+    if ( cursor == c_NoCursor )
+        return m_segmentIndex.empty() ? SearchSegment( x ) : FindSegment( x );
+
+    uint32_t i = std::min( cursor, len - 1 );
+    while ( i > 0 && x < keys[i].x )
+        --i;
+    while ( i + 1 < len && x >= keys[i + 1].x )
+        ++i;
+
+    return i;
+}
+
+uint32_t HermiteCurve::SearchSegment( float x ) const
+{
+    size_t len = keys.size() - 1;
+
+    // Work out which segment we are in.
+    size_t i;
+    for ( i = 0; i < len; ++i )
+    {
+        if ( x >= keys[i].x && x < keys[i + 1].x )
+            break;
+    }
+
+    return static_cast<uint32_t>(i);
+}
+
+float HermiteCurve::EvaluateSegment( uint32_t i, float x ) const
+{
+    // evaluate hermite
+    float t = (x - keys[i].x) / (keys[i + 1].x - keys[i].x);
+    float t2 = sqr( t );
+    float t3 = cube( t );
+
+    return (2 * t3 - 3 * t2 + 1) * keys[i].y + (t3 - 2 * t2 + t) * keys[i].w + (-2 * t3 + 3 * t2) * keys[i + 1].y + (t3 - t2) * keys[i + 1].z;
+}
+
+//------------------------------------------------------------------------------------------------
+
+float FlightEnvironment::Compile()
+{
+    float maxError = std::max( pressureHeight.Compile(), temperatureHeight.Compile() );
+
+    for ( uint32_t stage = 0; stage < 4; ++stage )
+    {
+        maxError = std::max( maxError, liftMach[stage].Compile() );
+        maxError = std::max( maxError, dragMach[stage].Compile() );
+    }
+
+    m_seaLevelPressure = GetStaticPressure( 0 );
+    m_compiled = true;
+
+    return maxError;
+}
+
+void FlightEnvironment::ScaleAtmosphere( float pressureScale, float temperatureScale )
+{
+    pressureHeight.Scale( pressureScale );
+    temperatureHeight.Scale( temperatureScale );
+
+    if ( m_compiled )
+        m_seaLevelPressure = GetStaticPressure( 0 );
+}
+
+//------------------------------------------------------------------------------------------------
+
+float FlightEnvironment::GetAtmosphereHeight() const
+{
+    if ( pressureHeight.keys.empty() || pressureHeight.keys.back().y > 0 )
+        return FLT_MAX;
+
+    return pressureHeight.keys.back().x;
+}
+
+void FlightEnvironment::CalcOrbitParameters( const float2& eciPos, const float2& eciVel, float& a, float2& e, float& E ) const
+{
+    float v2 = dot( eciVel, eciVel );
+    float r = length( eciPos );
+
+    // Calc eccentricty
+    e = (v2 / params.mu - 1 / r) * eciPos - (dot( eciPos, eciVel ) / params.mu) * eciVel;
+
+    // Calc semi-major axis
+    E = v2 / 2 - params.mu / r;
+    a = -params.mu / (2 * E);
+}
+
+//------------------------------------------------------------------------------------------------
+
+void GenerateMonotonicInterpolants( std::vector<float4>& curveData )
+{
+    std::vector<float> delta;
+    for ( uint32_t i = 0; i < curveData.size() - 1; ++i )
+    {
+        delta.emplace_back( (curveData[i + 1].y - curveData[i].y) / (curveData[i + 1].x - curveData[i].x) );
+    }
+
+    std::vector<float> tangents;
+    tangents.emplace_back( delta.front() );
+    for ( uint32_t i = 1; i < delta.size(); ++i )
+    {
+        if ( (delta[i - 1] > 0.0f) == (delta[i] > 0.0f) )
+            tangents.emplace_back( (delta[i - 1] + delta[i]) / 2 );
+        else
+            tangents.emplace_back( 0.0f );
+    }
+    tangents.emplace_back( delta.back() );
+
+    for ( uint32_t i = 0; i < delta.size(); ++i )
+    {
+        if ( fabs( delta[i] ) < FLT_EPSILON )
+        {
+            tangents[i] = 0.f;
+            tangents[i + 1] = 0.f;
+            ++i;
+        }
+        else
+        {
+            float alpha = tangents[i] / delta[i];
+            float beta = tangents[i + 1] / delta[i];
+
+            if ( alpha < 0.0f || beta < 0.0f )
+            {
+                tangents[i] = 0.f;
+            }
+            else
+            {
+                float s = alpha * alpha + beta * beta;
+                if ( s > 9.0f )
+                {
+                    s = 3.0f / sqrt( s );
+                    tangents[i] = s * alpha * delta[i];
+                    tangents[i + 1] = s * beta * delta[i];
+                }
+            }
+        }
+    }
+
+    for ( uint32_t i = 0; i < curveData.size(); ++i )
+    {
+        curveData[i].z = curveData[i].w = tangents[i];
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+void FixupHermiteTangents( std::vector<float4>& curveData )
+{
+    curveData[0].z = 0.0f;
+    curveData[0].w *= (curveData[1].x - curveData[0].x);
+    uint32_t i;
+    for ( i = 1; i < curveData.size() - 1; ++i )
+    {
+        curveData[i].z *= (curveData[i].x - curveData[i - 1].x);
+        curveData[i].w *= (curveData[i + 1].x - curveData[i].x);
+    }
+    curveData[i].z *= (curveData[i].x - curveData[i - 1].x);
+    curveData[i].w = 0.0f;
+}
+
+//------------------------------------------------------------------------------------------------
+
+bool ParseHermiteCurve( const nlohmann::json& keyListJson, std::vector<float4>& curveData )
+{
+    curveData.clear();
+    curveData.reserve( keyListJson.size() );
+
+    bool generateInterpolants = true;
+    for ( const nlohmann::json& keyJson : keyListJson["keys"] )
+    {
+        std::vector<float> key = keyJson;
+
+        if ( key.size() >= 4 )
+        {
+            curveData.emplace_back( key[0], key[1], key[2], key[3] );
+            generateInterpolants = false;
+        }
+        else if ( key.size() >= 2 )
+        {
+            curveData.emplace_back( key[0], key[1], 0.0f, 0.0f );
+        }
+    }
+
+    if ( curveData.size() > 1 )
+    {
+        if ( generateInterpolants )
+        {
+            GenerateMonotonicInterpolants( curveData );
+        }
+
+        FixupHermiteTangents( curveData );
+    }
+
+    return curveData.size() > 0;
+}
+
+//------------------------------------------------------------------------------------------------
+
+bool ParseMachSweep( std::istream& iStream, bool lift, std::vector<float4>& curveData, std::string& error )
+{
+    std::string line;
+    std::getline( iStream, line );
+
+    std::vector<std::string> headers;
+    for ( size_t start = 0; start <= line.size(); )
+    {
+        size_t end = std::min( line.find( ',', start ), line.size() );
+        headers.emplace_back( line, start, end - start );
+        std::for_each( headers.back().begin(), headers.back().end(), [] ( char& a ) { a = static_cast<char>(tolower( a )); } );
+        headers.back().erase( std::remove_if( headers.back().begin(), headers.back().end(), [] ( char a ) { return isspace( a ) != 0; } ), headers.back().end() );
+        start = end + 1;
+    }
+
+    std::vector<std::vector<double>> data;
+    data.emplace_back();
+    for (;;)
+    {
+        std::istream::int_type c;
+        for (;;)
+        {
+            c = iStream.peek();
+            if ( c == std::istream::traits_type::eof() || isdigit( c ) || c == '-' )
+                break;
+            iStream.get();
+        }
+
+        float f;
+        iStream >> f;
+
+        if ( !iStream.good() )
+            break;
+
+        if ( data.back().size() < headers.size() )
+            data.back().push_back( f );
+        else
+            data.emplace_back( std::vector<double>( 1, f ) );
+    }
+
+    if ( data.size() > 0 )
+    {
+        for ( uint32_t i = 1; i < data.size(); ++i )
+        {
+            data.erase( data.begin() + i );
+        }
+
+        const char* columnNames[] = { "mach", "a", "cd" };
+        double scale = 1.0f;
+        if ( lift )
+        {
+            columnNames[2] = "cl";
+            scale = 1000;
+        }
+
+        std::array<uint32_t, 3> columnIndex;
+        for ( uint32_t i = 0; i < columnIndex.size(); ++i )
+        {
+            std::vector<std::string>::const_iterator colIter = std::find( headers.cbegin(), headers.cend(), columnNames[i] );
+            if ( colIter == headers.cend() )
+            {
+                error = std::string( "Missing " ) + char( toupper( *columnNames[i] ) ) + (columnNames[i] + 1) + " column.";
+                return false;
+            }
+            columnIndex[i] = static_cast<uint32_t>(colIter - headers.cbegin());
+        }
+
+        curveData.clear();
+        curveData.reserve( data.size() );
+
+        for ( const std::vector<double>& src : data )
+        {
+            if ( src.size() < headers.size() )
+                continue;
+
+            float mach = float( src[columnIndex[0]] );
+            float y = float( src[columnIndex[2]] * src[columnIndex[1]] * scale );
+
+            curveData.emplace_back( mach, y, 0.0f, 0.0f );
+        }
+
+        if ( curveData.size() > 1 )
+        {
+            GenerateMonotonicInterpolants( curveData );
+            FixupHermiteTangents( curveData );
+            return true;
+        }
+    }
+
+    error = "No valid data in file.";
+    return false;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void ParseMissionParams( const nlohmann::json& missionParamsJson, double earthRadius, double earthMu, MissionParams& missionParams )
+{
+    missionParams = MissionParams{};
+
+    missionParams.stageCount = 0;
+    for ( const nlohmann::json& stageJson : missionParamsJson["stages"] )
+    {
+        StageData& stage = missionParams.stage[missionParams.stageCount];
+
+        stage.wetMass = stageJson.value( "wetmass", 0.0f );
+        stage.dryMass = stageJson.value( "drymass", 0.0f );
+        stage.IspSL = stageJson.value( "IspSL", 0.0f );
+        stage.IspVac = stageJson.value( "IspVac", 0.0f );
+        stage.rotationRate = 3.14159265f / 180.0f;
+
+        float fuelMass = stageJson.value( "fuelmass", 0.0f );
+        if ( fuelMass > 0.0f )
+            stage.dryMass = stage.wetMass - fuelMass;
+
+        if ( stage.IspVac > 0.0f )
+        {
+            // Convert thrust (in kN) to mass flow rate
+            float thrust = stageJson.value( "thrustVac", 0.0f );
+            float thrustLimit = stageJson.value( "thrustLimit", 1.0f );
+            thrustLimit = std::min( std::max( thrustLimit, 0.0f ), 1.0f );
+            stage.massFlow = thrust * 1000.0f * thrustLimit / (9.82025f * stage.IspVac);
+        }
+
+        if ( stage.dryMass > 0.0f )
+        {
+            if ( ++missionParams.stageCount >= 4 )
+                break;
+        }
+    }
+
+    SetMissionOrbit( missionParamsJson.value( "apoapsis", 200000.0 ), missionParamsJson.value( "periapsis", 200000.0 ), earthRadius, earthMu, missionParams );
+}
+
+void SetMissionOrbit( double apoapsis, double periapsis, double earthRadius, double earthMu, MissionParams& missionParams )
+{
+    double Ap = apoapsis + earthRadius;
+    double Pe = periapsis + earthRadius;
+
+    double a = (Ap + Pe) / 2.0;
+    double e = 1 - Pe / a;
+    double L = a * (1 - e * e);
+
+    missionParams.finalState.r = float( Pe );
+    missionParams.finalState.rv = 0;
+    missionParams.finalState.h = float( sqrt( earthMu * L ) );
+    missionParams.finalState.omega = missionParams.finalState.h / float( Pe * Pe );
+
+    missionParams.finalOrbitalEnergy = float( -earthMu / (2 * a) );
+}
+
+//------------------------------------------------------------------------------------------------
+
+void ParseEnvironmentalParams( const nlohmann::json& enviroParamsJson, double& earthRadius, double& earthMu, EnvironmentalData& enviroParams )
+{
+    earthMu = enviroParamsJson.value( "gravConstant", earthMu );
+    earthRadius = enviroParamsJson.value( "earthRadius", earthRadius );
+
+    enviroParams.mu = float( earthMu );
+    enviroParams.Re = float( earthRadius );
+    enviroParams.g0 = float( earthMu / (earthRadius * earthRadius) );
+    enviroParams.airM = enviroParamsJson.value( "airMolarMass", 0.0289644f );
+    enviroParams.Rstar = 8.3144598f;     // universal gas constant
+    enviroParams.airGamma = enviroParamsJson.value( "adiabaticIndex", 1.4f );
+    enviroParams.launchLatitude = enviroParamsJson.value( "launchLatitude", 28.608389f );
+    enviroParams.launchAltitude = enviroParamsJson.value( "launchAltitude", 85.0f );
+    enviroParams.rotationPeriod = enviroParamsJson.value( "rotationPeriod", 86164.098903691f );
+}
+
+//------------------------------------------------------------------------------------------------
+
+AscentParams MakeAscentParams( float pitchOverSpeed, float pitchOverAngle )
+{
+    const float aimOffset = 3.14159265f / 180.0f;
+
+    AscentParams params;
+    params.pitchOverSpeed = pitchOverSpeed;
+    params.sinPitchOverAngle = sin( pitchOverAngle );
+    params.cosPitchOverAngle = cos( pitchOverAngle );
+    params.sinAimAngle = sin( pitchOverAngle + aimOffset );
+    params.cosAimAngle = cos( pitchOverAngle + aimOffset );
+
+    return params;
+}
+
+void GenerateAscentParams( float minSpeed, float maxSpeed, float minAngle, float maxAngle, uint32_t speedCount, uint32_t angleCount, AscentParams* ascentParams )
+{
+    float speedStep = (maxSpeed - minSpeed) / float( speedCount - 1 );
+    float angleStep = (maxAngle - minAngle) / float( angleCount - 1 );
+
+    for ( uint32_t speed = 0; speed < speedCount; ++speed )
+    {
+        for ( uint32_t angle = 0; angle < angleCount; ++angle )
+        {
+            ascentParams[speed * angleCount + angle] = MakeAscentParams( minSpeed + speed * speedStep, minAngle + angle * angleStep );
+        }
+    }
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <array>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "Dual.h"
+#include "json.hpp"
+#include "ShaderMath.h"
+
+//------------------------------------------------------------------------------------------------
+// CPU side of environmental_data.hlsl, shared by the renderer's file loaders and the CPU engine.
+
+// Matches the EnvironmentalData cbuffer layout. Everything is SI standard units.
+struct EnvironmentalData
+{
+    float   mu;             // Gravitational constant
+    float   Re;             // Earth radius
+    float   g0;             // Standard gravity
+    float   airM;           // Molar mass of air
+    float   Rstar;          // Universal gas constant
+    float   airGamma;       // Adiabatic index
+    float   launchLatitude; // Degrees
+    float   launchAltitude;
+    float   rotationPeriod;
+};
+
+//------------------------------------------------------------------------------------------------
+
+// Keys are (x, y, in tangent, out tangent) with tangents already scaled by the segment length.
+//
+// Compile builds a segment index over a uniform grid of cells in x, each holding the first segment an x
+// in the cell can fall in, so Evaluate finds its segment in constant time rather than searching the keys.
+// Keys changed after Compile need compiling again, an uncompiled curve searches.
+class HermiteCurve
+{
+public:
+    std::vector<ShaderShared::float4>   keys;
+
+    // Returns the largest difference from searching the keys found at and either side of every key, and
+    // across every segment. The index only changes the search so anything but zero is a bug.
+    float   Compile();
+
+    float   Evaluate( float x ) const;
+
+    // Walks to x's segment from the cursor, the segment an earlier call left it on, and leaves it on x's.
+    // Constant time when x moves a segment or so between calls, as altitude and Mach do between steps,
+    // whether or not the curve is compiled. A cursor at c_NoCursor starts from Evaluate's lookup.
+    static const uint32_t c_NoCursor = ~0u;
+    float   Evaluate( float x, uint32_t& cursor ) const;
+
+    // As above with x's derivatives carried through, for flights differentiated through (see Dual.h).
+    template<uint32_t N>
+    Dual<N> Evaluate( const Dual<N>& x, uint32_t& cursor ) const
+    {
+        if ( keys.empty() )
+            return 0.0f;
+
+        if ( x <= keys[0].x )
+        {
+            return keys[0].y;
+        }
+
+        size_t len = keys.size() - 1;
+
+        if ( x >= keys[len].x )
+        {
+            return keys[len].y;
+        }
+
+        cursor = WalkSegment( x.v, cursor );
+        return EvaluateSegment( cursor, x );
+    }
+
+    // Scales y and the tangents. The segment index only depends on x, so a compiled curve stays compiled.
+    void    Scale( float scale );
+
+    // Segment i runs from keys[i] to keys[i + 1]. The index is empty until compiled.
+    const std::vector<uint32_t>&    GetSegmentIndex() const { return m_segmentIndex; }
+    float       GetCellScale() const { return m_cellScale; }    // Cells per unit x
+    uint32_t    GetMaxWalk() const { return m_maxWalk; }        // Most segments past its first an x in one cell can be in
+
+private:
+    float       CalcCell( float x ) const;
+    uint32_t    FindSegment( float x ) const;
+    uint32_t    SearchSegment( float x ) const;
+    uint32_t    WalkSegment( float x, uint32_t cursor ) const;
+    float       EvaluateSegment( uint32_t i, float x ) const;
+
+    template<uint32_t N>
+    Dual<N>     EvaluateSegment( uint32_t i, const Dual<N>& x ) const
+    {
+        Dual<N> t = (x - keys[i].x) / (keys[i + 1].x - keys[i].x);
+        Dual<N> t2 = sqr( t );
+        Dual<N> t3 = cube( t );
+
+        return (2 * t3 - 3 * t2 + 1) * keys[i].y + (t3 - 2 * t2 + t) * keys[i].w + (-2 * t3 + 3 * t2) * keys[i + 1].y + (t3 - t2) * keys[i + 1].z;
+    }
+
+    std::vector<uint32_t>   m_segmentIndex;
+    float                   m_cellScale = 0;
+    uint32_t                m_maxWalk = 0;
+};
+
+//------------------------------------------------------------------------------------------------
+
+// One trajectory's cursors into the curves FlightEnvironment evaluates, for the overloads taking them.
+struct CurveCursors
+{
+    uint32_t    pressure = HermiteCurve::c_NoCursor;
+    uint32_t    temperature = HermiteCurve::c_NoCursor;
+    uint32_t    drag[4] = { HermiteCurve::c_NoCursor, HermiteCurve::c_NoCursor, HermiteCurve::c_NoCursor, HermiteCurve::c_NoCursor };
+};
+
+//------------------------------------------------------------------------------------------------
+
+class FlightEnvironment
+{
+public:
+    EnvironmentalData   params = {};
+
+    HermiteCurve        pressureHeight;
+    HermiteCurve        temperatureHeight;
+    std::array<HermiteCurve, 4> liftMach;
+    std::array<HermiteCurve, 4> dragMach;
+
+    // Compiles every curve (see HermiteCurve) and caches the constants taken from them. Returns the largest
+    // error any curve's Compile found.
+    float   Compile();
+
+    // Scales the pressure and temperature curves, keeping the cached constants up to date.
+    void    ScaleAtmosphere( float pressureScale, float temperatureScale );
+
+    float   GetStaticPressure( float h ) const
+    {
+        return pressureHeight.Evaluate( h ) * 1000;
+    }
+
+    float   GetStaticPressure( float h, CurveCursors& cursors ) const
+    {
+        return pressureHeight.Evaluate( h, cursors.pressure ) * 1000;
+    }
+
+    // GetStaticPressure( 0 ), cached by Compile.
+    float   GetSeaLevelPressure() const
+    {
+        return m_compiled ? m_seaLevelPressure : GetStaticPressure( 0 );
+    }
+
+    // Height the pressure curve drops to zero at, above which there's no drag. FLT_MAX if it never does.
+    float   GetAtmosphereHeight() const;
+
+    float   GetTemperature( float h ) const
+    {
+        return temperatureHeight.Evaluate( h );
+    }
+
+    float   GetTemperature( float h, CurveCursors& cursors ) const
+    {
+        return temperatureHeight.Evaluate( h, cursors.temperature );
+    }
+
+    float   GetAtmosDensity( float P, float T ) const
+    {
+        return P * params.airM / (params.Rstar * T);
+    }
+
+    float   CalcQfromPressure( float P, float M ) const
+    {
+        return 0.5f * params.airGamma * P * ShaderShared::sqr( M );
+    }
+
+    float   GetSpeedOfSound( float T ) const
+    {
+        return sqrtf( params.airGamma * params.Rstar * T / params.airM );
+    }
+
+    // Drag, M is mach number
+    float   GetCdA( uint32_t stage, float M ) const
+    {
+        return dragMach[stage].Evaluate( M );
+    }
+
+    float   GetCdA( uint32_t stage, float M, CurveCursors& cursors ) const
+    {
+        return dragMach[stage].Evaluate( M, cursors.drag[stage] );
+    }
+
+    // Lift, M is mach number
+    float   GetClA( uint32_t stage, float M ) const
+    {
+        return liftMach[stage].Evaluate( M ) * 1e-3f;
+    }
+
+    void    CalcOrbitParameters( const ShaderShared::float2& eciPos, const ShaderShared::float2& eciVel, float& a, ShaderShared::float2& e, float& E ) const;
+
+    //--------------------------------------------------------------------------------------------
+    // The overloads StepFlight calls, over Duals for flights differentiated through. Same operations
+    // in the same order as the float ones, so the values match them exactly.
+
+    template<uint32_t N>
+    Dual<N> GetStaticPressure( const Dual<N>& h, CurveCursors& cursors ) const
+    {
+        return pressureHeight.Evaluate( h, cursors.pressure ) * 1000;
+    }
+
+    template<uint32_t N>
+    Dual<N> GetTemperature( const Dual<N>& h, CurveCursors& cursors ) const
+    {
+        return temperatureHeight.Evaluate( h, cursors.temperature );
+    }
+
+    template<uint32_t N>
+    Dual<N> CalcQfromPressure( const Dual<N>& P, const Dual<N>& M ) const
+    {
+        return 0.5f * params.airGamma * P * sqr( M );
+    }
+
+    template<uint32_t N>
+    Dual<N> GetSpeedOfSound( const Dual<N>& T ) const
+    {
+        return sqrtf( params.airGamma * params.Rstar * T / params.airM );
+    }
+
+    template<uint32_t N>
+    Dual<N> GetCdA( uint32_t stage, const Dual<N>& M, CurveCursors& cursors ) const
+    {
+        return dragMach[stage].Evaluate( M, cursors.drag[stage] );
+    }
+
+    template<uint32_t N>
+    void    CalcOrbitParameters( const Dual2<N>& eciPos, const Dual2<N>& eciVel, Dual<N>& a, Dual2<N>& e, Dual<N>& E ) const
+    {
+        Dual<N> v2 = dot( eciVel, eciVel );
+        Dual<N> r = length( eciPos );
+
+        e = (v2 / params.mu - 1 / r) * eciPos - (dot( eciPos, eciVel ) / params.mu) * eciVel;
+
+        E = v2 / 2 - params.mu / r;
+        a = -params.mu / (2 * E);
+    }
+
+private:
+    bool    m_compiled = false;
+    float   m_seaLevelPressure = 0;
+};
+
+//------------------------------------------------------------------------------------------------
+// File parsers. Stream based so the renderer can open files with wide names and the CLI with narrow ones.
+
+void    GenerateMonotonicInterpolants( std::vector<ShaderShared::float4>& curveData );
+void    FixupHermiteTangents( std::vector<ShaderShared::float4>& curveData );
+
+// Returns false if no keys were found.
+bool    ParseHermiteCurve( const nlohmann::json& keyListJson, std::vector<ShaderShared::float4>& curveData );
+
+// Parses a Mach sweep csv into a CdA (or ClA * 1000 if lift is set) curve, returns false with an error message on failure.
+bool    ParseMachSweep( std::istream& iStream, bool lift, std::vector<ShaderShared::float4>& curveData, std::string& error );
+
+// earthRadius and earthMu are passed in double precision as the final state is sensitive to rounding.
+void    ParseMissionParams( const nlohmann::json& missionParamsJson, double earthRadius, double earthMu, ShaderShared::MissionParams& missionParams );
+// Sets the target orbit from apoapsis and periapsis altitudes, in metres, as ParseMissionParams does.
+void    SetMissionOrbit( double apoapsis, double periapsis, double earthRadius, double earthMu, ShaderShared::MissionParams& missionParams );
+void    ParseEnvironmentalParams( const nlohmann::json& enviroParamsJson, double& earthRadius, double& earthMu, EnvironmentalData& enviroParams );
+
+// Ascent params of a single profile, angle in radians.
+ShaderShared::AscentParams  MakeAscentParams( float pitchOverSpeed, float pitchOverAngle );
+
+// Fills a speed major grid of ascent params; speed varies by row, angle (in radians) by column.
+void    GenerateAscentParams( float minSpeed, float maxSpeed, float minAngle, float maxAngle, uint32_t speedCount, uint32_t angleCount, ShaderShared::AscentParams* ascentParams );
@@ -0,0 +1,475 @@
+#include "FlightGradient.h"
+
+#include <math.h>
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+    typedef FlightScalarTypes<AscentDual> DualTypes;
+
+    // As MakeAscentParams, with pitch over speed and angle the two inputs.
+    DualAscentParams<2> MakeDualAscentParams( float pitchOverSpeed, float pitchOverAngle )
+    {
+        const AscentParams params = MakeAscentParams( pitchOverSpeed, pitchOverAngle );
+        const AscentDual angle = AscentDual::MakeInput( pitchOverAngle, 1 );
+
+        DualAscentParams<2> dual;
+        dual.pitchOverSpeed = AscentDual::MakeInput( pitchOverSpeed, 0 );
+        dual.sinPitchOverAngle = AscentDual::Chain( angle, params.sinPitchOverAngle, params.cosPitchOverAngle );
+        dual.cosPitchOverAngle = AscentDual::Chain( angle, params.cosPitchOverAngle, -params.sinPitchOverAngle );
+        dual.sinAimAngle = AscentDual::Chain( angle, params.sinAimAngle, params.cosAimAngle );
+        dual.cosAimAngle = AscentDual::Chain( angle, params.cosAimAngle, -params.sinAimAngle );
+
+        return dual;
+    }
+
+    float2 GetValue( const DualTypes::Vector2& v )
+    {
+        return float2( v.x.v, v.y.v );
+    }
+
+    TelemetryData GetTelemetryValue( const DualTypes::TelemetryData& telemetry )
+    {
+        TelemetryData value;
+        value.eciPosition = GetValue( telemetry.eciPosition );
+        value.eciVelocity = GetValue( telemetry.eciVelocity );
+        value.surfVelocity = GetValue( telemetry.surfVelocity );
+        value.heading = GetValue( telemetry.heading );
+        value.stage = telemetry.stage;
+        value.mass = telemetry.mass.v;
+        value.flightPhase = telemetry.flightPhase;
+        value.guidancePitch = telemetry.guidancePitch.v;
+        value.T = float4( telemetry.T.x.v, telemetry.T.y.v, telemetry.T.z.v, telemetry.T.w.v );
+        return value;
+    }
+
+    FlightData GetFlightDataValue( const DualTypes::FlightData& flightData )
+    {
+        FlightData value;
+        value.maxAltitude = flightData.maxAltitude.v;
+        value.maxSurfSpeed = flightData.maxSurfSpeed.v;
+        value.maxEciSpeed = flightData.maxEciSpeed.v;
+        value.maxQ = flightData.maxQ.v;
+        value.minMass = flightData.minMass.v;
+        value.maxAccel = flightData.maxAccel.v;
+        value.flightPhase = flightData.flightPhase;
+        value.stage = flightData.stage;
+        value.a = flightData.a.v;
+        value.e = flightData.e.v;
+        value.E = flightData.E.v;
+
+        for ( uint32_t i = 0; i < 4; ++i )
+        {
+            const DualTypes::GuidanceData& G = flightData.guidance[i];
+            value.stageBurnTime[i] = flightData.stageBurnTime[i].v;
+            value.guidance[i] = GuidanceData{ G.A.v, G.B.v, G.T.v, G.t.v, G.omegaT.v };
+        }
+
+        return value;
+    }
+
+    //--------------------------------------------------------------------------------------------
+    // StepFlight's events all happen at the end of a step, where a continuous flight would have crossed their
+    // thresholds part way through it. That leaves a fixed step flight piecewise constant in whatever only moves
+    // its events, the pitch over speed above all. EventTiming adds the derivatives of when each threshold was
+    // crossed to the state after the step that crossed it, at zero value so the flight still flies exactly as
+    // the float one does, or with their values too to interpolate the events to their crossings.
+    class EventTiming
+    {
+    public:
+        EventTiming( const FlightSimulator& simulator, const DualTypes::AscentParams& ascentParams, bool interpolate ) :
+            m_simulator( simulator ),
+            m_ascentParams( ascentParams ),
+            m_interpolate( interpolate )
+        {
+            ResetCrossings();
+        }
+
+        // telemetry and flightData are after the step, before and flightBefore the state it started from.
+        void    AddStepTiming( const DualTypes::TelemetryData& before, const DualTypes::FlightData& flightBefore, DualTypes::TelemetryData& telemetry,
+                               DualTypes::FlightData& flightData );
+
+    private:
+        void    ResetCrossings() { m_crossings[0] = m_crossings[1] = m_crossings[2] = NAN; }
+
+        // Seconds before the end of the step a threshold crossing / rate past was crossed, zero valued unless
+        // interpolating.
+        AscentDual  CalcLead( const AscentDual& crossing, float rate ) const;
+
+        // Turns the heading as much further toward aim as it would have turned in lead more seconds.
+        void    AddSteeringSwitch( const DualTypes::TelemetryData& before, DualTypes::TelemetryData& telemetry, const DualTypes::Vector2& aim, const AscentDual& lead ) const;
+
+        // Guidance engages once dynamic pressure is low enough and either its aim has pitched below prograde
+        // or, after staging, dynamic pressure is lower still. Returns true with the lead of whichever was met
+        // last if it engaged this step.
+        bool    TrackGuidanceEngage( const DualTypes::TelemetryData& before, const DualTypes::FlightData& flightBefore, const DualTypes::TelemetryData& telemetry,
+                                     const DualTypes::FlightData& flightData, DualTypes::Vector2& aim, AscentDual& lead );
+
+        // MECO at the end of a step whose orbital energy passed the target part way through it. Had it passed
+        // later the burn would have run on that much longer at the step's acceleration.
+        void    AddCutoff( const DualTypes::TelemetryData& before, const DualTypes::FlightData& flightBefore, DualTypes::TelemetryData& telemetry,
+                           DualTypes::FlightData& flightData ) const;
+
+        const FlightSimulator&              m_simulator;
+        const DualTypes::AscentParams&      m_ascentParams;
+        const bool                          m_interpolate;
+
+        float   m_crossings[3];     // How far past the phase's thresholds the flight was last step, NaN if not tracked
+    };
+
+    AscentDual EventTiming::CalcLead( const AscentDual& crossing, float rate ) const
+    {
+        AscentDual lead = crossing / rate;
+        if ( !m_interpolate )
+            lead.v = 0;
+        return lead;
+    }
+
+    void EventTiming::AddStepTiming( const DualTypes::TelemetryData& before, const DualTypes::FlightData& flightBefore, DualTypes::TelemetryData& telemetry,
+                                     DualTypes::FlightData& flightData )
+    {
+        const float timeStep = m_simulator.GetTimeStep();
+        const uint32_t phase = flightBefore.flightPhase;
+        const bool switched = flightData.flightPhase != phase;
+
+        DualTypes::Vector2 aim;
+        AscentDual crossing;
+        AscentDual lead;
+
+        switch ( phase )
+        {
+        case c_PhaseLiftoff:
+        {
+            // Turning to the pitch over aim once the speed passed the pitch over speed.
+            const DualTypes::Vector2 upVec = normalize( before.eciPosition );
+            aim.x = dot( upVec, DualTypes::Vector2( m_ascentParams.cosAimAngle, m_ascentParams.sinAimAngle ) );
+            aim.y = dot( upVec, DualTypes::Vector2( -m_ascentParams.sinAimAngle, m_ascentParams.cosAimAngle ) );
+            crossing = length( telemetry.surfVelocity ) - m_ascentParams.pitchOverSpeed;
+            break;
+        }
+        case c_PhasePitchOver:
+            // Turning to prograde once it had tipped past the pitch over angle.
+            aim = normalize( telemetry.surfVelocity );
+            crossing = m_ascentParams.cosPitchOverAngle - dot( aim, normalize( before.eciPosition ) );
+            break;
+        case c_PhaseGuidanceReady:
+            if ( TrackGuidanceEngage( before, flightBefore, telemetry, flightData, aim, lead ) )
+                AddSteeringSwitch( before, telemetry, aim, lead );
+            if ( switched )
+                ResetCrossings();
+            return;
+        case c_PhaseGuidanceActive:
+            if ( flightData.flightPhase == c_PhaseMECO )
+                AddCutoff( before, flightBefore, telemetry, flightData );
+            return;
+        default:
+            return;
+        }
+
+        const float rate = (crossing.v - m_crossings[0]) / timeStep;
+        m_crossings[0] = crossing.v;
+
+        if ( switched )
+        {
+            if ( rate > 0 )
+                AddSteeringSwitch( before, telemetry, aim, CalcLead( crossing, rate ) );
+            ResetCrossings();
+        }
+    }
+
+    void EventTiming::AddSteeringSwitch( const DualTypes::TelemetryData& before, DualTypes::TelemetryData& telemetry, const DualTypes::Vector2& aim, const AscentDual& lead ) const
+    {
+        const MissionParams& missionParams = m_simulator.GetMissionParams();
+        const float turnRate = fmaxf( missionParams.stage[before.stage].rotationRate, 0.001f ) * sqrtf( missionParams.stage[0].wetMass / before.mass.v );
+
+        // Across the heading, toward the aim.
+        const float2 heading = GetValue( telemetry.heading );
+        float2 across( -heading.y, heading.x );
+        if ( heading.x * aim.y.v - heading.y * aim.x.v < 0 )
+            across = -across;
+
+        telemetry.heading += DualTypes::Vector2( across ) * (turnRate * lead);
+    }
+
+    bool EventTiming::TrackGuidanceEngage( const DualTypes::TelemetryData& before, const DualTypes::FlightData& flightBefore, const DualTypes::TelemetryData& telemetry,
+                                           const DualTypes::FlightData& flightData, DualTypes::Vector2& aim, AscentDual& lead )
+    {
+        const FlightEnvironment& environment = m_simulator.GetEnvironment();
+        const StageData& stageData = m_simulator.GetMissionParams().stage[before.stage];
+        const float timeStep = m_simulator.GetTimeStep();
+        const uint32_t stage = before.stage;
+
+        // The dynamic pressure and thrust StepFlight flew the step with, as it works them out.
+        CurveCursors cursors;
+        AscentDual h = length( before.eciPosition ) - environment.params.Re;
+        AscentDual P = environment.GetStaticPressure( h, cursors );
+        AscentDual M = length( before.surfVelocity ) / environment.GetSpeedOfSound( environment.GetTemperature( h, cursors ) );
+        AscentDual Q = environment.CalcQfromPressure( P, M );
+
+        AscentDual thrustMul = fminf( (before.mass - stageData.dryMass) / (timeStep * stageData.massFlow), 1 );
+        AscentDual exhaustV = environment.params.g0 * lerp( stageData.IspVac, stageData.IspSL, P / environment.GetSeaLevelPressure() );
+        AscentDual thrust = thrustMul * stageData.massFlow * exhaustV;
+
+        // The aim guidance gave, at the time it was asked for.
+        DualTypes::GuidanceData G = flightData.guidance[stage];
+        G.t -= timeStep;
+
+        const DualTypes::Vector3 position3( telemetry.eciPosition.x, telemetry.eciPosition.y, 0 );
+        const DualTypes::Vector3 velocity3( telemetry.eciVelocity.x, telemetry.eciVelocity.y, 0 );
+        const DualTypes::Vector3 guidance = m_simulator.CalcGuidanceAim<AscentDual>( G, position3, velocity3, thrust / before.mass );
+        const bool guidanceValid = thrust > 0 && dot( guidance, guidance ) > 0.9f;
+
+        const DualTypes::Vector2 upVec = normalize( before.eciPosition );
+        const AscentDual crossings[3] =
+        {
+            flightBefore.maxQ * 0.05f - Q,
+            dot( upVec, normalize( telemetry.surfVelocity ) ) - dot( upVec, xy( guidance ) ),
+            stage > 0 ? flightBefore.maxQ * 0.01f - Q : AscentDual( -1 ),
+        };
+
+        // Seconds since each threshold was crossed, infinite if it was already met and negative if it isn't.
+        float leads[3];
+        float rates[3];
+        for ( uint32_t i = 0; i < 3; ++i )
+        {
+            rates[i] = (crossings[i].v - m_crossings[i]) / timeStep;
+            if ( crossings[i].v < 0 )
+                leads[i] = -1;
+            else if ( m_crossings[i] < 0 && rates[i] > 0 )
+                leads[i] = crossings[i].v / rates[i];
+            else
+                leads[i] = INFINITY;
+        }
+
+        for ( uint32_t i = 0; i < 3; ++i )
+            m_crossings[i] = guidanceValid ? crossings[i].v : NAN;
+
+        if ( flightData.flightPhase != c_PhaseGuidanceActive )
+            return false;
+
+        // Engaged when the first and either of the others were met.
+        uint32_t either = leads[1] >= leads[2] ? 1 : 2;
+        uint32_t engaged = leads[0] <= leads[either] ? 0 : either;
+        if ( !(leads[engaged] >= 0) || leads[engaged] == INFINITY )
+            return false;
+
+        aim = xy( guidance );
+        lead = CalcLead( crossings[engaged], rates[engaged] );
+        return true;
+    }
+
+    void EventTiming::AddCutoff( const DualTypes::TelemetryData& before, const DualTypes::FlightData& flightBefore, DualTypes::TelemetryData& telemetry,
+                                 DualTypes::FlightData& flightData ) const
+    {
+        const FlightEnvironment& environment = m_simulator.GetEnvironment();
+        const float timeStep = m_simulator.GetTimeStep();
+
+        const float energyRate = (flightData.E.v - flightBefore.E.v) / timeStep;
+        if ( !(energyRate > 0) || telemetry.stage != before.stage )
+            return;
+
+        const AscentDual late = -CalcLead( flightData.E - m_simulator.GetMissionParams().finalOrbitalEnergy, energyRate );
+        const DualTypes::Vector2 acceleration( (GetValue( telemetry.eciVelocity ) - GetValue( before.eciVelocity )) / timeStep );
+        const float massRate = (before.mass.v - telemetry.mass.v) / timeStep;
+
+        telemetry.surfVelocity += acceleration * late;
+        telemetry.eciVelocity += acceleration * late;
+        telemetry.eciPosition += telemetry.eciVelocity * late;
+
+        const bool lowest = flightData.minMass.v == telemetry.mass.v;
+        telemetry.mass -= massRate * late;
+        if ( lowest )
+            flightData.minMass = telemetry.mass;
+
+        DualTypes::Vector2 eccentricity;
+        environment.CalcOrbitParameters( telemetry.eciPosition, telemetry.eciVelocity, flightData.a, eccentricity, flightData.E );
+        flightData.e = length( eccentricity );
+    }
+
+    //--------------------------------------------------------------------------------------------
+
+    // As SweepEngine rounds the flight time.
+    uint32_t CalcTotalSteps( const SweepConfig& config )
+    {
+        return uint32_t( config.flightTime / (config.simulationStepSize * config.telemetryStepSize) + 0.5f ) * config.telemetryStepSize;
+    }
+
+    // As FlyRun in FlightDispersion.cpp, flying the flight on from step firstStep and retiring it as a sweep in
+    // config.coastMode would.
+    template<typename Integrator>
+    void FlyRun( const FlightSimulator& simulator, const SweepConfig& config, const AscentParams& ascentParams, uint32_t firstStep, uint32_t totalSteps,
+                 TelemetryData& state, FlightData& flightData, CurveCursors& cursors )
+    {
+        for ( uint32_t step = firstStep; step < totalSteps; ++step )
+        {
+            simulator.StepFlight<Integrator>( ascentParams, state, flightData, nullptr, config.curveCursors ? &cursors : nullptr );
+
+            if ( ShouldRetireFlight( config.coastMode, simulator, state, flightData ) )
+            {
+                FinishFlight( config.coastMode, simulator, step, totalSteps, state, flightData, nullptr, config.telemetryStepSize, 0 );
+                break;
+            }
+        }
+    }
+
+    template<typename Integrator>
+    void FlyFlight( const FlightSimulator& simulator, const SweepConfig& config, float pitchOverSpeed, float pitchOverAngle, FlightData& flightData )
+    {
+        const AscentParams ascentParams = MakeAscentParams( pitchOverSpeed, pitchOverAngle );
+
+        TelemetryData state;
+        CurveCursors cursors;
+        simulator.InitFlight( ascentParams, state, flightData );
+
+        FlyRun<Integrator>( simulator, config, ascentParams, 0, CalcTotalSteps( config ), state, flightData, cursors );
+    }
+
+    // As above over AscentDual with the event timing until the flight is terminal, where dualFlightData is left.
+    // Past there it only coasts, which the values in flightData go on to as the float flight would.
+    template<typename Integrator>
+    void FlyFlight( const FlightSimulator& simulator, const SweepConfig& config, float pitchOverSpeed, float pitchOverAngle, bool interpolateEvents,
+                    DualTypes::FlightData& dualFlightData, FlightData& flightData )
+    {
+        const DualTypes::AscentParams ascentParams = MakeDualAscentParams( pitchOverSpeed, pitchOverAngle );
+        const uint32_t totalSteps = CalcTotalSteps( config );
+
+        DualTypes::TelemetryData state;
+        CurveCursors cursors;
+        simulator.InitFlight<AscentDual>( ascentParams, state, dualFlightData );
+
+        EventTiming eventTiming( simulator, ascentParams, interpolateEvents );
+
+        uint32_t step = 0;
+        for ( ; step < totalSteps; ++step )
+        {
+            const DualTypes::TelemetryData before = state;
+            const DualTypes::FlightData flightBefore = dualFlightData;
+
+            simulator.StepFlight<Integrator, AscentDual>( ascentParams, state, dualFlightData, nullptr, config.curveCursors ? &cursors : nullptr );
+            eventTiming.AddStepTiming( before, flightBefore, state, dualFlightData );
+
+            if ( simulator.IsFlightTerminal<AscentDual>( state, dualFlightData ) )
+                break;
+        }
+
+        flightData = GetFlightDataValue( dualFlightData );
+        if ( step == totalSteps )
+            return;
+
+        TelemetryData values = GetTelemetryValue( state );
+        if ( ShouldRetireFlight( config.coastMode, simulator, values, flightData ) )
+            FinishFlight( config.coastMode, simulator, step, totalSteps, values, flightData, nullptr, config.telemetryStepSize, 0 );
+        else
+            FlyRun<Integrator>( simulator, config, MakeAscentParams( pitchOverSpeed, pitchOverAngle ), step + 1, totalSteps, values, flightData, cursors );
+    }
+
+    FlightSensitivity MakeSensitivity( const AscentDual& x )
+    {
+        return FlightSensitivity{ x.v, x.d[0], x.d[1] };
+    }
+
+    template<typename Scalar>
+    Scalar CalcApoapsis( const typename FlightScalarTypes<Scalar>::FlightData& flightData, float earthRadius )
+    {
+        return flightData.a * (1 + flightData.e) - earthRadius;
+    }
+
+    template<typename Scalar>
+    Scalar CalcPeriapsis( const typename FlightScalarTypes<Scalar>::FlightData& flightData, float earthRadius )
+    {
+        return flightData.a * (1 - flightData.e) - earthRadius;
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+bool CalcFlightGradient( const FlightSimulator& simulator, const SweepConfig& config, float pitchOverSpeed, float pitchOverAngle, FlightGradient& gradient,
+                         bool interpolateEvents )
+{
+    const float earthRadius = simulator.GetEnvironment().params.Re;
+    DualFlightData<2> flightData;
+    switch ( config.integrator )
+    {
+    case FlightIntegrator::Euler:
+        FlyFlight<SymplecticEuler>( simulator, config, pitchOverSpeed, pitchOverAngle, interpolateEvents, flightData, gradient.flightData );
+        break;
+    case FlightIntegrator::Verlet:
+        FlyFlight<VelocityVerlet>( simulator, config, pitchOverSpeed, pitchOverAngle, interpolateEvents, flightData, gradient.flightData );
+        break;
+    case FlightIntegrator::Yoshida4:
+        FlyFlight<Yoshida4>( simulator, config, pitchOverSpeed, pitchOverAngle, interpolateEvents, flightData, gradient.flightData );
+        break;
+    default:
+        return false;
+    }
+
+    gradient.minMass = MakeSensitivity( flightData.minMass );
+    gradient.apoapsis = MakeSensitivity( CalcApoapsis<AscentDual>( flightData, earthRadius ) );
+    gradient.periapsis = MakeSensitivity( CalcPeriapsis<AscentDual>( flightData, earthRadius ) );
+    gradient.a = MakeSensitivity( flightData.a );
+    gradient.e = MakeSensitivity( flightData.e );
+    gradient.E = MakeSensitivity( flightData.E );
+
+    return true;
+}
+
+bool CalcFlightDifferences( const FlightSimulator& simulator, const SweepConfig& config, float pitchOverSpeed, float pitchOverAngle, float speedStep, float angleStep,
+                            FlightGradient& gradient )
+{
+    const float earthRadius = simulator.GetEnvironment().params.Re;
+
+    // The profile, then speed and angle below and above it.
+    const float profiles[5][2] =
+    {
+        { pitchOverSpeed, pitchOverAngle },
+        { pitchOverSpeed - speedStep, pitchOverAngle },
+        { pitchOverSpeed + speedStep, pitchOverAngle },
+        { pitchOverSpeed, pitchOverAngle - angleStep },
+        { pitchOverSpeed, pitchOverAngle + angleStep },
+    };
+
+    FlightData flightData[5];
+    for ( uint32_t i = 0; i < 5; ++i )
+    {
+        switch ( config.integrator )
+        {
+        case FlightIntegrator::Euler:
+            FlyFlight<SymplecticEuler>( simulator, config, profiles[i][0], profiles[i][1], flightData[i] );
+            break;
+        case FlightIntegrator::Verlet:
+            FlyFlight<VelocityVerlet>( simulator, config, profiles[i][0], profiles[i][1], flightData[i] );
+            break;
+        case FlightIntegrator::Yoshida4:
+            FlyFlight<Yoshida4>( simulator, config, profiles[i][0], profiles[i][1], flightData[i] );
+            break;
+        default:
+            return false;
+        }
+    }
+
+    gradient.flightData = flightData[0];
+
+    // Each quantity of the five flights, by speed then by angle.
+    float quantities[6][5];
+    for ( uint32_t i = 0; i < 5; ++i )
+    {
+        quantities[0][i] = flightData[i].minMass;
+        quantities[1][i] = CalcApoapsis<float>( flightData[i], earthRadius );
+        quantities[2][i] = CalcPeriapsis<float>( flightData[i], earthRadius );
+        quantities[3][i] = flightData[i].a;
+        quantities[4][i] = flightData[i].e;
+        quantities[5][i] = flightData[i].E;
+    }
+
+    FlightSensitivity* sensitivities[6] = { &gradient.minMass, &gradient.apoapsis, &gradient.periapsis, &gradient.a, &gradient.e, &gradient.E };
+    for ( uint32_t q = 0; q < 6; ++q )
+    {
+        const float* x = quantities[q];
+        *sensitivities[q] = FlightSensitivity{ x[0], (x[2] - x[1]) / (2 * speedStep), (x[4] - x[3]) / (2 * angleStep) };
+    }
+
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "SweepEngine.h"
+
+//------------------------------------------------------------------------------------------------
+// Sensitivities of a flight's outcome to its pitch over speed and angle, for gradient based searches of
+// the ascent. CalcFlightGradient flies the profile once with StepFlight over AscentDual, so guidance,
+// atmosphere and drag carry the derivatives with respect to both alongside every value and one pass gives
+// the flight and its gradient. The values are exactly those of the float flight, finished in the config's
+// coast mode as a sweep would.
+//
+// A fixed step flight only moves with its pitch over speed when an event moves to another step, so after each
+// step the derivatives of where within it the pitch over, guidance engagement and MECO thresholds were crossed
+// are added; without them the speed's derivatives would be zero. The orbit's values still scatter between
+// neighbouring profiles by about a step's energy gain, wherever MECO falls within its step, and differences
+// between them mostly measure that. The derivatives follow the flight with each event interpolated to its
+// crossing instead, whose orbit moves smoothly and which interpolateEvents flies. Averaged over a few m/s or
+// tenths of a degree the orbit's derivatives come to within about a tenth of its change, though at any one
+// profile they move with where its events fell within their steps. Flights are flown with cold guidance and the
+// config's fixed step integrator, Dopri5 isn't differentiated.
+//
+// What's returned is the derivative of the discrete flight at the profile, not a descent direction. The final
+// mass still steps between neighbouring profiles as guidance converges and updates on step boundaries, which
+// no derivative sees, so even averaged over a few m/s its derivative can be out by a third of its change or
+// more. Searches of the final mass should step by its change between flights rather than its derivative.
+//
+// CalcFlightDifferences estimates the same by central differences, four more flights, to check against.
+
+// A quantity and its derivatives with respect to pitch over speed and angle.
+struct FlightSensitivity
+{
+    float   value;
+    float   perSpeed;       // Per m/s
+    float   perAngle;       // Per radian
+};
+
+struct FlightGradient
+{
+    ShaderShared::FlightData    flightData;     // The flight, at the inputs
+
+    FlightSensitivity   minMass;
+    FlightSensitivity   apoapsis;       // Altitude, m
+    FlightSensitivity   periapsis;      // Altitude, m
+    FlightSensitivity   a;
+    FlightSensitivity   e;
+    FlightSensitivity   E;
+};
+
+// Flies the profile, angle in radians, from the pad to the end of the flight time, differentiating it until it's
+// terminal. interpolateEvents moves the values to the events' crossings too, so they no longer match the float
+// flight. Returns false if config.integrator is Dopri5.
+bool    CalcFlightGradient( const FlightSimulator& simulator, const SweepConfig& config, float pitchOverSpeed, float pitchOverAngle, FlightGradient& gradient,
+                            bool interpolateEvents = false );
+
+// As above by central differences, flying the profile and each input speedStep or angleStep either side of it.
+bool    CalcFlightDifferences( const FlightSimulator& simulator, const SweepConfig& config, float pitchOverSpeed, float pitchOverAngle, float speedStep, float angleStep,
+                               FlightGradient& gradient );
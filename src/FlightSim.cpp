@@ -0,0 +1,775 @@
+#include "FlightSim.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+using namespace ShaderShared;
+
+static constexpr float  c_Pi = 3.14159265f;
+static constexpr float  c_DegreeToRad = c_Pi / 180.0f;
+
+//------------------------------------------------------------------------------------------------
+
+const IntegratorStage SymplecticEuler::c_Stages[] = { { 1, 1 } };
+
+const IntegratorStage VelocityVerlet::c_Stages[] = { { 0.5f, 1 }, { 0.5f, 0 } };
+
+// w1 = 1 / (2 - 2^(1/3)), w0 = 1 - 2 w1. Kicks are w1 / 2, (w0 + w1) / 2, (w0 + w1) / 2, w1 / 2 and drifts w1, w0, w1.
+const IntegratorStage Yoshida4::c_Stages[] =
+{
+    { 0.67560359597982889f, 1.35120719195965777f },
+    { -0.17560359597982889f, -1.70241438391931554f },
+    { -0.17560359597982889f, 1.35120719195965777f },
+    { 0.67560359597982889f, 0 },
+};
+
+static const char* const c_FlightIntegratorNames[] = { "euler", "verlet", "yoshida4", "dopri5" };
+
+const char* GetFlightIntegratorName( FlightIntegrator integrator )
+{
+    return c_FlightIntegratorNames[uint32_t( integrator )];
+}
+
+bool ParseFlightIntegrator( const char* name, FlightIntegrator& integrator )
+{
+    for ( uint32_t i = 0; i < sizeof( c_FlightIntegratorNames ) / sizeof( c_FlightIntegratorNames[0] ); ++i )
+    {
+        if ( !strcmp( name, c_FlightIntegratorNames[i] ) )
+        {
+            integrator = FlightIntegrator( i );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Solves the 2x2 system [m00 m01; m10 m11] x = Mb.
+template<typename Scalar>
+static typename FlightScalarTypes<Scalar>::Vector2 SolveGuidance( Scalar m00, Scalar m01, Scalar m10, Scalar m11, const typename FlightScalarTypes<Scalar>::Vector2& Mb )
+{
+    typedef typename FlightScalarTypes<Scalar>::Vector2 Vector2;
+
+    Scalar det = m00 * m11 - m01 * m10;
+    if ( fabsf( det ) > 1e-7f )
+    {
+        Vector2 Mx;
+        Mx.x = (m11 * Mb.x - m01 * Mb.y) / det;
+        Mx.y = (m00 * Mb.y - m10 * Mb.x) / det;
+
+        return Mx;
+    }
+
+    return Vector2( 0, 0 );
+}
+
+template<typename Scalar>
+static typename FlightScalarTypes<Scalar>::ReferenceFrame CalcReferenceFrame( const typename FlightScalarTypes<Scalar>::Vector3& position, const typename FlightScalarTypes<Scalar>::Vector3& velocity )
+{
+    typename FlightScalarTypes<Scalar>::ReferenceFrame rf;
+    rf.r = length( position );
+    rf.h = length( cross( position, velocity ) );
+    rf.omega = rf.h / sqr( rf.r );
+    rf.rv = dot( velocity, position / rf.r );
+
+    return rf;
+}
+
+// Guidance solves only record values, warm starts are a sweep's and a differentiated flight starts cold.
+static const GuidanceData& GetGuidanceValue( const GuidanceData& G )
+{
+    return G;
+}
+
+template<uint32_t N>
+static GuidanceData GetGuidanceValue( const DualGuidanceData<N>& G )
+{
+    GuidanceData value;
+    value.A = G.A.v;
+    value.B = G.B.v;
+    value.T = G.T.v;
+    value.t = G.t.v;
+    value.omegaT = G.omegaT.v;
+    return value;
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<typename Scalar>
+FlightSimulator::FlightIntegrals<Scalar> FlightSimulator::CalcFlightIntegrals( Scalar exhaustV, Scalar tau, Scalar T ) const
+{
+    FlightIntegrals<Scalar> integrals;
+    integrals.b0 = -exhaustV * logf( 1 - T / tau ); // delta V
+    integrals.b1 = integrals.b0 * tau - exhaustV * T;
+    integrals.c0 = integrals.b0 * T - integrals.b1;
+    integrals.c1 = integrals.c0 * tau - exhaustV * sqr( T ) * 0.5f;
+
+    return integrals;
+}
+
+template<typename Scalar>
+FlightSimulator::HeadingDerivatives<Scalar> FlightSimulator::CalcHeadingDerivatives( const typename FlightScalarTypes<Scalar>::GuidanceData& G, const typename FlightScalarTypes<Scalar>::ReferenceFrame& rf,
+                                                                                     const typename FlightScalarTypes<Scalar>::ReferenceFrame& S, Scalar accel, Scalar accelT ) const
+{
+    const float mu = m_environment.params.mu;
+
+    HeadingDerivatives<Scalar> f;
+
+    f.r = G.A + (mu / sqr( rf.r ) - sqr( rf.omega ) * rf.r) / accel;
+    f.rT = G.A + G.B * G.T + (mu / sqr( S.r ) - sqr( S.omega ) * S.r) / accelT;
+    f.dr = (f.rT - f.r) / G.T;
+
+    f.h = 0;
+    f.hT = 0;
+    f.dh = 0;
+
+    f.theta = 1 - sqr( f.r ) * 0.5f - sqr( f.h ) * 0.5f;
+    f.dtheta = -(f.r * f.dr + f.h * f.dh);
+    f.ddtheta = -(sqr( f.dr ) + sqr( f.dh )) * 0.5f;
+
+    return f;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Low frequency guidance loop, does estimation and updates current guidance.
+template<typename Scalar>
+void FlightSimulator::UpdateGuidanceFinalStage( typename FlightScalarTypes<Scalar>::GuidanceData& G, const typename FlightScalarTypes<Scalar>::ReferenceFrame& rf, Scalar exhaustV, Scalar accel ) const
+{
+    typedef FlightScalarTypes<Scalar> Types;
+
+    // Step steering constants forward
+    G.A += G.B * G.t;
+    G.T -= G.t;
+
+    Scalar tau = exhaustV / accel;
+    Scalar accelT = accel / (1 - G.T / tau);
+
+    const typename Types::ReferenceFrame& S = m_missionParams.finalState;
+    HeadingDerivatives<Scalar> f = CalcHeadingDerivatives<Scalar>( G, rf, S, accel, accelT );
+
+    // Calculate required delta V
+    Scalar dh = S.h - rf.h;
+    Scalar meanRadius = (rf.r + S.r) * 0.5f;
+
+    Scalar deltaV = dh / meanRadius;
+    deltaV += exhaustV * G.T * (f.dtheta + f.ddtheta * tau);
+    deltaV += f.ddtheta * exhaustV * sqr( G.T ) * 0.5f;
+    deltaV /= f.theta + (f.dtheta + f.ddtheta * tau) * tau;
+
+    // Calculate new estimate for T
+    G.T = tau * (1 - expf( -deltaV / exhaustV ));
+    G.t = 0;
+
+    // Update A, B with new T estimate
+    FlightIntegrals<Scalar> integrals = CalcFlightIntegrals( exhaustV, tau, G.T );
+
+    typename Types::Vector2 AB = SolveGuidance( integrals.b0, integrals.b1, integrals.c0, integrals.c1, typename Types::Vector2( S.rv - rf.rv, S.r - rf.r - rf.rv * G.T ) );
+    G.A = AB.x;
+    G.B = AB.y;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Low frequency guidance loop, does estimation and updates current guidance.
+template<typename Scalar>
+void FlightSimulator::UpdateGuidanceInterStage( typename FlightScalarTypes<Scalar>::GuidanceData& G, typename FlightScalarTypes<Scalar>::GuidanceData& G2, typename FlightScalarTypes<Scalar>::ReferenceFrame& rf,
+                                                typename FlightScalarTypes<Scalar>::Vector2 exhaustV, typename FlightScalarTypes<Scalar>::Vector2 accel ) const
+{
+    typedef FlightScalarTypes<Scalar> Types;
+
+    const float mu = m_environment.params.mu;
+
+    // Step steering constants forward
+    G.A += G.B * G.t;
+    G.T -= G.t;
+    G.T = fmaxf( G.T, 1 );  // Must always be > 0 while stage active
+
+    Scalar tau = exhaustV.x / accel.x;
+    Scalar accelT = accel.x / (1 - G.T / tau);
+
+    // Current flight integrals
+    FlightIntegrals<Scalar> fi = CalcFlightIntegrals( exhaustV.x, tau, G.T );
+
+    // state at staging
+    typename Types::ReferenceFrame S;
+    S.r = rf.r + rf.rv * G.T + fi.c0 * G.A + fi.c1 * G.B;
+    S.rv = rf.rv + fi.b0 * G.A + fi.b1 * G.B;
+    S.h = 0;
+    S.omega = G.omegaT;
+
+    HeadingDerivatives<Scalar> f = CalcHeadingDerivatives<Scalar>( G, rf, S, accel.x, accelT );
+
+    // Angular momentum gain at staging
+    Scalar b2 = fi.b1 * tau - exhaustV.x * sqr( G.T ) * 0.5f;
+    S.h = rf.h + (rf.r + S.r) * 0.5f * (f.theta * fi.b0 + f.dtheta * fi.b1 + f.ddtheta * b2);
+
+    // Tangental and angular speed at staging
+    Scalar VtangT = S.h / S.r;
+    S.omega = VtangT / S.r;
+    G.omegaT = S.omega;  // feedback to next loop
+
+    // guidance discontinuities at staging.
+    Scalar x = (mu / sqr( S.r ) - sqr( S.omega ) * S.r);
+    Scalar deltaA = x * (1 / accelT - 1 / accel.y);
+    Scalar deltaB = -x * (1 / exhaustV.x - 1 / exhaustV.y) + (3 * sqr( S.omega ) - 2 * mu / cube( S.r )) * S.rv * (1 / accelT - 1 / accel.y);
+
+    // Next stage flight integrals
+    Scalar tau2 = exhaustV.y / accel.y;
+
+    FlightIntegrals<Scalar> fi2 = CalcFlightIntegrals( exhaustV.y, tau2, G2.T );
+
+    // Update guidance for current stage
+    Scalar m00 = fi.b0 + fi2.b0;
+    Scalar m01 = fi.b1 + fi2.b1 + fi2.b0 * G.T;
+    Scalar m10 = fi.c0 + fi2.c0 + fi.b0 * G2.T;
+    Scalar m11 = fi.c1 + fi.b1 * G2.T + fi2.c0 * G.T + fi2.c1;
+
+    typename Types::ReferenceFrame S2;
+    if ( G2.omegaT < 0 )
+    {
+        S2 = m_missionParams.finalState;
+    }
+    else
+    {
+        S2.r = S.r + S.rv * G2.T + fi2.c0 * G2.A + fi2.c1 * G2.B;
+        S2.rv = S.rv + fi2.b0 * G2.A + fi2.b1 * G2.B;
+    }
+
+    typename Types::Vector2 Mb;
+    Mb.x = S2.rv - rf.rv - fi2.b0 * deltaA - fi2.b1 * deltaB;
+    Mb.y = S2.r - rf.r - rf.rv * (G.T + G2.T) - fi2.c0 * deltaA - fi2.c1 * deltaB;
+
+    typename Types::Vector2 AB = SolveGuidance( m00, m01, m10, m11, Mb );
+    G.A = AB.x;
+    G.B = AB.y;
+    G.t = 0;
+
+    // Update next stage guidance using staging state at start
+    G2.A = deltaA + AB.x + AB.y * G.T;
+    G2.B = deltaB + AB.y;
+
+    // Update reference frame for next stage
+    rf = S;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Multi-stage powered explicit guidance
+template<typename Scalar>
+void FlightSimulator::UpdateGuidance( typename FlightScalarTypes<Scalar>::GuidanceData* guidance, uint32_t stage, const typename FlightScalarTypes<Scalar>::Vector3& position,
+                                      const typename FlightScalarTypes<Scalar>::Vector3& velocity, Scalar exhaustV, Scalar accel ) const
+{
+    typedef FlightScalarTypes<Scalar> Types;
+
+    const float g0 = m_environment.params.g0;
+
+    typename Types::Vector2 stageEv = typename Types::Vector2( exhaustV, 0 );
+    typename Types::Vector2 stageAccel = typename Types::Vector2( accel, 0 );
+
+    typename Types::ReferenceFrame rf = CalcReferenceFrame<Scalar>( position, velocity );
+
+    for ( uint32_t s = stage; s < m_missionParams.stageCount; ++s )
+    {
+        if ( s < m_missionParams.stageCount - 1 )
+        {
+            // Assume next stage will be running in vacuum.
+            stageEv.y = g0 * m_missionParams.stage[s + 1].IspVac;
+            stageAccel.y = m_missionParams.stage[s + 1].massFlow * stageEv.y / m_missionParams.stage[s + 1].wetMass;
+
+            UpdateGuidanceInterStage<Scalar>( guidance[s], guidance[s + 1], rf, stageEv, stageAccel );
+
+            stageEv.x = stageEv.y;
+            stageAccel.x = stageAccel.y;
+        }
+        else
+        {
+            UpdateGuidanceFinalStage<Scalar>( guidance[s], rf, stageEv.x, stageAccel.x );
+        }
+    }
+}
+
+template<typename Scalar>
+void FlightSimulator::ConvergeGuidance( typename FlightScalarTypes<Scalar>::GuidanceData* guidance, uint32_t stage, const typename FlightScalarTypes<Scalar>::Vector3& position,
+                                        const typename FlightScalarTypes<Scalar>::Vector3& velocity, Scalar exhaustV, Scalar accel, GuidanceSolve* solve ) const
+{
+    typedef FlightScalarTypes<Scalar> Types;
+
+    const float g0 = m_environment.params.g0;
+
+    // Warm start from the seed's solution. The current stage keeps the burn time estimated from its mass.
+    if ( solve && solve->seed )
+    {
+        for ( uint32_t s = std::max( stage, solve->seed->stage ); s < m_missionParams.stageCount; ++s )
+        {
+            Scalar T = guidance[s].T;
+            guidance[s] = solve->seed->guidance[s];
+            guidance[s].t = 0;
+
+            if ( s == stage )
+                guidance[s].T = T;
+        }
+    }
+
+    Scalar allStageEv[4] = { exhaustV, 0.0f, 0.0f, 0.0f };
+    Scalar allStageAccel[4] = { accel, 0.0f, 0.0f, 0.0f };
+    typename Types::ReferenceFrame currentRF = CalcReferenceFrame<Scalar>( position, velocity );
+
+    // Stages past the end of the mission are never read by the update loop below.
+    for ( uint32_t i = 1; i < 4 && stage + i < 4; ++i )
+    {
+        if ( m_missionParams.stage[stage + i].wetMass > 0 )
+        {
+            allStageEv[i] = g0 * m_missionParams.stage[stage + i].IspVac;
+            allStageAccel[i] = m_missionParams.stage[stage + i].massFlow * allStageEv[i] / m_missionParams.stage[stage + i].wetMass;
+        }
+    }
+
+    uint32_t convergedStages = stage;
+    for ( uint32_t count = 0; convergedStages < m_missionParams.stageCount && count < 30; ++count )
+    {
+        Scalar A = guidance[convergedStages].A;
+
+        uint32_t idx = 0;
+        typename Types::ReferenceFrame rf = currentRF;
+
+        for ( uint32_t s = stage; s <= convergedStages; ++s, ++idx )
+        {
+            if ( s < m_missionParams.stageCount - 1 )
+            {
+                UpdateGuidanceInterStage<Scalar>( guidance[s], guidance[s + 1], rf, typename Types::Vector2( allStageEv[idx], allStageEv[idx + 1] ),
+                                                  typename Types::Vector2( allStageAccel[idx], allStageAccel[idx + 1] ) );
+            }
+            else
+            {
+                UpdateGuidanceFinalStage<Scalar>( guidance[s], rf, allStageEv[idx], allStageAccel[idx] );
+            }
+        }
+
+        if ( fabsf( A - guidance[convergedStages].A ) < 0.01f )
+            ++convergedStages;
+
+        if ( solve )
+            solve->iterations = count + 1;
+    }
+
+    if ( solve )
+    {
+        for ( uint32_t s = 0; s < 4; ++s )
+            solve->guidance[s] = GetGuidanceValue( guidance[s] );
+        solve->stage = stage;
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+// High frequency guidance loop, does steering control.
+template<typename Scalar>
+typename FlightScalarTypes<Scalar>::Vector3 FlightSimulator::GetGuidanceAim( typename FlightScalarTypes<Scalar>::GuidanceData& G, const typename FlightScalarTypes<Scalar>::Vector3& position,
+                                                                             const typename FlightScalarTypes<Scalar>::Vector3& velocity, Scalar accel ) const
+{
+    typename FlightScalarTypes<Scalar>::Vector3 aim = CalcGuidanceAim<Scalar>( G, position, velocity, accel );
+
+    // Advance t
+    G.t += m_timeStep;
+
+    return aim;
+}
+
+template<typename Scalar>
+typename FlightScalarTypes<Scalar>::Vector3 FlightSimulator::CalcGuidanceAim( const typename FlightScalarTypes<Scalar>::GuidanceData& G, const typename FlightScalarTypes<Scalar>::Vector3& position,
+                                                                              const typename FlightScalarTypes<Scalar>::Vector3& velocity, Scalar accel ) const
+{
+    typedef typename FlightScalarTypes<Scalar>::Vector3 Vector3;
+
+    Scalar r = length( position );
+    Vector3 radial = position / r;
+    Vector3 downtrack = cross( normalize( cross( position, velocity ) ), radial );
+    Scalar omega = dot( velocity, downtrack ) / r;
+
+    // Calculate radial heading vector
+    Scalar Fr = G.A + G.B * G.t;
+    // Add gravity and centifugal force term.
+    Fr += (m_environment.params.mu / sqr( r ) - sqr( omega ) * r) / accel;
+
+    // Construct vector
+    Vector3 aim = Vector3( 0, 0, 0 );
+    if ( Fr < 1 )
+    {
+        aim = Fr * radial + sqrtf( 1 - sqr( Fr ) ) * downtrack;
+    }
+
+    return aim;
+}
+
+template float3 FlightSimulator::CalcGuidanceAim<float>( const GuidanceData& G, const float3& position, const float3& velocity, float accel ) const;
+
+//------------------------------------------------------------------------------------------------
+
+void FlightSimulator::ConvergeLaneGuidance( GuidanceData* guidance, uint32_t stage, float mass, float posX, float posY, float velX, float velY, float exhaustV, float accel,
+                                            GuidanceSolve* solve ) const
+{
+    const StageData& stageData = m_missionParams.stage[stage];
+
+    // Update estimate for T.
+    guidance[stage].T = (mass - stageData.dryMass) / stageData.massFlow;
+
+    ConvergeGuidance( guidance, stage, float3( posX, posY, 0 ), float3( velX, velY, 0 ), exhaustV, accel, solve );
+}
+
+void FlightSimulator::UpdateLaneGuidance( GuidanceData* guidance, uint32_t stage, float posX, float posY, float velX, float velY, float exhaustV, float accel ) const
+{
+    UpdateGuidance( guidance, stage, float3( posX, posY, 0 ), float3( velX, velY, 0 ), exhaustV, accel );
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<typename Scalar>
+void FlightSimulator::InitFlight( const typename FlightScalarTypes<Scalar>::AscentParams& ascentParams, typename FlightScalarTypes<Scalar>::TelemetryData& telemetry,
+                                  typename FlightScalarTypes<Scalar>::FlightData& flightData ) const
+{
+    typedef FlightScalarTypes<Scalar> Types;
+
+    const EnvironmentalData& env = m_environment.params;
+
+    telemetry = typename Types::TelemetryData{};
+    flightData = typename Types::FlightData{};
+
+    // Initial state
+    telemetry.eciPosition = typename Types::Vector2( 0, env.Re + env.launchAltitude );
+    telemetry.surfVelocity = typename Types::Vector2( 0, 0 );
+    telemetry.heading = typename Types::Vector2( 0, 1 );
+    telemetry.stage = 0;
+    telemetry.mass = m_missionParams.stage[0].wetMass;
+    telemetry.guidancePitch = 4.0f;  // >pi == no guidance
+
+    Scalar padRadius = length( telemetry.eciPosition ) * cosf( env.launchLatitude * c_DegreeToRad );
+    Scalar padSpeed = 2 * c_Pi * padRadius / env.rotationPeriod;
+    telemetry.eciVelocity = telemetry.surfVelocity + typename Types::Vector2( padSpeed, 0 );
+
+    flightData.maxAltitude = 0;
+    flightData.maxSurfSpeed = 0;
+    flightData.maxEciSpeed = 0;
+    flightData.maxQ = 1e-6f;    // non-zero to avoid divide by zero in the aero flight calcs
+    flightData.minMass = telemetry.mass;
+    flightData.flightPhase = c_PhaseLiftoff;
+
+    for ( uint32_t i = 0; i < m_missionParams.stageCount; ++i )
+    {
+        flightData.guidance[i].A = 0;
+        flightData.guidance[i].B = 0;
+        // Estimated burn time
+        flightData.guidance[i].T = (m_missionParams.stage[i].wetMass - m_missionParams.stage[i].dryMass) / m_missionParams.stage[i].massFlow;
+        flightData.guidance[i].t = 0;
+        flightData.guidance[i].omegaT = 0;
+
+        flightData.stageBurnTime[i] = 0;
+    }
+
+    // Flag for last stage
+    flightData.guidance[m_missionParams.stageCount - 1].omegaT = -1;
+
+    // If pitchover speed is 0, pitch on pad.
+    if ( ascentParams.pitchOverSpeed <= 0.0f )
+    {
+        telemetry.heading = typename Types::Vector2( ascentParams.sinPitchOverAngle, ascentParams.cosPitchOverAngle );
+        flightData.flightPhase = c_PhaseAeroFlight;
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<typename Scalar>
+bool FlightSimulator::IsFlightCrashed( const typename FlightScalarTypes<Scalar>::TelemetryData& telemetry ) const
+{
+    return length( telemetry.eciPosition ) - m_environment.params.Re < 0;
+}
+
+template<typename Scalar>
+bool FlightSimulator::IsFlightTerminal( const typename FlightScalarTypes<Scalar>::TelemetryData& telemetry, const typename FlightScalarTypes<Scalar>::FlightData& flightData ) const
+{
+    if ( flightData.flightPhase == c_PhaseMECO || IsFlightCrashed<Scalar>( telemetry ) )
+        return true;
+
+    // Burnt out with nothing left to stage to, nothing but the coast left to simulate.
+    return telemetry.stage == m_missionParams.stageCount - 1 && telemetry.mass <= m_missionParams.stage[telemetry.stage].dryMass;
+}
+
+bool FlightSimulator::IsOrbitClearOfAtmosphere( const FlightData& flightData ) const
+{
+    float atmosphereRadius = m_environment.params.Re + m_environment.GetAtmosphereHeight();
+    return flightData.E < 0 && flightData.a * (1 - flightData.e) >= atmosphereRadius;
+}
+
+//------------------------------------------------------------------------------------------------
+
+template<typename Scalar>
+typename FlightScalarTypes<Scalar>::Vector2 FlightSimulator::CalcAcceleration( const typename FlightScalarTypes<Scalar>::Vector2& position, const typename FlightScalarTypes<Scalar>::Vector2& surfVelocity,
+                                                                               const typename FlightScalarTypes<Scalar>::Vector2& heading, Scalar mass, Scalar thrustMul, uint32_t stage,
+                                                                               CurveCursors& cursors ) const
+{
+    const EnvironmentalData& env = m_environment.params;
+    const StageData& stageData = m_missionParams.stage[stage];
+
+    Scalar h = fmaxf( length( position ) - env.Re, 0 );
+    Scalar P = m_environment.GetStaticPressure( h, cursors );
+    Scalar T = m_environment.GetTemperature( h, cursors );
+
+    Scalar exhaustV = env.g0 * lerp( stageData.IspVac, stageData.IspSL, P / m_environment.GetSeaLevelPressure() );
+    Scalar thrust = thrustMul * stageData.massFlow * exhaustV;
+
+    Scalar M = length( surfVelocity ) / m_environment.GetSpeedOfSound( T );
+    Scalar Fdrag = m_environment.CalcQfromPressure( P, M ) * m_environment.GetCdA( stage, M, cursors );
+
+    typename FlightScalarTypes<Scalar>::Vector2 acceleration = -normalize( position ) * env.mu / dot( position, position );
+    acceleration += ((thrust - Fdrag) * heading) / mass;
+
+    return acceleration;
+}
+
+template<typename Integrator, typename Scalar>
+void FlightSimulator::StepFlight( const typename FlightScalarTypes<Scalar>::AscentParams& ascentParams, typename FlightScalarTypes<Scalar>::TelemetryData& telemetry,
+                                  typename FlightScalarTypes<Scalar>::FlightData& flightData, GuidanceSolve* solve, CurveCursors* cursors ) const
+{
+    typedef typename FlightScalarTypes<Scalar>::Vector2 Vector2;
+    typedef typename FlightScalarTypes<Scalar>::Vector3 Vector3;
+
+    const EnvironmentalData& env = m_environment.params;
+    const float timeStep = m_timeStep;
+
+    CurveCursors stepCursors;
+    CurveCursors& curveCursors = cursors ? *cursors : stepCursors;
+
+    telemetry.T.x = flightData.guidance[0].T - flightData.guidance[0].t;
+    telemetry.T.y = flightData.guidance[1].T - flightData.guidance[1].t;
+    telemetry.T.z = flightData.guidance[2].T - flightData.guidance[2].t;
+    telemetry.T.w = flightData.guidance[3].T - flightData.guidance[3].t;
+
+    Vector2 upVec = normalize( telemetry.eciPosition );
+    Scalar h = length( telemetry.eciPosition ) - env.Re;
+
+    // Crash = freeze telemetry
+    if ( h < 0 )
+    {
+        return;
+    }
+
+    const StageData& stageData = m_missionParams.stage[telemetry.stage];
+    uint32_t stage = telemetry.stage;
+
+    // environmental data
+    Scalar P = m_environment.GetStaticPressure( h, curveCursors );
+    Scalar T = m_environment.GetTemperature( h, curveCursors );
+
+    // calculate fuel burn time
+    Scalar mass = telemetry.mass;
+    Scalar fuelT = 0;
+    if ( flightData.flightPhase < c_PhaseMECO )
+    {
+        fuelT = fminf( (mass - stageData.dryMass) / (timeStep * stageData.massFlow), 1 ) * timeStep;
+    }
+
+    // calculate current thrust, F0
+    Scalar thrustMul = fuelT / timeStep;
+    Scalar exhaustV = env.g0 * lerp( stageData.IspVac, stageData.IspSL, P / m_environment.GetSeaLevelPressure() );
+    Scalar thrust = thrustMul * stageData.massFlow * exhaustV;
+
+    // reduce thrust by drag
+    Scalar M = length( telemetry.surfVelocity ) / m_environment.GetSpeedOfSound( T );
+    Scalar Q = m_environment.CalcQfromPressure( P, M );
+    Scalar Fdrag = Q * m_environment.GetCdA( stage, M, curveCursors );
+
+    Vector2 position = telemetry.eciPosition;
+
+    // Symplectic Euler integration; a0 = F0/m0, v1 = v0 + a0*dt, x1 = x0 + v1*dt
+    // acceleration
+    Vector2 acceleration = -normalize( position ) * env.mu / dot( position, position );
+
+    acceleration += ((thrust - Fdrag) * telemetry.heading) / mass;
+
+    // Higher order integrators add kicks part way through the step, with the mass burnt by then. Drifts are
+    // summed before adding to the position, a float position is only good to half a metre and rounding each
+    // of Yoshida's back and forth drifts into it drags slow flights down.
+    Vector2 kickAcceleration = acceleration;
+    Vector2 displacement( 0, 0 );
+    float stepFraction = 0;
+
+    for ( uint32_t i = 0; i < Integrator::c_StageCount; ++i )
+    {
+        const IntegratorStage& integratorStage = Integrator::c_Stages[i];
+
+        if ( i > 0 )
+            kickAcceleration = CalcAcceleration( position + displacement, telemetry.surfVelocity, telemetry.heading, mass - stageData.massFlow * fuelT * stepFraction, thrustMul, stage,
+                                                 curveCursors );
+
+        // velocity
+        telemetry.surfVelocity += kickAcceleration * (integratorStage.kick * timeStep);
+        telemetry.eciVelocity += kickAcceleration * (integratorStage.kick * timeStep);
+
+        displacement += telemetry.eciVelocity * (integratorStage.drift * timeStep);
+        stepFraction += integratorStage.drift;
+    }
+
+    // position
+    telemetry.eciPosition += displacement;
+
+    // Current osculating orbit
+    Scalar prevE = flightData.E;
+    Vector2 eccentricty;
+    m_environment.CalcOrbitParameters( telemetry.eciPosition, telemetry.eciVelocity, flightData.a, eccentricty, flightData.E );
+    flightData.e = length( eccentricty );
+
+    // steering
+    Vector2 aim;
+
+    if ( flightData.flightPhase == c_PhaseLiftoff )
+    {
+        // if below pitch over speed just aim straight up.
+        aim = upVec;
+        if ( length( telemetry.surfVelocity ) >= ascentParams.pitchOverSpeed )
+        {
+            flightData.flightPhase = c_PhasePitchOver;
+        }
+    }
+    else if ( flightData.flightPhase == c_PhasePitchOver )
+    {
+        aim.x = dot( upVec, Vector2( ascentParams.cosAimAngle, ascentParams.sinAimAngle ) );
+        aim.y = dot( upVec, Vector2( -ascentParams.sinAimAngle, ascentParams.cosAimAngle ) );
+
+        Vector2 prograde = normalize( telemetry.surfVelocity );
+        Scalar pitch = dot( prograde, upVec );
+        if ( pitch <= ascentParams.cosPitchOverAngle )
+        {
+            flightData.flightPhase = c_PhaseAeroFlight;
+        }
+    }
+    else if ( flightData.flightPhase < c_PhaseMECO && thrust > 0 )
+    {
+        Vector3 position3( telemetry.eciPosition.x, telemetry.eciPosition.y, 0 );
+        Vector3 velocity3( telemetry.eciVelocity.x, telemetry.eciVelocity.y, 0 );
+        Vector3 guidance;
+
+        if ( flightData.flightPhase == c_PhaseAeroFlight )
+        {
+            if ( Q <= flightData.maxQ * 0.2f )
+            {
+                // Update estimate for T.
+                flightData.guidance[stage].T = (mass - stageData.dryMass) / stageData.massFlow;
+
+                ConvergeGuidance( flightData.guidance, stage, position3, velocity3, exhaustV, thrust / mass, solve );
+
+                flightData.flightPhase = c_PhaseGuidanceReady;
+            }
+            guidance = Vector3( 0, 0, 0 );
+        }
+        else
+        {
+            // Guidance runs every second
+            if ( flightData.guidance[stage].t >= (1.0f - timeStep * 0.5f) && flightData.guidance[stage].T > 10 )
+            {
+                UpdateGuidance( flightData.guidance, stage, position3, velocity3, exhaustV, thrust / mass );
+            }
+
+            guidance = GetGuidanceAim( flightData.guidance[stage], position3, velocity3, thrust / mass );
+        }
+
+        // If guidance is valid then it is a unit vector
+        bool guidanceValid = dot( guidance, guidance ) > 0.9f;
+
+        if ( guidanceValid )
+            telemetry.guidancePitch = c_Pi - acosf( dot( upVec, xy( guidance ) ) );
+
+        // If we don't have valid guidance then fall back to open loop
+        if ( flightData.flightPhase < c_PhaseGuidanceActive || !guidanceValid )
+        {
+            aim = normalize( telemetry.surfVelocity );
+
+            // Make sure dynamic pressure is low enough to start manoeuvres
+            if ( guidanceValid && Q <= flightData.maxQ * 0.05f )
+            {
+                // Check guidance pitch, when guidance is saying pitch down relative to open loop, engage guidance.
+                // Alternatively, if Q is at 1% of maxQ, engage guidance.
+                if ( dot( upVec, xy( guidance ) ) <= dot( upVec, aim ) || (stage > 0 && Q <= flightData.maxQ * 0.01f) )
+                {
+                    flightData.flightPhase = c_PhaseGuidanceActive;
+                    aim = xy( guidance );
+                }
+            }
+        }
+        else
+        {
+            aim = xy( guidance );
+
+            // Have we reached final orbital energy, or likely to reach it within half the next time step?
+            Scalar deltaE = flightData.E - prevE;
+            if ( flightData.E >= m_missionParams.finalOrbitalEnergy ||
+                 (flightData.E + deltaE * 0.5f) >= m_missionParams.finalOrbitalEnergy )
+            {
+                flightData.flightPhase = c_PhaseMECO;
+            }
+        }
+    }
+    else
+    {
+        aim = telemetry.heading;
+    }
+
+    // steer to aim (a bit rough but eh).
+    Scalar steerAngle = acosf( dot( aim, telemetry.heading ) );
+    Scalar rotRate = fmaxf( stageData.rotationRate, 0.001f ) * timeStep * sqrtf( m_missionParams.stage[0].wetMass / mass );
+    telemetry.heading = normalize( lerp( telemetry.heading, aim, rotRate / fmaxf( steerAngle, rotRate ) ) );
+
+    // mass and staging
+    telemetry.mass -= stageData.massFlow * fuelT;
+    flightData.stageBurnTime[stage] += (fuelT > 0) * timeStep;
+
+    if ( telemetry.mass <= stageData.dryMass )
+    {
+        uint32_t nextStage = stage + 1;
+        if ( nextStage < m_missionParams.stageCount )
+        {
+            telemetry.stage = nextStage;
+            telemetry.mass = m_missionParams.stage[nextStage].wetMass;
+        }
+    }
+
+    telemetry.flightPhase = flightData.flightPhase;
+
+    // Update flight data
+    flightData.maxAltitude = fmaxf( flightData.maxAltitude, h );
+    flightData.maxSurfSpeed = fmaxf( flightData.maxSurfSpeed, length( telemetry.surfVelocity ) );
+    flightData.maxEciSpeed = fmaxf( flightData.maxEciSpeed, length( telemetry.eciVelocity ) );
+    flightData.maxQ = fmaxf( flightData.maxQ, Q );
+    flightData.minMass = fminf( flightData.minMass, telemetry.mass );
+    flightData.maxAccel = fmaxf( flightData.maxAccel, length( acceleration ) );
+    flightData.stage = telemetry.stage;
+}
+
+//------------------------------------------------------------------------------------------------
+
+template void FlightSimulator::InitFlight<float>( const AscentParams& ascentParams, TelemetryData& telemetry, FlightData& flightData ) const;
+template bool FlightSimulator::IsFlightCrashed<float>( const TelemetryData& telemetry ) const;
+template bool FlightSimulator::IsFlightTerminal<float>( const TelemetryData& telemetry, const FlightData& flightData ) const;
+
+template void FlightSimulator::StepFlight<SymplecticEuler, float>( const AscentParams& ascentParams, TelemetryData& telemetry, FlightData& flightData, GuidanceSolve* solve, CurveCursors* cursors ) const;
+template void FlightSimulator::StepFlight<VelocityVerlet, float>( const AscentParams& ascentParams, TelemetryData& telemetry, FlightData& flightData, GuidanceSolve* solve, CurveCursors* cursors ) const;
+template void FlightSimulator::StepFlight<Yoshida4, float>( const AscentParams& ascentParams, TelemetryData& telemetry, FlightData& flightData, GuidanceSolve* solve, CurveCursors* cursors ) const;
+
+typedef FlightScalarTypes<AscentDual> DualTypes;
+
+template void FlightSimulator::InitFlight<AscentDual>( const DualTypes::AscentParams& ascentParams, DualTypes::TelemetryData& telemetry, DualTypes::FlightData& flightData ) const;
+template bool FlightSimulator::IsFlightCrashed<AscentDual>( const DualTypes::TelemetryData& telemetry ) const;
+template bool FlightSimulator::IsFlightTerminal<AscentDual>( const DualTypes::TelemetryData& telemetry, const DualTypes::FlightData& flightData ) const;
+
+template void FlightSimulator::StepFlight<SymplecticEuler, AscentDual>( const DualTypes::AscentParams& ascentParams, DualTypes::TelemetryData& telemetry, DualTypes::FlightData& flightData,
+                                                                        GuidanceSolve* solve, CurveCursors* cursors ) const;
+template void FlightSimulator::StepFlight<VelocityVerlet, AscentDual>( const DualTypes::AscentParams& ascentParams, DualTypes::TelemetryData& telemetry, DualTypes::FlightData& flightData,
+                                                                       GuidanceSolve* solve, CurveCursors* cursors ) const;
+template void FlightSimulator::StepFlight<Yoshida4, AscentDual>( const DualTypes::AscentParams& ascentParams, DualTypes::TelemetryData& telemetry, DualTypes::FlightData& flightData,
+                                                                 GuidanceSolve* solve, CurveCursors* cursors ) const;
+
+template DualTypes::Vector3 FlightSimulator::CalcGuidanceAim<AscentDual>( const DualTypes::GuidanceData& G, const DualTypes::Vector3& position, const DualTypes::Vector3& velocity,
+                                                                          AscentDual accel ) const;
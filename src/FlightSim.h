@@ -0,0 +1,279 @@
+#pragma once
+
+#include "Dual.h"
+#include "FlightEnvironment.h"
+
+//------------------------------------------------------------------------------------------------
+// Fixed step integrators for StepFlight, as a sequence of kick and drift stages. Each stage kicks the
+// velocity by kick * dt of the acceleration where the flight is, then drifts the position by drift * dt
+// of the new velocity. Thrust, drag and mass are re-evaluated for every kick after the first, heading
+// and the steering decisions stay per step.
+
+struct IntegratorStage
+{
+    float   kick;
+    float   drift;
+};
+
+// First order, the GPU's integrator.
+struct SymplecticEuler
+{
+    static const uint32_t           c_StageCount = 1;
+    static const IntegratorStage    c_Stages[c_StageCount];
+};
+
+// Second order, kick-drift-kick.
+struct VelocityVerlet
+{
+    static const uint32_t           c_StageCount = 2;
+    static const IntegratorStage    c_Stages[c_StageCount];
+};
+
+// Fourth order, Yoshida's composition of three Verlet steps.
+struct Yoshida4
+{
+    static const uint32_t           c_StageCount = 4;
+    static const IntegratorStage    c_Stages[c_StageCount];
+};
+
+enum class FlightIntegrator : uint32_t
+{
+    Euler,      // StepFlight<SymplecticEuler>
+    Verlet,     // StepFlight<VelocityVerlet>
+    Yoshida4,   // StepFlight<Yoshida4>
+    Dopri5,     // Adaptive Dormand-Prince 5(4), AdaptiveFlightSimulator
+};
+
+const char* GetFlightIntegratorName( FlightIntegrator integrator );
+bool        ParseFlightIntegrator( const char* name, FlightIntegrator& integrator );
+
+//------------------------------------------------------------------------------------------------
+// A flight's first guidance solve, made as it enters c_PhaseGuidanceReady. ConvergeGuidance starts from the
+// seed's solution rather than the cold InitFlight constants if it has one, which neighbouring profiles
+// converge to closely, and records its own solution here for later solves to start from.
+
+struct GuidanceSolve
+{
+    const GuidanceSolve*        seed;           // Converged solve to start from, null for a cold start
+    ShaderShared::GuidanceData  guidance[4];    // As converged
+    uint32_t                    stage;          // Stage solved in, earlier stages are unused
+    uint32_t                    iterations;     // Update passes to converge, 0 until then
+};
+
+//------------------------------------------------------------------------------------------------
+// The state StepFlight and the guidance are written over, by scalar type. Flights are float, the GPU's
+// types, or AscentDual to differentiate them with respect to their pitch over speed and angle (see
+// FlightGradient.h), with the same structs over Duals.
+
+// Derivatives with respect to pitch over speed (m/s) and pitch over angle (radians), in that order.
+typedef Dual<2>     AscentDual;
+
+template<uint32_t N>
+struct DualAscentParams
+{
+    Dual<N>     pitchOverSpeed;
+    Dual<N>     sinPitchOverAngle;
+    Dual<N>     cosPitchOverAngle;
+    Dual<N>     sinAimAngle;
+    Dual<N>     cosAimAngle;
+};
+
+template<uint32_t N>
+struct DualGuidanceData
+{
+    Dual<N>     A;
+    Dual<N>     B;
+    Dual<N>     T;
+    Dual<N>     t;
+    Dual<N>     omegaT;
+
+    DualGuidanceData() {}
+    DualGuidanceData( const ShaderShared::GuidanceData& G ) : A( G.A ), B( G.B ), T( G.T ), t( G.t ), omegaT( G.omegaT ) {}
+};
+
+template<uint32_t N>
+struct DualReferenceFrame
+{
+    Dual<N>     r;
+    Dual<N>     rv;
+    Dual<N>     h;
+    Dual<N>     omega;
+
+    DualReferenceFrame() {}
+    DualReferenceFrame( const ShaderShared::ReferenceFrame& rf ) : r( rf.r ), rv( rf.rv ), h( rf.h ), omega( rf.omega ) {}
+};
+
+template<uint32_t N>
+struct DualTelemetryData
+{
+    Dual2<N>    eciPosition;
+    Dual2<N>    eciVelocity;
+    Dual2<N>    surfVelocity;
+    Dual2<N>    heading;
+    uint32_t    stage;
+    Dual<N>     mass;
+    uint32_t    flightPhase;
+    Dual<N>     guidancePitch;
+    Dual4<N>    T;
+};
+
+template<uint32_t N>
+struct DualFlightData
+{
+    Dual<N>     maxAltitude;
+    Dual<N>     maxSurfSpeed;
+    Dual<N>     maxEciSpeed;
+    Dual<N>     maxQ;
+    Dual<N>     minMass;
+    Dual<N>     maxAccel;
+    uint32_t    flightPhase;
+    uint32_t    stage;
+    Dual<N>     stageBurnTime[4];
+
+    Dual<N>     a;
+    Dual<N>     e;
+    Dual<N>     E;
+
+    DualGuidanceData<N>     guidance[4];
+};
+
+template<typename Scalar>
+struct FlightScalarTypes;
+
+template<>
+struct FlightScalarTypes<float>
+{
+    typedef ShaderShared::float2            Vector2;
+    typedef ShaderShared::float3            Vector3;
+    typedef ShaderShared::AscentParams      AscentParams;
+    typedef ShaderShared::GuidanceData      GuidanceData;
+    typedef ShaderShared::ReferenceFrame    ReferenceFrame;
+    typedef ShaderShared::TelemetryData     TelemetryData;
+    typedef ShaderShared::FlightData        FlightData;
+};
+
+template<uint32_t N>
+struct FlightScalarTypes<Dual<N>>
+{
+    typedef Dual2<N>                Vector2;
+    typedef Dual3<N>                Vector3;
+    typedef DualAscentParams<N>     AscentParams;
+    typedef DualGuidanceData<N>     GuidanceData;
+    typedef DualReferenceFrame<N>   ReferenceFrame;
+    typedef DualTelemetryData<N>    TelemetryData;
+    typedef DualFlightData<N>       FlightData;
+};
+
+//------------------------------------------------------------------------------------------------
+// CPU port of simulate_flight_cs.hlsl. One call to StepFlight is one thread of one dispatch.
+
+class FlightSimulator
+{
+public:
+    FlightSimulator( const FlightEnvironment& environment, const ShaderShared::MissionParams& missionParams, float timeStep ) :
+        m_environment( environment ),
+        m_missionParams( missionParams ),
+        m_timeStep( timeStep )
+    {
+    }
+
+    // Sets up the pad state, equivalent to the first dispatch of a sweep.
+    template<typename Scalar = float>
+    void    InitFlight( const typename FlightScalarTypes<Scalar>::AscentParams& ascentParams, typename FlightScalarTypes<Scalar>::TelemetryData& telemetry,
+                        typename FlightScalarTypes<Scalar>::FlightData& flightData ) const;
+
+    // Advances one simulation step. Instantiated for the integrators above, over float and AscentDual.
+    // solve, if not null, seeds and records the guidance solve should the flight converge guidance this step.
+    // cursors, if not null, are the flight's curve cursors carried from its last step, otherwise curves are
+    // looked up afresh.
+    template<typename Integrator = SymplecticEuler, typename Scalar = float>
+    void    StepFlight( const typename FlightScalarTypes<Scalar>::AscentParams& ascentParams, typename FlightScalarTypes<Scalar>::TelemetryData& telemetry,
+                        typename FlightScalarTypes<Scalar>::FlightData& flightData, GuidanceSolve* solve = nullptr, CurveCursors* cursors = nullptr ) const;
+
+    // A crashed flight is frozen by StepFlight, so its state is final.
+    template<typename Scalar = float>
+    bool    IsFlightCrashed( const typename FlightScalarTypes<Scalar>::TelemetryData& telemetry ) const;
+
+    // Crashed, MECO, or the last stage has burnt out. Past here the flight only coasts, so a sweep can
+    // stop stepping it and keep the state it has.
+    template<typename Scalar = float>
+    bool    IsFlightTerminal( const typename FlightScalarTypes<Scalar>::TelemetryData& telemetry, const typename FlightScalarTypes<Scalar>::FlightData& flightData ) const;
+
+    // Bound orbit with its periapsis above the atmosphere, nothing but gravity acts on it when coasting.
+    bool    IsOrbitClearOfAtmosphere( const ShaderShared::FlightData& flightData ) const;
+
+    // Guidance solves for one lane of the SIMD batch kernel (see FlightBatch.h), which vectorises the
+    // rest of StepFlight. Plain floats in and out so the kernels share no inline code with this file.
+    void    ConvergeLaneGuidance( ShaderShared::GuidanceData* guidance, uint32_t stage, float mass, float posX, float posY, float velX, float velY, float exhaustV, float accel,
+                                  GuidanceSolve* solve ) const;
+    void    UpdateLaneGuidance( ShaderShared::GuidanceData* guidance, uint32_t stage, float posX, float posY, float velX, float velY, float exhaustV, float accel ) const;
+
+    // Steering vector from the guidance constants at G.t, zero if guidance has no solution.
+    template<typename Scalar>
+    typename FlightScalarTypes<Scalar>::Vector3     CalcGuidanceAim( const typename FlightScalarTypes<Scalar>::GuidanceData& G, const typename FlightScalarTypes<Scalar>::Vector3& position,
+                                                                     const typename FlightScalarTypes<Scalar>::Vector3& velocity, Scalar accel ) const;
+
+    float   GetTimeStep() const { return m_timeStep; }
+
+    const FlightEnvironment&            GetEnvironment() const { return m_environment; }
+    const ShaderShared::MissionParams&  GetMissionParams() const { return m_missionParams; }
+
+private:
+    template<typename Scalar>
+    struct FlightIntegrals
+    {
+        Scalar  b0;     // delta v
+        Scalar  b1;     // first moment of b0
+        Scalar  c0;     // ideal distance travelled
+        Scalar  c1;     // first moment of c0
+    };
+
+    template<typename Scalar>
+    struct HeadingDerivatives
+    {
+        Scalar  r;          // radial heading
+        Scalar  rT;         // radial heading at T
+        Scalar  dr;         // first derivative of radial heading
+
+        Scalar  h;          // crosstrack heading
+        Scalar  hT;         // crosstrack heading at T
+        Scalar  dh;         // first derivative of crosstrack heading
+
+        Scalar  theta;      // downtrack heading
+        Scalar  dtheta;     // first derivative of downtrack heading
+        Scalar  ddtheta;    // second derivative of downtrack heading
+    };
+
+    template<typename Scalar>
+    FlightIntegrals<Scalar>     CalcFlightIntegrals( Scalar exhaustV, Scalar tau, Scalar T ) const;
+    template<typename Scalar>
+    HeadingDerivatives<Scalar>  CalcHeadingDerivatives( const typename FlightScalarTypes<Scalar>::GuidanceData& G, const typename FlightScalarTypes<Scalar>::ReferenceFrame& rf,
+                                                        const typename FlightScalarTypes<Scalar>::ReferenceFrame& S, Scalar accel, Scalar accelT ) const;
+
+    template<typename Scalar>
+    void    UpdateGuidanceFinalStage( typename FlightScalarTypes<Scalar>::GuidanceData& G, const typename FlightScalarTypes<Scalar>::ReferenceFrame& rf, Scalar exhaustV, Scalar accel ) const;
+    template<typename Scalar>
+    void    UpdateGuidanceInterStage( typename FlightScalarTypes<Scalar>::GuidanceData& G, typename FlightScalarTypes<Scalar>::GuidanceData& G2, typename FlightScalarTypes<Scalar>::ReferenceFrame& rf,
+                                      typename FlightScalarTypes<Scalar>::Vector2 exhaustV, typename FlightScalarTypes<Scalar>::Vector2 accel ) const;
+
+    template<typename Scalar>
+    void    UpdateGuidance( typename FlightScalarTypes<Scalar>::GuidanceData* guidance, uint32_t stage, const typename FlightScalarTypes<Scalar>::Vector3& position,
+                            const typename FlightScalarTypes<Scalar>::Vector3& velocity, Scalar exhaustV, Scalar accel ) const;
+    template<typename Scalar>
+    void    ConvergeGuidance( typename FlightScalarTypes<Scalar>::GuidanceData* guidance, uint32_t stage, const typename FlightScalarTypes<Scalar>::Vector3& position,
+                              const typename FlightScalarTypes<Scalar>::Vector3& velocity, Scalar exhaustV, Scalar accel, GuidanceSolve* solve ) const;
+
+    template<typename Scalar>
+    typename FlightScalarTypes<Scalar>::Vector3     GetGuidanceAim( typename FlightScalarTypes<Scalar>::GuidanceData& G, const typename FlightScalarTypes<Scalar>::Vector3& position,
+                                                                    const typename FlightScalarTypes<Scalar>::Vector3& velocity, Scalar accel ) const;
+
+    // Gravity plus thrust less drag along the heading, for the kicks after the first in a step.
+    template<typename Scalar>
+    typename FlightScalarTypes<Scalar>::Vector2     CalcAcceleration( const typename FlightScalarTypes<Scalar>::Vector2& position, const typename FlightScalarTypes<Scalar>::Vector2& surfVelocity,
+                                                                      const typename FlightScalarTypes<Scalar>::Vector2& heading, Scalar mass, Scalar thrustMul, uint32_t stage,
+                                                                      CurveCursors& cursors ) const;
+
+    const FlightEnvironment&            m_environment;
+    const ShaderShared::MissionParams&  m_missionParams;
+    float                               m_timeStep;
+};
@@ -0,0 +1,161 @@
+#include "FlightTelemetry.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+
+using namespace ShaderShared;
+
+static constexpr float c_Pi = 3.14159265f;
+static constexpr float c_TwoPi = 2 * c_Pi;
+
+static const uint32_t   c_HeadingBits = 14;
+static const uint32_t   c_PitchBits = 13;
+static const float      c_MaxPitch = 4.0f;  // Past pi, the no guidance pitch InitFlight sets
+
+//------------------------------------------------------------------------------------------------
+
+CompactTelemetry EncodeTelemetry( const TelemetryData& telemetry )
+{
+    const uint32_t headingSteps = 1u << c_HeadingBits;
+    const uint32_t pitchSteps = (1u << c_PitchBits) - 1;
+
+    // Heading wraps, the angle is taken mod 2 pi.
+    float angle = atan2f( telemetry.heading.y, telemetry.heading.x );
+    uint32_t heading = uint32_t( int32_t( lrintf( angle * (headingSteps / c_TwoPi) ) ) ) & (headingSteps - 1);
+
+    float pitch = fminf( fmaxf( telemetry.guidancePitch, 0.0f ), c_MaxPitch );
+    uint32_t guidancePitch = uint32_t( lrintf( pitch * (pitchSteps / c_MaxPitch) ) );
+
+    CompactTelemetry sample;
+    sample.eciPosition = telemetry.eciPosition;
+    sample.eciVelocity = telemetry.eciVelocity;
+    sample.mass = telemetry.mass;
+    sample.headingStage = uint16_t( heading | (telemetry.stage << c_HeadingBits) );
+    sample.guidancePitchPhase = uint16_t( guidancePitch | (telemetry.flightPhase << c_PitchBits) );
+
+    return sample;
+}
+
+TelemetryData DecodeTelemetry( const CompactTelemetry& sample, const float2& frameVelocity )
+{
+    const uint32_t headingSteps = 1u << c_HeadingBits;
+    const uint32_t pitchSteps = (1u << c_PitchBits) - 1;
+
+    float angle = float( sample.headingStage & (headingSteps - 1) ) * (c_TwoPi / headingSteps);
+
+    TelemetryData telemetry = {};
+    telemetry.eciPosition = sample.eciPosition;
+    telemetry.eciVelocity = sample.eciVelocity;
+    telemetry.surfVelocity = sample.eciVelocity - frameVelocity;
+    telemetry.heading = float2( cosf( angle ), sinf( angle ) );
+    telemetry.stage = sample.headingStage >> c_HeadingBits;
+    telemetry.mass = sample.mass;
+    telemetry.flightPhase = sample.guidancePitchPhase >> c_PitchBits;
+    telemetry.guidancePitch = float( sample.guidancePitchPhase & pitchSteps ) * (c_MaxPitch / pitchSteps);
+    telemetry.T = float4( 0, 0, 0, 0 );
+
+    return telemetry;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static const char* const c_TelemetryChannelNames[] = { "altitude", "surfaceSpeed", "eciSpeed", "Q", "mass", "pitch", "aoa", "guidancePitch" };
+
+const char* GetTelemetryChannelName( TelemetryChannel channel )
+{
+    return c_TelemetryChannelNames[uint32_t( channel )];
+}
+
+void CalcTelemetryChannels( const TelemetryData& telemetry, const FlightEnvironment& environment, float* values )
+{
+    float h = length( telemetry.eciPosition ) - environment.params.Re;
+    float surfSpeed = length( telemetry.surfVelocity );
+
+    // On the ground there's no airflow to speak of.
+    float P = environment.GetStaticPressure( fmaxf( h, 0 ) );
+    float T = environment.GetTemperature( fmaxf( h, 0 ) );
+    float M = h < 0 ? 0 : surfSpeed / environment.GetSpeedOfSound( T );
+
+    float2 up = normalize( telemetry.eciPosition );
+    float aoaCos = surfSpeed > 0 ? dot( telemetry.surfVelocity / surfSpeed, telemetry.heading ) : 1;
+
+    values[uint32_t( TelemetryChannel::Altitude )] = h;
+    values[uint32_t( TelemetryChannel::SurfaceSpeed )] = surfSpeed;
+    values[uint32_t( TelemetryChannel::EciSpeed )] = length( telemetry.eciVelocity );
+    values[uint32_t( TelemetryChannel::Q )] = environment.CalcQfromPressure( P, M );
+    values[uint32_t( TelemetryChannel::Mass )] = telemetry.mass;
+    values[uint32_t( TelemetryChannel::Pitch )] = c_Pi - acosf( fminf( fmaxf( dot( telemetry.heading, up ), -1.0f ), 1.0f ) );
+    values[uint32_t( TelemetryChannel::AoA )] = acosf( fminf( aoaCos, 1.0f ) );
+    values[uint32_t( TelemetryChannel::GuidancePitch )] = telemetry.guidancePitch;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void TelemetryPyramid::Append( const TelemetryData& telemetry )
+{
+    float values[c_TelemetryChannelCount];
+    CalcTelemetryChannels( telemetry, m_environment, values );
+
+    ++m_sampleCount;
+
+    for ( uint32_t channel = 0; channel < c_TelemetryChannelCount; ++channel )
+    {
+        std::vector<std::vector<float2>>& levels = m_levels[channel];
+
+        if ( levels.empty() )
+            levels.emplace_back();
+
+        levels[0].emplace_back( values[channel], values[channel] );
+
+        // Every pair completed climbs a level.
+        for ( uint32_t level = 0; (levels[level].size() & 1) == 0; ++level )
+        {
+            const float2& a = levels[level][levels[level].size() - 2];
+            const float2& b = levels[level].back();
+            float2 node( fminf( a.x, b.x ), fmaxf( a.y, b.y ) );
+
+            if ( level + 1 == levels.size() )
+                levels.emplace_back();
+
+            levels[level + 1].push_back( node );
+        }
+    }
+}
+
+float2 TelemetryPyramid::GetRange( TelemetryChannel channel, uint32_t begin, uint32_t end ) const
+{
+    const std::vector<std::vector<float2>>& levels = m_levels[uint32_t( channel )];
+    float2 range( FLT_MAX, -FLT_MAX );
+
+    // Odd ends are the nodes whose parent would spill past the range, the rest pair up a level above.
+    end = std::min( end, m_sampleCount );
+    for ( uint32_t level = 0; begin < end; ++level, begin >>= 1, end >>= 1 )
+    {
+        if ( begin & 1 )
+        {
+            const float2& node = levels[level][begin++];
+            range = float2( fminf( range.x, node.x ), fmaxf( range.y, node.y ) );
+        }
+
+        if ( end & 1 )
+        {
+            const float2& node = levels[level][--end];
+            range = float2( fminf( range.x, node.x ), fmaxf( range.y, node.y ) );
+        }
+    }
+
+    return range;
+}
+
+void TelemetryPyramid::GetEnvelope( TelemetryChannel channel, uint32_t bucketCount, float2* envelope ) const
+{
+    for ( uint32_t bucket = 0; bucket < bucketCount; ++bucket )
+    {
+        uint32_t begin = uint32_t( uint64_t( bucket ) * m_sampleCount / bucketCount );
+        uint32_t end = uint32_t( uint64_t( bucket + 1 ) * m_sampleCount / bucketCount );
+
+        envelope[bucket] = GetRange( channel, std::min( begin, m_sampleCount - 1 ), std::max( end, begin + 1 ) );
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "FlightEnvironment.h"
+
+//------------------------------------------------------------------------------------------------
+// Telemetry sample as the CPU sweep stores it, 24 bytes to TelemetryData's 64, which at 6000 samples
+// for each of 512 profiles is 74 MB rather than 196 MB.
+//
+// Position, velocity and mass stay full floats, everything the graphs and export derive from them
+// needs them. Surface velocity differs from the ECI one by the pad's rotation, a constant of the
+// flight, so it isn't stored. Heading is an angle in 14 bits with the stage above it, guidance pitch
+// 13 bits over [0, 4] with the flight phase above it, both to better than 0.03 degrees. The remaining
+// burn times aren't kept, nothing reads them back from a sample.
+
+struct CompactTelemetry
+{
+    ShaderShared::float2    eciPosition;
+    ShaderShared::float2    eciVelocity;
+    float                   mass;
+    uint16_t                headingStage;
+    uint16_t                guidancePitchPhase;
+};
+
+CompactTelemetry            EncodeTelemetry( const ShaderShared::TelemetryData& telemetry );
+
+// frameVelocity is the flight's ECI less surface velocity, as on the pad. T decodes as zero.
+ShaderShared::TelemetryData DecodeTelemetry( const CompactTelemetry& sample, const ShaderShared::float2& frameVelocity );
+
+//------------------------------------------------------------------------------------------------
+// Values the graphs plot from a sample, in SI units and radians. Pitch is from the horizon as in
+// graph_pitch_vtx.hlsl and Q is dynamic pressure as in graph_Q_vtx.hlsl. Guidance pitch is 4 until
+// guidance has a solution.
+
+enum class TelemetryChannel : uint32_t
+{
+    Altitude,
+    SurfaceSpeed,
+    EciSpeed,
+    Q,
+    Mass,
+    Pitch,
+    AoA,
+    GuidancePitch,
+    Count,
+};
+
+static const uint32_t   c_TelemetryChannelCount = uint32_t( TelemetryChannel::Count );
+
+const char* GetTelemetryChannelName( TelemetryChannel channel );
+void        CalcTelemetryChannels( const ShaderShared::TelemetryData& telemetry, const FlightEnvironment& environment, float* values );
+
+//------------------------------------------------------------------------------------------------
+// Min/max mip pyramid of one flight's telemetry channels. Level 0 is the samples and each node above is
+// the min and max of the two below it, added as soon as both are, so the pyramid grows with Append as
+// samples are written. GetRange finds the exact min and max over any run of samples in O(log samples)
+// reads, so a graph or export can take the envelope of a flight at any resolution without touching
+// every sample, and without the aliasing of interpolating two samples per point, which misses spikes
+// like max Q at low zoom.
+
+class TelemetryPyramid
+{
+public:
+    explicit TelemetryPyramid( const FlightEnvironment& environment ) :
+        m_environment( environment ),
+        m_sampleCount( 0 )
+    {
+    }
+
+    void        Append( const ShaderShared::TelemetryData& telemetry );
+
+    uint32_t    GetSampleCount() const { return m_sampleCount; }
+    uint32_t    GetLevelCount() const { return static_cast<uint32_t>(m_levels[0].size()); }
+
+    // Min and max of samples [begin, end) in x and y, FLT_MAX and -FLT_MAX if the range is empty.
+    ShaderShared::float2    GetRange( TelemetryChannel channel, uint32_t begin, uint32_t end ) const;
+
+    // Envelope of bucketCount even splits of the samples, each bucket at least one sample wide.
+    void        GetEnvelope( TelemetryChannel channel, uint32_t bucketCount, ShaderShared::float2* envelope ) const;
+
+private:
+    const FlightEnvironment&    m_environment;
+    uint32_t                    m_sampleCount;
+
+    // Per channel, per level, (min, max) of each node.
+    std::vector<std::vector<ShaderShared::float2>>  m_levels[c_TelemetryChannelCount];
+};
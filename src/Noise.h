@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+
+//------------------------------------------------------------------------------------------------
+// Noise functions. Stateless hashes of a position and seed, so any thread can draw sample n of a
+// sequence without sharing generator state.
+
+// Some large interesting (i.e. with well spread bit patterns) primes for noise generation.
+// Several orders of magnitude difference
+const int neNoisePrime6SF = 769729;
+const int neNoisePrime7SF = 6542989;
+const int neNoisePrime8SF = 38370263;
+const int neNoisePrime9SF = 198491317;
+
+inline uint32_t NoiseMake2dKey(const uint32_t key1, const uint32_t key2)
+{
+    constexpr uint32_t PRIME1 = neNoisePrime9SF;  // Large interesting prime
+    return key1 + (key2 * PRIME1);
+}
+
+inline uint32_t NoiseMake3dKey(const uint32_t key1, const uint32_t key2, const uint32_t key3)
+{
+    constexpr uint32_t PRIME1 = neNoisePrime9SF;    // Large interesting prime
+    constexpr uint32_t PRIME2 = neNoisePrime7SF;    // Another large interesting prime (order of mag different)
+    return key1 + (key2 * PRIME1) + (key3 * PRIME2);
+}
+
+inline uint32_t NoiseMake4dKey(const uint32_t key1, const uint32_t key2, const uint32_t key3, const uint32_t key4)
+{
+    constexpr uint32_t PRIME1 = neNoisePrime9SF;    // Large interesting prime
+    constexpr uint32_t PRIME2 = neNoisePrime7SF;    // Another large interesting prime (order of mag different)
+    constexpr uint32_t PRIME3 = neNoisePrime8SF;    // Another large interesting prime (order of mag different)
+    return key1 + (key2 * PRIME1) + (key3 * PRIME2) + (key4 * PRIME3);
+}
+
+// [0, UINT_MAX]
+inline uint32_t Noise1dUnsigned(const uint32_t position, const uint32_t seed)
+{
+    constexpr uint32_t BIT_NOISE1 = 0xb5297a4d;
+    constexpr uint32_t BIT_NOISE2 = 0x68e31da4;
+    constexpr uint32_t BIT_NOISE3 = 0x1b56c4e9;
+
+    uint32_t noise = position;
+    noise *= BIT_NOISE1;
+    noise += seed;
+    noise ^= (noise >> 8);
+    noise += BIT_NOISE2;
+    noise ^= (noise << 8);
+    noise *= BIT_NOISE3;
+    noise ^= (noise >> 8);
+    return noise;
+}
+
+// [INT_MIN, INT_MAX]
+inline int32_t Noise1dSigned(const uint32_t position, const uint32_t seed)
+{
+    return static_cast<int32_t>(Noise1dUnsigned(position, seed));
+}
+
+// [0, 1.0f]
+inline float Noise1dUnsignedF(const uint32_t position, const uint32_t seed)
+{
+    return static_cast<float>(Noise1dUnsigned(position, seed)) / 4294967295.0f;
+}
+
+// [-1.0f, 1.0f]
+inline float Noise1dSignedF(const uint32_t position, const uint32_t seed)
+{
+    return static_cast<float>(Noise1dSigned(position, seed)) / 2147483647.0f;
+}
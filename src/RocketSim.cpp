@@ -3,6 +3,8 @@
 
 #include "stdafx.h"
 #include "RocketSim.h"
+#include "FlightEnvironment.h"
+#include "FlightAnalysis.h"
 
 #define MAX_LOADSTRING 100
 
@@ -973,31 +975,7 @@ void RocketSim::ReloadAscentParams( TrackedFile& trackedFile )
         float minAngle = ascentJson.value( "minAngle", 1.0f );
         float maxAngle = ascentJson.value( "maxAngle", 5.0f );
 
-        float speedStep = (maxSpeed - minSpeed) / float( m_ascentParams.size() - 1 );
-        float angleStep = (maxAngle - minAngle) / float( m_ascentParams[0].size() - 1 );
-
-        for ( uint32_t angle = 0; angle < m_ascentParams[0].size(); ++angle )
-        {
-            float a = (minAngle + angle * angleStep) * c_DegreeToRad;
-            m_ascentParams[0][angle].pitchOverSpeed = minSpeed;
-            m_ascentParams[0][angle].sinPitchOverAngle = sin( a );
-            m_ascentParams[0][angle].cosPitchOverAngle = cos( a );
-            m_ascentParams[0][angle].sinAimAngle = sin( a + c_DegreeToRad );
-            m_ascentParams[0][angle].cosAimAngle = cos( a + c_DegreeToRad );
-        }
-
-        for ( uint32_t speed = 1; speed < m_ascentParams.size(); ++speed )
-        {
-            float pitchOverSpeed = minSpeed + speed * speedStep;
-            for ( uint32_t angle = 0; angle < m_ascentParams[0].size(); ++angle )
-            {
-                m_ascentParams[speed][angle].pitchOverSpeed = pitchOverSpeed;
-                m_ascentParams[speed][angle].sinPitchOverAngle = m_ascentParams[speed - 1][angle].sinPitchOverAngle;
-                m_ascentParams[speed][angle].cosPitchOverAngle = m_ascentParams[speed - 1][angle].cosPitchOverAngle;
-                m_ascentParams[speed][angle].sinAimAngle = m_ascentParams[speed - 1][angle].sinAimAngle;
-                m_ascentParams[speed][angle].cosAimAngle = m_ascentParams[speed - 1][angle].cosAimAngle;
-            }
-        }
+        GenerateAscentParams( minSpeed, maxSpeed, minAngle * c_DegreeToRad, maxAngle * c_DegreeToRad, static_cast<uint32_t>(m_ascentParams.size()), static_cast<uint32_t>(m_ascentParams[0].size()), &m_ascentParams[0][0] );
 
         ResourceData* resourceData = static_cast<ResourceData*>(trackedFile.userData);
         CreateStructuredBuffer( trackedFile.filename, resourceData->resource, resourceData->desc, m_ascentParams.data(),
@@ -1026,51 +1004,7 @@ void RocketSim::ReloadMissionParams( TrackedFile& trackedFile )
     {
         nlohmann::json missionParamsJson = LoadJsonFile( trackedFile.filename );
 
-        memset( &m_missionParams, 0, sizeof( m_missionParams ) );
-
-        m_missionParams.stageCount = 0;
-        for ( const nlohmann::json& stageJson : missionParamsJson["stages"] )
-        {
-            m_missionParams.stage[m_missionParams.stageCount].wetMass = stageJson.value( "wetmass", 0.0f );
-            m_missionParams.stage[m_missionParams.stageCount].dryMass = stageJson.value( "drymass", 0.0f );
-            m_missionParams.stage[m_missionParams.stageCount].IspSL = stageJson.value( "IspSL", 0.0f );
-            m_missionParams.stage[m_missionParams.stageCount].IspVac = stageJson.value( "IspVac", 0.0f );
-            m_missionParams.stage[m_missionParams.stageCount].rotationRate = c_DegreeToRad;
-
-            float fuelMass = stageJson.value( "fuelmass", 0.0f );
-            if ( fuelMass > 0.0f )
-                m_missionParams.stage[m_missionParams.stageCount].dryMass = m_missionParams.stage[m_missionParams.stageCount].wetMass - fuelMass;
-
-            if ( m_missionParams.stage[m_missionParams.stageCount].IspVac > 0.0f )
-            {
-                // Convert thrust (in kN) to mass flow rate
-                float thrust = stageJson.value( "thrustVac", 0.0f );
-                float thrustLimit = stageJson.value( "thrustLimit", 1.0f );
-                thrustLimit = std::min( std::max( thrustLimit, 0.0f ), 1.0f );
-                m_missionParams.stage[m_missionParams.stageCount].massFlow = thrust * 1000.0f * thrustLimit / (9.82025f * m_missionParams.stage[m_missionParams.stageCount].IspVac);
-            }
-
-            if ( m_missionParams.stage[m_missionParams.stageCount].dryMass > 0.0f )
-            {
-                if ( ++m_missionParams.stageCount >= ARRAY_SIZE( m_missionParams.stage ) )
-                    break;
-            }
-        }
-
-        double Ap = missionParamsJson.value( "apoapsis", 200000.0 ) + earthRadius;
-        double Pe = missionParamsJson.value( "periapsis", 200000.0 ) + earthRadius;
-
-        double a = (Ap + Pe) / 2.0;
-        double e = 1 - Pe / a;
-        double L = a * (1 - e * e);
-
-
-        m_missionParams.finalState.r = float(Pe);
-        m_missionParams.finalState.rv = 0;
-        m_missionParams.finalState.h = float( sqrt( earthMu * L ) );
-        m_missionParams.finalState.omega = m_missionParams.finalState.h / float( sqr(Pe) );
-
-        m_missionParams.finalOrbitalEnergy = float( -earthMu / (2 * a));
+        ParseMissionParams( missionParamsJson, earthRadius, earthMu, m_missionParams );
 
         CreateConstantBuffer( trackedFile.filename, *static_cast<ResourceData*>(trackedFile.userData), &m_missionParams, sizeof( m_missionParams ) );
 
@@ -1097,24 +1031,11 @@ void RocketSim::ReloadEnvironmentalParams( TrackedFile& trackedFile )
     {
         nlohmann::json enviroParamsJson = LoadJsonFile( trackedFile.filename );
 
-        earthMu = enviroParamsJson.value("gravConstant", earthMu);
-        earthRadius = enviroParamsJson.value("earthRadius", earthRadius);
+        EnvironmentalData data;
+        ParseEnvironmentalParams( enviroParamsJson, earthRadius, earthMu, data );
         earthg0 = earthMu / (earthRadius * earthRadius);
 
-        float data[] =
-        {
-            float( earthMu ),
-            float( earthRadius ),
-            float( earthg0 ),
-            enviroParamsJson.value( "airMolarMass", 0.0289644f ),
-            8.3144598f,     // universal gas constant
-            enviroParamsJson.value( "adiabaticIndex", 1.4f ),
-            enviroParamsJson.value( "launchLatitude", 28.608389f ),
-            enviroParamsJson.value( "launchAltitude", 85.0f ),
-            enviroParamsJson.value( "rotationPeriod", 86164.098903691f ),
-        };
-
-        CreateConstantBuffer( trackedFile.filename, *static_cast<ResourceData*>(trackedFile.userData), data, sizeof( data ) );
+        CreateConstantBuffer( trackedFile.filename, *static_cast<ResourceData*>(trackedFile.userData), &data, sizeof( data ) );
 
         // Reload mission params as they depend on earthRadius
         InvalidateTrackedFile( L"mission_params.json" );
@@ -1131,79 +1052,6 @@ void RocketSim::ReloadEnvironmentalParams( TrackedFile& trackedFile )
 
 //------------------------------------------------------------------------------------------------
 
-static void GenerateMonotonicInterpolants( std::vector<ShaderShared::float4>& curveData )
-{
-    std::vector<float> delta;
-    for ( uint32_t i = 0; i < curveData.size() - 1; ++i )
-    {
-        delta.emplace_back( (curveData[i + 1].y - curveData[i].y) / (curveData[i + 1].x - curveData[i].x) );
-    }
-
-    std::vector<float> tangents;
-    tangents.emplace_back( delta.front() );
-    for ( uint32_t i = 1; i < delta.size(); ++i )
-    {
-        if ( (delta[i - 1] > 0.0f) == (delta[i] > 0.0f) )
-            tangents.emplace_back( (delta[i - 1] + delta[i]) / 2 );
-        else
-            tangents.emplace_back( 0.0f );
-    }
-    tangents.emplace_back( delta.back() );
-
-    for ( uint32_t i = 0; i < delta.size(); ++i )
-    {
-        if ( fabs( delta[i] ) < FLT_EPSILON )
-        {
-            tangents[i] = 0.f;
-            tangents[i + 1] = 0.f;
-            ++i;
-        }
-        else
-        {
-            float alpha = tangents[i] / delta[i];
-            float beta = tangents[i + 1] / delta[i];
-
-            if ( alpha < 0.0f || beta < 0.0f )
-            {
-                tangents[i] = 0.f;
-            }
-            else
-            {
-                float s = alpha * alpha + beta * beta;
-                if ( s > 9.0f )
-                {
-                    s = 3.0f / sqrt( s );
-                    tangents[i] = s * alpha * delta[i];
-                    tangents[i + 1] = s * beta * delta[i];
-                }
-            }
-        }
-    }
-
-    for ( uint32_t i = 0; i < curveData.size(); ++i )
-    {
-        curveData[i].z = curveData[i].w = tangents[i];
-    }
-}
-
-//------------------------------------------------------------------------------------------------
-
-static void FixupHermiteTangents( std::vector<ShaderShared::float4>& curveData )
-{
-    curveData[0].z = 0.0f;
-    curveData[0].w *= (curveData[1].x - curveData[0].x);
-    uint32_t i;
-    for ( i = 1; i < curveData.size() - 1; ++i )
-    {
-        curveData[i].z *= (curveData[i].x - curveData[i - 1].x);
-        curveData[i].w *= (curveData[i + 1].x - curveData[i].x);
-    }
-    curveData[i].z *= (curveData[i].x - curveData[i - 1].x);
-    curveData[i].w = 0.0f;
-}
-
-//------------------------------------------------------------------------------------------------
-
 void RocketSim::ReloadMachSweep( TrackedFile& trackedFile )
 {
     if ( !trackedFile.userData )
@@ -1218,88 +1066,16 @@ void RocketSim::ReloadMachSweep( TrackedFile& trackedFile )
         return;
     }
 
-    char line[500];
-    iStream.getline( line, ARRAY_SIZE( line ) );
-
-    std::vector<std::string> headers;
-    char* context;
-    for ( const char* token = strtok_s( line, ",", &context ); token; token = strtok_s( nullptr, ",", &context ) )
-    {
-        headers.emplace_back( token );
-        std::for_each(headers.back().begin(), headers.back().end(), [] (char& a) { a = static_cast<char>(tolower(a)); } );
-    }
-
-    std::vector<std::vector<double>> data;
-    data.emplace_back();
-    for (;;)
-    {
-        std::ifstream::int_type c;
-        for (;;)
-        {
-            c = iStream.peek();
-            if ( c == std::ifstream::traits_type::eof() || isdigit( c ) || c == '-' )
-                break;
-            iStream.get();
-        }
-
-        float f;
-        iStream >> f;
-
-        if (!iStream.good())
-            break;
+    ResourceData& resourceData = *static_cast<ResourceData*>(trackedFile.userData);
 
-        if ( data.back().size() < headers.size() )
-            data.back().push_back( f );
-        else
-            data.emplace_back( std::vector<double>( 1, f ) );
-    }
+    bool lift = resourceData.desc.ptr >= m_shaderHeap.GetCPUHandle( ShaderShared::srvLiftMachCurve ).ptr && resourceData.desc.ptr <= m_shaderHeap.GetCPUHandle( ShaderShared::srvLiftMachCurve, 3 ).ptr;
 
-    if ( data.size() > 0 )
+    std::vector<ShaderShared::float4> curveData;
+    std::string error;
+    if ( ParseMachSweep( iStream, lift, curveData, error ) )
     {
-        ResourceData& resourceData = *static_cast<ResourceData*>(trackedFile.userData);
-
-        for ( uint32_t i = 1; i < data.size(); ++i )
-        {
-            data.erase( data.begin() + i );
-        }
-
-        const char* columnNames[] = { "mach", "a", "cd" };
-        double scale = 1.0f;
-        if ( resourceData.desc.ptr >= m_shaderHeap.GetCPUHandle( ShaderShared::srvLiftMachCurve ).ptr && resourceData.desc.ptr <= m_shaderHeap.GetCPUHandle( ShaderShared::srvLiftMachCurve, 3 ).ptr )
-        {
-            columnNames[2] = "cl";
-            scale = 1000;
-        }
-
-        std::array<uint32_t, ARRAY_SIZE( columnNames )> columnIndex;
-        for ( uint32_t i = 0; i < columnIndex.size(); ++i )
-        {
-            std::vector<std::string>::const_iterator colIter = std::find( headers.cbegin(), headers.cend(), columnNames[i] );
-            if ( colIter == headers.cend() )
-            {
-                ErrorTrace( trackedFile, L"Missing %c%s column.", toupper( *columnNames[i] ), columnNames[i] + 1 );
-                return;
-            }
-            columnIndex[i] = static_cast<uint32_t>(colIter - headers.cbegin());
-        }
-
-        std::vector<ShaderShared::float4> curveData;
-
-        curveData.reserve( data.size() );
-
-        for ( const std::vector<double>& src : data )
-        {
-            float mach = float(src[columnIndex[0]]);
-            float y = float(src[columnIndex[2]] * src[columnIndex[1]] * scale);
-
-            curveData.emplace_back( mach, y, 0.0f, 0.0f );
-        }
-
-        GenerateMonotonicInterpolants( curveData );
-        FixupHermiteTangents( curveData );
-
         wchar_t name[200];
-        swprintf_s( name, L"%s:%SA", trackedFile.filename, columnNames[2] );
+        swprintf_s( name, L"%s:%SA", trackedFile.filename, lift ? "cl" : "cd" );
 
         CreateFloat4Buffer( name, resourceData.resource, resourceData.desc, curveData.data(), static_cast<uint32_t>(curveData.size()) );
         resourceData.size = static_cast<uint32_t>(curveData.size());
@@ -1309,7 +1085,7 @@ void RocketSim::ReloadMachSweep( TrackedFile& trackedFile )
     }
     else
     {
-        ErrorTrace( trackedFile, L"No valid data in file." );
+        ErrorTrace( trackedFile, L"%S", error.c_str() );
     }
 }
 
@@ -1327,34 +1103,8 @@ void RocketSim::ReloadHermiteCurve( TrackedFile& trackedFile )
         nlohmann::json keyListJson = LoadJsonFile( trackedFile.filename );
 
         std::vector<ShaderShared::float4> curveData;
-        curveData.reserve( keyListJson.size() );
-
-        bool generateInterpolants = true;
-        for ( const std::vector<float>& key : keyListJson["keys"] )
-        {
-            if ( key.size() >= 4 )
-            {
-                curveData.emplace_back( key[0], key[1], key[2], key[3] );
-                generateInterpolants = false;
-            }
-            else if ( key.size() >= 2 )
-            {
-                curveData.emplace_back( key[0], key[1], 0.0f, 0.0f );
-            }
-        }
-
-        if ( curveData.size() > 0 )
+        if ( ParseHermiteCurve( keyListJson, curveData ) )
         {
-            if ( curveData.size() > 1 )
-            {
-                if ( generateInterpolants )
-                {
-                    GenerateMonotonicInterpolants( curveData );
-                }
-
-                FixupHermiteTangents( curveData );
-            }
-
             ResourceData& resourceData = *static_cast<ResourceData*>(trackedFile.userData);
 
             CreateFloat4Buffer( trackedFile.filename, resourceData.resource, resourceData.desc, curveData.data(), static_cast<uint32_t>(curveData.size()) );
@@ -2425,26 +2175,12 @@ void RocketSim::RenderFrame()
 
                 for ( uint32_t i = 0; i < m_simulationThreadCount; ++i )
                 {
-                    if ( flightData[i].flightPhase == ShaderShared::c_PhaseMECO && flightData[i].maxQ < 60000.0f )
-                    {
-                        float massDelta = flightData[m_simulationThreadCount + 1].minMass - flightData[i].minMass;
-                        massDelta = std::max( massDelta, 0.0f );
-
-                        float targetPe = float(m_missionParams.finalState.r - earthRadius);
-                        float targetAp = float(-earthMu / (2 * m_missionParams.finalOrbitalEnergy) - earthRadius) * 2 - targetPe;
-
-                        float Ap = (1 + flightData[i].e) * flightData[i].a - float(earthRadius);
-                        float Pe = (1 - flightData[i].e) * flightData[i].a - float(earthRadius);
+                    float delta = CalcSelectionScore( flightData[i], flightData[m_simulationThreadCount + 1].minMass, m_missionParams, earthRadius, earthMu );
 
-                        float orbDelta = sqrtf(sqr( Ap - targetAp ) + sqr( Pe - targetPe ));
-
-                        float delta = massDelta + sqr(orbDelta * 0.001f) * 10.0f;
-
-                        if ( delta < bestDelta )
-                        {
-                            bestDelta = delta;
-                            selected = i;
-                        }
+                    if ( delta < bestDelta )
+                    {
+                        bestDelta = delta;
+                        selected = i;
                     }
                 }
 
@@ -2774,31 +2510,7 @@ void RocketSim::MouseReleased( int x, int y, bool captureLost )
             if ( maxSpeed < minSpeed )
                 std::swap( minSpeed, maxSpeed );
 
-            float angleStep = (maxAngle - minAngle) / float( m_ascentParams[0].size() - 1 );
-            float speedStep = (maxSpeed - minSpeed) / float( m_ascentParams.size() - 1 );
-
-            for ( uint32_t angle = 0; angle < m_ascentParams[0].size(); ++angle )
-            {
-                float a = minAngle + angle * angleStep;
-                m_ascentParams[0][angle].pitchOverSpeed = minSpeed;
-                m_ascentParams[0][angle].sinPitchOverAngle = sin( a );
-                m_ascentParams[0][angle].cosPitchOverAngle = cos( a );
-                m_ascentParams[0][angle].sinAimAngle = sin( a + c_DegreeToRad );
-                m_ascentParams[0][angle].cosAimAngle = cos( a + c_DegreeToRad );
-            }
-
-            for ( uint32_t speed = 1; speed < m_ascentParams.size(); ++speed )
-            {
-                float pitchOverSpeed = minSpeed + speed * speedStep;
-                for ( uint32_t angle = 0; angle < m_ascentParams[0].size(); ++angle )
-                {
-                    m_ascentParams[speed][angle].pitchOverSpeed = pitchOverSpeed;
-                    m_ascentParams[speed][angle].sinPitchOverAngle = m_ascentParams[speed - 1][angle].sinPitchOverAngle;
-                    m_ascentParams[speed][angle].cosPitchOverAngle = m_ascentParams[speed - 1][angle].cosPitchOverAngle;
-                    m_ascentParams[speed][angle].sinAimAngle = m_ascentParams[speed - 1][angle].sinAimAngle;
-                    m_ascentParams[speed][angle].cosAimAngle = m_ascentParams[speed - 1][angle].cosAimAngle;
-                }
-            }
+            GenerateAscentParams( minSpeed, maxSpeed, minAngle, maxAngle, static_cast<uint32_t>(m_ascentParams.size()), static_cast<uint32_t>(m_ascentParams[0].size()), &m_ascentParams[0][0] );
 
             ResourceData* resourceData = &m_ascentParamsBuffer;
             CreateStructuredBuffer( L"Zoomed ascent params", resourceData->resource, resourceData->desc, m_ascentParams.data(),
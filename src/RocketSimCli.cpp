@@ -0,0 +1,1155 @@
+// RocketSimCli.cpp : Headless ascent sweep on the CPU, for machines without a D3D12 capable GPU.
+//
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "AscentOptimiser.h"
+#include "Benchmarks.h"
+#include "FlightAnalysis.h"
+#include "FlightDispersion.h"
+#include "SweepCache.h"
+#include "SweepDesign.h"
+#include "SweepEngine.h"
+#include "SweepRefinement.h"
+#include "SweepShards.h"
+#include "SweepSurrogate.h"
+#include "VehicleBatch.h"
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+static constexpr float  c_RadToDegree = 180.0f / 3.14159265f;
+static constexpr float  c_DegreeToRad = 3.14159265f / 180.0f;
+
+static double earthRadius = 6371000;
+static double earthMu = 3.986004418e+14;
+
+//------------------------------------------------------------------------------------------------
+
+struct CliOptions
+{
+    std::string     resourcePath = "resources";
+    std::string     missionFile = "mission_params.json";
+    std::string     environmentFile = "environmental_params.json";
+    std::string     ascentFile = "ascent_params.json";
+    std::string     pressureFile = "pressure_height.json";
+    std::string     temperatureFile = "temperature_height.json";
+    std::string     machSweepFiles[4] = { "MachSweep_S1.csv", "MachSweep_S2.csv" };
+    std::string     outputFile = "flight_data.json";
+    std::string     telemetryFile;
+    std::string     benchmark;
+    bool            help = false;           // Print the usage and exit
+    uint32_t        telemetryPoints = 0;    // 0 writes every sample
+    uint32_t        threadCount = 0;
+    uint32_t        gridSpeedCount = c_SweepSpeedCount;
+    uint32_t        gridAngleCount = c_SweepAngleCount;
+    std::string     designFile;
+    std::string     cacheDirectory;         // Empty flies every profile
+    ShardConfig     shards;
+    bool            sharded = false;        // Coordinate workers with --workers
+    bool            shardWorker = false;    // Serve shards on stdin and stdout
+    std::vector<std::string>    vehiclePaths;   // Mission files or directories of them
+    uint32_t        designBatchSize = 65536;    // Profiles per sweep of a design
+    bool            refine = false;
+    RefinementConfig    refinement;
+    bool            optimise = false;
+    OptimiserConfig     optimiser;
+    bool            surrogate = false;
+    SurrogateConfig     surrogateSearch;
+    bool            disperse = false;
+    DispersionConfig    dispersion;
+    SweepConfig     sweep;
+};
+
+static void PrintUsage()
+{
+    printf( "Usage: rocketsim-cli [options]\n"
+            "  --resources <dir>         Directory holding the input files (default: resources)\n"
+            "  --mission <file>          Mission params (default: mission_params.json)\n"
+            "  --environment <file>      Environmental params (default: environmental_params.json)\n"
+            "  --ascent <file>           Ascent params (default: ascent_params.json)\n"
+            "  --pressure <file>         Pressure height curve (default: pressure_height.json)\n"
+            "  --temperature <file>      Temperature height curve (default: temperature_height.json)\n"
+            "  --machsweep <stage> <file> Mach sweep csv for a stage (defaults: MachSweep_S1.csv, MachSweep_S2.csv)\n"
+            "  --threads <n>             Worker threads including the main thread (default: all)\n"
+            "  --grid <speeds> <angles>  Pitch over speeds and angles the sweep grid has (default: 32 16)\n"
+            "  --step <seconds>          Simulation step size (default: 0.02)\n"
+            "  --time <seconds>          Flight time to simulate (default: 600)\n"
+            "  --output <file>           FlightData output (default: flight_data.json, flight_data.csv with --design)\n"
+            "  --telemetry <file>        Write telemetry of the selected profile as csv\n"
+            "  --telemetry-profiles <n>  Store telemetry for the n best profiles only, replaying others (default: all)\n"
+            "  --telemetry-points <n>    Write the min/max of each graph channel over n time buckets instead of every sample\n"
+            "  --simd <level>            none, scalar, avx2 or avx512 (default: best supported)\n"
+            "  --coast <mode>            After MECO or burnout: integrate, freeze or kepler (default: kepler)\n"
+            "  --integrator <name>       euler, verlet, yoshida4 (fixed step) or dopri5 (adaptive) (default: euler)\n"
+            "  --tolerance <rel>         Relative error per step for dopri5 (default: 1e-7)\n"
+            "  --refine <m/s> <deg>      Zoom the grid in on the best profile until its steps are this fine, writing each level\n"
+            "  --optimise <method>       Search for the best profile with cmaes or neldermead instead of sweeping the grid\n"
+            "  --surrogate <n>           Search for the best profile by expected improvement on a fitted surrogate, flying at most n\n"
+            "  --dispersion <n>          Fly n perturbed copies of the selected profile and write statistics of their results\n"
+            "  --seed <n>                Dispersion seed, run i of a seed is always the same flight (default: 1)\n"
+            "  --vehicles <path>         Find the best profile for every mission file at path, a file or a directory of them; may repeat\n"
+            "  --design <file>           Fly the points of a sweep design over more parameters than the grid's, writing them as csv\n"
+            "  --cache <dir>             Keep results in dir and fly only profiles it has none for, with cold guidance\n"
+            "  --cold-guidance           Start every guidance solve cold rather than from a converged neighbour's\n"
+            "  --workers <n>             Split the sweep into shards flown by n worker processes, with cold guidance\n"
+            "  --shard-size <n>          Profiles per shard (default: 256)\n"
+            "  --shard-timeout <s>       Seconds a worker may hold a shard before it's dropped (default: no limit)\n"
+            "  --kill-worker <n>         For testing: kill the first worker when it's sent its nth shard\n"
+            "  --shard-worker            Serve shards on stdin and stdout, as started by --workers\n"
+            "  --help, -h                Print this and exit\n"
+            "  --bench <name>            Run a benchmark instead of the sweep, one of:\n" );
+
+    PrintBenchmarks();
+}
+
+static bool ParseOptions( int argc, char* argv[], CliOptions& options )
+{
+    for ( int i = 1; i < argc; ++i )
+    {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if ( !strcmp( arg, "--resources" ) && hasValue )
+            options.resourcePath = argv[++i];
+        else if ( !strcmp( arg, "--mission" ) && hasValue )
+            options.missionFile = argv[++i];
+        else if ( !strcmp( arg, "--environment" ) && hasValue )
+            options.environmentFile = argv[++i];
+        else if ( !strcmp( arg, "--ascent" ) && hasValue )
+            options.ascentFile = argv[++i];
+        else if ( !strcmp( arg, "--pressure" ) && hasValue )
+            options.pressureFile = argv[++i];
+        else if ( !strcmp( arg, "--temperature" ) && hasValue )
+            options.temperatureFile = argv[++i];
+        else if ( !strcmp( arg, "--machsweep" ) && i + 2 < argc )
+        {
+            int stage = atoi( argv[++i] ) - 1;
+            if ( stage < 0 || stage >= 4 )
+            {
+                fprintf( stderr, "Mach sweep stage must be 1-4.\n" );
+                return false;
+            }
+            options.machSweepFiles[stage] = argv[++i];
+        }
+        else if ( !strcmp( arg, "--threads" ) && hasValue )
+            options.threadCount = static_cast<uint32_t>(atoi( argv[++i] ));
+        else if ( !strcmp( arg, "--grid" ) && i + 2 < argc )
+        {
+            options.gridSpeedCount = static_cast<uint32_t>(atoi( argv[++i] ));
+            options.gridAngleCount = static_cast<uint32_t>(atoi( argv[++i] ));
+        }
+        else if ( !strcmp( arg, "--step" ) && hasValue )
+            options.sweep.simulationStepSize = float( atof( argv[++i] ) );
+        else if ( !strcmp( arg, "--time" ) && hasValue )
+            options.sweep.flightTime = float( atof( argv[++i] ) );
+        else if ( !strcmp( arg, "--output" ) && hasValue )
+            options.outputFile = argv[++i];
+        else if ( !strcmp( arg, "--telemetry" ) && hasValue )
+            options.telemetryFile = argv[++i];
+        else if ( !strcmp( arg, "--telemetry-profiles" ) && hasValue )
+            options.sweep.telemetryProfiles = static_cast<uint32_t>(atoi( argv[++i] ));
+        else if ( !strcmp( arg, "--telemetry-points" ) && hasValue )
+            options.telemetryPoints = static_cast<uint32_t>(atoi( argv[++i] ));
+        else if ( !strcmp( arg, "--simd" ) && hasValue )
+        {
+            if ( !ParseSimdLevel( argv[++i], options.sweep.simdLevel ) || !IsSimdLevelSupported( options.sweep.simdLevel ) )
+            {
+                fprintf( stderr, "SIMD level %s isn't supported on this machine.\n", argv[i] );
+                return false;
+            }
+        }
+        else if ( !strcmp( arg, "--coast" ) && hasValue )
+        {
+            if ( !ParseCoastMode( argv[++i], options.sweep.coastMode ) )
+            {
+                fprintf( stderr, "Unknown coast mode %s.\n", argv[i] );
+                return false;
+            }
+        }
+        else if ( !strcmp( arg, "--integrator" ) && hasValue )
+        {
+            if ( !ParseFlightIntegrator( argv[++i], options.sweep.integrator ) )
+            {
+                fprintf( stderr, "Unknown integrator %s.\n", argv[i] );
+                return false;
+            }
+        }
+        else if ( !strcmp( arg, "--tolerance" ) && hasValue )
+            options.sweep.tolerance = atof( argv[++i] );
+        else if ( !strcmp( arg, "--refine" ) && i + 2 < argc )
+        {
+            options.refine = true;
+            options.refinement.speedResolution = float( atof( argv[++i] ) );
+            options.refinement.angleResolution = float( atof( argv[++i] ) ) * c_DegreeToRad;
+        }
+        else if ( !strcmp( arg, "--optimise" ) && hasValue )
+        {
+            options.optimise = true;
+            if ( !ParseOptimiserMethod( argv[++i], options.optimiser.method ) )
+            {
+                fprintf( stderr, "Unknown optimiser %s.\n", argv[i] );
+                return false;
+            }
+        }
+        else if ( !strcmp( arg, "--surrogate" ) && hasValue )
+        {
+            options.surrogate = true;
+            options.surrogateSearch.maxEvaluations = static_cast<uint32_t>(atoi( argv[++i] ));
+        }
+        else if ( !strcmp( arg, "--dispersion" ) && hasValue )
+        {
+            options.disperse = true;
+            options.dispersion.runCount = static_cast<uint32_t>(atoi( argv[++i] ));
+        }
+        else if ( !strcmp( arg, "--seed" ) && hasValue )
+            options.dispersion.seed = static_cast<uint32_t>(strtoul( argv[++i], nullptr, 10 ));
+        else if ( !strcmp( arg, "--vehicles" ) && hasValue )
+            options.vehiclePaths.push_back( argv[++i] );
+        else if ( !strcmp( arg, "--design" ) && hasValue )
+            options.designFile = argv[++i];
+        else if ( !strcmp( arg, "--cache" ) && hasValue )
+            options.cacheDirectory = argv[++i];
+        else if ( !strcmp( arg, "--cold-guidance" ) )
+            options.sweep.warmStartGuidance = false;
+        else if ( !strcmp( arg, "--workers" ) && hasValue )
+        {
+            options.sharded = true;
+            options.shards.workerCount = static_cast<uint32_t>(atoi( argv[++i] ));
+        }
+        else if ( !strcmp( arg, "--shard-size" ) && hasValue )
+            options.shards.shardSize = static_cast<uint32_t>(atoi( argv[++i] ));
+        else if ( !strcmp( arg, "--shard-timeout" ) && hasValue )
+            options.shards.timeout = atof( argv[++i] );
+        else if ( !strcmp( arg, "--kill-worker" ) && hasValue )
+            options.shards.killAfter = static_cast<uint32_t>(atoi( argv[++i] ));
+        else if ( !strcmp( arg, "--shard-worker" ) )
+            options.shardWorker = true;
+        else if ( !strcmp( arg, "--bench" ) && hasValue )
+            options.benchmark = argv[++i];
+        else if ( !strcmp( arg, "--help" ) || !strcmp( arg, "-h" ) )
+        {
+            options.help = true;
+            return true;
+        }
+        else
+        {
+            fprintf( stderr, "Unknown or incomplete option: %s\n", arg );
+            return false;
+        }
+    }
+
+    if ( options.sweep.simulationStepSize <= 0.0f || options.sweep.flightTime <= 0.0f || options.sweep.tolerance <= 0.0 )
+    {
+        fprintf( stderr, "Step size, flight time and tolerance must be positive.\n" );
+        return false;
+    }
+
+    if ( options.gridSpeedCount < 2 || options.gridAngleCount < 2 || uint64_t( options.gridSpeedCount ) * options.gridAngleCount > ~0u )
+    {
+        fprintf( stderr, "Grid needs at least 2 speeds and 2 angles.\n" );
+        return false;
+    }
+
+    options.refinement.speedCount = options.gridSpeedCount;
+    options.refinement.angleCount = options.gridAngleCount;
+
+    if ( !options.designFile.empty() && options.outputFile == "flight_data.json" )
+        options.outputFile = "flight_data.csv";
+
+    if ( options.refine && (options.refinement.speedResolution <= 0.0f || options.refinement.angleResolution <= 0.0f) )
+    {
+        fprintf( stderr, "Refinement resolutions must be positive.\n" );
+        return false;
+    }
+
+    if ( options.sharded )
+    {
+        if ( options.shards.workerCount == 0 || options.shards.shardSize == 0 )
+        {
+            fprintf( stderr, "Sharded sweeps need at least 1 worker and 1 profile per shard.\n" );
+            return false;
+        }
+
+        if ( options.refine || options.optimise || options.surrogate || options.disperse || !options.designFile.empty() || !options.vehiclePaths.empty() ||
+             !options.telemetryFile.empty() || !options.cacheDirectory.empty() )
+        {
+            fprintf( stderr, "--workers shards the plain sweep only, without telemetry or a cache.\n" );
+            return false;
+        }
+
+        // Shards only match a single sweep without it, see SweepShards.h.
+        options.sweep.warmStartGuidance = false;
+    }
+
+    if ( !options.vehiclePaths.empty() && (options.surrogate || options.disperse || !options.designFile.empty() || !options.telemetryFile.empty() ||
+                                           !options.cacheDirectory.empty()) )
+    {
+        fprintf( stderr, "--vehicles refines or optimises each vehicle only, without telemetry or a cache.\n" );
+        return false;
+    }
+
+    if ( !options.designFile.empty() && (options.refine || options.optimise || options.surrogate || options.disperse || !options.telemetryFile.empty() ||
+                                         !options.cacheDirectory.empty()) )
+    {
+        fprintf( stderr, "--design flies the design's points only, without refinement, telemetry or a cache.\n" );
+        return false;
+    }
+
+    // Cached results only match flying them again without it, see SweepCache.h.
+    if ( !options.cacheDirectory.empty() )
+        options.sweep.warmStartGuidance = false;
+
+    if ( options.disperse && options.dispersion.runCount == 0 )
+    {
+        fprintf( stderr, "Dispersion needs at least 1 run.\n" );
+        return false;
+    }
+
+    if ( options.surrogate && options.surrogateSearch.maxEvaluations < options.surrogateSearch.initialSamples )
+    {
+        fprintf( stderr, "Surrogate search needs at least %u profiles.\n", options.surrogateSearch.initialSamples );
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static std::string ResourceFile( const CliOptions& options, const std::string& filename )
+{
+    if ( filename.empty() || filename[0] == '/' || options.resourcePath.empty() )
+        return filename;
+
+    return options.resourcePath + "/" + filename;
+}
+
+static nlohmann::json LoadJsonFile( const std::string& filename )
+{
+    std::ifstream iStream( filename );
+    if ( iStream.fail() )
+    {
+        throw nlohmann::json::other_error::create( 502, "Failed to open file " + filename + "." );
+    }
+
+    nlohmann::json j;
+    iStream >> j;
+
+    return j;
+}
+
+static bool LoadInputs( const CliOptions& options, FlightEnvironment& environment, MissionParams& missionParams, std::vector<AscentParams>& ascentParams )
+{
+    try
+    {
+        ParseEnvironmentalParams( LoadJsonFile( ResourceFile( options, options.environmentFile ) ), earthRadius, earthMu, environment.params );
+
+        // Mission params depend on earthRadius
+        ParseMissionParams( LoadJsonFile( ResourceFile( options, options.missionFile ) ), earthRadius, earthMu, missionParams );
+        if ( missionParams.stageCount == 0 )
+        {
+            fprintf( stderr, "%s: No valid stages.\n", options.missionFile.c_str() );
+            return false;
+        }
+
+        if ( !ParseHermiteCurve( LoadJsonFile( ResourceFile( options, options.pressureFile ) ), environment.pressureHeight.keys ) )
+        {
+            fprintf( stderr, "%s: No valid data in file.\n", options.pressureFile.c_str() );
+            return false;
+        }
+
+        if ( !ParseHermiteCurve( LoadJsonFile( ResourceFile( options, options.temperatureFile ) ), environment.temperatureHeight.keys ) )
+        {
+            fprintf( stderr, "%s: No valid data in file.\n", options.temperatureFile.c_str() );
+            return false;
+        }
+
+        nlohmann::json ascentJson = LoadJsonFile( ResourceFile( options, options.ascentFile ) );
+
+        float minSpeed = ascentJson.value( "minSpeed", 20.0f );
+        float maxSpeed = ascentJson.value( "maxSpeed", 100.0f );
+        float minAngle = ascentJson.value( "minAngle", 1.0f );
+        float maxAngle = ascentJson.value( "maxAngle", 5.0f );
+
+        ascentParams.resize( size_t( options.gridSpeedCount ) * options.gridAngleCount );
+        GenerateAscentParams( minSpeed, maxSpeed, minAngle * c_DegreeToRad, maxAngle * c_DegreeToRad, options.gridSpeedCount, options.gridAngleCount, ascentParams.data() );
+    }
+    catch ( nlohmann::json::exception& e )
+    {
+        fprintf( stderr, "%s\n", e.what() );
+        return false;
+    }
+
+    for ( uint32_t stage = 0; stage < 4; ++stage )
+    {
+        const std::string& filename = options.machSweepFiles[stage];
+        if ( filename.empty() )
+            continue;
+
+        for ( bool lift : { true, false } )
+        {
+            std::ifstream iStream( ResourceFile( options, filename ) );
+            if ( iStream.fail() )
+            {
+                fprintf( stderr, "%s: Failed to open file.\n", filename.c_str() );
+                return false;
+            }
+
+            std::string error;
+            HermiteCurve& curve = lift ? environment.liftMach[stage] : environment.dragMach[stage];
+            if ( !ParseMachSweep( iStream, lift, curve.keys, error ) )
+            {
+                fprintf( stderr, "%s: %s\n", filename.c_str(), error.c_str() );
+                return false;
+            }
+        }
+    }
+
+    float curveError = environment.Compile();
+    if ( curveError > 0 )
+        fprintf( stderr, "Compiled curves differ from searching the keys by up to %g.\n", curveError );
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static nlohmann::json FlightDataToJson( const FlightData& flightData )
+{
+    nlohmann::json j;
+    j["flightPhase"] = flightData.flightPhase;
+    j["stage"] = flightData.stage;
+    j["maxAltitude"] = flightData.maxAltitude;
+    j["maxSurfSpeed"] = flightData.maxSurfSpeed;
+    j["maxEciSpeed"] = flightData.maxEciSpeed;
+    j["maxQ"] = flightData.maxQ;
+    j["minMass"] = flightData.minMass;
+    j["maxAccel"] = flightData.maxAccel;
+    j["a"] = flightData.a;
+    j["e"] = flightData.e;
+    j["E"] = flightData.E;
+    j["apoapsis"] = (1.0f + flightData.e) * flightData.a - float( earthRadius );
+    j["periapsis"] = (1.0f - flightData.e) * flightData.a - float( earthRadius );
+    j["stageBurnTime"] = std::vector<float>( std::begin( flightData.stageBurnTime ), std::end( flightData.stageBurnTime ) );
+
+    return j;
+}
+
+static void PrintSelectedProfile( const std::vector<FlightData>& flightData, const std::vector<AscentParams>& ascentParams, uint32_t selected )
+{
+    if ( selected < ascentParams.size() )
+    {
+        const FlightData& selectedData = flightData[selected];
+        printf( "Selected profile %u: pitch over %.1f m/s at %.2f\xc2\xb0, min mass %.3f t, max Q %.2f kPa, Ap %.3f km, Pe %.3f km\n",
+                selected, ascentParams[selected].pitchOverSpeed, acosf( ascentParams[selected].cosPitchOverAngle ) * c_RadToDegree,
+                selectedData.minMass / 1000.0f, selectedData.maxQ / 1000.0f,
+                ((1.0f + selectedData.e) * selectedData.a - earthRadius) / 1000.0, ((1.0f - selectedData.e) * selectedData.a - earthRadius) / 1000.0 );
+    }
+    else
+    {
+        printf( "No profile reached MECO within the max Q limit.\n" );
+    }
+}
+
+// flightData has one entry per profile followed by the min and max extents, as SweepEngine::GetFlightData.
+static bool WriteFlightData( const std::string& filename, const std::vector<FlightData>& flightData, const MissionParams& missionParams,
+                             const std::vector<AscentParams>& ascentParams, const SweepConfig& config, uint32_t selected )
+{
+    const uint32_t profileCount = static_cast<uint32_t>(ascentParams.size());
+
+    nlohmann::json output;
+    output["simulationStepSize"] = config.simulationStepSize;
+    output["flightTime"] = config.flightTime;
+    output["selected"] = selected < profileCount ? int64_t( selected ) : -1;
+
+    nlohmann::json& profiles = output["profiles"];
+    for ( uint32_t i = 0; i < profileCount; ++i )
+    {
+        nlohmann::json profile = FlightDataToJson( flightData[i] );
+        profile["pitchOverSpeed"] = ascentParams[i].pitchOverSpeed;
+        profile["pitchOverAngle"] = acosf( ascentParams[i].cosPitchOverAngle ) * c_RadToDegree;
+        profiles.push_back( profile );
+    }
+
+    output["extents"]["min"] = FlightDataToJson( flightData[profileCount] );
+    output["extents"]["max"] = FlightDataToJson( flightData[profileCount + 1] );
+    output["paretoFront"] = CalcParetoFront( flightData.data(), profileCount, missionParams, earthRadius, earthMu );
+
+    std::ofstream oStream( filename );
+    if ( oStream.fail() )
+    {
+        fprintf( stderr, "%s: Failed to create file.\n", filename.c_str() );
+        return false;
+    }
+
+    oStream << output.dump( 4 ) << "\n";
+    return oStream.good();
+}
+
+static bool WriteTelemetry( const std::string& filename, const SweepEngine& engine, const SweepConfig& config, uint32_t profile )
+{
+    std::ofstream oStream( filename );
+    if ( oStream.fail() )
+    {
+        fprintf( stderr, "%s: Failed to create file.\n", filename.c_str() );
+        return false;
+    }
+
+    oStream << "time,altitude,eciPositionX,eciPositionY,eciVelocityX,eciVelocityY,surfVelocityX,surfVelocityY,headingX,headingY,stage,mass,flightPhase,guidancePitch\n";
+
+    const std::vector<TelemetryData> telemetry = engine.GetProfileTelemetry( profile );
+    const float sampleTime = config.simulationStepSize * config.telemetryStepSize;
+
+    char line[512];
+    for ( uint32_t s = 0; s < telemetry.size(); ++s )
+    {
+        const TelemetryData& t = telemetry[s];
+        snprintf( line, sizeof( line ), "%.2f,%.1f,%.1f,%.1f,%.3f,%.3f,%.3f,%.3f,%.5f,%.5f,%u,%.1f,%u,%.5f\n",
+                  (s + 1) * sampleTime, length( t.eciPosition ) - earthRadius, t.eciPosition.x, t.eciPosition.y, t.eciVelocity.x, t.eciVelocity.y,
+                  t.surfVelocity.x, t.surfVelocity.y, t.heading.x, t.heading.y, t.stage, t.mass, t.flightPhase, t.guidancePitch );
+        oStream << line;
+    }
+
+    return oStream.good();
+}
+
+// Each row is a bucket of samples with every channel's min and max over it, from the min/max pyramid.
+static bool WriteTelemetryEnvelope( const std::string& filename, const SweepEngine& engine, const FlightEnvironment& environment, const SweepConfig& config, uint32_t profile,
+                                    uint32_t bucketCount )
+{
+    std::ofstream oStream( filename );
+    if ( oStream.fail() )
+    {
+        fprintf( stderr, "%s: Failed to create file.\n", filename.c_str() );
+        return false;
+    }
+
+    TelemetryPyramid pyramid( environment );
+    for ( const TelemetryData& t : engine.GetProfileTelemetry( profile ) )
+        pyramid.Append( t );
+
+    std::vector<float2> envelopes[c_TelemetryChannelCount];
+
+    oStream << "startTime,endTime";
+    for ( uint32_t channel = 0; channel < c_TelemetryChannelCount; ++channel )
+    {
+        envelopes[channel].resize( bucketCount );
+        pyramid.GetEnvelope( TelemetryChannel( channel ), bucketCount, envelopes[channel].data() );
+
+        const char* name = GetTelemetryChannelName( TelemetryChannel( channel ) );
+        oStream << "," << name << "Min," << name << "Max";
+    }
+    oStream << "\n";
+
+    const float sampleTime = config.simulationStepSize * config.telemetryStepSize;
+    const uint32_t sampleCount = pyramid.GetSampleCount();
+
+    char line[64];
+    for ( uint32_t bucket = 0; bucket < bucketCount; ++bucket )
+    {
+        uint32_t begin = uint32_t( uint64_t( bucket ) * sampleCount / bucketCount );
+        uint32_t end = std::max( uint32_t( uint64_t( bucket + 1 ) * sampleCount / bucketCount ), begin + 1 );
+
+        snprintf( line, sizeof( line ), "%.2f,%.2f", (begin + 1) * sampleTime, end * sampleTime );
+        oStream << line;
+
+        for ( uint32_t channel = 0; channel < c_TelemetryChannelCount; ++channel )
+        {
+            snprintf( line, sizeof( line ), ",%.6g,%.6g", envelopes[channel][bucket].x, envelopes[channel][bucket].y );
+            oStream << line;
+        }
+        oStream << "\n";
+    }
+
+    return oStream.good();
+}
+
+// Prints the rest of a "Best profile" line and writes output with the profile added as "best".
+static bool WriteBestProfile( const std::string& filename, nlohmann::json& output, const AscentParams& ascentParams, const FlightData& flightData )
+{
+    printf( "pitch over %.3f m/s at %.4f\xc2\xb0, min mass %.3f t, max Q %.2f kPa, Ap %.3f km, Pe %.3f km\n",
+            ascentParams.pitchOverSpeed, asinf( ascentParams.sinPitchOverAngle ) * c_RadToDegree,
+            flightData.minMass / 1000.0f, flightData.maxQ / 1000.0f,
+            ((1.0f + flightData.e) * flightData.a - earthRadius) / 1000.0, ((1.0f - flightData.e) * flightData.a - earthRadius) / 1000.0 );
+
+    nlohmann::json& best = output["best"];
+    best = FlightDataToJson( flightData );
+    best["pitchOverSpeed"] = ascentParams.pitchOverSpeed;
+    best["pitchOverAngle"] = asinf( ascentParams.sinPitchOverAngle ) * c_RadToDegree;
+
+    std::ofstream oStream( filename );
+    if ( oStream.fail() )
+    {
+        fprintf( stderr, "%s: Failed to create file.\n", filename.c_str() );
+        return false;
+    }
+
+    oStream << output.dump( 4 ) << "\n";
+    return oStream.good();
+}
+
+// Refines the loaded grid, see RefineSweep, printing each level and writing them with the final best profile.
+static bool RunRefinement( const std::string& filename, SweepEngine& engine, const std::vector<AscentParams>& ascentParams, const RefinementConfig& config )
+{
+    // The ranges back from the grid, as RocketSim::MouseReleased reads them.
+    float minSpeed = ascentParams.front().pitchOverSpeed;
+    float maxSpeed = ascentParams.back().pitchOverSpeed;
+    float minAngle = asinf( ascentParams.front().sinPitchOverAngle );
+    float maxAngle = asinf( ascentParams[config.angleCount - 1].sinPitchOverAngle );
+
+    RefinementResult result;
+    bool found = RefineSweep( engine, config, minSpeed, maxSpeed, minAngle, maxAngle, earthRadius, earthMu, result );
+
+    printf( "level  speed (m/s)         step (m/s)  angle (deg)         step (deg)  swept  reused  time (s)\n" );
+
+    nlohmann::json output;
+    nlohmann::json& levels = output["levels"];
+
+    double totalTime = 0;
+    for ( uint32_t i = 0; i < result.levels.size(); ++i )
+    {
+        const RefinementLevel& level = result.levels[i];
+        float speedStep = (level.maxSpeed - level.minSpeed) / (config.speedCount - 1);
+        float angleStep = (level.maxAngle - level.minAngle) / (config.angleCount - 1) * c_RadToDegree;
+
+        printf( "%5u  %8.3f - %8.3f  %10.4f  %7.4f - %7.4f  %10.5f  %5u  %6u  %8.3f\n", i, level.minSpeed, level.maxSpeed, speedStep,
+                level.minAngle * c_RadToDegree, level.maxAngle * c_RadToDegree, angleStep, level.simulated, level.reused, level.time );
+        totalTime += level.time;
+
+        nlohmann::json j;
+        j["minSpeed"] = level.minSpeed;
+        j["maxSpeed"] = level.maxSpeed;
+        j["minAngle"] = level.minAngle * c_RadToDegree;
+        j["maxAngle"] = level.maxAngle * c_RadToDegree;
+        j["simulated"] = level.simulated;
+        j["reused"] = level.reused;
+        j["best"] = level.best != ~0u ? int64_t( level.best ) : -1;
+        levels.push_back( j );
+    }
+
+    if ( !found )
+    {
+        printf( "No profile reached MECO within the max Q limit.\n" );
+        return false;
+    }
+
+    printf( "Best profile in %.3f s: ", totalTime );
+    return WriteBestProfile( filename, output, result.bestParams, result.bestData );
+}
+
+// Searches for the best profile over the loaded grid's ranges, see OptimiseAscent.
+static bool RunOptimiser( const std::string& filename, SweepEngine& engine, const std::vector<AscentParams>& ascentParams, uint32_t angleCount, const OptimiserConfig& config )
+{
+    float minSpeed = ascentParams.front().pitchOverSpeed;
+    float maxSpeed = ascentParams.back().pitchOverSpeed;
+    float minAngle = asinf( ascentParams.front().sinPitchOverAngle );
+    float maxAngle = asinf( ascentParams[angleCount - 1].sinPitchOverAngle );
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    OptimiserResult result;
+    bool found = OptimiseAscent( engine, config, minSpeed, maxSpeed, minAngle, maxAngle, earthRadius, earthMu, result );
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf( "%s: %u profiles in %u generations, %s\n", GetOptimiserMethodName( config.method ), result.evaluations, result.generations,
+            result.converged ? "converged" : "stopped at the evaluation limit" );
+
+    if ( !found )
+    {
+        printf( "No profile reached MECO within the max Q limit.\n" );
+        return false;
+    }
+
+    nlohmann::json output;
+    output["method"] = GetOptimiserMethodName( config.method );
+    output["evaluations"] = result.evaluations;
+    output["generations"] = result.generations;
+    output["converged"] = result.converged;
+
+    printf( "Best profile in %.3f s: ", elapsed.count() );
+    return WriteBestProfile( filename, output, result.bestParams, result.bestData );
+}
+
+// Searches for the best profile over the loaded grid's ranges, see SearchWithSurrogate.
+static bool RunSurrogateSearch( const std::string& filename, SweepEngine& engine, ThreadPool& threadPool, const std::vector<AscentParams>& ascentParams,
+                                uint32_t angleCount, const SurrogateConfig& config )
+{
+    float minSpeed = ascentParams.front().pitchOverSpeed;
+    float maxSpeed = ascentParams.back().pitchOverSpeed;
+    float minAngle = asinf( ascentParams.front().sinPitchOverAngle );
+    float maxAngle = asinf( ascentParams[angleCount - 1].sinPitchOverAngle );
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    SurrogateResult result;
+    bool found = SearchWithSurrogate( engine, threadPool, config, minSpeed, maxSpeed, minAngle, maxAngle, earthRadius, earthMu, result );
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf( "Surrogate: %u profiles in %u sweeps\n", result.evaluations, result.iterations );
+
+    if ( !found )
+    {
+        printf( "No profile reached MECO within the max Q limit.\n" );
+        return false;
+    }
+
+    nlohmann::json output;
+    output["evaluations"] = result.evaluations;
+    output["sweeps"] = result.iterations;
+
+    nlohmann::json& history = output["history"];
+    for ( const std::pair<uint32_t, float>& entry : result.history )
+        history.push_back( { { "evaluations", entry.first }, { "objective", entry.second } } );
+
+    printf( "Best profile in %.3f s: ", elapsed.count() );
+    return WriteBestProfile( filename, output, result.bestParams, result.bestData );
+}
+
+// Loads and flies a sweep design, see RunSweepDesign, writing a row per point of its axes' values and results.
+static bool RunDesign( const CliOptions& options, const FlightEnvironment& environment, const MissionParams& missionParams, ThreadPool& threadPool )
+{
+    SweepDesign design;
+    try
+    {
+        std::string error;
+        if ( !ParseSweepDesign( LoadJsonFile( ResourceFile( options, options.designFile ) ), missionParams.stageCount, design, error ) )
+        {
+            fprintf( stderr, "%s: %s\n", options.designFile.c_str(), error.c_str() );
+            return false;
+        }
+    }
+    catch ( nlohmann::json::exception& e )
+    {
+        fprintf( stderr, "%s\n", e.what() );
+        return false;
+    }
+
+    DesignResult result;
+    RunSweepDesign( design, environment, missionParams, options.sweep, threadPool, earthRadius, earthMu, options.designBatchSize, result );
+
+    const uint32_t pointCount = design.GetPointCount();
+    printf( "Simulated %u points of %zu axes, %u missions in %u sweeps, in %.3f s on %u threads (%.0f profiles/s)\n", pointCount, design.axes.size(),
+            result.missions, result.sweeps, result.time, threadPool.GetThreadCount(), pointCount / result.time );
+
+    std::ofstream oStream( options.outputFile );
+    if ( oStream.fail() )
+    {
+        fprintf( stderr, "%s: Failed to create file.\n", options.outputFile.c_str() );
+        return false;
+    }
+
+    for ( const SweepAxis& axis : design.axes )
+    {
+        oStream << GetSweepParameterName( axis.parameter );
+        if ( axis.parameter == SweepParameter::ThrustScale || axis.parameter == SweepParameter::RotationRate )
+            oStream << "S" << axis.stage + 1;
+        oStream << ",";
+    }
+    oStream << "flightPhase,minMass,maxQ,maxAccel,finalApoapsis,finalPeriapsis,objective\n";
+
+    char line[256];
+    for ( uint32_t point = 0; point < pointCount; ++point )
+    {
+        const float* values = design.GetPoint( point );
+        for ( size_t a = 0; a < design.axes.size(); ++a )
+        {
+            snprintf( line, sizeof( line ), "%.9g,", values[a] );
+            oStream << line;
+        }
+
+        const FlightData& flightData = result.flightData[point];
+        snprintf( line, sizeof( line ), "%u,%.1f,%.1f,%.3f,%.1f,%.1f,", flightData.flightPhase, flightData.minMass, flightData.maxQ, flightData.maxAccel,
+                  (1.0f + flightData.e) * flightData.a - earthRadius, (1.0f - flightData.e) * flightData.a - earthRadius );
+        oStream << line;
+
+        // Left empty for flights that didn't reach MECO within the max Q limit.
+        if ( result.objective[point] < FLT_MAX )
+        {
+            snprintf( line, sizeof( line ), "%.3f", result.objective[point] );
+            oStream << line;
+        }
+        oStream << "\n";
+    }
+
+    return oStream.good();
+}
+
+static nlohmann::json StatisticToJson( const StreamingStatistic& statistic )
+{
+    nlohmann::json j;
+    j["mean"] = statistic.GetMean();
+    j["sigma"] = sqrt( statistic.GetVariance() );
+    j["min"] = statistic.GetMin();
+    j["max"] = statistic.GetMax();
+
+    nlohmann::json& quantiles = j["quantiles"];
+    for ( uint32_t q = 0; q < StreamingStatistic::c_QuantileCount; ++q )
+        quantiles.push_back( { { "p", StreamingStatistic::c_Quantiles[q] }, { "value", statistic.GetQuantile( q ) } } );
+
+    return j;
+}
+
+// Flies perturbed copies of a profile, see RunDispersion, printing and writing statistics of the results.
+static bool RunDispersionRuns( const CliOptions& options, const FlightEnvironment& environment, const MissionParams& missionParams, ThreadPool& threadPool,
+                               const AscentParams& ascentParams )
+{
+    DispersionResult result;
+    RunDispersion( ascentParams, environment, missionParams, options.sweep, options.dispersion, threadPool, earthRadius, earthMu, result, nullptr );
+
+    printf( "Dispersed %u runs in %.3f s (seed %u), %u reached MECO within the max Q limit\n", result.runs, result.time, options.dispersion.seed, result.mecoRuns );
+
+    const std::pair<const char*, const StreamingStatistic*> statistics[] =
+    {
+        { "apoapsis", &result.apoapsis },
+        { "periapsis", &result.periapsis },
+        { "orbitError", &result.orbitError },
+        { "minMass", &result.minMass },
+        { "maxQ", &result.maxQ },
+    };
+
+    printf( "%-10s  %12s  %10s  %12s  %12s  %12s\n", "", "mean", "sigma", "5%", "50%", "95%" );
+
+    nlohmann::json output;
+    output["pitchOverSpeed"] = ascentParams.pitchOverSpeed;
+    output["pitchOverAngle"] = asinf( ascentParams.sinPitchOverAngle ) * c_RadToDegree;
+    output["seed"] = options.dispersion.seed;
+    output["runs"] = result.runs;
+    output["mecoRuns"] = result.mecoRuns;
+
+    for ( const std::pair<const char*, const StreamingStatistic*>& entry : statistics )
+    {
+        const StreamingStatistic& statistic = *entry.second;
+        printf( "%-10s  %12.1f  %10.1f  %12.1f  %12.1f  %12.1f\n", entry.first, statistic.GetMean(), sqrt( statistic.GetVariance() ),
+                statistic.GetQuantile( 1 ), statistic.GetQuantile( 3 ), statistic.GetQuantile( 5 ) );
+        output[entry.first] = StatisticToJson( statistic );
+    }
+
+    std::ofstream oStream( options.outputFile );
+    if ( oStream.fail() )
+    {
+        fprintf( stderr, "%s: Failed to create file.\n", options.outputFile.c_str() );
+        return false;
+    }
+
+    oStream << output.dump( 4 ) << "\n";
+    return oStream.good();
+}
+
+// The json files in a directory, sorted, or the path itself if it isn't a directory.
+static std::vector<std::string> ListMissionFiles( const std::string& path )
+{
+    std::vector<std::string> files;
+
+    struct stat info;
+    if ( stat( path.c_str(), &info ) != 0 || !(info.st_mode & S_IFDIR) )
+    {
+        files.push_back( path );
+        return files;
+    }
+
+    auto isJson = [] ( const std::string& name ) { return name.size() > 5 && name.compare( name.size() - 5, 5, ".json" ) == 0; };
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    HANDLE find = FindFirstFileA( (path + "\\*.json").c_str(), &findData );
+    if ( find != INVALID_HANDLE_VALUE )
+    {
+        do
+        {
+            if ( !(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && isJson( findData.cFileName ) )
+                files.push_back( path + "/" + findData.cFileName );
+        } while ( FindNextFileA( find, &findData ) );
+        FindClose( find );
+    }
+#else
+    if ( DIR* dir = opendir( path.c_str() ) )
+    {
+        while ( dirent* entry = readdir( dir ) )
+        {
+            std::string file = path + "/" + entry->d_name;
+            if ( isJson( entry->d_name ) && stat( file.c_str(), &info ) == 0 && !(info.st_mode & S_IFDIR) )
+                files.push_back( file );
+        }
+        closedir( dir );
+    }
+#endif
+
+    std::sort( files.begin(), files.end() );
+    return files;
+}
+
+// Optimises every vehicle given with --vehicles over the loaded grid's ranges, see OptimiseVehicles.
+static bool RunVehicleBatch( const CliOptions& options, const FlightEnvironment& environment, const std::vector<AscentParams>& ascentParams, ThreadPool& threadPool )
+{
+    std::vector<std::string> files;
+    std::vector<MissionParams> vehicles;
+
+    for ( const std::string& path : options.vehiclePaths )
+    {
+        for ( const std::string& file : ListMissionFiles( ResourceFile( options, path ) ) )
+        {
+            MissionParams missionParams = {};
+            try
+            {
+                // A directory may hold other json files.
+                nlohmann::json missionJson = LoadJsonFile( file );
+                if ( missionJson.is_object() && missionJson.count( "stages" ) )
+                    ParseMissionParams( missionJson, earthRadius, earthMu, missionParams );
+            }
+            catch ( nlohmann::json::exception& e )
+            {
+                fprintf( stderr, "%s\n", e.what() );
+                return false;
+            }
+
+            if ( missionParams.stageCount == 0 )
+            {
+                fprintf( stderr, "%s: No valid stages, skipped.\n", file.c_str() );
+                continue;
+            }
+
+            files.push_back( file );
+            vehicles.push_back( missionParams );
+        }
+    }
+
+    if ( vehicles.empty() )
+    {
+        fprintf( stderr, "No vehicles to optimise.\n" );
+        return false;
+    }
+
+    VehicleBatchConfig config;
+    config.useOptimiser = options.optimise;
+    config.optimiser = options.optimiser;
+    config.refinement = options.refinement;
+
+    float minSpeed = ascentParams.front().pitchOverSpeed;
+    float maxSpeed = ascentParams.back().pitchOverSpeed;
+    float minAngle = asinf( ascentParams.front().sinPitchOverAngle );
+    float maxAngle = asinf( ascentParams[options.gridAngleCount - 1].sinPitchOverAngle );
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<VehicleResult> results;
+    OptimiseVehicles( environment, vehicles, options.sweep, config, threadPool, minSpeed, maxSpeed, minAngle, maxAngle, earthRadius, earthMu, results );
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf( "Optimised %zu vehicles by %s in %.3f s on %u threads\n", vehicles.size(), config.useOptimiser ? GetOptimiserMethodName( config.optimiser.method ) : "refinement",
+            elapsed.count(), threadPool.GetThreadCount() );
+    printf( "profiles  time (s)  speed (m/s)  angle (deg)  min mass (t)  max Q (kPa)  vehicle\n" );
+
+    nlohmann::json output;
+    nlohmann::json& entries = output["vehicles"];
+
+    for ( size_t v = 0; v < vehicles.size(); ++v )
+    {
+        const VehicleResult& result = results[v];
+
+        nlohmann::json entry;
+        entry["file"] = files[v];
+        entry["evaluations"] = result.evaluations;
+        entry["time"] = result.time;
+
+        if ( result.found )
+        {
+            printf( "%8u  %8.3f  %11.3f  %11.4f  %12.3f  %11.2f  %s\n", result.evaluations, result.time, result.bestParams.pitchOverSpeed,
+                    asinf( result.bestParams.sinPitchOverAngle ) * c_RadToDegree, result.bestData.minMass / 1000.0f, result.bestData.maxQ / 1000.0f, files[v].c_str() );
+
+            nlohmann::json& best = entry["best"];
+            best = FlightDataToJson( result.bestData );
+            best["pitchOverSpeed"] = result.bestParams.pitchOverSpeed;
+            best["pitchOverAngle"] = asinf( result.bestParams.sinPitchOverAngle ) * c_RadToDegree;
+        }
+        else
+        {
+            printf( "%8u  %8.3f  no profile reached MECO within the max Q limit  %s\n", result.evaluations, result.time, files[v].c_str() );
+        }
+
+        entries.push_back( entry );
+    }
+
+    std::ofstream oStream( options.outputFile );
+    if ( oStream.fail() )
+    {
+        fprintf( stderr, "%s: Failed to create file.\n", options.outputFile.c_str() );
+        return false;
+    }
+
+    oStream << output.dump( 4 ) << "\n";
+    return oStream.good();
+}
+
+//------------------------------------------------------------------------------------------------
+
+// This program with the same inputs, less the options only the coordinator acts on, and the threads shared
+// out between the workers unless --threads says otherwise.
+static std::vector<std::string> MakeWorkerCommand( int argc, char* argv[], const CliOptions& options )
+{
+    static const char* const c_CoordinatorOptions[] = { "--workers", "--shard-size", "--shard-timeout", "--kill-worker", "--output", "--bench" };
+
+    uint32_t threadCount = std::max( std::thread::hardware_concurrency() / options.shards.workerCount, 1u );
+    std::vector<std::string> command = { argv[0], "--threads", std::to_string( threadCount ) };
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        auto isCoordinatorOption = [arg = argv[i]] ( const char* option ) { return !strcmp( arg, option ); };
+        if ( std::any_of( std::begin( c_CoordinatorOptions ), std::end( c_CoordinatorOptions ), isCoordinatorOption ) )
+            ++i;
+        else
+            command.push_back( argv[i] );
+    }
+
+    command.push_back( "--cold-guidance" );
+    command.push_back( "--shard-worker" );
+    return command;
+}
+
+// Flies the sweep on worker processes, see RunShardedSweep, and writes what a single process sweep would.
+static bool RunShardCoordinator( const CliOptions& options, const std::vector<std::string>& workerCommand, const FlightEnvironment& environment,
+                                 const MissionParams& missionParams, const std::vector<AscentParams>& ascentParams, ThreadPool& threadPool )
+{
+    std::vector<FlightData> flightData;
+    ShardStats stats;
+    if ( !RunShardedSweep( workerCommand, environment, missionParams, options.sweep, threadPool, ascentParams, options.shards, flightData, stats ) )
+        return false;
+
+    const uint32_t profileCount = static_cast<uint32_t>(ascentParams.size());
+
+    printf( "Simulated %u profiles in %u shards on %u workers in %.3f s, %u reassigned, %u workers lost, %u flown here\n", profileCount, stats.shards,
+            options.shards.workerCount, stats.time, stats.reassigned, stats.workersLost, stats.localShards );
+    printf( "Shards per worker:" );
+    for ( uint32_t shards : stats.workerShards )
+        printf( " %u", shards );
+    printf( "\n" );
+
+    uint32_t selected = SelectBestFlight( flightData.data(), profileCount, flightData[profileCount + 1].minMass, missionParams, earthRadius, earthMu );
+    PrintSelectedProfile( flightData, ascentParams, selected );
+
+    return WriteFlightData( options.outputFile, flightData, missionParams, ascentParams, options.sweep, selected );
+}
+
+//------------------------------------------------------------------------------------------------
+
+int main( int argc, char* argv[] )
+{
+    CliOptions options;
+    if ( !ParseOptions( argc, argv, options ) )
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if ( options.help )
+    {
+        PrintUsage();
+        return 0;
+    }
+
+    options.sweep.recordTelemetry = !options.telemetryFile.empty() && !options.refine && !options.optimise && !options.surrogate && !options.disperse;
+
+    FlightEnvironment environment;
+    MissionParams missionParams;
+    std::vector<AscentParams> ascentParams;
+
+    if ( !LoadInputs( options, environment, missionParams, ascentParams ) )
+        return 1;
+
+    ThreadPool threadPool( options.threadCount );
+
+    if ( !options.benchmark.empty() )
+    {
+        std::vector<std::string> workerCommand = MakeWorkerCommand( argc, argv, options );
+        BenchmarkContext context = { environment, missionParams, ascentParams, options.gridAngleCount, options.sweep, threadPool, earthRadius, earthMu, workerCommand };
+        return RunBenchmark( options.benchmark, context ) ? 0 : 1;
+    }
+
+    // Results go to stdout, which RunShardWorker keeps to itself.
+    if ( options.shardWorker )
+        return RunShardWorker( environment, missionParams, options.sweep, threadPool, 0, 1 ) ? 0 : 1;
+
+    if ( options.sharded )
+        return RunShardCoordinator( options, MakeWorkerCommand( argc, argv, options ), environment, missionParams, ascentParams, threadPool ) ? 0 : 1;
+
+    if ( !options.vehiclePaths.empty() )
+        return RunVehicleBatch( options, environment, ascentParams, threadPool ) ? 0 : 1;
+
+    if ( !options.designFile.empty() )
+        return RunDesign( options, environment, missionParams, threadPool ) ? 0 : 1;
+
+    SweepEngine engine( environment, missionParams, options.sweep, threadPool );
+
+    SweepCache cache( options.cacheDirectory );
+    if ( !options.cacheDirectory.empty() )
+    {
+        engine.SetResultCache( &cache );
+        if ( !cache.IsOpen() )
+        {
+            fprintf( stderr, "%s: Failed to open the result cache.\n", options.cacheDirectory.c_str() );
+            return 1;
+        }
+    }
+
+    if ( options.refine )
+        return RunRefinement( options.outputFile, engine, ascentParams, options.refinement ) ? 0 : 1;
+
+    if ( options.optimise )
+        return RunOptimiser( options.outputFile, engine, ascentParams, options.gridAngleCount, options.optimiser ) ? 0 : 1;
+
+    if ( options.surrogate )
+        return RunSurrogateSearch( options.outputFile, engine, threadPool, ascentParams, options.gridAngleCount, options.surrogateSearch ) ? 0 : 1;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    engine.Run( ascentParams );
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf( "Simulated %u profiles x %u steps in %.3f s on %u threads (simd: %s)\n", engine.GetProfileCount(), engine.GetTotalSteps(), elapsed.count(),
+            threadPool.GetThreadCount(), GetSimdLevelName( engine.GetSimdLevel() ) );
+
+    if ( cache.IsOpen() )
+        printf( "Read %u of %u profiles from the cache, %u results held\n", engine.GetCacheHits(), engine.GetProfileCount(), cache.GetEntryCount() );
+
+    if ( options.sweep.recordTelemetry && options.sweep.telemetryProfiles > 0 )
+        engine.StoreTelemetry( engine.RankProfiles( earthRadius, earthMu, options.sweep.telemetryProfiles ) );
+
+    uint32_t selected = engine.SelectBestProfile( earthRadius, earthMu );
+    PrintSelectedProfile( engine.GetFlightData(), ascentParams, selected );
+
+    if ( options.disperse )
+    {
+        if ( selected >= engine.GetProfileCount() )
+            return 1;
+
+        return RunDispersionRuns( options, environment, missionParams, threadPool, ascentParams[selected] ) ? 0 : 1;
+    }
+
+    if ( !WriteFlightData( options.outputFile, engine.GetFlightData(), engine.GetMissionParams(), ascentParams, options.sweep, selected ) )
+        return 1;
+
+    if ( !options.telemetryFile.empty() && selected < engine.GetProfileCount() )
+    {
+        bool written = options.telemetryPoints > 0 ? WriteTelemetryEnvelope( options.telemetryFile, engine, environment, options.sweep, selected, options.telemetryPoints )
+                                                   : WriteTelemetry( options.telemetryFile, engine, options.sweep, selected );
+        if ( !written )
+            return 1;
+    }
+
+    return 0;
+}
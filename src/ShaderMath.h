@@ -0,0 +1,137 @@
+#pragma once
+
+#include <math.h>
+
+#include "resources/data_formats.h"
+
+//------------------------------------------------------------------------------------------------
+// HLSL style vector maths for the CPU ports of the simulation shaders.
+// min/max follow HLSL semantics and return the non-NaN operand, hence fminf/fmaxf.
+
+namespace ShaderShared
+{
+
+inline float sqr( float x )
+{
+    return x * x;
+}
+
+inline float cube( float x )
+{
+    return x * x * x;
+}
+
+inline float lerp( float a, float b, float t )
+{
+    return a + (b - a) * t;
+}
+
+//------------------------------------------------------------------------------------------------
+
+inline float2 operator+( const float2& lhs, const float2& rhs )
+{
+    return float2( lhs.x + rhs.x, lhs.y + rhs.y );
+}
+
+inline float2 operator-( const float2& lhs, const float2& rhs )
+{
+    return float2( lhs.x - rhs.x, lhs.y - rhs.y );
+}
+
+inline float2 operator-( const float2& v )
+{
+    return float2( -v.x, -v.y );
+}
+
+inline float2 operator*( const float2& v, float s )
+{
+    return float2( v.x * s, v.y * s );
+}
+
+inline float2 operator*( float s, const float2& v )
+{
+    return float2( v.x * s, v.y * s );
+}
+
+inline float2 operator/( const float2& v, float s )
+{
+    return float2( v.x / s, v.y / s );
+}
+
+inline float2& operator+=( float2& lhs, const float2& rhs )
+{
+    lhs.x += rhs.x;
+    lhs.y += rhs.y;
+    return lhs;
+}
+
+inline float2& operator-=( float2& lhs, const float2& rhs )
+{
+    lhs.x -= rhs.x;
+    lhs.y -= rhs.y;
+    return lhs;
+}
+
+inline float dot( const float2& lhs, const float2& rhs )
+{
+    return lhs.x * rhs.x + lhs.y * rhs.y;
+}
+
+inline float length( const float2& v )
+{
+    return sqrtf( dot( v, v ) );
+}
+
+inline float2 normalize( const float2& v )
+{
+    return v / length( v );
+}
+
+inline float2 lerp( const float2& a, const float2& b, float t )
+{
+    return a + (b - a) * t;
+}
+
+//------------------------------------------------------------------------------------------------
+
+inline float3 operator*( const float3& v, float s )
+{
+    return float3( v.x * s, v.y * s, v.z * s );
+}
+
+inline float3 operator*( float s, const float3& v )
+{
+    return float3( v.x * s, v.y * s, v.z * s );
+}
+
+inline float3 operator/( const float3& v, float s )
+{
+    return float3( v.x / s, v.y / s, v.z / s );
+}
+
+inline float dot( const float3& lhs, const float3& rhs )
+{
+    return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z;
+}
+
+inline float3 cross( const float3& lhs, const float3& rhs )
+{
+    return float3( lhs.y * rhs.z - lhs.z * rhs.y, lhs.z * rhs.x - lhs.x * rhs.z, lhs.x * rhs.y - lhs.y * rhs.x );
+}
+
+inline float length( const float3& v )
+{
+    return sqrtf( dot( v, v ) );
+}
+
+inline float3 normalize( const float3& v )
+{
+    return v / length( v );
+}
+
+inline float2 xy( const float3& v )
+{
+    return float2( v.x, v.y );
+}
+
+}
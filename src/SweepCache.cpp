@@ -0,0 +1,275 @@
+#include "SweepCache.h"
+#include "SweepEngine.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+    // Bump whenever a change to the simulation changes what a flight comes out as, orphaning every pack.
+    const uint32_t  c_SweepCacheVersion = 1;
+    const uint32_t  c_SweepCacheMagic = 0x43535352;     // "RSSC"
+
+    struct PackHeader
+    {
+        uint32_t    magic;
+        uint32_t    version;
+        uint64_t    contextHash;
+    };
+
+    const uint64_t  c_FnvOffset = 0xcbf29ce484222325ull;
+    const uint64_t  c_FnvPrime = 0x100000001b3ull;
+
+    uint64_t HashBytes( uint64_t hash, const void* data, size_t size )
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for ( size_t i = 0; i < size; ++i )
+        {
+            hash ^= bytes[i];
+            hash *= c_FnvPrime;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    uint64_t HashValue( uint64_t hash, const T& value )
+    {
+        return HashBytes( hash, &value, sizeof( T ) );
+    }
+
+    uint64_t HashCurve( uint64_t hash, const HermiteCurve& curve )
+    {
+        hash = HashValue( hash, uint64_t( curve.keys.size() ) );
+        return HashBytes( hash, curve.keys.data(), curve.keys.size() * sizeof( float4 ) );
+    }
+
+    // Sample count and samples follow the FlightData.
+    const size_t    c_RecordHeaderSize = sizeof( uint64_t ) + sizeof( FlightData ) + sizeof( uint32_t );
+
+    void AppendBytes( std::vector<char>& buffer, const void* data, size_t size )
+    {
+        const char* bytes = static_cast<const char*>(data);
+        buffer.insert( buffer.end(), bytes, bytes + size );
+    }
+
+    void MakeDirectory( const std::string& directory )
+    {
+#ifdef _WIN32
+        _mkdir( directory.c_str() );
+#else
+        mkdir( directory.c_str(), 0755 );
+#endif
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+uint64_t CalcSweepContextHash( const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& config )
+{
+    // Only the settings that change what a flight comes out as, not how the sweep is laid out or what it keeps.
+    uint64_t hash = HashValue( c_FnvOffset, c_SweepCacheVersion );
+    hash = HashValue( hash, environment.params );
+    hash = HashCurve( hash, environment.pressureHeight );
+    hash = HashCurve( hash, environment.temperatureHeight );
+    for ( const HermiteCurve& curve : environment.liftMach )
+        hash = HashCurve( hash, curve );
+    for ( const HermiteCurve& curve : environment.dragMach )
+        hash = HashCurve( hash, curve );
+    hash = HashValue( hash, missionParams );
+    hash = HashValue( hash, config.simulationStepSize );
+    hash = HashValue( hash, config.telemetryStepSize );
+    hash = HashValue( hash, config.flightTime );
+    hash = HashValue( hash, config.stepsPerBatch );
+    hash = HashValue( hash, config.coastMode );
+    hash = HashValue( hash, config.simdLevel );
+    hash = HashValue( hash, config.integrator );
+    hash = HashValue( hash, config.tolerance );
+    hash = HashValue( hash, config.shareLiftoff );
+    hash = HashValue( hash, config.warmStartGuidance );
+    hash = HashValue( hash, config.curveCursors );
+
+    return hash;
+}
+
+//------------------------------------------------------------------------------------------------
+
+SweepCache::SweepCache( const std::string& directory ) :
+    m_directory( directory )
+{
+}
+
+bool SweepCache::Open( const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& config )
+{
+    Close();
+
+    m_contextHash = CalcSweepContextHash( environment, missionParams, config );
+
+    char name[32];
+    snprintf( name, sizeof( name ), "%016llx.rsc", static_cast<unsigned long long>(m_contextHash) );
+    m_packPath = m_directory + "/" + name;
+    const std::string& path = m_packPath;
+
+    m_file.open( path, std::ios::in | std::ios::out | std::ios::binary );
+    if ( !m_file.is_open() )
+    {
+        MakeDirectory( m_directory );
+
+        PackHeader header = { c_SweepCacheMagic, c_SweepCacheVersion, m_contextHash };
+        std::ofstream create( path, std::ios::binary | std::ios::trunc );
+        create.write( reinterpret_cast<const char*>(&header), sizeof( header ) );
+        create.close();
+
+        m_file.open( path, std::ios::in | std::ios::out | std::ios::binary );
+        if ( !m_file.is_open() )
+            return false;
+    }
+
+    m_file.seekg( 0, std::ios::end );
+    const uint64_t fileSize = static_cast<uint64_t>(m_file.tellg());
+    m_file.seekg( 0 );
+
+    PackHeader header = {};
+    m_file.read( reinterpret_cast<char*>(&header), sizeof( header ) );
+    if ( !m_file || header.magic != c_SweepCacheMagic || header.version != c_SweepCacheVersion || header.contextHash != m_contextHash )
+    {
+        m_file.close();
+        return false;
+    }
+
+    // Up to the last record written in full, Flush writes over anything after it.
+    uint64_t offset = sizeof( header );
+    while ( offset + c_RecordHeaderSize <= fileSize )
+    {
+        uint64_t key;
+        Entry entry;
+        m_file.seekg( offset );
+        m_file.read( reinterpret_cast<char*>(&key), sizeof( key ) );
+        m_file.read( reinterpret_cast<char*>(&entry.flightData), sizeof( entry.flightData ) );
+        m_file.read( reinterpret_cast<char*>(&entry.sampleCount), sizeof( entry.sampleCount ) );
+        if ( !m_file )
+            break;
+
+        entry.telemetryOffset = offset + c_RecordHeaderSize;
+        const uint64_t end = entry.telemetryOffset + uint64_t( entry.sampleCount ) * sizeof( CompactTelemetry );
+        if ( end > fileSize )
+            break;
+
+        m_index[key] = entry;
+        offset = end;
+    }
+
+    m_file.clear();
+    m_fileEnd = offset;
+    return true;
+}
+
+void SweepCache::Close()
+{
+    if ( m_file.is_open() )
+    {
+        Flush();
+        m_file.close();
+    }
+
+    m_index.clear();
+    m_pending.clear();
+    m_fileEnd = 0;
+}
+
+//------------------------------------------------------------------------------------------------
+
+uint64_t SweepCache::CalcKey( const AscentParams& ascentParams ) const
+{
+    return HashValue( HashValue( c_FnvOffset, m_contextHash ), ascentParams );
+}
+
+bool SweepCache::Find( const AscentParams& ascentParams, FlightData& flightData, std::vector<CompactTelemetry>* telemetry )
+{
+    auto found = m_index.find( CalcKey( ascentParams ) );
+    if ( found == m_index.end() )
+        return false;
+
+    const Entry& entry = found->second;
+    flightData = entry.flightData;
+
+    if ( telemetry )
+    {
+        if ( entry.telemetryOffset >= m_fileEnd && !Flush() )
+            return false;
+
+        telemetry->resize( entry.sampleCount );
+        if ( entry.sampleCount > 0 )
+        {
+            m_file.seekg( entry.telemetryOffset );
+            m_file.read( reinterpret_cast<char*>(telemetry->data()), std::streamsize( entry.sampleCount ) * sizeof( CompactTelemetry ) );
+            if ( !m_file )
+            {
+                m_file.clear();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool SweepCache::HasTelemetry( const AscentParams& ascentParams ) const
+{
+    auto found = m_index.find( CalcKey( ascentParams ) );
+    return found != m_index.end() && found->second.sampleCount > 0;
+}
+
+void SweepCache::Store( const AscentParams& ascentParams, const FlightData& flightData, const CompactTelemetry* telemetry, uint32_t sampleCount )
+{
+    if ( !m_file.is_open() )
+        return;
+
+    if ( !telemetry )
+        sampleCount = 0;
+
+    // Indexed now at the offset Flush will write it to, a later result for the same flight replaces it.
+    const uint64_t key = CalcKey( ascentParams );
+
+    Entry& entry = m_index[key];
+    entry.flightData = flightData;
+    entry.telemetryOffset = m_fileEnd + m_pending.size() + c_RecordHeaderSize;
+    entry.sampleCount = sampleCount;
+
+    AppendBytes( m_pending, &key, sizeof( key ) );
+    AppendBytes( m_pending, &flightData, sizeof( flightData ) );
+    AppendBytes( m_pending, &sampleCount, sizeof( sampleCount ) );
+    AppendBytes( m_pending, telemetry, size_t( sampleCount ) * sizeof( CompactTelemetry ) );
+}
+
+bool SweepCache::Flush()
+{
+    if ( !m_file.is_open() )
+        return false;
+
+    if ( m_pending.empty() )
+        return true;
+
+    m_file.seekp( m_fileEnd );
+    m_file.write( m_pending.data(), std::streamsize( m_pending.size() ) );
+    m_file.flush();
+
+    if ( !m_file )
+    {
+        m_file.clear();
+        return false;
+    }
+
+    m_fileEnd += m_pending.size();
+    m_pending.clear();
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FlightEnvironment.h"
+#include "FlightTelemetry.h"
+
+struct SweepConfig;
+
+//------------------------------------------------------------------------------------------------
+// On disk cache of flight results, keyed by a hash of everything a flight depends on: the environment
+// params and every curve's keys, the mission params, the sweep settings that change results, the cache
+// version and the flight's ascent params. A sweep flies only the profiles it has no result for, so rerunning
+// a sweep, or one that overlaps it, reads back what was flown before.
+//
+// Everything but the ascent params is the context, hashed once. Each context's results are appended to a
+// pack file of their own in the cache directory, named by the context hash, holding each flight's key,
+// FlightData and telemetry if it was recorded. FlightData is indexed in memory when a pack is opened,
+// telemetry is read from the file when asked for.
+//
+// Hashes are 64 bit FNV-1a, so a collision is as good as impossible at any sweep size but not guarded against.
+// With warm started guidance a flight depends on the neighbours its solve was seeded from, enough to change
+// its flight phase, so cached results would depend on which sweeps filled the cache. Engines only take a cache
+// with warm starts off, see SweepEngine::SetResultCache.
+
+// Hash of everything but the ascent params a flight depends on, which names a context's pack. Also lets
+// processes check they loaded the same inputs.
+uint64_t    CalcSweepContextHash( const FlightEnvironment& environment, const ShaderShared::MissionParams& missionParams, const SweepConfig& config );
+
+class SweepCache
+{
+public:
+    explicit SweepCache( const std::string& directory );
+
+    // Opens the context's pack, creating it and the directory if there isn't one, and reads its index. A record
+    // cut short by a crash is dropped. Returns false if the pack can't be read or created. config.simdLevel
+    // should be the level the engine actually flies at.
+    bool        Open( const FlightEnvironment& environment, const ShaderShared::MissionParams& missionParams, const SweepConfig& config );
+
+    // Flushes and closes the pack, leaving it on disk.
+    void        Close();
+
+    bool        IsOpen() const { return m_file.is_open(); }
+    const std::string&  GetPackPath() const { return m_packPath; }
+    uint64_t    GetContextHash() const { return m_contextHash; }
+    uint32_t    GetEntryCount() const { return static_cast<uint32_t>(m_index.size()); }
+
+    // Looks up a flight's result. telemetry, if not null, is filled with its samples, or left empty if none
+    // were stored.
+    bool        Find( const ShaderShared::AscentParams& ascentParams, ShaderShared::FlightData& flightData, std::vector<CompactTelemetry>* telemetry );
+
+    // Whether the flight has telemetry stored, without reading it.
+    bool        HasTelemetry( const ShaderShared::AscentParams& ascentParams ) const;
+
+    // Queues a result to append on the next Flush, a Find for it before then reads the FlightData but flushes
+    // to read the telemetry. telemetry may be null.
+    void        Store( const ShaderShared::AscentParams& ascentParams, const ShaderShared::FlightData& flightData, const CompactTelemetry* telemetry, uint32_t sampleCount );
+
+    // Appends the queued results to the pack. Returns false if the write failed.
+    bool        Flush();
+
+private:
+    struct Entry
+    {
+        ShaderShared::FlightData    flightData;
+        uint64_t    telemetryOffset;    // In the pack file
+        uint32_t    sampleCount;
+    };
+
+    uint64_t    CalcKey( const ShaderShared::AscentParams& ascentParams ) const;
+
+    std::string     m_directory;
+    std::string     m_packPath;
+    std::fstream    m_file;
+    uint64_t        m_fileEnd = 0;      // Of the last complete record
+    uint64_t        m_contextHash = 0;
+
+    std::unordered_map<uint64_t, Entry>     m_index;
+    std::vector<char>                       m_pending;      // Records not yet written, in file layout
+};
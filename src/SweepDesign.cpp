@@ -0,0 +1,361 @@
+#include "SweepDesign.h"
+#include "FlightAnalysis.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+static const char* const c_SweepParameterNames[] = { "pitchOverSpeed", "pitchOverAngle", "thrustScale", "rotationRate", "apoapsis", "periapsis", "launchLatitude" };
+
+const char* GetSweepParameterName( SweepParameter parameter )
+{
+    return c_SweepParameterNames[uint32_t( parameter )];
+}
+
+bool ParseSweepParameter( const char* name, SweepParameter& parameter )
+{
+    for ( uint32_t i = 0; i < sizeof( c_SweepParameterNames ) / sizeof( c_SweepParameterNames[0] ); ++i )
+    {
+        if ( !strcmp( name, c_SweepParameterNames[i] ) )
+        {
+            parameter = SweepParameter( i );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------------------------
+
+static const float     c_DegreeToRad = 3.14159265f / 180.0f;
+
+// Halton bases, one per axis.
+static const uint32_t  c_Primes[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53 };
+static const uint32_t  c_MaxAxes = sizeof( c_Primes ) / sizeof( c_Primes[0] );
+
+namespace
+{
+    double RadicalInverse( uint32_t i, uint32_t base )
+    {
+        double inverse = 0, scale = 1.0 / base;
+        for ( ; i > 0; i /= base, scale /= base )
+            inverse += (i % base) * scale;
+
+        return inverse;
+    }
+
+    float GetLevel( const SweepAxis& axis, uint32_t level )
+    {
+        return axis.count > 1 ? axis.min + (axis.max - axis.min) * float( level ) / float( axis.count - 1 ) : axis.min;
+    }
+
+    bool IsStageParameter( SweepParameter parameter )
+    {
+        return parameter == SweepParameter::ThrustScale || parameter == SweepParameter::RotationRate;
+    }
+}
+
+bool MakeGridDesign( const std::vector<SweepAxis>& axes, SweepDesign& design )
+{
+    uint64_t count = 1;
+    for ( const SweepAxis& axis : axes )
+    {
+        count *= axis.count;
+        if ( count > ~0u )
+            return false;
+    }
+
+    design.axes = axes;
+    design.values.resize( size_t( count ) * axes.size() );
+
+    for ( uint32_t point = 0; point < uint32_t( count ); ++point )
+    {
+        float* values = &design.values[size_t( point ) * axes.size()];
+
+        // Last axis varies fastest.
+        uint32_t index = point;
+        for ( size_t a = axes.size(); a-- > 0; )
+        {
+            values[a] = GetLevel( axes[a], index % axes[a].count );
+            index /= axes[a].count;
+        }
+    }
+
+    return true;
+}
+
+void MakeSampledDesign( const std::vector<SweepAxis>& axes, uint32_t count, SweepDesign& design )
+{
+    design.axes = axes;
+    design.values.resize( size_t( count ) * axes.size() );
+
+    for ( uint32_t point = 0; point < count; ++point )
+    {
+        float* values = &design.values[size_t( point ) * axes.size()];
+
+        for ( size_t a = 0; a < axes.size(); ++a )
+        {
+            const SweepAxis& axis = axes[a];
+            float u = float( RadicalInverse( point + 1, c_Primes[a] ) );
+
+            if ( IsMissionParameter( axis.parameter ) )
+                values[a] = GetLevel( axis, std::min( uint32_t( u * axis.count ), axis.count - 1 ) );
+            else
+                values[a] = axis.min + (axis.max - axis.min) * u;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+bool ParseSweepDesign( const nlohmann::json& designJson, uint32_t stageCount, SweepDesign& design, std::string& error )
+{
+    std::vector<SweepAxis> axes;
+
+    for ( const nlohmann::json& axisJson : designJson["axes"] )
+    {
+        std::string name = axisJson.value( "parameter", std::string() );
+
+        SweepAxis axis;
+        if ( !ParseSweepParameter( name.c_str(), axis.parameter ) )
+        {
+            error = "Unknown sweep parameter \"" + name + "\".";
+            return false;
+        }
+
+        axis.stage = 0;
+        if ( IsStageParameter( axis.parameter ) )
+        {
+            int stage = axisJson.value( "stage", 0 );
+            if ( stage < 1 || stage > int( stageCount ) )
+            {
+                error = name + " needs a stage from 1 to " + std::to_string( stageCount ) + ".";
+                return false;
+            }
+            axis.stage = uint32_t( stage - 1 );
+        }
+
+        axis.min = axisJson.value( "min", 0.0f );
+        axis.max = axisJson.value( "max", axis.min );
+        axis.count = axisJson.value( "count", 1u );
+
+        if ( axis.count == 0 || axis.max < axis.min )
+        {
+            error = name + " needs a count of at least 1 and max no less than min.";
+            return false;
+        }
+
+        bool valid = true;
+        switch ( axis.parameter )
+        {
+        case SweepParameter::PitchOverSpeed:
+        case SweepParameter::RotationRate:
+            valid = axis.min > 0.0f;
+            break;
+        case SweepParameter::ThrustScale:
+            valid = axis.min > 0.0f && axis.max <= 1.0f;
+            break;
+        case SweepParameter::PitchOverAngle:
+            valid = axis.min >= 0.0f && axis.max < 90.0f;
+            break;
+        case SweepParameter::Apoapsis:
+        case SweepParameter::Periapsis:
+            valid = axis.min >= 0.0f;
+            break;
+        case SweepParameter::LaunchLatitude:
+            valid = axis.min >= -90.0f && axis.max <= 90.0f;
+            break;
+        }
+
+        if ( !valid )
+        {
+            error = name + " range is out of bounds.";
+            return false;
+        }
+
+        for ( const SweepAxis& other : axes )
+        {
+            if ( other.parameter == axis.parameter && other.stage == axis.stage )
+            {
+                error = name + " is swept twice.";
+                return false;
+            }
+        }
+
+        axes.push_back( axis );
+    }
+
+    for ( SweepParameter parameter : { SweepParameter::PitchOverSpeed, SweepParameter::PitchOverAngle } )
+    {
+        if ( std::none_of( axes.begin(), axes.end(), [parameter] ( const SweepAxis& axis ) { return axis.parameter == parameter; } ) )
+        {
+            error = std::string( "No " ) + GetSweepParameterName( parameter ) + " axis.";
+            return false;
+        }
+    }
+
+    if ( axes.size() > c_MaxAxes )
+    {
+        error = "At most " + std::to_string( c_MaxAxes ) + " axes can be swept.";
+        return false;
+    }
+
+    uint32_t samples = designJson.value( "samples", 0u );
+    if ( samples > 0 )
+    {
+        MakeSampledDesign( axes, samples, design );
+    }
+    else if ( !MakeGridDesign( axes, design ) )
+    {
+        error = "Grid has too many points, use a sampled design.";
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void ApplyDesignPoint( const SweepDesign& design, const float* point, double earthRadius, double earthMu, FlightEnvironment& environment, MissionParams& missionParams )
+{
+    // Target orbit as loaded, for the altitude not swept.
+    double a = -earthMu / (2.0 * missionParams.finalOrbitalEnergy);
+    double periapsis = missionParams.finalState.r - earthRadius;
+    double apoapsis = 2.0 * a - missionParams.finalState.r - earthRadius;
+    bool orbitSwept = false;
+
+    for ( size_t i = 0; i < design.axes.size(); ++i )
+    {
+        const SweepAxis& axis = design.axes[i];
+        StageData& stage = missionParams.stage[axis.stage];
+
+        switch ( axis.parameter )
+        {
+        case SweepParameter::ThrustScale:
+            // A scale of the limited thrust rather than a limit of its own, the full thrust isn't kept.
+            stage.massFlow *= point[i];
+            break;
+        case SweepParameter::RotationRate:
+            stage.rotationRate = point[i] * c_DegreeToRad;
+            break;
+        case SweepParameter::Apoapsis:
+            apoapsis = point[i];
+            orbitSwept = true;
+            break;
+        case SweepParameter::Periapsis:
+            periapsis = point[i];
+            orbitSwept = true;
+            break;
+        case SweepParameter::LaunchLatitude:
+            environment.params.launchLatitude = point[i];
+            break;
+        default:
+            break;
+        }
+    }
+
+    if ( orbitSwept )
+        SetMissionOrbit( std::max( apoapsis, periapsis ), std::min( apoapsis, periapsis ), earthRadius, earthMu, missionParams );
+}
+
+//------------------------------------------------------------------------------------------------
+
+void RunSweepDesign( const SweepDesign& design, const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& config,
+                     ThreadPool& threadPool, double earthRadius, double earthMu, uint32_t batchSize, DesignResult& result )
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const uint32_t pointCount = design.GetPointCount();
+    const size_t axisCount = design.axes.size();
+
+    std::vector<size_t> missionAxes;
+    size_t speedAxis = 0, angleAxis = 0;
+    for ( size_t a = 0; a < axisCount; ++a )
+    {
+        if ( design.axes[a].parameter == SweepParameter::PitchOverSpeed )
+            speedAxis = a;
+        else if ( design.axes[a].parameter == SweepParameter::PitchOverAngle )
+            angleAxis = a;
+        else
+            missionAxes.push_back( a );
+    }
+
+    // Points ordered by mission, and within a mission as the design has them, so neighbours in a sweep stay
+    // neighbours for the guidance warm start.
+    auto compareMissions = [&design, &missionAxes] ( uint32_t a, uint32_t b )
+    {
+        const float* pa = design.GetPoint( a );
+        const float* pb = design.GetPoint( b );
+        for ( size_t axis : missionAxes )
+        {
+            if ( pa[axis] != pb[axis] )
+                return pa[axis] < pb[axis] ? -1 : 1;
+        }
+        return 0;
+    };
+
+    std::vector<uint32_t> order( pointCount );
+    std::iota( order.begin(), order.end(), 0u );
+    std::stable_sort( order.begin(), order.end(), [&compareMissions] ( uint32_t a, uint32_t b ) { return compareMissions( a, b ) < 0; } );
+
+    SweepConfig sweepConfig = config;
+    sweepConfig.recordTelemetry = false;
+    batchSize = std::max( batchSize, 1u );
+
+    result.flightData.resize( pointCount );
+    result.objective.resize( pointCount );
+    result.missions = 0;
+    result.sweeps = 0;
+
+    std::vector<AscentParams> ascentParams;
+
+    for ( uint32_t first = 0; first < pointCount; )
+    {
+        uint32_t last = first + 1;
+        while ( last < pointCount && compareMissions( order[first], order[last] ) == 0 )
+            ++last;
+
+        // The engine holds on to both, so they live until it's done with them.
+        FlightEnvironment missionEnvironment = environment;
+        MissionParams mission = missionParams;
+        ApplyDesignPoint( design, design.GetPoint( order[first] ), earthRadius, earthMu, missionEnvironment, mission );
+
+        SweepEngine engine( missionEnvironment, mission, sweepConfig, threadPool );
+
+        for ( uint32_t begin = first; begin < last; begin += batchSize )
+        {
+            uint32_t end = std::min( begin + batchSize, last );
+
+            ascentParams.resize( end - begin );
+            for ( uint32_t i = begin; i < end; ++i )
+            {
+                const float* point = design.GetPoint( order[i] );
+                ascentParams[i - begin] = MakeAscentParams( point[speedAxis], point[angleAxis] * c_DegreeToRad );
+            }
+
+            engine.Run( ascentParams );
+            ++result.sweeps;
+
+            const std::vector<FlightData>& flightData = engine.GetFlightData();
+            for ( uint32_t i = begin; i < end; ++i )
+            {
+                result.flightData[order[i]] = flightData[i - begin];
+                result.objective[order[i]] = CalcSelectionObjective( flightData[i - begin], mission, earthRadius, earthMu );
+            }
+        }
+
+        ++result.missions;
+        first = last;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.time = elapsed.count();
+}
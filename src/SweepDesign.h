@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "SweepEngine.h"
+
+//------------------------------------------------------------------------------------------------
+// Sweeps over more than pitch over speed and angle. A design is a list of axes, each a parameter of the
+// ascent, the vehicle or the mission with its range and level count, and the points to fly, laid out either
+// as their full Cartesian product or as a quasi-random sample of it.
+//
+// Every point needing the same vehicle and mission is flown by one engine, in flat batches of pitch over
+// profiles, so a design of 10^6 points is a few hundred sweeps of a few thousand profiles rather than 10^6
+// of one. Sampled designs snap the vehicle and mission axes to their levels for the same reason and leave
+// only pitch over speed and angle continuous.
+
+enum class SweepParameter : uint32_t
+{
+    PitchOverSpeed,     // m/s
+    PitchOverAngle,     // Degrees
+    ThrustScale,        // Up to 1, scales the stage's mass flow after the mission file's thrustLimit
+    RotationRate,       // Degrees per second, the stage's guidance turn rate limit
+    Apoapsis,           // Target altitude, m
+    Periapsis,          // Target altitude, m
+    LaunchLatitude,     // Degrees
+};
+
+const char* GetSweepParameterName( SweepParameter parameter );
+bool        ParseSweepParameter( const char* name, SweepParameter& parameter );
+
+// Whether each of the engine's flights shares the parameter, so that points differing in it need a sweep of their own.
+inline bool IsMissionParameter( SweepParameter parameter )
+{
+    return parameter != SweepParameter::PitchOverSpeed && parameter != SweepParameter::PitchOverAngle;
+}
+
+struct SweepAxis
+{
+    SweepParameter  parameter;
+    uint32_t        stage;      // ThrustScale and RotationRate only, from 0
+    float           min;
+    float           max;
+    uint32_t        count;      // Levels, from min to max inclusive; min alone if 1
+};
+
+struct SweepDesign
+{
+    std::vector<SweepAxis>  axes;
+    std::vector<float>      values;     // Point major, one per axis
+
+    uint32_t        GetPointCount() const { return axes.empty() ? 0 : static_cast<uint32_t>(values.size() / axes.size()); }
+    const float*    GetPoint( uint32_t point ) const { return &values[size_t( point ) * axes.size()]; }
+};
+
+// Every combination of the axes' levels, the first axis varying slowest. Returns false if there are more than 2^32 - 1.
+bool    MakeGridDesign( const std::vector<SweepAxis>& axes, SweepDesign& design );
+
+// count points of a Halton sequence over the axes' ranges. Vehicle and mission axes are rounded to their levels.
+void    MakeSampledDesign( const std::vector<SweepAxis>& axes, uint32_t count, SweepDesign& design );
+
+// Parses a design file: an "axes" array of { "parameter", "stage" (from 1), "min", "max", "count" } and, for
+// a sampled design, "samples". Pitch over speed and angle must both be given. Returns false with an error
+// message on failure.
+bool    ParseSweepDesign( const nlohmann::json& designJson, uint32_t stageCount, SweepDesign& design, std::string& error );
+
+// Applies a point's vehicle and mission parameters to copies of the loaded environment and mission.
+void    ApplyDesignPoint( const SweepDesign& design, const float* point, double earthRadius, double earthMu, FlightEnvironment& environment,
+                          ShaderShared::MissionParams& missionParams );
+
+//------------------------------------------------------------------------------------------------
+
+struct DesignResult
+{
+    std::vector<ShaderShared::FlightData>   flightData;     // Per point, in the design's order
+    std::vector<float>      objective;      // CalcSelectionObjective against the point's own mission
+    uint32_t    missions;                   // Distinct vehicles and missions, each flown by its own engine
+    uint32_t    sweeps;                     // Engine Runs
+    double      time;                       // Seconds
+};
+
+// Flies every point of the design, batchSize profiles per sweep at most. Telemetry is never recorded.
+void    RunSweepDesign( const SweepDesign& design, const FlightEnvironment& environment, const ShaderShared::MissionParams& missionParams, const SweepConfig& config,
+                        ThreadPool& threadPool, double earthRadius, double earthMu, uint32_t batchSize, DesignResult& result );
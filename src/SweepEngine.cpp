@@ -0,0 +1,833 @@
+#include "SweepEngine.h"
+#include "FlightAnalysis.h"
+#include "SweepCache.h"
+
+#include <float.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+SweepEngine::SweepEngine( const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& config, ThreadPool& threadPool ) :
+    m_simulator( environment, missionParams, config.simulationStepSize ),
+    m_config( config ),
+    m_threadPool( threadPool ),
+    m_resultCache( nullptr ),
+    m_profileCount( 0 ),
+    m_laneSteps( 0 ),
+    m_cacheHits( 0 ),
+    m_extentsReduced( false ),
+    m_ascentParams( nullptr ),
+    m_speedScale( 1 ),
+    m_angleScale( 1 )
+{
+    m_telemetryMaxSamples = uint32_t( config.flightTime / (config.simulationStepSize * config.telemetryStepSize) + 0.5f );
+
+    if ( config.integrator == FlightIntegrator::Euler )
+        m_batchKernel = CreateFlightBatchKernel( config.simdLevel, m_simulator );
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SweepEngine::SetResultCache( SweepCache* cache )
+{
+    m_resultCache = cache;
+
+    if ( cache && m_config.warmStartGuidance )
+    {
+        fprintf( stderr, "The result cache needs warm started guidance off, or results would depend on the sweeps that filled it.\n" );
+        m_resultCache = nullptr;
+    }
+    else if ( cache )
+    {
+        // Keyed on the level flown at, which a fallback may have changed.
+        SweepConfig config = m_config;
+        config.simdLevel = GetSimdLevel();
+        cache->Open( m_simulator.GetEnvironment(), m_simulator.GetMissionParams(), config );
+    }
+}
+
+void SweepEngine::Run( const std::vector<AscentParams>& ascentParams )
+{
+    const uint32_t count = static_cast<uint32_t>(ascentParams.size());
+    m_cacheHits = 0;
+
+    if ( !m_resultCache || !m_resultCache->IsOpen() )
+    {
+        Simulate( ascentParams.data(), count );
+        return;
+    }
+
+    // With every profile's telemetry kept, a hit needs its samples as well.
+    const bool fullTelemetry = m_config.recordTelemetry && m_config.telemetryProfiles == 0;
+
+    std::vector<FlightData> cachedData( count );
+    std::vector<uint32_t> missIndex( count, ~0u );
+    std::vector<AscentParams> missParams;
+
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        if ( m_resultCache->Find( ascentParams[i], cachedData[i], nullptr ) && (!fullTelemetry || m_resultCache->HasTelemetry( ascentParams[i] )) )
+        {
+            ++m_cacheHits;
+        }
+        else
+        {
+            missIndex[i] = static_cast<uint32_t>(missParams.size());
+            missParams.push_back( ascentParams[i] );
+        }
+    }
+
+    const uint32_t missCount = static_cast<uint32_t>(missParams.size());
+
+    if ( missCount > 0 || m_cacheHits == 0 )
+    {
+        Simulate( m_cacheHits == 0 ? ascentParams.data() : missParams.data(), missCount );
+
+        for ( uint32_t j = 0; j < missCount; ++j )
+            m_resultCache->Store( missParams[j], m_flightData[j], fullTelemetry ? GetTelemetry( j ) : nullptr, m_telemetryMaxSamples );
+
+        m_resultCache->Flush();
+    }
+    else
+    {
+        m_laneSteps = 0;
+    }
+
+    if ( m_cacheHits > 0 )
+        MergeCachedProfiles( ascentParams, cachedData, missIndex );
+}
+
+// Lays the profiles Simulate flew and the ones read from the cache back out in the order Run was given them,
+// as if every one had been flown. Hits have no guidance solve, so they seed nothing and replay unseeded.
+void SweepEngine::MergeCachedProfiles( const std::vector<AscentParams>& ascentParams, const std::vector<FlightData>& cachedData, const std::vector<uint32_t>& missIndex )
+{
+    const uint32_t count = static_cast<uint32_t>(ascentParams.size());
+    const bool fullTelemetry = m_config.recordTelemetry && m_config.telemetryProfiles == 0;
+
+    std::vector<FlightData> flightData( count + 2 );
+    std::vector<TelemetryData> state( count );
+    std::vector<float2> frameVelocity( count );
+    std::vector<GuidanceSolve> guidanceSolves( count, GuidanceSolve{} );
+    std::vector<GuidanceSolve> prevGuidanceSolves( count, GuidanceSolve{} );
+    std::vector<GuidanceSolve> replaySeeds( count, GuidanceSolve{} );
+    std::vector<CompactTelemetry> telemetry( fullTelemetry ? size_t( count ) * m_telemetryMaxSamples : 0 );
+    std::vector<CompactTelemetry> samples;
+
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        CompactTelemetry* output = fullTelemetry ? &telemetry[size_t( i ) * m_telemetryMaxSamples] : nullptr;
+        const uint32_t j = missIndex[i];
+
+        if ( j == ~0u )
+        {
+            FlightData padData;
+            m_simulator.InitFlight( ascentParams[i], state[i], padData );
+            frameVelocity[i] = state[i].eciVelocity - state[i].surfVelocity;
+            flightData[i] = cachedData[i];
+
+            if ( output && m_resultCache->Find( ascentParams[i], flightData[i], &samples ) )
+                std::copy( samples.begin(), samples.begin() + std::min( size_t( m_telemetryMaxSamples ), samples.size() ), output );
+        }
+        else
+        {
+            flightData[i] = m_flightData[j];
+            state[i] = m_state[j];
+            frameVelocity[i] = m_frameVelocity[j];
+            guidanceSolves[i] = m_guidanceSolves[j];
+            prevGuidanceSolves[i] = m_prevGuidanceSolves[j];
+            replaySeeds[i] = m_replaySeeds[j];
+
+            if ( output )
+                std::copy( GetTelemetry( j ), GetTelemetry( j ) + m_telemetryMaxSamples, output );
+        }
+    }
+
+    ReduceFlightDataExtents( flightData.data(), count, m_simulator.GetMissionParams(), m_simulator.GetEnvironment().params.Re,
+                             m_threadPool, flightData[count], flightData[count + 1] );
+
+    m_flightData.swap( flightData );
+    m_state.swap( state );
+    m_frameVelocity.swap( frameVelocity );
+    m_guidanceSolves.swap( guidanceSolves );
+    m_prevGuidanceSolves.swap( prevGuidanceSolves );
+    m_replaySeeds.swap( replaySeeds );
+    m_telemetry.swap( telemetry );
+
+    m_telemetrySlot.assign( m_config.recordTelemetry ? count : 0, ~0u );
+    if ( fullTelemetry )
+    {
+        for ( uint32_t i = 0; i < count; ++i )
+            m_telemetrySlot[i] = i;
+    }
+
+    m_ascentParams = ascentParams.data();
+    m_prevAscentParams = ascentParams;
+    m_profileCount = count;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SweepEngine::Simulate( const AscentParams* ascentParams, uint32_t count )
+{
+    m_ascentParams = ascentParams;
+    m_profileCount = count;
+
+    m_state.resize( m_profileCount );
+    m_flightData.resize( m_profileCount + 2 );
+
+    // With telemetryProfiles set nothing is stored until StoreTelemetry.
+    m_telemetrySlot.assign( m_config.recordTelemetry ? m_profileCount : 0, ~0u );
+
+    if ( m_config.recordTelemetry && m_config.telemetryProfiles == 0 )
+    {
+        m_telemetry.resize( size_t( m_profileCount ) * m_telemetryMaxSamples );
+
+        for ( uint32_t i = 0; i < m_profileCount; ++i )
+            m_telemetrySlot[i] = i;
+    }
+    else
+    {
+        m_telemetry.clear();
+    }
+
+    m_frameVelocity.resize( m_profileCount );
+
+    for ( uint32_t i = 0; i < m_profileCount; ++i )
+    {
+        m_simulator.InitFlight( m_ascentParams[i], m_state[i], m_flightData[i] );
+        m_frameVelocity[i] = m_state[i].eciVelocity - m_state[i].surfVelocity;
+    }
+
+    m_guidanceSolves.assign( m_profileCount, GuidanceSolve{} );
+    m_curveCursors.assign( m_profileCount, CurveCursors{} );
+    m_guidanceOffered.assign( m_profileCount, false );
+    m_seedDistance.assign( m_profileCount, FLT_MAX );
+
+    if ( m_config.warmStartGuidance )
+    {
+        float minSpeed = FLT_MAX, maxSpeed = -FLT_MAX;
+        float minAngle = FLT_MAX, maxAngle = -FLT_MAX;
+
+        for ( uint32_t i = 0; i < m_profileCount; ++i )
+        {
+            minSpeed = fminf( minSpeed, m_ascentParams[i].pitchOverSpeed );
+            maxSpeed = fmaxf( maxSpeed, m_ascentParams[i].pitchOverSpeed );
+            minAngle = fminf( minAngle, m_ascentParams[i].sinPitchOverAngle );
+            maxAngle = fmaxf( maxAngle, m_ascentParams[i].sinPitchOverAngle );
+        }
+
+        m_speedScale = maxSpeed > minSpeed ? 1 / (maxSpeed - minSpeed) : 1;
+        m_angleScale = maxAngle > minAngle ? 1 / (maxAngle - minAngle) : 1;
+
+        std::vector<uint32_t> donors;
+        for ( uint32_t i = 0; i < m_prevGuidanceSolves.size(); ++i )
+        {
+            if ( m_prevGuidanceSolves[i].iterations > 0 )
+                donors.push_back( i );
+        }
+
+        SeedGuidance( m_prevGuidanceSolves.data(), m_prevAscentParams.data(), donors );
+    }
+
+    const uint32_t totalSteps = GetTotalSteps();
+    m_laneSteps = 0;
+
+    m_workerExtents.assign( m_threadPool.GetThreadCount(), WorkerExtents{} );
+
+    if ( m_config.integrator == FlightIntegrator::Dopri5 )
+    {
+        SimulateAdaptive();
+    }
+    else if ( m_batchKernel )
+    {
+        uint32_t firstStep = m_config.shareLiftoff ? SimulateLiftoff<SymplecticEuler>( false ) : 0;
+
+        m_batchKernel->SetTelemetryOutput( m_telemetry.empty() ? nullptr : m_telemetry.data(), m_config.telemetryStepSize, m_telemetryMaxSamples );
+        m_batchKernel->SetCoastMode( m_config.coastMode, GetTotalSteps() );
+        m_batchKernel->SetGuidanceSolves( m_guidanceSolves.data() );
+        m_batchKernel->InitFlights( m_ascentParams, m_state.data(), m_flightData.data(), m_profileCount );
+
+        for ( uint32_t step = firstStep; step < totalSteps && m_batchKernel->GetGroupCount() > 0; step += m_config.stepsPerBatch )
+        {
+            uint32_t stepCount = std::min( m_config.stepsPerBatch, totalSteps - step );
+
+            if ( m_config.warmStartGuidance )
+                SeedGuidanceFromSweep();
+
+            ClearLiveExtents();
+            m_threadPool.ParallelFor( m_batchKernel->GetGroupCount(), 1, [this, step, stepCount] ( uint32_t begin, uint32_t end )
+            {
+                WorkerExtents& extents = m_workerExtents[m_threadPool.GetThreadIndex()];
+                m_batchKernel->StepFlights( begin, end, step, stepCount, &extents.retired, &extents.live );
+            } );
+
+            m_laneSteps += uint64_t( m_batchKernel->GetGroupCount() ) * m_batchKernel->GetWidth() * stepCount;
+            m_batchKernel->CompactFlights();
+            PublishExtents();
+        }
+
+        m_batchKernel->GetFlightData( m_flightData.data() );
+    }
+    else
+    {
+        switch ( m_config.integrator )
+        {
+        case FlightIntegrator::Verlet:
+            RunProfiles<VelocityVerlet>();
+            break;
+        case FlightIntegrator::Yoshida4:
+            RunProfiles<Yoshida4>();
+            break;
+        default:
+            RunProfiles<SymplecticEuler>();
+            break;
+        }
+    }
+
+    // The last batch's live partials hold the flights still going at the end of the flight time, so only a
+    // sweep with no batches, shorter than the shared climb, leaves flights unaccounted for.
+    m_extentsReduced = !PublishExtents();
+    if ( m_extentsReduced )
+    {
+        ReduceFlightDataExtents( m_flightData.data(), m_profileCount, m_simulator.GetMissionParams(), m_simulator.GetEnvironment().params.Re,
+                                 m_threadPool, m_flightData[m_profileCount], m_flightData[m_profileCount + 1] );
+    }
+
+    // Replays start from the seeds this Run's solves did, some of which are about to be overwritten.
+    m_replaySeeds.assign( m_profileCount, GuidanceSolve{} );
+    for ( uint32_t i = 0; i < m_profileCount; ++i )
+    {
+        if ( m_guidanceSolves[i].seed )
+        {
+            m_replaySeeds[i] = *m_guidanceSolves[i].seed;
+            m_replaySeeds[i].seed = nullptr;
+        }
+    }
+
+    // Kept to seed the next Run, the seeds they started from are gone by then.
+    m_prevGuidanceSolves = m_guidanceSolves;
+    m_prevAscentParams.assign( m_ascentParams, m_ascentParams + m_profileCount );
+
+    for ( GuidanceSolve& solve : m_prevGuidanceSolves )
+        solve.seed = nullptr;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Every profile still on the pad state climbs straight up, with the aim fixed to the up vector, until it
+// reaches its pitch over speed. Their states are identical until then, so the climb is flown once as a trunk
+// that never pitches over and each profile is forked off it on the step it would have pitched over, which
+// is the only point StepFlight reads AscentParams during the climb. Profiles forked early are then stepped
+// on to the last fork. Returns the step the sweep carries on from.
+//
+// Without catchUp every profile is forked at the lowest pitch over speed and the rest of the climb is left
+// to the sweep, for the batch kernels which would otherwise wait on a scalar catch up.
+template<typename Integrator>
+uint32_t SweepEngine::SimulateLiftoff( bool catchUp )
+{
+    std::vector<uint32_t> forks;
+    for ( uint32_t i = 0; i < m_profileCount; ++i )
+    {
+        if ( m_flightData[i].flightPhase == c_PhaseLiftoff )
+            forks.push_back( i );
+    }
+
+    if ( forks.size() < 2 )
+        return 0;
+
+    std::sort( forks.begin(), forks.end(), [this] ( uint32_t a, uint32_t b ) { return m_ascentParams[a].pitchOverSpeed < m_ascentParams[b].pitchOverSpeed; } );
+
+    const uint32_t totalSteps = GetTotalSteps();
+    const uint32_t telemetryStepSize = m_config.telemetryStepSize;
+
+    AscentParams trunkParams = m_ascentParams[forks[0]];
+    trunkParams.pitchOverSpeed = FLT_MAX;
+
+    TelemetryData trunk = m_state[forks[0]];
+    FlightData trunkData = m_flightData[forks[0]];
+    CurveCursors trunkCursors;
+    std::vector<CompactTelemetry> trunkTelemetry;
+
+    std::vector<uint32_t> forkStep( m_profileCount );
+    uint32_t forked = 0;
+    uint32_t step = 0;
+
+    for ( ; step < totalSteps && forked < forks.size(); ++step )
+    {
+        m_simulator.StepFlight<Integrator>( trunkParams, trunk, trunkData, nullptr, m_config.curveCursors ? &trunkCursors : nullptr );
+        ++m_laneSteps;
+
+        if ( !m_telemetry.empty() && (step % telemetryStepSize) == telemetryStepSize - 1 )
+            trunkTelemetry.push_back( EncodeTelemetry( trunk ) );
+
+        // If the trunk crashes or runs out of time, whatever hasn't pitched over ends with it.
+        bool trunkEnded = ShouldRetireFlight( m_config.coastMode, m_simulator, trunk, trunkData ) || step + 1 == totalSteps;
+        float speed = length( trunk.surfVelocity );
+
+        bool forkAll = trunkEnded || (!catchUp && speed >= m_ascentParams[forks[0]].pitchOverSpeed);
+
+        for ( ; forked < forks.size() && (forkAll || speed >= m_ascentParams[forks[forked]].pitchOverSpeed); ++forked )
+        {
+            uint32_t profile = forks[forked];
+            m_state[profile] = trunk;
+            m_flightData[profile] = trunkData;
+            m_curveCursors[profile] = trunkCursors;
+            forkStep[profile] = step;
+
+            if ( speed >= m_ascentParams[profile].pitchOverSpeed )
+            {
+                m_state[profile].flightPhase = c_PhasePitchOver;
+                m_flightData[profile].flightPhase = c_PhasePitchOver;
+            }
+
+            if ( !m_telemetry.empty() )
+            {
+                CompactTelemetry* telemetry = &m_telemetry[size_t( profile ) * m_telemetryMaxSamples];
+                std::copy( trunkTelemetry.begin(), trunkTelemetry.end(), telemetry );
+
+                if ( (step % telemetryStepSize) == telemetryStepSize - 1 )
+                    telemetry[step / telemetryStepSize] = EncodeTelemetry( m_state[profile] );
+            }
+        }
+    }
+
+    // Crashes are left for the sweep's first step to retire, StepFlight holds them frozen until then.
+    std::vector<uint32_t> catchUpSteps( forks.size() );
+
+    m_threadPool.ParallelFor( static_cast<uint32_t>(forks.size()), 4, [&] ( uint32_t begin, uint32_t end )
+    {
+        for ( uint32_t j = begin; j < end; ++j )
+        {
+            uint32_t i = forks[j];
+            TelemetryData& state = m_state[i];
+            CompactTelemetry* telemetry = m_telemetry.empty() ? nullptr : &m_telemetry[size_t( i ) * m_telemetryMaxSamples];
+
+            for ( uint32_t s = forkStep[i] + 1; s < step && !m_simulator.IsFlightCrashed( state ); ++s )
+            {
+                m_simulator.StepFlight<Integrator>( m_ascentParams[i], state, m_flightData[i], &m_guidanceSolves[i], m_config.curveCursors ? &m_curveCursors[i] : nullptr );
+                ++catchUpSteps[j];
+
+                if ( telemetry && (s % telemetryStepSize) == telemetryStepSize - 1 )
+                    telemetry[s / telemetryStepSize] = EncodeTelemetry( state );
+            }
+        }
+    } );
+
+    for ( uint32_t count : catchUpSteps )
+        m_laneSteps += count;
+
+    return step;
+}
+
+template<typename Integrator>
+void SweepEngine::RunProfiles()
+{
+    const uint32_t totalSteps = GetTotalSteps();
+    uint32_t firstStep = m_config.shareLiftoff ? SimulateLiftoff<Integrator>( true ) : 0;
+
+    m_activeProfiles.resize( m_profileCount );
+    m_retireStep.assign( m_profileCount, ~0u );
+
+    for ( uint32_t i = 0; i < m_profileCount; ++i )
+        m_activeProfiles[i] = i;
+
+    // Small grain as profiles cost very different amounts once guidance kicks in.
+    const uint32_t grain = 4;
+
+    for ( uint32_t step = firstStep; step < totalSteps && !m_activeProfiles.empty(); step += m_config.stepsPerBatch )
+    {
+        uint32_t stepCount = std::min( m_config.stepsPerBatch, totalSteps - step );
+
+        if ( m_config.warmStartGuidance )
+            SeedGuidanceFromSweep();
+
+        ClearLiveExtents();
+        m_threadPool.ParallelFor( static_cast<uint32_t>(m_activeProfiles.size()), grain, [this, step, stepCount] ( uint32_t begin, uint32_t end )
+        {
+            SimulateProfiles<Integrator>( begin, end, step, stepCount );
+        } );
+
+        // Profiles that retired part way through the batch only stepped up to their retire step.
+        for ( uint32_t profile : m_activeProfiles )
+            m_laneSteps += m_retireStep[profile] == ~0u ? stepCount : m_retireStep[profile] + 1 - step;
+
+        m_activeProfiles.erase( std::remove_if( m_activeProfiles.begin(), m_activeProfiles.end(), [this] ( uint32_t profile ) { return m_retireStep[profile] != ~0u; } ),
+                                m_activeProfiles.end() );
+        PublishExtents();
+    }
+}
+
+template<typename Integrator>
+void SweepEngine::SimulateProfiles( uint32_t begin, uint32_t end, uint32_t firstStep, uint32_t stepCount )
+{
+    const uint32_t telemetryStepSize = m_config.telemetryStepSize;
+    const float earthRadius = m_simulator.GetEnvironment().params.Re;
+    WorkerExtents& extents = m_workerExtents[m_threadPool.GetThreadIndex()];
+
+    for ( uint32_t j = begin; j < end; ++j )
+    {
+        uint32_t i = m_activeProfiles[j];
+        TelemetryData& state = m_state[i];
+        FlightData& flightData = m_flightData[i];
+        CompactTelemetry* telemetry = m_telemetry.empty() ? nullptr : &m_telemetry[size_t( i ) * m_telemetryMaxSamples];
+
+        for ( uint32_t step = firstStep; step < firstStep + stepCount; ++step )
+        {
+            m_simulator.StepFlight<Integrator>( m_ascentParams[i], state, flightData, &m_guidanceSolves[i], m_config.curveCursors ? &m_curveCursors[i] : nullptr );
+
+            // The GPU overwrites the current sample every step, so a sample holds the state after its last step.
+            if ( telemetry && (step % telemetryStepSize) == telemetryStepSize - 1 )
+                telemetry[step / telemetryStepSize] = EncodeTelemetry( state );
+
+            if ( ShouldRetireFlight( m_config.coastMode, m_simulator, state, flightData ) )
+            {
+                RetireProfile( i, step );
+                break;
+            }
+        }
+
+        // While the profile's FlightData is still in cache.
+        AccumulateFlightDataExtents( flightData, i, m_simulator.GetMissionParams(), earthRadius, m_retireStep[i] != ~0u ? extents.retired : extents.live );
+    }
+}
+
+// Each profile is flown start to end in one go, there are no fixed steps to batch.
+void SweepEngine::SimulateAdaptive()
+{
+    AdaptiveFlightSimulator simulator( m_simulator, m_config.tolerance );
+
+    const double sampleInterval = double( m_config.simulationStepSize ) * m_config.telemetryStepSize;
+    const double flightTime = double( GetTotalSteps() ) * m_config.simulationStepSize;
+
+    std::vector<uint32_t> stepCounts( m_profileCount );
+
+    m_threadPool.ParallelFor( m_profileCount, 1, [&] ( uint32_t begin, uint32_t end )
+    {
+        WorkerExtents& extents = m_workerExtents[m_threadPool.GetThreadIndex()];
+
+        for ( uint32_t i = begin; i < end; ++i )
+        {
+            CompactTelemetry* telemetry = m_telemetry.empty() ? nullptr : &m_telemetry[size_t( i ) * m_telemetryMaxSamples];
+            stepCounts[i] = simulator.SimulateFlight( m_ascentParams[i], m_state[i], m_flightData[i], telemetry, sampleInterval, m_telemetryMaxSamples, flightTime, m_config.coastMode,
+                                                        &m_guidanceSolves[i] );
+            AccumulateFlightDataExtents( m_flightData[i], i, m_simulator.GetMissionParams(), m_simulator.GetEnvironment().params.Re, extents.retired );
+        }
+    } );
+
+    for ( uint32_t count : stepCounts )
+        m_laneSteps += count;
+}
+
+// Merges the workers' partials into the extents entries after the profiles. Returns whether every profile was
+// accounted for.
+bool SweepEngine::PublishExtents()
+{
+    FlightDataExtents extents;
+    for ( const WorkerExtents& worker : m_workerExtents )
+    {
+        MergeFlightDataExtents( extents, worker.retired );
+        MergeFlightDataExtents( extents, worker.live );
+    }
+
+    ResolveFlightDataExtents( extents, m_flightData[m_profileCount], m_flightData[m_profileCount + 1] );
+    return extents.flightCount == m_profileCount;
+}
+
+// The live partials only hold the flights still going after the batch that filled them, each batch refills them.
+void SweepEngine::ClearLiveExtents()
+{
+    for ( WorkerExtents& worker : m_workerExtents )
+        worker.live = FlightDataExtents{};
+}
+
+void SweepEngine::RetireProfile( uint32_t profile, uint32_t step )
+{
+    m_retireStep[profile] = step;
+
+    CompactTelemetry* telemetry = m_telemetry.empty() ? nullptr : &m_telemetry[size_t( profile ) * m_telemetryMaxSamples];
+    FinishFlight( m_config.coastMode, m_simulator, step, GetTotalSteps(), m_state[profile], m_flightData[profile], telemetry, m_config.telemetryStepSize, m_telemetryMaxSamples );
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Without SimulateLiftoff's shared climb, which leaves every profile as it would have flown it alone.
+void SweepEngine::ReplayFlights( const std::vector<uint32_t>& profiles, CompactTelemetry* telemetry, FlightData* flightData ) const
+{
+    const uint32_t count = static_cast<uint32_t>(profiles.size());
+    const uint32_t totalSteps = GetTotalSteps();
+
+    std::vector<AscentParams> ascentParams( count );
+    std::vector<TelemetryData> state( count );
+    std::vector<FlightData> data( count );
+    std::vector<GuidanceSolve> solves( count, GuidanceSolve{} );
+
+    for ( uint32_t j = 0; j < count; ++j )
+    {
+        uint32_t i = profiles[j];
+        ascentParams[j] = m_prevAscentParams[i];
+        m_simulator.InitFlight( ascentParams[j], state[j], data[j] );
+
+        if ( m_guidanceSolves[i].seed )
+            solves[j].seed = &m_replaySeeds[i];
+    }
+
+    auto sampleOutput = [telemetry, this] ( uint32_t j ) { return telemetry ? telemetry + size_t( j ) * m_telemetryMaxSamples : nullptr; };
+
+    if ( m_config.integrator == FlightIntegrator::Dopri5 )
+    {
+        AdaptiveFlightSimulator simulator( m_simulator, m_config.tolerance );
+
+        const double sampleInterval = double( m_config.simulationStepSize ) * m_config.telemetryStepSize;
+        const double flightTime = double( totalSteps ) * m_config.simulationStepSize;
+
+        m_threadPool.ParallelFor( count, 1, [&] ( uint32_t begin, uint32_t end )
+        {
+            for ( uint32_t j = begin; j < end; ++j )
+                simulator.SimulateFlight( ascentParams[j], state[j], data[j], sampleOutput( j ), sampleInterval, m_telemetryMaxSamples, flightTime, m_config.coastMode, &solves[j] );
+        } );
+    }
+    else if ( m_batchKernel )
+    {
+        // A kernel of its own so replays don't disturb the sweep's, the lanes round the same in any group.
+        std::unique_ptr<FlightBatchKernel> kernel = CreateFlightBatchKernel( m_config.simdLevel, m_simulator );
+        kernel->SetTelemetryOutput( telemetry, m_config.telemetryStepSize, m_telemetryMaxSamples );
+        kernel->SetCoastMode( m_config.coastMode, totalSteps );
+        kernel->SetGuidanceSolves( solves.data() );
+        kernel->InitFlights( ascentParams.data(), state.data(), data.data(), count );
+
+        for ( uint32_t step = 0; step < totalSteps && kernel->GetGroupCount() > 0; step += m_config.stepsPerBatch )
+        {
+            uint32_t stepCount = std::min( m_config.stepsPerBatch, totalSteps - step );
+
+            m_threadPool.ParallelFor( kernel->GetGroupCount(), 1, [&kernel, step, stepCount] ( uint32_t begin, uint32_t end )
+            {
+                kernel->StepFlights( begin, end, step, stepCount, nullptr, nullptr );
+            } );
+
+            kernel->CompactFlights();
+        }
+
+        kernel->GetFlightData( data.data() );
+    }
+    else
+    {
+        m_threadPool.ParallelFor( count, 1, [&] ( uint32_t begin, uint32_t end )
+        {
+            for ( uint32_t j = begin; j < end; ++j )
+            {
+                switch ( m_config.integrator )
+                {
+                case FlightIntegrator::Verlet:
+                    ReplayProfile<VelocityVerlet>( ascentParams[j], state[j], data[j], solves[j], sampleOutput( j ) );
+                    break;
+                case FlightIntegrator::Yoshida4:
+                    ReplayProfile<Yoshida4>( ascentParams[j], state[j], data[j], solves[j], sampleOutput( j ) );
+                    break;
+                default:
+                    ReplayProfile<SymplecticEuler>( ascentParams[j], state[j], data[j], solves[j], sampleOutput( j ) );
+                    break;
+                }
+            }
+        } );
+    }
+
+    if ( flightData )
+        std::copy( data.begin(), data.end(), flightData );
+}
+
+// SimulateProfiles for one profile from the pad.
+template<typename Integrator>
+void SweepEngine::ReplayProfile( const AscentParams& ascentParams, TelemetryData& state, FlightData& flightData, GuidanceSolve& solve, CompactTelemetry* telemetry ) const
+{
+    const uint32_t totalSteps = GetTotalSteps();
+    const uint32_t telemetryStepSize = m_config.telemetryStepSize;
+
+    CurveCursors cursors;
+
+    for ( uint32_t step = 0; step < totalSteps; ++step )
+    {
+        m_simulator.StepFlight<Integrator>( ascentParams, state, flightData, &solve, m_config.curveCursors ? &cursors : nullptr );
+
+        if ( telemetry && (step % telemetryStepSize) == telemetryStepSize - 1 )
+            telemetry[step / telemetryStepSize] = EncodeTelemetry( state );
+
+        if ( ShouldRetireFlight( m_config.coastMode, m_simulator, state, flightData ) )
+        {
+            FinishFlight( m_config.coastMode, m_simulator, step, totalSteps, state, flightData, telemetry, telemetryStepSize, m_telemetryMaxSamples );
+            break;
+        }
+    }
+}
+
+void SweepEngine::StoreTelemetry( const std::vector<uint32_t>& profiles )
+{
+    if ( !m_config.recordTelemetry )
+        return;
+
+    m_telemetry.resize( profiles.size() * m_telemetryMaxSamples );
+    ReplayFlights( profiles, m_telemetry.data(), nullptr );
+
+    m_telemetrySlot.assign( m_profileCount, ~0u );
+    for ( uint32_t j = 0; j < profiles.size(); ++j )
+        m_telemetrySlot[profiles[j]] = j;
+}
+
+std::vector<TelemetryData> SweepEngine::GetProfileTelemetry( uint32_t profile ) const
+{
+    std::vector<TelemetryData> telemetry;
+    if ( !m_config.recordTelemetry )
+        return telemetry;
+
+    std::vector<CompactTelemetry> replayed;
+    const CompactTelemetry* samples = GetTelemetry( profile );
+
+    if ( !samples )
+    {
+        replayed.resize( m_telemetryMaxSamples );
+        ReplayFlights( { profile }, replayed.data(), nullptr );
+        samples = replayed.data();
+    }
+
+    telemetry.resize( m_telemetryMaxSamples );
+    for ( uint32_t s = 0; s < m_telemetryMaxSamples; ++s )
+        telemetry[s] = DecodeTelemetry( samples[s], m_frameVelocity[profile] );
+
+    return telemetry;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Offers the donors' solves to every profile yet to converge guidance, each keeping the nearest as its seed.
+void SweepEngine::SeedGuidance( const GuidanceSolve* solves, const AscentParams* solveParams, const std::vector<uint32_t>& donors )
+{
+    if ( donors.empty() )
+        return;
+
+    for ( uint32_t i = 0; i < m_profileCount; ++i )
+    {
+        GuidanceSolve& solve = m_guidanceSolves[i];
+        if ( solve.iterations > 0 )
+            continue;
+
+        for ( uint32_t donor : donors )
+        {
+            float distance = CalcProfileDistance( m_ascentParams[i], solveParams[donor] );
+            if ( distance < m_seedDistance[i] )
+            {
+                m_seedDistance[i] = distance;
+                solve.seed = &solves[donor];
+            }
+        }
+    }
+}
+
+// Solves are only offered between batches, once no thread is writing them, so the seeds don't depend on
+// how the batch was scheduled.
+void SweepEngine::SeedGuidanceFromSweep()
+{
+    std::vector<uint32_t> donors;
+    for ( uint32_t i = 0; i < m_profileCount; ++i )
+    {
+        if ( m_guidanceSolves[i].iterations > 0 && !m_guidanceOffered[i] )
+        {
+            donors.push_back( i );
+            m_guidanceOffered[i] = true;
+        }
+    }
+
+    SeedGuidance( m_guidanceSolves.data(), m_ascentParams, donors );
+}
+
+// Steps across the sweep grid, sin is as good as the angle at pitch over angles this small.
+float SweepEngine::CalcProfileDistance( const AscentParams& a, const AscentParams& b ) const
+{
+    return fabsf( a.pitchOverSpeed - b.pitchOverSpeed ) * m_speedScale + fabsf( a.sinPitchOverAngle - b.sinPitchOverAngle ) * m_angleScale;
+}
+
+uint32_t SweepEngine::GetGuidanceSolveCount() const
+{
+    uint32_t count = 0;
+    for ( const GuidanceSolve& solve : m_guidanceSolves )
+        count += solve.iterations > 0;
+
+    return count;
+}
+
+uint64_t SweepEngine::GetGuidanceIterations() const
+{
+    uint64_t iterations = 0;
+    for ( const GuidanceSolve& solve : m_guidanceSolves )
+        iterations += solve.iterations;
+
+    return iterations;
+}
+
+//------------------------------------------------------------------------------------------------
+
+uint32_t SweepEngine::SelectBestProfile( double earthRadius, double earthMu ) const
+{
+    return SelectBestFlight( m_flightData.data(), m_profileCount, m_flightData[m_profileCount + 1].minMass, m_simulator.GetMissionParams(), earthRadius, earthMu );
+}
+
+std::vector<uint32_t> SweepEngine::RankProfiles( double earthRadius, double earthMu, uint32_t count ) const
+{
+    std::vector<std::pair<float, uint32_t>> scores;
+    for ( uint32_t i = 0; i < m_profileCount; ++i )
+    {
+        float delta = CalcSelectionScore( m_flightData[i], m_flightData[m_profileCount + 1].minMass, m_simulator.GetMissionParams(), earthRadius, earthMu );
+
+        if ( delta < FLT_MAX )
+            scores.emplace_back( delta, i );
+    }
+
+    // Ties go to the lower index, as in SelectBestProfile.
+    count = std::min( count, static_cast<uint32_t>(scores.size()) );
+    std::partial_sort( scores.begin(), scores.begin() + count, scores.end() );
+
+    std::vector<uint32_t> profiles( count );
+    for ( uint32_t j = 0; j < count; ++j )
+        profiles[j] = scores[j].second;
+
+    return profiles;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void ReduceFlightDataExtents( const FlightData* flightData, uint32_t count, const MissionParams& missionParams, float earthRadius,
+                              ThreadPool& threadPool, FlightData& minData, FlightData& maxData )
+{
+    // Large enough to amortise a task, small enough to balance a 1M flight sweep over the pool.
+    static const uint32_t c_chunkSize = 4096;
+
+    uint32_t chunkCount = std::max( (count + c_chunkSize - 1) / c_chunkSize, 1u );
+    std::vector<FlightDataExtents> partials( chunkCount );
+
+    threadPool.ParallelFor( chunkCount, 1, [&] ( uint32_t begin, uint32_t end )
+    {
+        for ( uint32_t i = begin; i < end; ++i )
+        {
+            AccumulateFlightDataExtents( flightData, i * c_chunkSize, std::min( (i + 1) * c_chunkSize, count ), missionParams, earthRadius, partials[i] );
+        }
+    } );
+
+    // Each level merges the right partial of every pair into the left, leaving the result in partials[0].
+    for ( uint32_t stride = 1; stride < chunkCount; stride *= 2 )
+    {
+        uint32_t pairCount = (chunkCount + stride - 1) / (2 * stride);
+
+        threadPool.ParallelFor( pairCount, 16, [&] ( uint32_t begin, uint32_t end )
+        {
+            for ( uint32_t i = begin; i < end; ++i )
+            {
+                uint32_t left = i * 2 * stride;
+                MergeFlightDataExtents( partials[left], partials[left + stride] );
+            }
+        } );
+    }
+
+    ResolveFlightDataExtents( partials[0], minData, maxData );
+}
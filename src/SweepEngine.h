@@ -0,0 +1,192 @@
+#pragma once
+
+#include <vector>
+
+#include "FlightAdaptive.h"
+#include "FlightBatch.h"
+#include "FlightCoast.h"
+#include "FlightSim.h"
+#include "ThreadPool.h"
+
+//------------------------------------------------------------------------------------------------
+// Headless CPU equivalent of the SimulateFlight dispatch loop in RocketSim::RenderFrame. Every
+// ascent profile is stepped to the end of the flight time and the FlightData buffer is filled in
+// the same layout as the GPU one: one entry per profile followed by the min and max extents.
+//
+// Profiles are dropped from the work list between batches once they crash or, depending on the coast
+// mode, stop burning. FinishFlight fills in the rest of their telemetry and FlightData.
+//
+// The extents are accumulated by the workers as they step, rather than in a pass of their own at the end,
+// and published to the FlightData buffer after every batch.
+
+class SweepCache;
+
+// Sweep grid, matches c_ThreadWidth x c_ThreadHeight in data_formats.h.
+static const uint32_t   c_SweepAngleCount = 16;
+static const uint32_t   c_SweepSpeedCount = 32;
+
+struct SweepConfig
+{
+    float       simulationStepSize = 1.0f / 50.0f;  // In seconds
+    uint32_t    telemetryStepSize = 5;              // In sim steps
+    float       flightTime = 600.0f;                // In seconds
+    uint32_t    stepsPerBatch = 250;                // Sim steps between progress updates
+    bool        recordTelemetry = true;
+    CoastMode   coastMode = CoastMode::Kepler;      // How flights are finished after MECO or burnout
+    SimdLevel   simdLevel = DetectSimdLevel();      // SimdLevel::None steps each profile with FlightSimulator
+    FlightIntegrator    integrator = FlightIntegrator::Euler;   // Only Euler has batch kernels, Dopri5 flies each profile with AdaptiveFlightSimulator
+    double      tolerance = 1e-7;                   // Relative error per step for FlightIntegrator::Dopri5
+    bool        shareLiftoff = true;                // Fly the vertical climb once for every profile, see SimulateLiftoff
+    bool        warmStartGuidance = true;           // Start guidance solves from the nearest converged profile, see SeedGuidance
+    bool        curveCursors = true;                // Per profile path walks each profile's curve lookups on from its last step
+    uint32_t    telemetryProfiles = 0;              // If not 0, Run stores no telemetry and StoreTelemetry keeps this many profiles'
+};
+
+class SweepEngine
+{
+public:
+    SweepEngine( const FlightEnvironment& environment, const ShaderShared::MissionParams& missionParams, const SweepConfig& config, ThreadPool& threadPool );
+
+    // Simulates every profile to the end of the flight time, blocking until complete.
+    void        Run( const std::vector<ShaderShared::AscentParams>& ascentParams );
+
+    // Opens the cache for this engine's context and has Run fly only the profiles it has no result for,
+    // storing theirs. Null, or a cache that fails to open, flies everything. The cache must outlive the engine.
+    // With warmStartGuidance on the cache isn't opened, see SweepCache.h.
+    void        SetResultCache( SweepCache* cache );
+
+    // Profiles the last Run read from the cache rather than flew.
+    uint32_t    GetCacheHits() const { return m_cacheHits; }
+
+    const ShaderShared::MissionParams&  GetMissionParams() const { return m_simulator.GetMissionParams(); }
+
+    uint32_t    GetProfileCount() const { return m_profileCount; }
+    uint32_t    GetTotalSteps() const { return m_telemetryMaxSamples * m_config.telemetryStepSize; }
+    uint32_t    GetTelemetryMaxSamples() const { return m_telemetryMaxSamples; }
+
+    // Level actually used, falls back to SimdLevel::None if the configured one isn't supported.
+    SimdLevel   GetSimdLevel() const { return m_batchKernel ? m_config.simdLevel : SimdLevel::None; }
+
+    // Steps actually simulated by the last Run, counting every lane of a batch kernel group and every
+    // accepted adaptive step.
+    uint64_t    GetLaneSteps() const { return m_laneSteps; }
+
+    // Whether the last Run fell back to reducing its FlightData for the extents, which it only does if it
+    // stepped no batches and so has no per worker partials of them.
+    bool        GetExtentsReduced() const { return m_extentsReduced; }
+
+    // Guidance solves made by the last Run and the update passes ConvergeGuidance took over all of them.
+    uint32_t    GetGuidanceSolveCount() const;
+    uint64_t    GetGuidanceIterations() const;
+
+    // Profile count + 2 entries, see above.
+    const std::vector<ShaderShared::FlightData>&    GetFlightData() const { return m_flightData; }
+
+    // Samples are stored per profile, rather than per step as on the GPU, to keep each thread's writes contiguous.
+    // They're held as CompactTelemetry, null if the profile's aren't stored.
+    const CompactTelemetry*  GetTelemetry( uint32_t profile ) const
+    {
+        return m_telemetrySlot.empty() || m_telemetrySlot[profile] == ~0u ? nullptr : &m_telemetry[size_t( m_telemetrySlot[profile] ) * m_telemetryMaxSamples];
+    }
+
+    size_t      GetTelemetryBytes() const { return m_telemetry.size() * sizeof( CompactTelemetry ); }
+
+    // Decoded samples of a profile for graphs and export, replayed if they aren't stored. Empty if the last
+    // Run didn't record telemetry.
+    std::vector<ShaderShared::TelemetryData>    GetProfileTelemetry( uint32_t profile ) const;
+
+    // With SweepConfig::telemetryProfiles, Run stores no telemetry. This replays the profiles given and
+    // stores theirs, in place of any stored before, typically the best few by RankProfiles.
+    void        StoreTelemetry( const std::vector<uint32_t>& profiles );
+
+    // Flies profiles of the last Run again from the pad, as they flew in it, so the same guidance seeds
+    // and the same integrator path. Telemetry, if not null, takes GetTelemetryMaxSamples samples per profile
+    // and flightData, if not null, one entry per profile. Milliseconds a profile against a sweep's seconds,
+    // so the telemetry of a large sweep can be kept for its best profiles only.
+    void        ReplayFlights( const std::vector<uint32_t>& profiles, CompactTelemetry* telemetry, ShaderShared::FlightData* flightData ) const;
+
+    // Best profile by the renderer's auto select score, ~0u if nothing reached MECO.
+    uint32_t    SelectBestProfile( double earthRadius, double earthMu ) const;
+
+    // Up to count profiles that reached MECO by the same score, best first.
+    std::vector<uint32_t>   RankProfiles( double earthRadius, double earthMu, uint32_t count ) const;
+
+    // Profiles on the Pareto front of final mass, max Q, max acceleration and orbit error, see CalcParetoFront.
+    std::vector<uint32_t>   GetParetoFront( double earthRadius, double earthMu ) const
+    {
+        return CalcParetoFront( m_flightData.data(), m_profileCount, m_simulator.GetMissionParams(), earthRadius, earthMu );
+    }
+
+private:
+    void        Simulate( const ShaderShared::AscentParams* ascentParams, uint32_t count );
+    void        MergeCachedProfiles( const std::vector<ShaderShared::AscentParams>& ascentParams, const std::vector<ShaderShared::FlightData>& cachedData,
+                                     const std::vector<uint32_t>& missIndex );
+    template<typename Integrator>
+    uint32_t    SimulateLiftoff( bool catchUp );
+    template<typename Integrator>
+    void        RunProfiles();
+    template<typename Integrator>
+    void        SimulateProfiles( uint32_t begin, uint32_t end, uint32_t firstStep, uint32_t stepCount );
+    void        SimulateAdaptive();
+    template<typename Integrator>
+    void        ReplayProfile( const ShaderShared::AscentParams& ascentParams, ShaderShared::TelemetryData& state, ShaderShared::FlightData& flightData, GuidanceSolve& solve,
+                               CompactTelemetry* telemetry ) const;
+    bool        PublishExtents();
+    void        ClearLiveExtents();
+    void        RetireProfile( uint32_t profile, uint32_t step );
+    void        SeedGuidance( const GuidanceSolve* solves, const ShaderShared::AscentParams* solveParams, const std::vector<uint32_t>& donors );
+    void        SeedGuidanceFromSweep();
+    float       CalcProfileDistance( const ShaderShared::AscentParams& a, const ShaderShared::AscentParams& b ) const;
+
+    // Running extents kept by each worker, indexed by ThreadPool::GetThreadIndex: flights that have finished,
+    // and flights still going as of the batch just stepped.
+    struct WorkerExtents
+    {
+        FlightDataExtents   retired;
+        FlightDataExtents   live;
+    };
+
+    FlightSimulator                 m_simulator;
+    SweepConfig                     m_config;
+    ThreadPool&                     m_threadPool;
+
+    std::unique_ptr<FlightBatchKernel>  m_batchKernel;  // Null when stepping per profile
+    SweepCache*                         m_resultCache;
+
+    uint32_t                        m_telemetryMaxSamples;
+    uint32_t                        m_profileCount;
+    uint64_t                        m_laneSteps;
+    uint32_t                        m_cacheHits;
+    bool                            m_extentsReduced;
+
+    const ShaderShared::AscentParams*           m_ascentParams;
+    std::vector<ShaderShared::TelemetryData>    m_state;        // Current state of each profile
+    std::vector<CompactTelemetry>               m_telemetry;
+    std::vector<uint32_t>                       m_telemetrySlot;    // Each profile's samples in m_telemetry, ~0u if not stored
+    std::vector<ShaderShared::float2>           m_frameVelocity;    // ECI less surface velocity of each profile, to decode telemetry with
+    std::vector<ShaderShared::FlightData>       m_flightData;
+    std::vector<WorkerExtents>                  m_workerExtents;
+
+    // Per profile path only. Profiles still being stepped, compacted after every batch, and the step
+    // each profile retired on (~0u while live).
+    std::vector<uint32_t>                       m_activeProfiles;
+    std::vector<uint32_t>                       m_retireStep;
+    std::vector<CurveCursors>                   m_curveCursors;     // Where each profile's last step left its curve lookups
+
+    // Guidance solve of each profile, and of each profile of the previous Run to seed this one's from.
+    // Profiles are seeded with the nearest converged solve by CalcProfileDistance, checked between batches.
+    std::vector<GuidanceSolve>                  m_guidanceSolves;
+    std::vector<GuidanceSolve>                  m_prevGuidanceSolves;
+    std::vector<ShaderShared::AscentParams>     m_prevAscentParams;     // Also what ReplayFlights flies, the caller's may be gone
+    std::vector<GuidanceSolve>                  m_replaySeeds;          // Copy of each seeded profile's seed, m_prevGuidanceSolves is overwritten
+    std::vector<float>                          m_seedDistance;
+    std::vector<bool>                           m_guidanceOffered;  // Solve has been offered as a seed
+    float                                       m_speedScale;       // Reciprocal of the sweep's pitch over speed range
+    float                                       m_angleScale;       // And of its pitch over angle range
+};
+
+// CalcFlightDataExtents as a parallel reduction: fixed size chunks of flights are reduced in a single pass
+// each, then merged pairwise in a tree. Chunks are independent of the thread count and merged in order,
+// so the result matches CalcFlightDataExtents exactly.
+void    ReduceFlightDataExtents( const ShaderShared::FlightData* flightData, uint32_t count, const ShaderShared::MissionParams& missionParams, float earthRadius,
+                                 ThreadPool& threadPool, ShaderShared::FlightData& minData, ShaderShared::FlightData& maxData );
@@ -0,0 +1,166 @@
+#include "SweepRefinement.h"
+#include "FlightAnalysis.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+    // One axis of the next level: how many new steps make an old one and the new step it starts on, counted
+    // in new steps from the old grid's start.
+    struct AxisRefinement
+    {
+        uint32_t    divisor;
+        uint32_t    first;
+    };
+
+    // Centres the new grid on the best point, kept inside the old grid. An axis already at resolution keeps
+    // its grid, which then coincides with the old one throughout. The new grid needn't start on an old point,
+    // a span of old steps that isn't whole couldn't always reach a best point at the end otherwise.
+    AxisRefinement RefineAxis( uint32_t best, uint32_t count, float step, float resolution )
+    {
+        // At most 4 or so old steps across, past that a level gains too little to be worth a sweep. Grids of
+        // fewer than 9 points are still halved, or they'd never narrow.
+        const uint32_t maxDivisor = std::max( (count - 1) / 4, 2u );
+
+        AxisRefinement axis;
+        axis.divisor = step > resolution ? std::min( uint32_t( ceilf( step / resolution ) ), maxDivisor ) : 1;
+
+        int32_t first = int32_t( best * axis.divisor ) - int32_t( (count - 1) / 2 );
+        int32_t last = int32_t( (count - 1) * (axis.divisor - 1) );
+        axis.first = uint32_t( std::min( std::max( first, 0 ), last ) );
+
+        return axis;
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+bool RefineSweep( SweepEngine& engine, const RefinementConfig& config, float minSpeed, float maxSpeed, float minAngle, float maxAngle,
+                  double earthRadius, double earthMu, RefinementResult& result )
+{
+    const uint32_t speedCount = config.speedCount;
+    const uint32_t angleCount = config.angleCount;
+    const uint32_t gridSize = speedCount * angleCount;
+
+    std::vector<AscentParams> grid( gridSize ), prevGrid;
+    std::vector<FlightData> data( gridSize ), prevData;
+    std::vector<uint32_t> source( gridSize, ~0u );     // Index in the previous level's grid of a reused point
+
+    std::vector<AscentParams> sweepParams;
+    std::vector<uint32_t> sweepIndex;
+
+    GenerateAscentParams( minSpeed, maxSpeed, minAngle, maxAngle, speedCount, angleCount, grid.data() );
+    result.levels.clear();
+
+    for ( uint32_t level = 0; level < config.maxLevels; ++level )
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        RefinementLevel info = { minSpeed, maxSpeed, minAngle, maxAngle, 0, 0, ~0u, 0.0 };
+
+        sweepParams.clear();
+        sweepIndex.clear();
+        for ( uint32_t i = 0; i < gridSize; ++i )
+        {
+            if ( source[i] != ~0u )
+            {
+                data[i] = prevData[source[i]];
+                ++info.reused;
+            }
+            else
+            {
+                sweepParams.push_back( grid[i] );
+                sweepIndex.push_back( i );
+            }
+        }
+
+        if ( !sweepParams.empty() )
+        {
+            engine.Run( sweepParams );
+
+            const std::vector<FlightData>& flightData = engine.GetFlightData();
+            for ( uint32_t i = 0; i < sweepIndex.size(); ++i )
+                data[sweepIndex[i]] = flightData[i];
+        }
+
+        info.simulated = static_cast<uint32_t>(sweepParams.size());
+
+        // Scored against the best final mass over this level's whole grid, as if it had been one sweep.
+        FlightData minData, maxData;
+        CalcFlightDataExtents( data.data(), gridSize, engine.GetMissionParams(), float( earthRadius ), minData, maxData );
+
+        float bestScore = FLT_MAX;
+        for ( uint32_t i = 0; i < gridSize; ++i )
+        {
+            float score = CalcSelectionScore( data[i], maxData.minMass, engine.GetMissionParams(), earthRadius, earthMu );
+            if ( score < bestScore )
+            {
+                bestScore = score;
+                info.best = i;
+            }
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        info.time = elapsed.count();
+        result.levels.push_back( info );
+
+        if ( info.best == ~0u )
+            return false;
+
+        result.bestParams = grid[info.best];
+        result.bestData = data[info.best];
+
+        float speedStep = (maxSpeed - minSpeed) / (speedCount - 1);
+        float angleStep = (maxAngle - minAngle) / (angleCount - 1);
+
+        if ( speedStep <= config.speedResolution && angleStep <= config.angleResolution )
+            break;
+
+        AxisRefinement speedAxis = RefineAxis( info.best / angleCount, speedCount, speedStep, config.speedResolution );
+        AxisRefinement angleAxis = RefineAxis( info.best % angleCount, angleCount, angleStep, config.angleResolution );
+
+        speedStep /= speedAxis.divisor;
+        minSpeed = minSpeed + speedAxis.first * speedStep;
+        maxSpeed = minSpeed + (speedCount - 1) * speedStep;
+
+        angleStep /= angleAxis.divisor;
+        minAngle = minAngle + angleAxis.first * angleStep;
+        maxAngle = minAngle + (angleCount - 1) * angleStep;
+
+        prevGrid.swap( grid );
+        prevData.swap( data );
+        grid.resize( gridSize );
+        data.resize( gridSize );
+
+        GenerateAscentParams( minSpeed, maxSpeed, minAngle, maxAngle, speedCount, angleCount, grid.data() );
+
+        // Coinciding points take the old params as well as the results, the new ones may round differently.
+        for ( uint32_t speed = 0; speed < speedCount; ++speed )
+        {
+            for ( uint32_t angle = 0; angle < angleCount; ++angle )
+            {
+                uint32_t i = speed * angleCount + angle;
+                source[i] = ~0u;
+
+                // New steps from the old grid's start, a multiple of the divisor on an old point.
+                const uint32_t speedOffset = speedAxis.first + speed;
+                const uint32_t angleOffset = angleAxis.first + angle;
+                if ( !config.reuseResults || speedOffset % speedAxis.divisor != 0 || angleOffset % angleAxis.divisor != 0 )
+                    continue;
+
+                source[i] = (speedOffset / speedAxis.divisor) * angleCount + angleOffset / angleAxis.divisor;
+                grid[i] = prevGrid[source[i]];
+            }
+        }
+    }
+
+    return true;
+}
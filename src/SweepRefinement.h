@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "SweepEngine.h"
+
+//------------------------------------------------------------------------------------------------
+// Automatic version of zooming the sweep grid with a shift drag. A coarse sweep is run, the grid is
+// narrowed around the profile with the best selection score and swept again, until the pitch over speed
+// and angle steps are down to the resolution asked for.
+//
+// Each level divides the previous level's steps by a whole number and starts on a multiple of the new
+// step, so every few points of the new grid coincide with old ones. Those aren't flown again.
+
+struct RefinementConfig
+{
+    float       speedResolution = 0.1f;         // Pitch over speed step to reach, m/s
+    float       angleResolution = 1.745329e-4f; // Pitch over angle step to reach, radians (0.01 degrees)
+    uint32_t    maxLevels = 8;                  // Including the first sweep
+    bool        reuseResults = true;            // Take coinciding grid points from the previous level
+    uint32_t    speedCount = c_SweepSpeedCount; // Grid of each level
+    uint32_t    angleCount = c_SweepAngleCount;
+};
+
+struct RefinementLevel
+{
+    float       minSpeed;       // m/s
+    float       maxSpeed;
+    float       minAngle;       // radians
+    float       maxAngle;
+    uint32_t    simulated;      // Profiles swept
+    uint32_t    reused;         // Profiles taken from the previous level
+    uint32_t    best;           // Grid index of the best profile by CalcSelectionScore, ~0u if none
+    double      time;           // Seconds
+};
+
+struct RefinementResult
+{
+    std::vector<RefinementLevel>    levels;
+    ShaderShared::AscentParams      bestParams;
+    ShaderShared::FlightData        bestData;
+};
+
+// Refines a config.speedCount x config.angleCount grid starting from the given ranges, angles in radians,
+// sweeping each level with the engine. Returns false if a level has no profile that reached MECO within
+// the max Q limit, with the levels swept so far in result.
+bool    RefineSweep( SweepEngine& engine, const RefinementConfig& config, float minSpeed, float maxSpeed, float minAngle, float maxAngle,
+                     double earthRadius, double earthMu, RefinementResult& result );
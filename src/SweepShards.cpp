@@ -0,0 +1,449 @@
+#include "SweepShards.h"
+#include "SweepCache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+    const uint32_t  c_ShardMagic = 0x44485352;      // "RSHD"
+    const uint32_t  c_ShardProtocolVersion = 1;
+
+    // Sent once by each worker when it has loaded its inputs.
+    struct HelloMessage
+    {
+        uint32_t    magic;
+        uint32_t    version;
+        uint64_t    contextHash;
+    };
+
+    // Heads a request, followed by count AscentParams, and its result, followed by count FlightData.
+    struct ShardHeader
+    {
+        uint32_t    magic;
+        uint32_t    shard;
+        uint32_t    count;
+    };
+
+    // Context hash at the SIMD level an engine with this config flies at.
+    uint64_t CalcEngineContextHash( const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& config, ThreadPool& threadPool )
+    {
+        SweepEngine engine( environment, missionParams, config, threadPool );
+
+        SweepConfig engineConfig = config;
+        engineConfig.simdLevel = engine.GetSimdLevel();
+        return CalcSweepContextHash( environment, missionParams, engineConfig );
+    }
+
+    // On an engine of its own, so the shard doesn't warm start from the one before.
+    void FlyShard( const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& config, ThreadPool& threadPool,
+                   const AscentParams* ascentParams, uint32_t count, FlightData* flightData )
+    {
+        SweepConfig shardConfig = config;
+        shardConfig.recordTelemetry = false;
+
+        SweepEngine engine( environment, missionParams, shardConfig, threadPool );
+        engine.Run( std::vector<AscentParams>( ascentParams, ascentParams + count ) );
+
+        std::copy( engine.GetFlightData().begin(), engine.GetFlightData().begin() + count, flightData );
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+#ifdef _WIN32
+
+bool RunShardedSweep( const std::vector<std::string>& workerCommand, const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& config,
+                      ThreadPool& threadPool, const std::vector<AscentParams>& ascentParams, const ShardConfig& shardConfig, std::vector<FlightData>& flightData, ShardStats& stats )
+{
+    fprintf( stderr, "Worker processes aren't supported on Windows.\n" );
+    return false;
+}
+
+bool RunShardWorker( const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& config, ThreadPool& threadPool, int inFd, int outFd )
+{
+    fprintf( stderr, "Worker processes aren't supported on Windows.\n" );
+    return false;
+}
+
+#else
+
+namespace
+{
+    // Bytes read before the end of the file or an error.
+    size_t ReadFully( int fd, void* data, size_t size )
+    {
+        char* bytes = static_cast<char*>(data);
+        size_t done = 0;
+
+        while ( done < size )
+        {
+            ssize_t result = read( fd, bytes + done, size - done );
+            if ( result < 0 && errno == EINTR )
+                continue;
+            if ( result <= 0 )
+                break;
+            done += size_t( result );
+        }
+
+        return done;
+    }
+
+    bool WriteFully( int fd, const void* data, size_t size )
+    {
+        const char* bytes = static_cast<const char*>(data);
+        size_t done = 0;
+
+        while ( done < size )
+        {
+            ssize_t result = write( fd, bytes + done, size - done );
+            if ( result < 0 && errno == EINTR )
+                continue;
+            if ( result <= 0 )
+                return false;
+            done += size_t( result );
+        }
+
+        return true;
+    }
+
+    struct Worker
+    {
+        pid_t       pid = -1;
+        int         requestFd = -1;
+        int         resultFd = -1;
+        bool        alive = false;
+        bool        ready = false;      // Hello received
+        uint32_t    shard = ~0u;        // Being flown, ~0u if idle
+        uint32_t    sent = 0;           // Shards sent
+        std::vector<char>   received;   // Bytes of the message in progress
+        std::chrono::steady_clock::time_point   sentTime;
+    };
+
+    // Pipes are close on exec, so a worker doesn't hold the others' open and hide their exit.
+    bool StartWorker( const std::vector<std::string>& command, Worker& worker )
+    {
+        // Built before the fork, the child shouldn't allocate.
+        std::vector<char*> argv;
+        for ( const std::string& arg : command )
+            argv.push_back( const_cast<char*>(arg.c_str()) );
+        argv.push_back( nullptr );
+
+        int request[2], result[2];
+        if ( pipe( request ) != 0 )
+            return false;
+        if ( pipe( result ) != 0 )
+        {
+            close( request[0] );
+            close( request[1] );
+            return false;
+        }
+
+        for ( int fd : { request[0], request[1], result[0], result[1] } )
+            fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+        pid_t pid = fork();
+        if ( pid == 0 )
+        {
+            dup2( request[0], STDIN_FILENO );
+            dup2( result[1], STDOUT_FILENO );
+            execvp( argv[0], argv.data() );
+            _exit( 127 );
+        }
+
+        close( request[0] );
+        close( result[1] );
+
+        if ( pid < 0 )
+        {
+            close( request[1] );
+            close( result[0] );
+            return false;
+        }
+
+        worker.pid = pid;
+        worker.requestFd = request[1];
+        worker.resultFd = result[0];
+        worker.alive = true;
+        return true;
+    }
+
+    void StopWorker( Worker& worker, bool kill )
+    {
+        if ( kill )
+            ::kill( worker.pid, SIGKILL );
+
+        // Closing the requests is what tells a live worker to exit.
+        close( worker.requestFd );
+        close( worker.resultFd );
+        waitpid( worker.pid, nullptr, 0 );
+
+        worker.alive = false;
+    }
+}
+
+bool RunShardedSweep( const std::vector<std::string>& workerCommand, const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& config,
+                      ThreadPool& threadPool, const std::vector<AscentParams>& ascentParams, const ShardConfig& shardConfig, std::vector<FlightData>& flightData, ShardStats& stats )
+{
+    if ( config.warmStartGuidance )
+    {
+        fprintf( stderr, "Sharded sweeps fly with warm started guidance off, or shards wouldn't match a single sweep.\n" );
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const uint32_t profileCount = static_cast<uint32_t>(ascentParams.size());
+    const uint32_t shardSize = std::max( shardConfig.shardSize, 1u );
+    const uint32_t shardCount = (profileCount + shardSize - 1) / shardSize;
+    const uint64_t contextHash = CalcEngineContextHash( environment, missionParams, config, threadPool );
+
+    stats = ShardStats{};
+    stats.shards = shardCount;
+    stats.workerShards.assign( shardConfig.workerCount, 0 );
+
+    flightData.assign( size_t( profileCount ) + 2, FlightData{} );
+
+    // A worker gone between poll and write would otherwise kill the coordinator.
+    signal( SIGPIPE, SIG_IGN );
+
+    std::vector<Worker> workers( shardConfig.workerCount );
+    uint32_t started = 0;
+    for ( Worker& worker : workers )
+        started += StartWorker( workerCommand, worker );
+
+    if ( started == 0 && shardCount > 0 )
+    {
+        fprintf( stderr, "Failed to start any worker processes.\n" );
+        return false;
+    }
+
+    std::deque<uint32_t> queue;
+    for ( uint32_t shard = 0; shard < shardCount; ++shard )
+        queue.push_back( shard );
+
+    uint32_t shardsDone = 0;
+
+    auto loseWorker = [&] ( Worker& worker, const char* reason )
+    {
+        fprintf( stderr, "Worker %u %s, dropping it.\n", uint32_t( &worker - workers.data() ), reason );
+
+        if ( worker.shard != ~0u )
+        {
+            queue.push_front( worker.shard );
+            worker.shard = ~0u;
+            ++stats.reassigned;
+        }
+
+        StopWorker( worker, true );
+        ++stats.workersLost;
+    };
+
+    // Takes what's complete from the worker's received bytes, returning false if it broke the protocol.
+    auto takeMessages = [&] ( Worker& worker )
+    {
+        std::vector<char>& received = worker.received;
+
+        if ( !worker.ready )
+        {
+            if ( received.size() < sizeof( HelloMessage ) )
+                return true;
+
+            HelloMessage hello;
+            memcpy( &hello, received.data(), sizeof( hello ) );
+            received.erase( received.begin(), received.begin() + sizeof( hello ) );
+
+            if ( hello.magic != c_ShardMagic || hello.version != c_ShardProtocolVersion || hello.contextHash != contextHash )
+                return false;
+
+            worker.ready = true;
+        }
+
+        if ( received.size() < sizeof( ShardHeader ) )
+            return received.empty() || worker.shard != ~0u;
+
+        ShardHeader header;
+        memcpy( &header, received.data(), sizeof( header ) );
+
+        const uint32_t first = worker.shard * shardSize;
+        const uint32_t count = std::min( shardSize, profileCount - first );
+        if ( worker.shard == ~0u || header.magic != c_ShardMagic || header.shard != worker.shard || header.count != count )
+            return false;
+
+        const size_t size = sizeof( header ) + size_t( count ) * sizeof( FlightData );
+        if ( received.size() < size )
+            return true;
+
+        memcpy( &flightData[first], received.data() + sizeof( header ), size_t( count ) * sizeof( FlightData ) );
+        received.erase( received.begin(), received.begin() + size );
+
+        ++stats.workerShards[&worker - workers.data()];
+        ++shardsDone;
+        worker.shard = ~0u;
+        return received.empty();
+    };
+
+    std::vector<pollfd> pollFds;
+    std::vector<Worker*> polled;
+    std::vector<char> buffer( 65536 );
+
+    while ( shardsDone < shardCount )
+    {
+        for ( Worker& worker : workers )
+        {
+            if ( !worker.alive || !worker.ready || worker.shard != ~0u || queue.empty() )
+                continue;
+
+            const uint32_t shard = queue.front();
+            const uint32_t first = shard * shardSize;
+            const uint32_t count = std::min( shardSize, profileCount - first );
+            queue.pop_front();
+
+            worker.shard = shard;
+            worker.sentTime = std::chrono::steady_clock::now();
+
+            ShardHeader header = { c_ShardMagic, shard, count };
+            if ( !WriteFully( worker.requestFd, &header, sizeof( header ) ) || !WriteFully( worker.requestFd, &ascentParams[first], size_t( count ) * sizeof( AscentParams ) ) )
+            {
+                loseWorker( worker, "stopped taking shards" );
+                continue;
+            }
+
+            if ( ++worker.sent == shardConfig.killAfter && &worker == &workers[0] )
+                kill( worker.pid, SIGKILL );
+        }
+
+        pollFds.clear();
+        polled.clear();
+        for ( Worker& worker : workers )
+        {
+            if ( worker.alive )
+            {
+                pollFds.push_back( { worker.resultFd, POLLIN, 0 } );
+                polled.push_back( &worker );
+            }
+        }
+
+        if ( polled.empty() )
+            break;
+
+        int timeout = shardConfig.timeout > 0 ? 100 : -1;
+        if ( poll( pollFds.data(), nfds_t( pollFds.size() ), timeout ) < 0 && errno != EINTR )
+            break;
+
+        for ( size_t p = 0; p < polled.size(); ++p )
+        {
+            Worker& worker = *polled[p];
+
+            if ( pollFds[p].revents != 0 )
+            {
+                ssize_t result = read( worker.resultFd, buffer.data(), buffer.size() );
+                if ( result < 0 && errno == EINTR )
+                    continue;
+
+                if ( result <= 0 )
+                {
+                    loseWorker( worker, worker.ready ? "exited" : "exited before it was ready" );
+                    continue;
+                }
+
+                worker.received.insert( worker.received.end(), buffer.begin(), buffer.begin() + result );
+                if ( !takeMessages( worker ) )
+                {
+                    loseWorker( worker, worker.ready ? "sent a malformed result" : "loaded different inputs" );
+                    continue;
+                }
+            }
+
+            if ( shardConfig.timeout > 0 && worker.shard != ~0u )
+            {
+                std::chrono::duration<double> held = std::chrono::steady_clock::now() - worker.sentTime;
+                if ( held.count() > shardConfig.timeout )
+                    loseWorker( worker, "timed out" );
+            }
+        }
+    }
+
+    for ( Worker& worker : workers )
+    {
+        if ( worker.alive )
+            StopWorker( worker, false );
+    }
+
+    if ( !queue.empty() )
+    {
+        fprintf( stderr, "Every worker was lost, flying the %zu shards left here.\n", queue.size() );
+
+        for ( uint32_t shard : queue )
+        {
+            const uint32_t first = shard * shardSize;
+            const uint32_t count = std::min( shardSize, profileCount - first );
+            FlyShard( environment, missionParams, config, threadPool, &ascentParams[first], count, &flightData[first] );
+            ++stats.localShards;
+        }
+    }
+
+    ReduceFlightDataExtents( flightData.data(), profileCount, missionParams, environment.params.Re, threadPool, flightData[profileCount], flightData[profileCount + 1] );
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stats.time = elapsed.count();
+    return true;
+}
+
+bool RunShardWorker( const FlightEnvironment& environment, const MissionParams& missionParams, const SweepConfig& config, ThreadPool& threadPool, int inFd, int outFd )
+{
+    if ( outFd == STDOUT_FILENO )
+    {
+        fflush( stdout );
+        outFd = dup( STDOUT_FILENO );
+        dup2( STDERR_FILENO, STDOUT_FILENO );
+    }
+
+    HelloMessage hello = { c_ShardMagic, c_ShardProtocolVersion, CalcEngineContextHash( environment, missionParams, config, threadPool ) };
+    if ( !WriteFully( outFd, &hello, sizeof( hello ) ) )
+        return false;
+
+    std::vector<AscentParams> ascentParams;
+    std::vector<FlightData> flightData;
+
+    for ( ;; )
+    {
+        ShardHeader header;
+        size_t headerSize = ReadFully( inFd, &header, sizeof( header ) );
+        if ( headerSize == 0 )
+            return true;
+
+        if ( headerSize != sizeof( header ) || header.magic != c_ShardMagic )
+            return false;
+
+        ascentParams.resize( header.count );
+        flightData.resize( header.count );
+
+        if ( ReadFully( inFd, ascentParams.data(), ascentParams.size() * sizeof( AscentParams ) ) != ascentParams.size() * sizeof( AscentParams ) )
+            return false;
+
+        FlyShard( environment, missionParams, config, threadPool, ascentParams.data(), header.count, flightData.data() );
+
+        if ( !WriteFully( outFd, &header, sizeof( header ) ) || !WriteFully( outFd, flightData.data(), flightData.size() * sizeof( FlightData ) ) )
+            return false;
+    }
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "SweepEngine.h"
+
+//------------------------------------------------------------------------------------------------
+// Sweeps split across worker processes on one machine. The coordinator cuts the profiles into shards of
+// a fixed size and starts the workers, each a process serving shards with RunShardWorker on its stdin and
+// stdout. A worker is sent one shard at a time, flies it on a SweepEngine of its own and writes its FlightData
+// back; the coordinator sends it the next as soon as it has.
+//
+// A worker that exits, closes its pipe or holds a shard past the timeout is dropped and its shard goes back
+// on the queue for the others. If every worker is lost the coordinator flies what's left itself.
+//
+// Each shard is flown by a fresh engine, so it comes out the same whichever worker flies it. Flights only
+// depend on the other profiles in their sweep through warm started guidance, so with that off the merged
+// FlightData matches a single process sweep bit for bit; RunShardedSweep requires it off.
+//
+// Messages are native endian structs, the workers are on the same machine. Every worker starts by sending
+// its CalcSweepContextHash, and one that loaded different inputs from the coordinator's is dropped. POSIX
+// only, fork, pipes and poll; on Windows RunShardedSweep fails.
+
+struct ShardConfig
+{
+    uint32_t    workerCount = 4;
+    uint32_t    shardSize = 256;        // Profiles per shard
+    double      timeout = 0;            // Seconds a worker may hold a shard, 0 waits for ever
+    uint32_t    killAfter = 0;          // For testing: SIGKILL the first worker when it's sent this many shards, 0 never
+};
+
+struct ShardStats
+{
+    uint32_t    shards;
+    uint32_t    reassigned;         // Shards sent again after their worker was lost
+    uint32_t    workersLost;
+    uint32_t    localShards;        // Flown by the coordinator after every worker was lost
+    std::vector<uint32_t>   workerShards;   // Shards each worker returned
+    double      time;               // Seconds, from starting the workers to the last shard
+};
+
+// Flies ascentParams on workers started with workerCommand, the program and its arguments, and fills
+// flightData with one entry per profile followed by the min and max extents, as SweepEngine::GetFlightData.
+// environment, missionParams and config are the coordinator's own inputs, which the workers' must hash the
+// same as. Returns false, having printed the reason, if the workers can't be started or config has warm
+// started guidance.
+bool    RunShardedSweep( const std::vector<std::string>& workerCommand, const FlightEnvironment& environment, const ShaderShared::MissionParams& missionParams,
+                         const SweepConfig& config, ThreadPool& threadPool, const std::vector<ShaderShared::AscentParams>& ascentParams, const ShardConfig& shardConfig,
+                         std::vector<ShaderShared::FlightData>& flightData, ShardStats& stats );
+
+// Serves shards read from inFd until it's closed, writing results to outFd. If outFd is stdout, stdout is
+// pointed at stderr first so nothing else writes into the results. Returns false if a message was cut short
+// or a write failed.
+bool    RunShardWorker( const FlightEnvironment& environment, const ShaderShared::MissionParams& missionParams, const SweepConfig& config, ThreadPool& threadPool,
+                        int inFd, int outFd );
@@ -0,0 +1,574 @@
+#include "SweepSurrogate.h"
+#include "FlightAnalysis.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+#include <numeric>
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+// Most points the hyperparameters are searched on, as each fit of the search is O(n^3).
+static const size_t     c_MaxSearchPoints = 128;
+
+void GaussianProcess::Fit( const std::vector<float2>& points, const std::vector<double>& values, bool keepHyperparameters )
+{
+
+    if ( !keepHyperparameters || !m_fitted )
+    {
+        const double count = double( values.size() );
+        m_mean = std::accumulate( values.begin(), values.end(), 0.0 ) / count;
+
+        double variance = 0;
+        for ( double y : values )
+            variance += (y - m_mean) * (y - m_mean);
+        m_scale = variance > 0 ? sqrt( variance / count ) : 1;
+    }
+
+    std::vector<double> normalised( values.size() );
+    for ( size_t i = 0; i < values.size(); ++i )
+        normalised[i] = (values[i] - m_mean) / m_scale;
+
+    if ( !keepHyperparameters || !m_fitted )
+    {
+        static const double c_LengthScales[] = { 0.03, 0.06, 0.12, 0.24 };
+        static const double c_Noise[] = { 1e-3, 1e-2, 1e-1, 3e-1 };
+
+        // Beyond c_MaxSearchPoints, on an even stride through them.
+        const size_t stride = (points.size() + c_MaxSearchPoints - 1) / c_MaxSearchPoints;
+        std::vector<double> searchValues;
+        m_points.clear();
+        for ( size_t i = 0; i < points.size(); i += stride )
+        {
+            m_points.push_back( points[i] );
+            searchValues.push_back( normalised[i] );
+        }
+
+        double bestLikelihood = -DBL_MAX;
+        double best[3] = { m_lengthScale[0], m_lengthScale[1], m_noise };
+
+        for ( double speedScale : c_LengthScales )
+        {
+            for ( double angleScale : c_LengthScales )
+            {
+                for ( double noise : c_Noise )
+                {
+                    m_lengthScale[0] = speedScale;
+                    m_lengthScale[1] = angleScale;
+                    m_noise = noise;
+
+                    double likelihood = Factor( searchValues );
+                    if ( likelihood > bestLikelihood )
+                    {
+                        bestLikelihood = likelihood;
+                        best[0] = speedScale;
+                        best[1] = angleScale;
+                        best[2] = noise;
+                    }
+                }
+            }
+        }
+
+        m_lengthScale[0] = best[0];
+        m_lengthScale[1] = best[1];
+        m_noise = best[2];
+    }
+
+    m_points = points;
+    Factor( normalised );
+    m_fitted = true;
+}
+
+void GaussianProcess::Predict( float2 point, double& mean, double& variance ) const
+{
+    const size_t count = m_points.size();
+
+    // v = L^-1 k, variance is of the latent function rather than of a noisy observation.
+    std::vector<double> v( count );
+    double dot = 0, vv = 0;
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        double k = Kernel( point, m_points[i] );
+        dot += k * m_alpha[i];
+
+        const double* row = &m_cholesky[i * count];
+        double sum = k;
+        for ( size_t j = 0; j < i; ++j )
+            sum -= row[j] * v[j];
+
+        v[i] = sum / row[i];
+        vv += v[i] * v[i];
+    }
+
+    mean = m_mean + m_scale * dot;
+    variance = m_scale * m_scale * std::max( 1 - vv, 1e-12 );
+}
+
+void GaussianProcess::AddPoint( float2 point, double value, bool exact )
+{
+    const size_t count = m_points.size();
+
+    // The factor grows by a row, L' = [L 0; l^T d] with L l = k and d^2 = 1 + noise - l.l, so the
+    // existing rows are copied over to the wider stride.
+    std::vector<double> cholesky( (count + 1) * (count + 1), 0.0 );
+    for ( size_t i = 0; i < count; ++i )
+        std::copy( &m_cholesky[i * count], &m_cholesky[i * count] + i + 1, &cholesky[i * (count + 1)] );
+
+    double* row = &cholesky[count * (count + 1)];
+    double ll = 0;
+    for ( size_t i = 0; i < count; ++i )
+    {
+        const double* rowI = &cholesky[i * (count + 1)];
+        double sum = Kernel( point, m_points[i] );
+        for ( size_t j = 0; j < i; ++j )
+            sum -= rowI[j] * row[j];
+
+        row[i] = sum / rowI[i];
+        ll += row[i] * row[i];
+    }
+    row[count] = sqrt( std::max( 1 + (exact ? 1e-6 : m_noise) - ll, 1e-12 ) );
+
+    m_cholesky.swap( cholesky );
+    m_points.push_back( point );
+    m_values.push_back( (value - m_mean) / m_scale );
+    Solve();
+}
+
+double GaussianProcess::Kernel( float2 a, float2 b ) const
+{
+    double dx = (a.x - b.x) / m_lengthScale[0];
+    double dy = (a.y - b.y) / m_lengthScale[1];
+    double r = sqrt( 5 * (dx * dx + dy * dy) );
+
+    return (1 + r + r * r / 3) * exp( -r );
+}
+
+double GaussianProcess::Factor( const std::vector<double>& values )
+{
+    const size_t count = m_points.size();
+    m_cholesky.assign( count * count, 0.0 );
+
+    double logDeterminant = 0;
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        double* row = &m_cholesky[i * count];
+
+        for ( size_t j = 0; j <= i; ++j )
+        {
+            const double* rowJ = &m_cholesky[j * count];
+            double sum = Kernel( m_points[i], m_points[j] ) + (i == j ? m_noise : 0);
+
+            for ( size_t k = 0; k < j; ++k )
+                sum -= row[k] * rowJ[k];
+
+            if ( i == j )
+            {
+                if ( sum <= 0 )
+                    return -DBL_MAX;
+
+                row[i] = sqrt( sum );
+                logDeterminant += 2 * log( row[i] );
+            }
+            else
+            {
+                row[j] = sum / rowJ[j];
+            }
+        }
+    }
+
+    m_values = values;
+    double fit = Solve();
+
+    return -0.5 * fit - 0.5 * logDeterminant;
+}
+
+double GaussianProcess::Solve()
+{
+    const size_t count = m_points.size();
+    m_alpha.resize( count );
+
+    // alpha = L^-T L^-1 y
+    for ( size_t i = 0; i < count; ++i )
+    {
+        const double* row = &m_cholesky[i * count];
+        double sum = m_values[i];
+        for ( size_t j = 0; j < i; ++j )
+            sum -= row[j] * m_alpha[j];
+
+        m_alpha[i] = sum / row[i];
+    }
+
+    double fit = 0;
+    for ( size_t i = 0; i < count; ++i )
+        fit += m_values[i] * m_alpha[i];
+
+    for ( size_t i = count; i-- > 0; )
+    {
+        double sum = m_alpha[i];
+        for ( size_t j = i + 1; j < count; ++j )
+            sum -= m_cholesky[j * count + i] * m_alpha[j];
+
+        m_alpha[i] = sum / m_cholesky[i * count + i];
+    }
+
+    return fit;
+}
+
+//------------------------------------------------------------------------------------------------
+
+FlightSurrogate::FlightSurrogate( const MissionParams& missionParams, double earthRadius, double earthMu, float minSpeed, float maxSpeed, float minAngle, float maxAngle ) :
+    m_missionParams( missionParams ),
+    m_earthRadius( earthRadius ),
+    m_earthMu( earthMu ),
+    m_minValues{ minSpeed, minAngle },
+    m_maxValues{ maxSpeed, maxAngle }
+{
+}
+
+float2 FlightSurrogate::ToUnit( float speed, float angle ) const
+{
+    return float2( (speed - m_minValues[0]) / std::max( m_maxValues[0] - m_minValues[0], 1e-6f ),
+                   (angle - m_minValues[1]) / std::max( m_maxValues[1] - m_minValues[1], 1e-6f ) );
+}
+
+void FlightSurrogate::AddResults( const AscentParams* ascentParams, const FlightData* flightData, uint32_t count )
+{
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        const FlightData& fd = flightData[i];
+        float2 point = ToUnit( ascentParams[i].pitchOverSpeed, asinf( ascentParams[i].sinPitchOverAngle ) );
+
+        float orbitError = CalcOrbitError( fd, m_missionParams, m_earthRadius, m_earthMu );
+        bool meco = fd.flightPhase == c_PhaseMECO && isfinite( fd.minMass ) && isfinite( orbitError );
+
+        m_points.push_back( point );
+        m_values[MaxQ].push_back( log( std::max( fd.maxQ, 1.0f ) ) );
+        m_values[Meco].push_back( meco && fd.maxQ < 60000.0f ? 1 : 0 );
+        m_values[Objective].push_back( CalcSelectionObjective( fd, m_missionParams, m_earthRadius, m_earthMu ) );
+
+        if ( meco )
+        {
+            m_mecoPoints.push_back( point );
+            m_values[MinMass].push_back( fd.minMass );
+            m_values[OrbitError].push_back( log1p( orbitError ) );
+        }
+    }
+}
+
+void FlightSurrogate::Fit( ThreadPool& threadPool )
+{
+    // Searching the hyperparameters is 64 fits, it's repeated once the results have grown by half.
+    uint32_t count = GetResultCount();
+    bool search = 2 * count >= 3 * m_searchedCount;
+    if ( search )
+        m_searchedCount = count;
+
+    std::vector<double> feasible;
+    for ( double objective : m_values[Objective] )
+    {
+        if ( objective < FLT_MAX )
+            feasible.push_back( objective );
+    }
+
+    std::vector<double> capped( m_values[Objective] );
+    if ( !feasible.empty() )
+    {
+        std::nth_element( feasible.begin(), feasible.begin() + feasible.size() / 2, feasible.end() );
+        double cap = feasible[feasible.size() / 2];
+
+        for ( double& objective : capped )
+            objective = std::min( objective, cap );
+    }
+
+    threadPool.ParallelFor( QuantityCount, 1, [this, search, &feasible, &capped] ( uint32_t begin, uint32_t end )
+    {
+        for ( uint32_t q = begin; q < end; ++q )
+        {
+            if ( q == Objective )
+            {
+                if ( !feasible.empty() )
+                    m_processes[q].Fit( m_points, capped, !search );
+            }
+            else if ( q == MaxQ || q == Meco )
+            {
+                m_processes[q].Fit( m_points, m_values[q], !search );
+            }
+            else if ( !m_mecoPoints.empty() )
+            {
+                m_processes[q].Fit( m_mecoPoints, m_values[q], !search );
+            }
+        }
+    } );
+
+    m_fittedObjective = !feasible.empty();
+
+    m_bestObjective = FLT_MAX;
+    for ( size_t i = 0; m_fittedObjective && i < m_points.size(); ++i )
+    {
+        double mean, variance;
+        m_processes[Objective].Predict( m_points[i], mean, variance );
+        m_bestObjective = std::min( m_bestObjective, float( mean ) );
+    }
+}
+
+SurrogatePrediction FlightSurrogate::Predict( float speed, float angle ) const
+{
+    float2 point = ToUnit( speed, angle );
+
+    double mean[QuantityCount], variance[QuantityCount];
+    for ( uint32_t q = 0; q < QuantityCount; ++q )
+    {
+        mean[q] = 0;
+        variance[q] = 0;
+        if ( q == Objective ? m_fittedObjective : !(q == MaxQ || q == Meco ? m_points : m_mecoPoints).empty() )
+            m_processes[q].Predict( point, mean[q], variance[q] );
+    }
+
+    SurrogatePrediction prediction;
+    prediction.minMass = float( mean[MinMass] );
+    prediction.maxQ = float( exp( mean[MaxQ] ) );
+    prediction.orbitError = float( expm1( mean[OrbitError] ) );
+    prediction.mecoProbability = float( std::min( std::max( mean[Meco], 0.0 ), 1.0 ) );
+    prediction.objective = m_fittedObjective ? float( mean[Objective] ) : FLT_MAX;
+    prediction.objectiveSigma = float( sqrt( variance[Objective] ) );
+
+    return prediction;
+}
+
+float FlightSurrogate::AddPending( float speed, float angle )
+{
+    if ( !m_fittedObjective )
+        return FLT_MAX;
+
+    float2 point = ToUnit( speed, angle );
+    double mean, variance;
+    m_processes[Objective].Predict( point, mean, variance );
+
+    m_processes[Objective].AddPoint( point, mean, true );
+
+    return float( mean );
+}
+
+double FlightSurrogate::CalcExpectedImprovement( float speed, float angle, float bestObjective ) const
+{
+    if ( !m_fittedObjective )
+        return 0;
+
+    float2 point = ToUnit( speed, angle );
+    double mean, variance, feasible, feasibleVariance;
+    m_processes[Objective].Predict( point, mean, variance );
+    m_processes[Meco].Predict( point, feasible, feasibleVariance );
+
+    double gain = double( bestObjective ) - mean;
+    double sigma = sqrt( variance );
+    double improvement = std::max( gain, 0.0 );
+
+    if ( sigma >= 1e-9 )
+    {
+        double z = gain / sigma;
+        double cdf = 0.5 * erfc( -z / sqrt( 2.0 ) );
+        double pdf = exp( -0.5 * z * z ) * 0.3989422804014327;    // 1 / sqrt(2 pi)
+        improvement = gain * cdf + sigma * pdf;
+    }
+
+    return improvement * std::min( std::max( feasible, 0.0 ), 1.0 );
+}
+
+//------------------------------------------------------------------------------------------------
+
+namespace
+{
+    double RadicalInverse( uint32_t i, uint32_t base )
+    {
+        double inverse = 0, scale = 1.0 / base;
+        for ( ; i > 0; i /= base, scale /= base )
+            inverse += (i % base) * scale;
+
+        return inverse;
+    }
+
+    // Flies a batch of unit square points as one sweep, adds them to the surrogate and keeps the best flight seen.
+    void FlyPoints( SweepEngine& engine, FlightSurrogate& surrogate, const std::vector<float2>& points, const float minValues[2], const float maxValues[2],
+                    double earthRadius, double earthMu, std::vector<AscentParams>& params, SurrogateResult& result )
+    {
+        params.resize( points.size() );
+        for ( size_t i = 0; i < points.size(); ++i )
+        {
+            params[i] = MakeAscentParams( minValues[0] + points[i].x * (maxValues[0] - minValues[0]),
+                                          minValues[1] + points[i].y * (maxValues[1] - minValues[1]) );
+        }
+
+        engine.Run( params );
+
+        const std::vector<FlightData>& flightData = engine.GetFlightData();
+        surrogate.AddResults( params.data(), flightData.data(), static_cast<uint32_t>(points.size()) );
+
+        for ( size_t i = 0; i < points.size(); ++i )
+        {
+            float score = CalcSelectionObjective( flightData[i], engine.GetMissionParams(), earthRadius, earthMu );
+            if ( score < result.bestScore )
+            {
+                result.bestScore = score;
+                result.bestParams = params[i];
+                result.bestData = flightData[i];
+            }
+        }
+
+        result.evaluations += static_cast<uint32_t>(points.size());
+        ++result.iterations;
+        result.history.emplace_back( result.evaluations, result.bestScore );
+    }
+}
+
+bool SearchWithSurrogate( SweepEngine& engine, ThreadPool& threadPool, const SurrogateConfig& config, float minSpeed, float maxSpeed, float minAngle, float maxAngle,
+                          double earthRadius, double earthMu, SurrogateResult& result )
+{
+    result = SurrogateResult{};
+    result.bestScore = FLT_MAX;
+
+    const float minValues[2] = { minSpeed, minAngle };
+    const float maxValues[2] = { maxSpeed, maxAngle };
+
+    FlightSurrogate surrogate( engine.GetMissionParams(), earthRadius, earthMu, minSpeed, maxSpeed, minAngle, maxAngle );
+    std::vector<AscentParams> params;
+    std::vector<float2> batch;
+    uint32_t halton = 1;
+
+    // Quasi-random points until something is feasible, there's no improvement to expect before then.
+    while ( result.bestScore == FLT_MAX && result.evaluations < config.maxEvaluations )
+    {
+        uint32_t count = std::min( result.evaluations ? config.batchSize : config.initialSamples, config.maxEvaluations - result.evaluations );
+        batch.resize( count );
+        for ( float2& point : batch )
+        {
+            point = float2( float( RadicalInverse( halton, 2 ) ), float( RadicalInverse( halton, 3 ) ) );
+            ++halton;
+        }
+
+        FlyPoints( engine, surrogate, batch, minValues, maxValues, earthRadius, earthMu, params, result );
+    }
+
+    const uint32_t side = std::max( config.candidateCount, 2u );
+    std::vector<float2> candidates( side * side );
+    for ( uint32_t i = 0; i < side * side; ++i )
+        candidates[i] = float2( float( i % side ) / (side - 1), float( i / side ) / (side - 1) );
+
+    std::vector<double> improvements( candidates.size() );
+    float incumbent = FLT_MAX;      // Best predicted objective, counting those believed for pending points
+
+    auto improvement = [&] ( float2 point )
+    {
+        return surrogate.CalcExpectedImprovement( minValues[0] + point.x * (maxValues[0] - minValues[0]),
+                                                  minValues[1] + point.y * (maxValues[1] - minValues[1]), incumbent );
+    };
+
+    // Compass search up the expected improvement, to a thousandth of the ranges.
+    auto climb = [&] ( float2& point )
+    {
+        double value = improvement( point );
+
+        for ( float step = 0.5f / (side - 1); step > 1e-3f; )
+        {
+            float2 next = point;
+            double nextValue = value;
+            const float2 moves[4] = { float2( step, 0 ), float2( -step, 0 ), float2( 0, step ), float2( 0, -step ) };
+
+            for ( const float2& move : moves )
+            {
+                float2 x( std::min( std::max( point.x + move.x, 0.0f ), 1.0f ), std::min( std::max( point.y + move.y, 0.0f ), 1.0f ) );
+                double xValue = improvement( x );
+                if ( xValue > nextValue )
+                {
+                    next = x;
+                    nextValue = xValue;
+                }
+            }
+
+            if ( nextValue > value )
+            {
+                point = next;
+                value = nextValue;
+            }
+            else
+            {
+                step *= 0.5f;
+            }
+        }
+
+        return value;
+    };
+
+    while ( result.bestScore < FLT_MAX && result.evaluations < config.maxEvaluations )
+    {
+        surrogate.Fit( threadPool );
+
+        // Each point of the batch is the maximum climbed to from the best candidate, and for the first also from
+        // the best flight, whose neighbourhood is where it's often found once the search has closed in. The point
+        // is then taken as pending, which flattens the improvement around it for the next. The grid is only
+        // searched in full for the first point, the rest start from its best few candidates, scored again.
+        const uint32_t batchSize = std::min( config.batchSize, config.maxEvaluations - result.evaluations );
+        batch.clear();
+        incumbent = surrogate.GetBestObjective();
+
+        threadPool.ParallelFor( static_cast<uint32_t>(candidates.size()), 64, [&] ( uint32_t begin, uint32_t end )
+        {
+            for ( uint32_t i = begin; i < end; ++i )
+                improvements[i] = improvement( candidates[i] );
+        } );
+
+        std::vector<uint32_t> starts( candidates.size() );
+        std::iota( starts.begin(), starts.end(), 0 );
+
+        const uint32_t startCount = std::min( 4 * batchSize, static_cast<uint32_t>(starts.size()) );
+        std::partial_sort( starts.begin(), starts.begin() + startCount, starts.end(), [&improvements] ( uint32_t a, uint32_t b ) { return improvements[a] > improvements[b]; } );
+        starts.resize( startCount );
+
+        while ( batch.size() < batchSize )
+        {
+            float2 point = candidates[starts[0]];
+            double value = -1;
+            for ( uint32_t i : starts )
+            {
+                double startValue = batch.empty() ? improvements[i] : improvement( candidates[i] );
+                if ( startValue > value )
+                {
+                    point = candidates[i];
+                    value = startValue;
+                }
+            }
+
+            value = climb( point );
+
+            if ( batch.empty() )
+            {
+                float2 bestPoint( (result.bestParams.pitchOverSpeed - minValues[0]) / std::max( maxValues[0] - minValues[0], 1e-6f ),
+                                  (asinf( result.bestParams.sinPitchOverAngle ) - minValues[1]) / std::max( maxValues[1] - minValues[1], 1e-6f ) );
+                double bestValue = climb( bestPoint );
+                if ( bestValue > value )
+                {
+                    point = bestPoint;
+                    value = bestValue;
+                }
+            }
+
+            if ( value < config.minImprovement )
+                break;
+
+            batch.push_back( point );
+            incumbent = std::min( incumbent, surrogate.AddPending( minValues[0] + point.x * (maxValues[0] - minValues[0]),
+                                                                   minValues[1] + point.y * (maxValues[1] - minValues[1]) ) );
+        }
+
+        if ( batch.empty() )
+            break;
+
+        FlyPoints( engine, surrogate, batch, minValues, maxValues, earthRadius, earthMu, params, result );
+    }
+
+    return result.bestScore < FLT_MAX;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <float.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "SweepEngine.h"
+
+//------------------------------------------------------------------------------------------------
+// Gaussian process surrogates of a sweep's results over pitch over speed and angle, so points that
+// haven't been flown can be predicted in microseconds rather than simulated for 30000 steps.
+//
+// FlightSurrogate fits one process each to final mass, max Q, orbit error and whether the flight reached
+// MECO within the max Q limit, and one to CalcSelectionObjective that SearchWithSurrogate uses to fly only the points with the
+// highest expected improvement. Max Q and orbit error span orders of magnitude over a sweep, so are fitted
+// as logs. The objective is capped at the median of the feasible ones, which infeasible flights are given
+// too: the search only needs the good region right, and the worst flights would swamp the fit.
+
+class GaussianProcess
+{
+public:
+    // Matern 5/2 kernel, with a length scale per input and the noise picked by maximum likelihood from a
+    // small grid, unless keepHyperparameters is set and the process has been fitted before. The values'
+    // normalisation is kept with them.
+    void    Fit( const std::vector<ShaderShared::float2>& points, const std::vector<double>& values, bool keepHyperparameters );
+
+    // Variance of the underlying function, without the noise.
+    void    Predict( ShaderShared::float2 point, double& mean, double& variance ) const;
+
+    // Adds a point to the fitted process without refitting it, in O(n^2) rather than O(n^3). An exact point
+    // is taken without the noise, so the variance left at it is next to none.
+    void    AddPoint( ShaderShared::float2 point, double value, bool exact );
+
+private:
+    double  Kernel( ShaderShared::float2 a, ShaderShared::float2 b ) const;
+    // Cholesky factor of the kernel matrix and alpha for the current hyperparameters, returns the log
+    // marginal likelihood or -DBL_MAX if the matrix isn't positive definite.
+    double  Factor( const std::vector<double>& values );
+    // alpha for the current factor and values, returns y^T alpha.
+    double  Solve();
+
+    std::vector<ShaderShared::float2>   m_points;
+    std::vector<double>     m_values;       // Normalised
+    std::vector<double>     m_cholesky;     // Lower triangle, row major
+    std::vector<double>     m_alpha;        // K^-1 (y - mean) / scale
+    double                  m_mean = 0;
+    double                  m_scale = 1;
+    double                  m_lengthScale[2] = { 0.1, 0.1 };
+    double                  m_noise = 1e-3; // Relative to the unit signal variance
+    bool                    m_fitted = false;
+};
+
+//------------------------------------------------------------------------------------------------
+
+struct SurrogatePrediction
+{
+    float   minMass;
+    float   maxQ;
+    float   orbitError;
+    float   mecoProbability;    // Of reaching MECO within the max Q limit
+    float   objective;          // Capped CalcSelectionObjective, see above
+    float   objectiveSigma;
+};
+
+class FlightSurrogate
+{
+public:
+    // Angles in radians. Points are scaled to the unit square over these ranges.
+    FlightSurrogate( const ShaderShared::MissionParams& missionParams, double earthRadius, double earthMu, float minSpeed, float maxSpeed, float minAngle, float maxAngle );
+
+    void    AddResults( const ShaderShared::AscentParams* ascentParams, const ShaderShared::FlightData* flightData, uint32_t count );
+    void    Fit( ThreadPool& threadPool );
+
+    uint32_t    GetResultCount() const { return static_cast<uint32_t>(m_points.size()); }
+
+    SurrogatePrediction     Predict( float speed, float angle ) const;
+
+    // Takes a point about to be flown as having the objective predicted for it, so the improvement expected
+    // around it drops and the next point picked for the same sweep is elsewhere (the kriging believer).
+    // Returns the objective believed, which the improvement of the next point should be expected on if
+    // it's the best. The next Fit drops the point again.
+    float   AddPending( float speed, float angle );
+
+    // Lowest objective predicted at a point flown. Flights a hair apart can differ by kilograms, so this rather
+    // than the best flown is what improvement should be expected on, or one lucky flight ends the search.
+    float   GetBestObjective() const { return m_bestObjective; }
+
+    // Expected improvement on bestObjective, in kg as the objective, weighted by the chance of reaching MECO
+    // within the max Q limit. The capped objective alone would still expect some of infeasible regions.
+    double  CalcExpectedImprovement( float speed, float angle, float bestObjective ) const;
+
+private:
+    enum Quantity
+    {
+        MinMass,
+        MaxQ,
+        OrbitError,
+        Meco,
+        Objective,
+        QuantityCount
+    };
+
+    ShaderShared::float2    ToUnit( float speed, float angle ) const;
+
+    const ShaderShared::MissionParams&  m_missionParams;
+    double                  m_earthRadius;
+    double                  m_earthMu;
+    float                   m_minValues[2];
+    float                   m_maxValues[2];
+
+    // Every point flown and those that reached MECO, which the mass and orbit processes are fitted to.
+    // Objectives are uncapped, FLT_MAX if infeasible.
+    std::vector<ShaderShared::float2>   m_points;
+    std::vector<ShaderShared::float2>   m_mecoPoints;
+    std::vector<double>                 m_values[QuantityCount];
+
+    GaussianProcess         m_processes[QuantityCount];
+    uint32_t                m_searchedCount = 0;    // Results when the hyperparameters were last searched
+    bool                    m_fittedObjective = false;  // Not until something is feasible
+    float                   m_bestObjective = FLT_MAX;
+};
+
+//------------------------------------------------------------------------------------------------
+
+struct SurrogateConfig
+{
+    uint32_t    initialSamples = 16;        // Halton points flown before the first fit
+    uint32_t    batchSize = 16;             // Points flown per iteration
+    uint32_t    maxEvaluations = 256;
+    float       minImprovement = 0.001f;    // Stop once no candidate expects to gain this much, kg
+    uint32_t    candidateCount = 33;        // Per side of the grid the acquisition is searched from
+};
+
+struct SurrogateResult
+{
+    ShaderShared::AscentParams  bestParams;
+    ShaderShared::FlightData    bestData;
+    float       bestScore;          // CalcSelectionObjective, FLT_MAX if nothing reached MECO within the max Q limit
+    uint32_t    evaluations;
+    uint32_t    iterations;         // Sweeps run
+
+    // Evaluations and best objective after each sweep.
+    std::vector<std::pair<uint32_t, float>>     history;
+};
+
+// Flies a Halton set, then repeatedly fits the surrogate and flies a batch of the points with the highest
+// expected improvement, each climbed to by compass search from the best of a grid of candidates. Angles
+// in radians. Returns false if nothing reached MECO within the max Q limit.
+bool    SearchWithSurrogate( SweepEngine& engine, ThreadPool& threadPool, const SurrogateConfig& config, float minSpeed, float maxSpeed, float minAngle, float maxAngle,
+                             double earthRadius, double earthMu, SurrogateResult& result );
@@ -0,0 +1,182 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------------------------
+
+// Pool and index of the current worker, so nested ParallelFor calls push to their own queue.
+static thread_local const ThreadPool*   s_threadPool = nullptr;
+static thread_local uint32_t            s_threadIndex = 0;
+
+//------------------------------------------------------------------------------------------------
+
+ThreadPool::ThreadPool( uint32_t threadCount ) :
+    m_queuedTasks( 0 ),
+    m_quit( false )
+{
+    if ( threadCount == 0 )
+        threadCount = std::max( std::thread::hardware_concurrency(), 1u );
+
+    // Last queue belongs to threads outside the pool.
+    for ( uint32_t i = 0; i < threadCount; ++i )
+        m_queues.emplace_back( new WorkQueue );
+
+    for ( uint32_t i = 0; i < threadCount - 1; ++i )
+        m_threads.emplace_back( &ThreadPool::WorkerThread, this, i );
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_wakeLock );
+        m_quit = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for ( std::thread& thread : m_threads )
+        thread.join();
+}
+
+//------------------------------------------------------------------------------------------------
+
+uint32_t ThreadPool::GetThreadIndex() const
+{
+    if ( s_threadPool == this )
+        return s_threadIndex;
+
+    return GetThreadCount() - 1;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void ThreadPool::ParallelFor( uint32_t count, uint32_t grain, const std::function<void( uint32_t, uint32_t )>& func )
+{
+    if ( count == 0 )
+        return;
+
+    grain = std::max( grain, 1u );
+    uint32_t taskCount = (count + grain - 1) / grain;
+
+    if ( taskCount == 1 || m_threads.empty() )
+    {
+        func( 0, count );
+        return;
+    }
+
+    Job job;
+    job.func = &func;
+    job.remaining = taskCount;
+
+    // Count first so a thief can never see more tasks than have been counted.
+    {
+        std::lock_guard<std::mutex> lock( m_wakeLock );
+        m_queuedTasks += taskCount;
+    }
+
+    // Deal tasks round robin starting with our own queue, stealing balances whatever is left.
+    uint32_t index = GetThreadIndex();
+    uint32_t queueCount = GetThreadCount();
+    for ( uint32_t i = 0; i < queueCount; ++i )
+    {
+        WorkQueue& queue = *m_queues[(index + i) % queueCount];
+        std::lock_guard<std::mutex> lock( queue.lock );
+
+        for ( uint32_t t = i; t < taskCount; t += queueCount )
+        {
+            uint32_t begin = t * grain;
+            queue.tasks.push_back( Task{ &job, begin, std::min( begin + grain, count ) } );
+        }
+    }
+
+    m_wakeCondition.notify_all();
+
+    // Help out until our job is complete; this may run tasks from other jobs too.
+    while ( job.remaining.load( std::memory_order_acquire ) > 0 )
+    {
+        Task task;
+        if ( PopTask( index, task ) || StealTask( index, task ) )
+        {
+            RunTask( task );
+        }
+        else
+        {
+            // Remaining tasks are running on other threads.
+            std::unique_lock<std::mutex> lock( m_wakeLock );
+            m_doneCondition.wait( lock, [&job] { return job.remaining.load( std::memory_order_acquire ) == 0; } );
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+void ThreadPool::WorkerThread( uint32_t index )
+{
+    s_threadPool = this;
+    s_threadIndex = index;
+
+    for (;;)
+    {
+        Task task;
+        if ( PopTask( index, task ) || StealTask( index, task ) )
+        {
+            RunTask( task );
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock( m_wakeLock );
+        m_wakeCondition.wait( lock, [this] { return m_quit || m_queuedTasks.load() > 0; } );
+
+        if ( m_quit )
+            return;
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+bool ThreadPool::PopTask( uint32_t index, Task& task )
+{
+    WorkQueue& queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock( queue.lock );
+
+    if ( queue.tasks.empty() )
+        return false;
+
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    --m_queuedTasks;
+
+    return true;
+}
+
+bool ThreadPool::StealTask( uint32_t index, Task& task )
+{
+    uint32_t queueCount = GetThreadCount();
+    for ( uint32_t i = 1; i < queueCount; ++i )
+    {
+        WorkQueue& queue = *m_queues[(index + i) % queueCount];
+        std::lock_guard<std::mutex> lock( queue.lock );
+
+        if ( !queue.tasks.empty() )
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            --m_queuedTasks;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::RunTask( const Task& task )
+{
+    (*task.job->func)( task.begin, task.end );
+
+    if ( task.job->remaining.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+    {
+        // Take the lock so the owner can't miss the notify between its check and wait.
+        std::lock_guard<std::mutex> lock( m_wakeLock );
+        m_doneCondition.notify_all();
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------
+// Work stealing thread pool. Each thread owns a queue, pops its own work LIFO and steals FIFO from
+// the others when it runs dry. The thread calling ParallelFor takes part in the work, and calls may
+// nest (e.g. a per vehicle task running a sweep) without blocking a worker.
+
+class ThreadPool
+{
+public:
+    // threadCount includes the calling thread, 0 uses every hardware thread.
+    explicit ThreadPool( uint32_t threadCount = 0 );
+    ~ThreadPool();
+
+    ThreadPool( const ThreadPool& ) = delete;
+    ThreadPool& operator=( const ThreadPool& ) = delete;
+
+    // Total threads doing work, including the caller.
+    uint32_t    GetThreadCount() const { return static_cast<uint32_t>(m_queues.size()); }
+
+    // Index of the current thread in [0, GetThreadCount()), for per thread scratch data.
+    // Threads outside the pool share the last index.
+    uint32_t    GetThreadIndex() const;
+
+    // Calls func(begin, end) over [0, count) in chunks of at most grain items, returns when all are done.
+    void        ParallelFor( uint32_t count, uint32_t grain, const std::function<void( uint32_t, uint32_t )>& func );
+
+private:
+    struct Job
+    {
+        const std::function<void( uint32_t, uint32_t )>*  func;
+        std::atomic<uint32_t>   remaining;
+    };
+
+    struct Task
+    {
+        Job*        job;
+        uint32_t    begin;
+        uint32_t    end;
+    };
+
+    struct WorkQueue
+    {
+        std::mutex          lock;
+        std::deque<Task>    tasks;
+    };
+
+    void        WorkerThread( uint32_t index );
+
+    bool        PopTask( uint32_t index, Task& task );
+    bool        StealTask( uint32_t index, Task& task );
+    void        RunTask( const Task& task );
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread>                m_threads;
+
+    std::mutex                  m_wakeLock;
+    std::condition_variable     m_wakeCondition;
+    std::condition_variable     m_doneCondition;
+    std::atomic<uint32_t>       m_queuedTasks;
+    bool                        m_quit;
+};
@@ -0,0 +1,56 @@
+#include "VehicleBatch.h"
+#include "FlightAnalysis.h"
+
+#include <float.h>
+
+#include <chrono>
+
+using namespace ShaderShared;
+
+//------------------------------------------------------------------------------------------------
+
+void OptimiseVehicles( const FlightEnvironment& environment, const std::vector<MissionParams>& vehicles, const SweepConfig& sweepConfig, const VehicleBatchConfig& config,
+                       ThreadPool& threadPool, float minSpeed, float maxSpeed, float minAngle, float maxAngle, double earthRadius, double earthMu,
+                       std::vector<VehicleResult>& results )
+{
+    SweepConfig engineConfig = sweepConfig;
+    engineConfig.recordTelemetry = false;
+
+    results.assign( vehicles.size(), VehicleResult{} );
+
+    threadPool.ParallelFor( static_cast<uint32_t>(vehicles.size()), 1, [&] ( uint32_t begin, uint32_t end )
+    {
+        for ( uint32_t v = begin; v < end; ++v )
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            const MissionParams& missionParams = vehicles[v];
+            VehicleResult& result = results[v];
+            SweepEngine engine( environment, missionParams, engineConfig, threadPool );
+
+            if ( config.useOptimiser )
+            {
+                OptimiserResult optimised;
+                result.found = OptimiseAscent( engine, config.optimiser, minSpeed, maxSpeed, minAngle, maxAngle, earthRadius, earthMu, optimised );
+                result.bestParams = optimised.bestParams;
+                result.bestData = optimised.bestData;
+                result.evaluations = optimised.evaluations;
+            }
+            else
+            {
+                RefinementResult refined;
+                result.found = RefineSweep( engine, config.refinement, minSpeed, maxSpeed, minAngle, maxAngle, earthRadius, earthMu, refined );
+                result.bestParams = refined.bestParams;
+                result.bestData = refined.bestData;
+                result.evaluations = 0;
+                for ( const RefinementLevel& level : refined.levels )
+                    result.evaluations += level.simulated;
+            }
+
+            result.bestScore = result.found ? CalcSelectionObjective( result.bestData, missionParams, earthRadius, earthMu ) : FLT_MAX;
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            result.time = elapsed.count();
+        }
+    } );
+}
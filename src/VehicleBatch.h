@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "AscentOptimiser.h"
+#include "SweepRefinement.h"
+
+//------------------------------------------------------------------------------------------------
+// Finds the best profile for many vehicles in one process. The environment, with its compiled curves, is
+// shared read-only by every vehicle's engine; only the mission params differ. Drag curves are per stage
+// index, so every vehicle flies the same Mach sweeps.
+//
+// Each vehicle is one task on the thread pool and runs its sweeps as ParallelFor calls nested in it, so
+// threads that finish a vehicle's work steal from the others' sweeps rather than wait for the batch.
+
+struct VehicleBatchConfig
+{
+    bool                useOptimiser = false;   // OptimiseAscent, otherwise RefineSweep
+    OptimiserConfig     optimiser;
+    RefinementConfig    refinement;
+};
+
+struct VehicleResult
+{
+    bool        found;              // Something reached MECO within the max Q limit
+    ShaderShared::AscentParams  bestParams;
+    ShaderShared::FlightData    bestData;
+    float       bestScore;          // CalcSelectionObjective, FLT_MAX if not found
+    uint32_t    evaluations;        // Profiles flown
+    double      time;               // Seconds, from the vehicle's first sweep to its last
+};
+
+// Angles in radians. results gets one entry per vehicle, in order.
+void    OptimiseVehicles( const FlightEnvironment& environment, const std::vector<ShaderShared::MissionParams>& vehicles, const SweepConfig& sweepConfig,
+                          const VehicleBatchConfig& config, ThreadPool& threadPool, float minSpeed, float maxSpeed, float minAngle, float maxAngle,
+                          double earthRadius, double earthMu, std::vector<VehicleResult>& results );